@@ -49,6 +49,13 @@ using namespace SonoAudio;
 
 ChannelGroup::ChannelGroup()
 {
+    effectPool->addGroup(this);
+}
+
+ChannelGroup::~ChannelGroup()
+{
+    effectPool->removeGroup(this);
+    releaseEffects();
 }
 
 // copy assignment
@@ -56,12 +63,13 @@ void ChannelGroup::copyParametersFrom(const ChannelGroup& other)
 {
     params = other.params;
 
-    compressorParamsChanged = true;
-    expanderParamsChanged = true;
-    eqParamsChanged = true;
-    limiterParamsChanged = true;
+    commitCompressorParams();
+    commitExpanderParams();
+    commitEqParams();
+    commitLimiterParams();
     monitorDelayParamsChanged = true;
 
+    reserveEffects();
 }
 
 void ChannelGroupParams::setToDefaults(bool isplugin)
@@ -89,66 +97,103 @@ void ChannelGroupParams::setToDefaults(bool isplugin)
 
 void ChannelGroup::init(double sampRate)
 {
-    sampleRate = sampRate;
-    
-    if (!compressor) {
-        compressor = std::make_unique<faustCompressor>();
-        compressorControl = std::make_unique<MapUI>();
+    if (lrint(sampRate) != lrint(sampleRate.load())) {
+        // effects built for the old rate go back to the pool, new ones get picked up when needed
+        sampleRate = sampRate;
+        releaseEffects();
+    }
+    else {
+        // just reset the state of the ones we have
+        const ScopedLock sl(effectsLock);
+        if (auto * fx = compressor.load()) fx->dsp.instanceClear();
+        if (auto * fx = expander.load()) fx->dsp.instanceClear();
+        if (auto * fx = limiter.load()) fx->dsp.instanceClear();
+        for (int j=0; j < 2; ++j) {
+            if (auto * fx = eq[j].load()) fx->dsp.instanceClear();
+        }
     }
-    compressor->init(sampleRate);
-    compressor->buildUserInterface(compressorControl.get());
 
-    //DBG("Compressor Params:");
-    //for(int i=0; i < mInputCompressorControl.getParamsCount(); i++){
-    //    DBG(mInputCompressorControl.getParamAddress(i));
-    //}
+    sampleRate = sampRate;
+
+    commitCompressorParams();
+    commitExpanderParams();
+    commitEqParams();
+    commitLimiterParams();
+    commitMonitorDelayParams();
 
-    if (!expander) {
-        expander = std::make_unique<faustExpander>();
-        expanderControl = std::make_unique<MapUI>();
-    }
+}
 
-    expander->init(sampleRate);
-    expander->buildUserInterface(expanderControl.get());
+void ChannelGroup::releaseEffects()
+{
+    const ScopedLock sl(effectsLock);
 
-    //DBG("Expander Params:");
-    //for(int i=0; i < mInputExpanderControl.getParamsCount(); i++){
-    //    DBG(mInputExpanderControl.getParamAddress(i));
-    //}
+    auto * oldcompressor = compressor.exchange(nullptr);
+    auto * oldexpander = expander.exchange(nullptr);
+    auto * oldlimiter = limiter.exchange(nullptr);
+    EqEffect * oldeq[2] = { eq[0].exchange(nullptr), eq[1].exchange(nullptr) };
 
-    for (int j=0; j < 2; ++j) {
-        if (!eq[j]) {
-            eq[j] = std::make_unique<faustParametricEQ>();
-            eqControl[j] = std::make_unique<MapUI>();
-        }
-        eq[j]->init(sampleRate);
-        eq[j]->buildUserInterface(eqControl[j].get());
+    // the audio thread may still be computing with them, it only sees the null ones from now on
+    while (effectsInUse.load()) {
+        Thread::yield();
     }
 
-    //DBG("EQ Params:");
-    //for(int i=0; i < mInputEqControl[0].getParamsCount(); i++){
-    //    DBG(mInputEqControl[0].getParamAddress(i));
-    //}
+    compressorOutputLevel = nullptr;
+    expanderOutputGain = nullptr;
 
-    if (!limiter) {
-        limiter = std::make_unique<faustCompressor>();
-        limiterControl = std::make_unique<MapUI>();
+    effectPool->release(oldcompressor);
+    effectPool->release(oldexpander);
+    effectPool->release(oldlimiter);
+    for (int j=0; j < 2; ++j) {
+        effectPool->release(oldeq[j]);
     }
+}
 
-    limiter->init(sampleRate);
-    limiter->buildUserInterface(limiterControl.get());
+bool ChannelGroup::isMissingEffects() const
+{
+    if (params.numChannels <= 0 || params.numChannels > 2) return false;
 
-    //DBG("Limiter Params:");
-    //for(int i=0; i < mInputLimiterControl.getParamsCount(); i++){
-    //    DBG(mInputLimiterControl.getParamAddress(i));
-    //}
+    return (params.compressorParams.enabled && !compressor.load())
+        || (params.limiterParams.enabled && !limiter.load())
+        || (params.expanderParams.enabled && !expander.load())
+        || (params.eqParams.enabled && (!eq[0].load() || !eq[1].load()));
+}
 
-    commitCompressorParams();
-    commitExpanderParams();
-    commitEqParams();
-    commitLimiterParams();
-    commitMonitorDelayParams();
+void ChannelGroup::reserveEffects()
+{
+    const ScopedLock sl(effectsLock);
+
+    if (params.numChannels <= 0 || params.numChannels > 2) return;
+
+    const int rate = (int) lrint(sampleRate.load());
 
+    // published only once the parameters are applied
+    if (params.compressorParams.enabled && !compressor.load()) {
+        if (auto * fx = effectPool->acquireCompressor(rate)) {
+            applyCompressorParams(*fx);
+            compressor = fx;
+        }
+    }
+    if (params.limiterParams.enabled && !limiter.load()) {
+        if (auto * fx = effectPool->acquireCompressor(rate)) {
+            applyLimiterParams(*fx);
+            limiter = fx;
+        }
+    }
+    if (params.expanderParams.enabled && !expander.load()) {
+        if (auto * fx = effectPool->acquireExpander(rate)) {
+            applyExpanderParams(*fx);
+            expander = fx;
+        }
+    }
+    if (params.eqParams.enabled) {
+        for (int j=0; j < 2; ++j) {
+            if (eq[j].load()) continue;
+            if (auto * fx = effectPool->acquireEq(rate)) {
+                applyEqParams(*fx);
+                eq[j] = fx;
+            }
+        }
+    }
 }
 
 void ChannelGroup::setMonitoringDelayEnabled(bool enabled, int numchans)
@@ -160,7 +205,7 @@ void ChannelGroup::setMonitoringDelayEnabled(bool enabled, int numchans)
             monitorDelayLine = std::make_unique<juce::dsp::DelayLine<float,juce::dsp::DelayLineInterpolationTypes::None> >(MAX_DELAY_SAMPLES);
             monitorDelayLine->setDelay(_monitorDelayTimeSamples);
 
-            juce::dsp::ProcessSpec delayspec = { sampleRate, 4096, (juce::uint32) numchans };
+            juce::dsp::ProcessSpec delayspec = { sampleRate.load(), 4096, (juce::uint32) numchans };
             monitorDelayLine->prepare(delayspec);
 
             _monitorDelayChans = numchans;
@@ -170,7 +215,7 @@ void ChannelGroup::setMonitoringDelayEnabled(bool enabled, int numchans)
             //
             const ScopedLock lock(_monitorDelayLock);
 
-            juce::dsp::ProcessSpec delayspec = { sampleRate, 4096, (juce::uint32) numchans };
+            juce::dsp::ProcessSpec delayspec = { sampleRate.load(), 4096, (juce::uint32) numchans };
             monitorDelayLine->prepare(delayspec);
             monitorDelayLine->reset();
             _monitorDelayChans = numchans;
@@ -193,7 +238,7 @@ void ChannelGroup::setMonitoringDelayEnabled(bool enabled, int numchans)
 void ChannelGroup::setMonitoringDelayTimeMs(double delayms)
 {
     params.monitorDelayParams.delayTimeMs = delayms;
-    auto newsamps = 1e-3 * delayms * sampleRate;
+    auto newsamps = 1e-3 * delayms * sampleRate.load();
     if ( fabs(_monitorDelayTimeSamples - newsamps) > 1) {
         _monitorDelayTimeSamples = jmin(newsamps, (double)MAX_DELAY_SAMPLES);
         _monitorDelayTimeChanged = true;
@@ -239,78 +284,78 @@ void ChannelGroup::processBlock (AudioBuffer<float>& frombuffer,
 
     procstate.lastlevel = dogain;
 
-    // these all operate ONLY when the channel group has 1 or 2 channels (and when the effects have been initialized)
-    if (params.numChannels > 0 && params.numChannels <= 2 && compressor)
+    // these all operate ONLY when the channel group has 1 or 2 channels (and when the effects are available from the pool)
+    if (params.numChannels > 0 && params.numChannels <= 2)
     {
-        // apply input expander
-        if (expanderParamsChanged) {
-            commitExpanderParams();
-            expanderParamsChanged = false;
+        effectsInUse = true;
+
+        if (isMissingEffects() && !effectsWanted.exchange(true)) {
+            effectPool->requestEffects();
         }
-        if (_lastExpanderEnabled || params.expanderParams.enabled) {
+
+        // apply input expander
+        if (auto * fx = expander.load(); fx && (_lastExpanderEnabled || params.expanderParams.enabled)) {
             if (tobufNumChan - destStartChan > 1 && numchan == 2 && destNumChans >= 2) {
                 float *bufs[2] = { tobuffer.getWritePointer(destStartChan), tobuffer.getWritePointer(destStartChan+1)};
-                expander->compute(numSamples, bufs, bufs);
+                fx->dsp.compute(numSamples, bufs, bufs);
             } else if (destStartChan < tobufNumChan) {
                 float *bufs[2] = { tobuffer.getWritePointer(destStartChan), silentBuffer.getWritePointer(0) }; // just a silent dummy buffer
-                expander->compute(numSamples, bufs, bufs);
+                fx->dsp.compute(numSamples, bufs, bufs);
             }
         }
         _lastExpanderEnabled = params.expanderParams.enabled;
 
 
         // apply input compressor
-        if (compressorParamsChanged) {
-            commitCompressorParams();
-            compressorParamsChanged = false;
-        }
-        if (_lastCompressorEnabled || params.compressorParams.enabled) {
+        if (auto * fx = compressor.load(); fx && (_lastCompressorEnabled || params.compressorParams.enabled)) {
             if (tobufNumChan - destStartChan > 1 && numchan == 2 && destNumChans >= 2) {
                 float *bufs[2] = { tobuffer.getWritePointer(destStartChan), tobuffer.getWritePointer(destStartChan+1)};
-                compressor->compute(numSamples, bufs, bufs);
+                fx->dsp.compute(numSamples, bufs, bufs);
             } else if (destStartChan < tobufNumChan) {
                 float *bufs[2] = { tobuffer.getWritePointer(destStartChan), silentBuffer.getWritePointer(0) }; // just a silent dummy buffer
-                compressor->compute(numSamples, bufs, bufs);
+                fx->dsp.compute(numSamples, bufs, bufs);
             }
         }
         _lastCompressorEnabled = params.compressorParams.enabled;
 
 
         // apply input EQ
-        if (eqParamsChanged) {
-            commitEqParams();
-            eqParamsChanged = false;
-        }
-        if (_lastEqEnabled || params.eqParams.enabled) {
+        EqEffect * eqfx[2] = { eq[0].load(), eq[1].load() };
+        if ((_lastEqEnabled || params.eqParams.enabled) && eqfx[0] && eqfx[1]) {
             if (tobufNumChan - destStartChan > 1 && numchan == 2 && destNumChans >= 2) {
                 // only 2 channels support for now... TODO
                 float *bufs[2] = { tobuffer.getWritePointer(destStartChan), tobuffer.getWritePointer(destStartChan+1)};
-                eq[0]->compute(numSamples, &bufs[0], &bufs[0]);
-                eq[1]->compute(numSamples, &bufs[1], &bufs[1]);
+                eqfx[0]->dsp.compute(numSamples, &bufs[0], &bufs[0]);
+                eqfx[1]->dsp.compute(numSamples, &bufs[1], &bufs[1]);
             } else if (destStartChan < tobufNumChan) {
                 float *inbuf = tobuffer.getWritePointer(destStartChan);
                 float *outbuf = tobuffer.getWritePointer(destStartChan);
-                eq[0]->compute(numSamples, &inbuf, &outbuf);
+                eqfx[0]->dsp.compute(numSamples, &inbuf, &outbuf);
             }
         }
         _lastEqEnabled = params.eqParams.enabled;
 
 
         // apply input limiter
-        if (limiterParamsChanged) {
-            commitLimiterParams();
-            limiterParamsChanged = false;
-        }
-        if (_lastLimiterEnabled || params.limiterParams.enabled) {
+        if (auto * fx = limiter.load(); fx && (_lastLimiterEnabled || params.limiterParams.enabled)) {
             if (tobufNumChan - destStartChan > 1 && numchan == 2 && destNumChans >= 2) {
                 float *bufs[2] = { tobuffer.getWritePointer(destStartChan), tobuffer.getWritePointer(destStartChan+1)};
-                limiter->compute(numSamples, bufs, bufs);
+                fx->dsp.compute(numSamples, bufs, bufs);
             } else if (destStartChan < tobufNumChan) {
                 float *bufs[2] = { tobuffer.getWritePointer(destStartChan), silentBuffer.getWritePointer(0) }; // just a silent dummy buffer
-                limiter->compute(numSamples, bufs, bufs);
+                fx->dsp.compute(numSamples, bufs, bufs);
+            }
+        }
+        else if (params.limiterParams.enabled) {
+            // no limiter from the pool yet, never let it through unlimited
+            const float ceiling = Decibels::decibelsToGain(params.limiterParams.thresholdDb);
+            for (int i = destStartChan; i < destStartChan + jmin(numchan, destNumChans) && i < tobufNumChan; ++i) {
+                FloatVectorOperations::clip(tobuffer.getWritePointer(i), tobuffer.getReadPointer(i), -ceiling, ceiling, numSamples);
             }
         }
         _lastLimiterEnabled = params.limiterParams.enabled;
+
+        effectsInUse = false;
     }
     
     // apply to reverb buffer
@@ -782,7 +827,13 @@ void ChannelGroup::commitAllParams()
 
 void ChannelGroup::commitCompressorParams()
 {
-    if (!compressorControl) return;
+    const ScopedLock sl(effectsLock);
+    if (auto * fx = compressor.load()) applyCompressorParams(*fx);
+}
+
+void ChannelGroup::applyCompressorParams(CompressorEffect & fx)
+{
+    auto * compressorControl = &fx.control;
     compressorControl->setParamValue("/compressor/Bypass", params.compressorParams.enabled ? 0.0f : 1.0f);
     compressorControl->setParamValue("/compressor/knee", 2.0f);
     compressorControl->setParamValue("/compressor/threshold", params.compressorParams.thresholdDb);
@@ -800,7 +851,13 @@ void ChannelGroup::commitCompressorParams()
 
 void ChannelGroup::commitExpanderParams()
 {
-    if (!expanderControl) return;
+    const ScopedLock sl(effectsLock);
+    if (auto * fx = expander.load()) applyExpanderParams(*fx);
+}
+
+void ChannelGroup::applyExpanderParams(ExpanderEffect & fx)
+{
+    auto * expanderControl = &fx.control;
     //mInputCompressorControl.setParamValue("/compressor/Bypass", mInputCompressorParams.enabled ? 0.0f : 1.0f);
     expanderControl->setParamValue("/expander/knee", 3.0f);
     expanderControl->setParamValue("/expander/threshold", params.expanderParams.thresholdDb);
@@ -817,7 +874,13 @@ void ChannelGroup::commitExpanderParams()
 
 void ChannelGroup::commitLimiterParams()
 {
-    if (!limiterControl) return;
+    const ScopedLock sl(effectsLock);
+    if (auto * fx = limiter.load()) applyLimiterParams(*fx);
+}
+
+void ChannelGroup::applyLimiterParams(CompressorEffect & fx)
+{
+    auto * limiterControl = &fx.control;
 
     limiterControl->setParamValue("/compressor/Bypass", params.limiterParams.enabled ? 0.0f : 1.0f);
     limiterControl->setParamValue("/compressor/threshold", params.limiterParams.thresholdDb);
@@ -829,22 +892,28 @@ void ChannelGroup::commitLimiterParams()
 
 void ChannelGroup::commitEqParams()
 {
-    if (!eqControl[0]) return;
-
+    const ScopedLock sl(effectsLock);
     for (int i=0; i < 2; ++i) {
-        eqControl[i]->setParamValue("/parametric_eq/low_shelf/gain", params.eqParams.lowShelfGain);
-        eqControl[i]->setParamValue("/parametric_eq/low_shelf/transition_freq", params.eqParams.lowShelfFreq);
-        eqControl[i]->setParamValue("/parametric_eq/para1/peak_gain", params.eqParams.para1Gain);
-        eqControl[i]->setParamValue("/parametric_eq/para1/peak_frequency", params.eqParams.para1Freq);
-        eqControl[i]->setParamValue("/parametric_eq/para1/peak_q", params.eqParams.para1Q);
-        eqControl[i]->setParamValue("/parametric_eq/para2/peak_gain", params.eqParams.para2Gain);
-        eqControl[i]->setParamValue("/parametric_eq/para2/peak_frequency", params.eqParams.para2Freq);
-        eqControl[i]->setParamValue("/parametric_eq/para2/peak_q", params.eqParams.para2Q);
-        eqControl[i]->setParamValue("/parametric_eq/high_shelf/gain", params.eqParams.highShelfGain);
-        eqControl[i]->setParamValue("/parametric_eq/high_shelf/transition_freq", params.eqParams.highShelfFreq);
+        if (auto * fx = eq[i].load()) applyEqParams(*fx);
     }
 }
 
+void ChannelGroup::applyEqParams(EqEffect & fx)
+{
+    auto * eqControl = &fx.control;
+
+    eqControl->setParamValue("/parametric_eq/low_shelf/gain", params.eqParams.lowShelfGain);
+    eqControl->setParamValue("/parametric_eq/low_shelf/transition_freq", params.eqParams.lowShelfFreq);
+    eqControl->setParamValue("/parametric_eq/para1/peak_gain", params.eqParams.para1Gain);
+    eqControl->setParamValue("/parametric_eq/para1/peak_frequency", params.eqParams.para1Freq);
+    eqControl->setParamValue("/parametric_eq/para1/peak_q", params.eqParams.para1Q);
+    eqControl->setParamValue("/parametric_eq/para2/peak_gain", params.eqParams.para2Gain);
+    eqControl->setParamValue("/parametric_eq/para2/peak_frequency", params.eqParams.para2Freq);
+    eqControl->setParamValue("/parametric_eq/para2/peak_q", params.eqParams.para2Q);
+    eqControl->setParamValue("/parametric_eq/high_shelf/gain", params.eqParams.highShelfGain);
+    eqControl->setParamValue("/parametric_eq/high_shelf/transition_freq", params.eqParams.highShelfFreq);
+}
+
 void ChannelGroup::commitMonitorDelayParams()
 {
     setMonitoringDelayTimeMs(params.monitorDelayParams.delayTimeMs);
@@ -852,3 +921,91 @@ void ChannelGroup::commitMonitorDelayParams()
 }
 
 
+
+
+ChannelGroupEffectPool::ChannelGroupEffectPool() : Thread("ChannelGroupEffectPool")
+{
+    startThread(Thread::Priority::low);
+}
+
+ChannelGroupEffectPool::~ChannelGroupEffectPool()
+{
+    stopThread(2000);
+}
+
+CompressorEffect * ChannelGroupEffectPool::acquireCompressor(int sampleRate)
+{
+    int numLeft = 0;
+    const ScopedLock sl(buildLock);
+    compressors.fill(sampleRate, 1);
+    auto * effect = compressors.acquire(sampleRate, numLeft);
+    requestRefill(sampleRate, numLeft);
+    return effect;
+}
+
+ExpanderEffect * ChannelGroupEffectPool::acquireExpander(int sampleRate)
+{
+    int numLeft = 0;
+    const ScopedLock sl(buildLock);
+    expanders.fill(sampleRate, 1);
+    auto * effect = expanders.acquire(sampleRate, numLeft);
+    requestRefill(sampleRate, numLeft);
+    return effect;
+}
+
+EqEffect * ChannelGroupEffectPool::acquireEq(int sampleRate)
+{
+    int numLeft = 0;
+    const ScopedLock sl(buildLock);
+    eqs.fill(sampleRate, 1);
+    auto * effect = eqs.acquire(sampleRate, numLeft);
+    requestRefill(sampleRate, numLeft);
+    return effect;
+}
+
+void ChannelGroupEffectPool::requestRefill(int sampleRate, int numLeft)
+{
+    // picked up on the next poll
+    if (numLeft < minFreeEffects) {
+        refillSampleRate = sampleRate;
+    }
+}
+
+void ChannelGroupEffectPool::addGroup(ChannelGroup * group)
+{
+    const ScopedLock sl(groupsLock);
+    groups.add(group);
+}
+
+void ChannelGroupEffectPool::removeGroup(ChannelGroup * group)
+{
+    // waits if the pool thread is serving it right now
+    const ScopedLock sl(groupsLock);
+    groups.removeFirstMatchingValue(group);
+}
+
+void ChannelGroupEffectPool::run()
+{
+    while (!threadShouldExit()) {
+        wait(refillPollMs);
+
+        if (effectsRequested.exchange(false)) {
+            const ScopedLock sl(groupsLock);
+            for (auto * group : groups) {
+                if (group->effectsWanted.exchange(false)) {
+                    group->reserveEffects();
+                }
+            }
+        }
+
+        int sampleRate = refillSampleRate.exchange(0);
+        if (sampleRate > 0 && !threadShouldExit()) {
+            // faust classInit is not thread safe, so build one at a time
+            const ScopedLock sl(buildLock);
+
+            compressors.fill(sampleRate, minFreeEffects * 2);
+            expanders.fill(sampleRate, minFreeEffects * 2);
+            eqs.fill(sampleRate, minFreeEffects * 2);
+        }
+    }
+}
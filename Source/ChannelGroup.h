@@ -12,12 +12,146 @@
 
 #include "EffectParams.h"
 
+#include <map>
+#include <vector>
+
 namespace SonoAudio {
 
 #ifndef MAX_CHANNELS
 #define MAX_CHANNELS 64
 #endif
 
+// a faust effect along with its parameter map
+template<class DSPType>
+struct FaustEffect
+{
+    DSPType dsp;
+    MapUI control;
+    int sampleRate = 0;
+};
+
+typedef FaustEffect<faustCompressor> CompressorEffect; // also used for the limiter
+typedef FaustEffect<faustExpander> ExpanderEffect;
+typedef FaustEffect<faustParametricEQ> EqEffect;
+
+// free list of built effects of one kind, keyed by sample rate
+template<class DSPType>
+class FaustEffectList
+{
+public:
+    typedef FaustEffect<DSPType> Effect;
+
+    ~FaustEffectList() {
+        for (auto & item : freeEffects) {
+            for (auto * effect : item.second) delete effect;
+        }
+    }
+
+    // returns nullptr if none is free at the sample rate
+    Effect * acquire(int sampleRate, int & numLeft) {
+        const SpinLock::ScopedLockType lock(listLock);
+        auto found = freeEffects.find(sampleRate);
+        if (found == freeEffects.end() || found->second.empty()) {
+            numLeft = 0;
+            return nullptr;
+        }
+        auto * effect = found->second.back();
+        found->second.pop_back();
+        numLeft = (int) found->second.size();
+        return effect;
+    }
+
+    // resets the effect state and makes it available again
+    void release(Effect * effect, int maxFree) {
+        if (!effect) return;
+        effect->dsp.instanceResetUserInterface();
+        effect->dsp.instanceClear();
+
+        const SpinLock::ScopedLockType lock(listLock);
+        auto & effects = freeEffects[effect->sampleRate];
+        if ((int) effects.size() < maxFree) {
+            effects.push_back(effect);
+        } else {
+            delete effect;
+        }
+    }
+
+    // builds effects until at least count of them are free at the sample rate
+    void fill(int sampleRate, int count) {
+        int needed;
+        {
+            const SpinLock::ScopedLockType lock(listLock);
+            needed = count - (int) freeEffects[sampleRate].size();
+        }
+
+        for (int i=0; i < needed; ++i) {
+            auto * effect = new Effect();
+            effect->sampleRate = sampleRate;
+            effect->dsp.init(sampleRate);
+            effect->dsp.buildUserInterface(&effect->control);
+
+            const SpinLock::ScopedLockType lock(listLock);
+            freeEffects[sampleRate].push_back(effect);
+        }
+    }
+
+private:
+    SpinLock listLock;
+    std::map<int, std::vector<Effect*>> freeEffects;
+};
+
+class ChannelGroup;
+
+// Pool of channel group effects shared by all channel groups (use it through a SharedResourcePointer).
+// Channel groups take effects out of it once an effect is enabled, and return them when they are
+// destroyed (e.g. on peer removal) or re-initialized at a new sample rate. None of this happens on the
+// audio thread, which can only ask for them: the pool thread then hands the missing effects to the
+// groups that asked, with their parameters applied. It also keeps a few spare ones built for the
+// sample rates in use.
+class ChannelGroupEffectPool : private Thread
+{
+public:
+    ChannelGroupEffectPool();
+    ~ChannelGroupEffectPool() override;
+
+    // not realtime safe, builds one if none is free
+    CompressorEffect * acquireCompressor(int sampleRate);
+    ExpanderEffect * acquireExpander(int sampleRate);
+    EqEffect * acquireEq(int sampleRate);
+
+    // not realtime safe
+    void release(CompressorEffect * effect) { compressors.release(effect, maxFreeEffects); }
+    void release(ExpanderEffect * effect) { expanders.release(effect, maxFreeEffects); }
+    void release(EqEffect * effect) { eqs.release(effect, maxFreeEffects); }
+
+    // realtime safe, the pool thread serves the groups that asked on its next poll
+    void requestEffects() { effectsRequested = true; }
+
+    static const int minFreeEffects = 2;
+    static const int maxFreeEffects = 32;
+    static const int refillPollMs = 20;
+
+private:
+    friend class ChannelGroup;
+
+    void run() override;
+    void requestRefill(int sampleRate, int numLeft);
+
+    void addGroup(ChannelGroup * group);
+    void removeGroup(ChannelGroup * group);
+
+    FaustEffectList<faustCompressor> compressors;
+    FaustEffectList<faustExpander> expanders;
+    FaustEffectList<faustParametricEQ> eqs;
+
+    std::atomic<int> refillSampleRate { 0 };
+    std::atomic<bool> effectsRequested { false };
+    CriticalSection buildLock;
+
+    Array<ChannelGroup*> groups;
+    CriticalSection groupsLock;
+};
+
 // used to encapsulate audio processing for grouped set of audio
 // is used for both local or remote audio input
 
@@ -94,10 +228,15 @@ class ChannelGroup
 public:
 
     ChannelGroup();
+    ~ChannelGroup();
 
-
+    // effects are not created here, but taken from the shared pool once they are enabled
     void init(double sampleRate);
 
+    // takes the enabled effects this group doesn't have yet from the pool and applies the parameters to them,
+    // call it after enabling one (not realtime safe)
+    void reserveEffects();
+
     struct ProcessState
     {
         float lastlevel = 0.0f;
@@ -118,6 +257,7 @@ public:
     // shallow copy of parameters and state
     void copyParametersFrom(const ChannelGroup& other);
 
+    // apply the parameters to the effects, not realtime safe
     void commitAllParams();
     
     void commitCompressorParams();
@@ -136,31 +276,24 @@ public:
     ProcessState inRevProcState;
     ProcessState revProcState;
 
+    // effects are set under effectsLock with their parameters already applied, the audio thread only uses them
     // compressor (only used for 1 or 2 channel groups)
-    std::unique_ptr<faustCompressor> compressor;
-    std::unique_ptr<MapUI> compressorControl;
+    std::atomic<CompressorEffect*> compressor { nullptr };
     float * compressorOutputLevel = nullptr;
-    bool compressorParamsChanged = false;
     bool _lastCompressorEnabled = false;
 
     // gate/expander
-    std::unique_ptr<faustExpander> expander;
-    std::unique_ptr<MapUI>  expanderControl;
-    bool expanderParamsChanged = false;
+    std::atomic<ExpanderEffect*> expander { nullptr };
     bool _lastExpanderEnabled = false;
     float * expanderOutputGain = nullptr;
 
     // EQ (stereo only)
-    std::unique_ptr<faustParametricEQ> eq[2];
-    std::unique_ptr<MapUI>  eqControl[2];
-    bool eqParamsChanged = false;
+    std::atomic<EqEffect*> eq[2] = { {nullptr}, {nullptr} };
     bool _lastEqEnabled = false;
 
     // limiter
     //faustLimiter mInputLimiter;
-    std::unique_ptr<faustCompressor> limiter;
-    std::unique_ptr<MapUI>  limiterControl;
-    bool limiterParamsChanged = false;
+    std::atomic<CompressorEffect*> limiter { nullptr };
     bool _lastLimiterEnabled = false;
 
     // monitoring delay
@@ -177,7 +310,30 @@ public:
     AudioBuffer<float> delayWorkBuffer;
 
 
-    double sampleRate = 48000.0;
+    std::atomic<double> sampleRate { 48000.0 };
+
+private:
+    friend class ChannelGroupEffectPool;
+
+    // realtime safe
+    bool isMissingEffects() const;
+
+    void applyCompressorParams(CompressorEffect & fx);
+    void applyExpanderParams(ExpanderEffect & fx);
+    void applyLimiterParams(CompressorEffect & fx);
+    void applyEqParams(EqEffect & fx);
+
+    // waits until the audio thread is done with them
+    void releaseEffects();
+
+    // set while processBlock uses the effects
+    std::atomic<bool> effectsInUse { false };
+
+    // set by the audio thread when an enabled effect is missing, cleared by the pool thread
+    std::atomic<bool> effectsWanted { false };
+    CriticalSection effectsLock;
+
+    SharedResourcePointer<ChannelGroupEffectPool> effectPool;
 };
 
 }
@@ -0,0 +1,402 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+
+#include "LocalTransport.h"
+
+#if JUCE_LINUX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#endif
+
+using namespace SonoAudio;
+
+namespace {
+
+const uint32 queueMagic = 0x53424c54; // "SBLT"
+const uint32 queueVersion = 1;
+
+const int numSlots = 256; // power of two
+const int maxPacketSize = 4096; // AOO_MAXPACKETSIZE
+
+// how long to wait before looking for the queue of a local peer again
+const double retryIntervalMs = 2000.0;
+
+// a full queue whose read position doesn't move for this long is wedged, e.g. by a sender
+// that died between claiming a slot and publishing it
+const double stallTimeoutMs = 500.0;
+
+String getQueueName(int port)
+{
+    return "/sonobus-local-" + String(port);
+}
+
+}
+
+struct LocalTransport::Queue
+{
+    struct Slot
+    {
+        std::atomic<uint64> sequence;
+        int32 senderPort;
+        int32 size;
+        char data[maxPacketSize];
+    };
+
+    std::atomic<uint32> magic;
+    uint32 version;
+    int32 port;
+    int32 ownerPid;
+    std::atomic<uint32> closed;
+
+    // futex word, bumped for every packet
+    alignas(64) std::atomic<uint32> signal;
+    std::atomic<uint32> sleeping;
+
+    alignas(64) std::atomic<uint64> writePos;
+    alignas(64) std::atomic<uint64> readPos;
+
+    alignas(64) Slot slots[numSlots];
+};
+
+static_assert(std::atomic<uint32>::is_always_lock_free && std::atomic<uint64>::is_always_lock_free,
+              "shared memory queue needs address-free atomics");
+
+
+#if JUCE_LINUX
+
+static void futexWait(std::atomic<uint32> * addr, uint32 expected, int timeoutMs)
+{
+    struct timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+    // not FUTEX_PRIVATE_FLAG, the word is shared between processes
+    syscall(SYS_futex, reinterpret_cast<uint32*>(addr), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+static void futexWake(std::atomic<uint32> * addr)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32*>(addr), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+#endif
+
+
+LocalTransport::LocalTransport()
+{
+    for (auto & addr : IPAddress::getAllAddresses(false)) {
+        localAddresses.add(addr.toString());
+    }
+}
+
+LocalTransport::~LocalTransport()
+{
+    close();
+}
+
+bool LocalTransport::isSupported()
+{
+#if JUCE_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool LocalTransport::open(int port)
+{
+    close();
+
+    if (port <= 0) return false;
+
+    inbound = mapQueue(port, true);
+    if (!inbound) {
+        return false;
+    }
+
+    localPort = port;
+    DBG("Opened local transport queue for port " << port);
+    return true;
+}
+
+void LocalTransport::close()
+{
+    {
+        const ScopedLock sl (outboundLock);
+        for (auto & item : outbound) {
+            unmapQueue(item.second.queue);
+        }
+        outbound.clear();
+    }
+
+    if (inbound) {
+#if JUCE_LINUX
+        // senders notice this and go back to UDP
+        inbound->closed.store(1);
+        shm_unlink(getQueueName(localPort).toRawUTF8());
+#endif
+        unmapQueue(inbound);
+        inbound = nullptr;
+        localPort = 0;
+    }
+}
+
+bool LocalTransport::isLocalAddress(const String & ipaddr) const
+{
+    return ipaddr.startsWith("127.") || localAddresses.contains(ipaddr);
+}
+
+LocalTransport::Queue * LocalTransport::mapQueue(int port, bool create)
+{
+#if JUCE_LINUX
+    auto name = getQueueName(port);
+
+    int fd = -1;
+    if (create) {
+        // anything left under our name is from a crashed instance, we own the port now
+        shm_unlink(name.toRawUTF8());
+        fd = shm_open(name.toRawUTF8(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd >= 0 && ftruncate(fd, sizeof(Queue)) != 0) {
+            ::close(fd);
+            shm_unlink(name.toRawUTF8());
+            fd = -1;
+        }
+    }
+    else {
+        fd = shm_open(name.toRawUTF8(), O_RDWR, 0);
+        struct stat st;
+        if (fd >= 0 && (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(Queue))) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    void * mem = mmap(nullptr, sizeof(Queue), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (mem == MAP_FAILED) {
+        DBG("Error mapping local transport queue " << name);
+        if (create) shm_unlink(name.toRawUTF8());
+        return nullptr;
+    }
+
+    auto queue = static_cast<Queue*>(mem);
+
+    if (create) {
+        // fresh segments are zero filled
+        queue->version = queueVersion;
+        queue->port = port;
+        queue->ownerPid = (int32) getpid();
+        for (int i = 0; i < numSlots; ++i) {
+            queue->slots[i].sequence.store((uint64) i, std::memory_order_relaxed);
+        }
+        queue->magic.store(queueMagic, std::memory_order_release);
+    }
+    else if (queue->magic.load(std::memory_order_acquire) != queueMagic
+             || queue->version != queueVersion || queue->port != port || queue->closed.load() != 0) {
+        unmapQueue(queue);
+        return nullptr;
+    }
+
+    return queue;
+#else
+    ignoreUnused(port, create);
+    return nullptr;
+#endif
+}
+
+void LocalTransport::unmapQueue(Queue * queue)
+{
+#if JUCE_LINUX
+    if (queue) {
+        munmap(queue, sizeof(Queue));
+    }
+#else
+    ignoreUnused(queue);
+#endif
+}
+
+LocalTransport::Queue * LocalTransport::getOutbound(int destPort)
+{
+    // outboundLock must be held
+    auto & mapping = outbound[destPort];
+
+    if (mapping.queue && mapping.queue->closed.load(std::memory_order_relaxed) != 0) {
+        unmapQueue(mapping.queue);
+        mapping.queue = nullptr;
+    }
+
+    if (!mapping.queue) {
+        auto now = Time::getMillisecondCounterHiRes();
+        if (now < mapping.retryStamp) {
+            return nullptr;
+        }
+
+        mapping.queue = mapQueue(destPort, false);
+
+        if (mapping.queue && mapping.stalled) {
+            if (mapping.queue->readPos.load() == mapping.stalledReadPos) {
+                dropOutbound(mapping);
+                return nullptr;
+            }
+            mapping.stalled = false;
+        }
+
+        if (!mapping.queue) {
+            mapping.retryStamp = now + retryIntervalMs;
+        }
+        else {
+            mapping.lastReadPos = mapping.queue->readPos.load();
+            mapping.readProgressStamp = now;
+            DBG("Using local transport to port " << destPort);
+        }
+    }
+
+    return mapping.queue;
+}
+
+void LocalTransport::dropOutbound(Mapping & mapping)
+{
+    // outboundLock must be held
+    unmapQueue(mapping.queue);
+    mapping.queue = nullptr;
+    mapping.retryStamp = Time::getMillisecondCounterHiRes() + retryIntervalMs;
+}
+
+bool LocalTransport::send(int destPort, const void * data, int size)
+{
+#if JUCE_LINUX
+    if (!inbound || size <= 0 || size > maxPacketSize) return false;
+
+    // held while copying, so a queue can't get unmapped under us
+    const ScopedLock sl (outboundLock);
+
+    auto queue = getOutbound(destPort);
+    if (!queue) return false;
+
+    // bounded multi-producer ring, every slot has a sequence number telling its state
+    auto pos = queue->writePos.load(std::memory_order_relaxed);
+    Queue::Slot * slot;
+
+    for (;;) {
+        slot = &queue->slots[pos & (numSlots - 1)];
+        auto seq = slot->sequence.load(std::memory_order_acquire);
+        auto diff = (int64) seq - (int64) pos;
+
+        if (diff == 0) {
+            if (queue->writePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            auto & mapping = outbound[destPort];
+
+            // full, check if the receiver is still around
+            if (kill((pid_t) queue->ownerPid, 0) != 0 && errno == ESRCH) {
+                DBG("Local transport receiver on port " << destPort << " has gone away");
+                dropOutbound(mapping);
+                return false;
+            }
+
+            // and if it's still getting anywhere
+            const auto readpos = queue->readPos.load();
+            const auto now = Time::getMillisecondCounterHiRes();
+            if (readpos != mapping.lastReadPos) {
+                mapping.lastReadPos = readpos;
+                mapping.readProgressStamp = now;
+            }
+            else if (now - mapping.readProgressStamp > stallTimeoutMs) {
+                DBG("Local transport queue to port " << destPort << " is stuck, using UDP");
+                mapping.stalled = true;
+                mapping.stalledReadPos = readpos;
+                dropOutbound(mapping);
+                return false;
+            }
+
+            droppedPackets += 1;
+            return true;
+        }
+        else {
+            pos = queue->writePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->senderPort = localPort;
+    slot->size = size;
+    memcpy(slot->data, data, (size_t) size);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    queue->signal.fetch_add(1);
+    if (queue->sleeping.load() != 0) {
+        futexWake(&queue->signal);
+    }
+
+    return true;
+#else
+    ignoreUnused(destPort, data, size);
+    return false;
+#endif
+}
+
+int LocalTransport::receive(void * buf, int maxSize, int & senderPort, int timeoutMs)
+{
+#if JUCE_LINUX
+    if (!inbound) return 0;
+
+    bool waited = false;
+
+    for (;;) {
+        // only one thread reads
+        auto pos = inbound->readPos.load(std::memory_order_relaxed);
+        auto & slot = inbound->slots[pos & (numSlots - 1)];
+
+        if (slot.sequence.load(std::memory_order_acquire) == pos + 1) {
+            int size = jmin((int) slot.size, maxSize);
+            memcpy(buf, slot.data, (size_t) size);
+            senderPort = slot.senderPort;
+
+            inbound->readPos.store(pos + 1, std::memory_order_relaxed);
+            slot.sequence.store(pos + numSlots, std::memory_order_release);
+            return size;
+        }
+
+        if (waited) {
+            return 0;
+        }
+
+        // if a packet comes in after this, the futex value won't match and we don't sleep
+        auto sig = inbound->signal.load();
+        inbound->sleeping.store(1);
+
+        if (slot.sequence.load(std::memory_order_acquire) != pos + 1) {
+            futexWait(&inbound->signal, sig, timeoutMs);
+        }
+
+        inbound->sleeping.store(0);
+        waited = true;
+    }
+#else
+    ignoreUnused(buf, maxSize, senderPort, timeoutMs);
+    return 0;
+#endif
+}
+
+void LocalTransport::wakeUp()
+{
+#if JUCE_LINUX
+    if (inbound) {
+        inbound->signal.fetch_add(1);
+        futexWake(&inbound->signal);
+    }
+#endif
+}
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include <map>
+
+namespace SonoAudio {
+
+// Packet transport between SonoBus instances on the same host
+//
+// Every instance owns one inbound queue in shared memory, named after its UDP port.
+// Any other instance on the host can push packets into it, so packets to a local peer
+// skip the kernel network stack. The queue is a bounded lock-free ring of fixed size
+// slots (one packet each), the receiver sleeps on a futex in the shared segment.
+//
+// Only available on Linux, open() fails everywhere else and everything goes over UDP.
+
+class LocalTransport
+{
+public:
+    LocalTransport();
+    ~LocalTransport();
+
+    // creates our inbound queue for the given UDP port
+    bool open(int localPort);
+    void close();
+    bool isOpen() const { return inbound != nullptr; }
+
+    // true if the address belongs to this host
+    bool isLocalAddress(const String & ipaddr) const;
+
+    // pushes a packet into the queue of the instance bound to destPort on this host.
+    // returns false if there is no such instance, the caller should use UDP then.
+    // a full queue drops the packet (and returns true), just like the network would,
+    // unless the receiver hasn't read anything for a while, then it's given up like a missing one
+    bool send(int destPort, const void * data, int size);
+
+    // waits up to timeoutMs for the next packet, returns its size (0 on timeout)
+    int receive(void * buf, int maxSize, int & senderPort, int timeoutMs);
+
+    // wakes up a receive() blocked in another thread
+    void wakeUp();
+
+    int64 getDroppedPackets() const { return droppedPackets.load(); }
+
+    static bool isSupported();
+
+private:
+    struct Queue;
+
+    struct Mapping
+    {
+        Queue * queue = nullptr;
+        double retryStamp = 0.0; // when to look for a missing queue again
+
+        // while full, the last read position seen and when it last moved
+        uint64 lastReadPos = 0;
+        double readProgressStamp = 0.0;
+        // a queue that stopped moving isn't used again until its read position changes
+        bool stalled = false;
+        uint64 stalledReadPos = 0;
+    };
+
+    static Queue * mapQueue(int port, bool create);
+    static void unmapQueue(Queue * queue);
+
+    Queue * getOutbound(int destPort);
+    void dropOutbound(Mapping & mapping);
+
+    Queue * inbound = nullptr;
+    int localPort = 0;
+
+    CriticalSection outboundLock;
+    std::map<int, Mapping> outbound;
+
+    StringArray localAddresses;
+
+    std::atomic<int64> droppedPackets { 0 };
+};
+
+}
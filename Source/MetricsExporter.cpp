@@ -0,0 +1,383 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+
+#include "MetricsExporter.h"
+#include "TraceRecorder.h"
+
+#if ! JUCE_WINDOWS
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+using namespace SonoAudio;
+
+namespace {
+
+const int maxRequestSize = 4096;
+const int requestTimeoutMs = 1000;
+
+String escapeLabel(const char * value)
+{
+    return String::fromUTF8(value).replace("\\", "\\\\").replace("\"", "\\\"").replace("\n", "\\n");
+}
+
+String httpResponse(int status, const String & statusText, const String & contentType, const String & body)
+{
+    String resp;
+    resp << "HTTP/1.0 " << status << " " << statusText << "\r\n"
+         << "Content-Type: " << contentType << "\r\n"
+         << "Content-Length: " << (int) body.getNumBytesAsUTF8() << "\r\n"
+         << "Connection: close\r\n\r\n"
+         << body;
+    return resp;
+}
+
+}
+
+MetricsExporter::MetricsExporter(SonobusAudioProcessor & processor_)
+: Thread("SonoBusMetrics"), processor(processor_)
+{
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    stopListening();
+}
+
+bool MetricsExporter::startListening(int port)
+{
+    stopListening();
+
+    listener = std::make_unique<StreamingSocket>();
+    if (!listener->createListener(port, "127.0.0.1")) {
+        DBG("Could not listen for metrics on port " << port);
+        listener.reset();
+        return false;
+    }
+
+    DBG("Serving metrics on 127.0.0.1:" << port);
+    startThread(Thread::Priority::low);
+    startTimer(1000);
+    return true;
+}
+
+bool MetricsExporter::startListening(const String & socketPath)
+{
+    stopListening();
+
+#if ! JUCE_WINDOWS
+    struct sockaddr_un addr;
+    zerostruct(addr);
+    addr.sun_family = AF_UNIX;
+
+    if (socketPath.isEmpty() || (size_t) socketPath.getNumBytesAsUTF8() >= sizeof(addr.sun_path)) {
+        DBG("Invalid metrics socket path: " << socketPath);
+        return false;
+    }
+    socketPath.copyToUTF8(addr.sun_path, sizeof(addr.sun_path));
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    // a leftover from a previous run would make bind fail
+    ::unlink(addr.sun_path);
+
+    if (::bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || ::listen(fd, 8) != 0) {
+        DBG("Could not listen for metrics on " << socketPath);
+        ::close(fd);
+        return false;
+    }
+
+    unixSocketFd = fd;
+    unixSocketPath = socketPath;
+
+    DBG("Serving metrics on " << socketPath);
+    startThread(Thread::Priority::low);
+    startTimer(1000);
+    return true;
+#else
+    ignoreUnused(socketPath);
+    return false;
+#endif
+}
+
+void MetricsExporter::stopListening()
+{
+    stopTimer();
+    signalThreadShouldExit();
+
+    // unblocks the accept
+    if (listener) {
+        listener->close();
+    }
+
+    stopThread(2000);
+    listener.reset();
+
+#if ! JUCE_WINDOWS
+    if (unixSocketFd >= 0) {
+        ::close(unixSocketFd);
+        ::unlink(unixSocketPath.toRawUTF8());
+        unixSocketFd = -1;
+        unixSocketPath.clear();
+    }
+#endif
+}
+
+void MetricsExporter::timerCallback()
+{
+    if (getXRunCount) {
+        const int xruns = getXRunCount();
+        const int lastxruns = xrunCount.exchange(xruns);
+        if (lastxruns >= 0 && xruns > lastxruns) {
+            SonoAudio::TraceRecorder::instant("device xrun", 0, xruns - lastxruns);
+            SonoAudio::TraceRecorder::requestDump();
+        }
+    }
+}
+
+void MetricsExporter::run()
+{
+    if (listener) {
+        serveTcp();
+    }
+    else {
+        serveUnixSocket();
+    }
+}
+
+void MetricsExporter::serveTcp()
+{
+    HeapBlock<char> buf (maxRequestSize + 1);
+
+    while (!threadShouldExit()) {
+        std::unique_ptr<StreamingSocket> conn (listener->waitForNextConnection());
+        if (!conn) {
+            if (threadShouldExit()) break;
+            continue;
+        }
+
+        int nbytes = 0;
+        if (conn->waitUntilReady(true, requestTimeoutMs) == 1) {
+            nbytes = conn->read(buf, maxRequestSize, false);
+        }
+        if (nbytes <= 0) continue;
+
+        auto response = handleRequest(String::fromUTF8(buf, nbytes));
+        conn->write(response.toRawUTF8(), (int) response.getNumBytesAsUTF8());
+    }
+}
+
+void MetricsExporter::serveUnixSocket()
+{
+#if ! JUCE_WINDOWS
+    HeapBlock<char> buf (maxRequestSize + 1);
+
+    while (!threadShouldExit()) {
+        struct pollfd pfd = { unixSocketFd, POLLIN, 0 };
+        if (::poll(&pfd, 1, 200) <= 0) continue;
+
+        int fd = ::accept(unixSocketFd, nullptr, nullptr);
+        if (fd < 0) continue;
+
+        struct pollfd cfd = { fd, POLLIN, 0 };
+        ssize_t nbytes = 0;
+        if (::poll(&cfd, 1, requestTimeoutMs) > 0) {
+            nbytes = ::read(fd, buf, maxRequestSize);
+        }
+
+        if (nbytes > 0) {
+            auto response = handleRequest(String::fromUTF8(buf, (int) nbytes));
+            const char * data = response.toRawUTF8();
+            size_t remaining = response.getNumBytesAsUTF8();
+#ifdef MSG_NOSIGNAL
+            const int flags = MSG_NOSIGNAL;
+#else
+            const int flags = 0;
+#endif
+            while (remaining > 0) {
+                auto sent = ::send(fd, data, remaining, flags);
+                if (sent <= 0) break;
+                data += sent;
+                remaining -= (size_t) sent;
+            }
+        }
+
+        ::close(fd);
+    }
+#endif
+}
+
+String MetricsExporter::handleRequest(const String & request) const
+{
+    // only the request line matters, e.g. "GET /metrics HTTP/1.1"
+    auto tokens = StringArray::fromTokens(request.upToFirstOccurrenceOf("\r\n", false, false), " ", "");
+    if (tokens.size() < 2 || tokens[0] != "GET") {
+        return httpResponse(405, "Method Not Allowed", "text/plain", "GET only\n");
+    }
+
+    auto path = tokens[1].upToFirstOccurrenceOf("?", false, false);
+
+    if (path == "/metrics" || path == "/") {
+        return httpResponse(200, "OK", "text/plain; version=0.0.4", getPrometheusText());
+    }
+    else if (path == "/metrics.json") {
+        return httpResponse(200, "OK", "application/json", getJson());
+    }
+    else if (path == "/trace") {
+        if (!TraceRecorder::isEnabled()) {
+            return httpResponse(404, "Not Found", "text/plain", "tracing is not enabled, start with --trace\n");
+        }
+        return httpResponse(200, "OK", "application/json", TraceRecorder::createChromeTrace());
+    }
+
+    return httpResponse(404, "Not Found", "text/plain", "try /metrics, /metrics.json or /trace\n");
+}
+
+String MetricsExporter::getPrometheusText() const
+{
+    Array<SonobusAudioProcessor::PeerStats> peers;
+    processor.getAllRemotePeerStats(peers);
+
+    String out;
+
+    auto header = [&out](const char * name, const char * type, const char * help) {
+        out << "# HELP " << name << " " << help << "\n"
+            << "# TYPE " << name << " " << type << "\n";
+    };
+
+    auto peerLabels = [](const SonobusAudioProcessor::PeerStats & peer) {
+        return String("{peer=\"") + escapeLabel(peer.userName) + "\",id=\"" + String(peer.viewId) + "\"}";
+    };
+
+    auto perPeer = [&](const char * name, const char * type, const char * help, std::function<String(const SonobusAudioProcessor::PeerStats &)> value) {
+        header(name, type, help);
+        for (auto & peer : peers) {
+            out << name << peerLabels(peer) << " " << value(peer) << "\n";
+        }
+    };
+
+    header("sonobus_peers", "gauge", "Number of connected peers");
+    out << "sonobus_peers " << peers.size() << "\n";
+
+    header("sonobus_peer_info", "gauge", "Codecs in use per peer");
+    for (auto & peer : peers) {
+        out << "sonobus_peer_info{peer=\"" << escapeLabel(peer.userName) << "\",id=\"" << String(peer.viewId)
+            << "\",send_codec=\"" << escapeLabel(peer.sendCodec) << "\",recv_codec=\"" << escapeLabel(peer.recvCodec) << "\"} 1\n";
+    }
+
+    perPeer("sonobus_peer_packets_sent_total", "counter", "Audio packets sent to the peer",
+            [](const SonobusAudioProcessor::PeerStats & p) { return String(p.packetsSent); });
+    perPeer("sonobus_peer_packets_received_total", "counter", "Audio packets received from the peer",
+            [](const SonobusAudioProcessor::PeerStats & p) { return String(p.packetsReceived); });
+    perPeer("sonobus_peer_packets_dropped_total", "counter", "Audio packets from the peer that were lost (reset by the user)",
+            [](const SonobusAudioProcessor::PeerStats & p) { return String(p.packetsDropped); });
+    perPeer("sonobus_peer_packets_resent_total", "counter", "Audio packets from the peer that had to be resent (reset by the user)",
+            [](const SonobusAudioProcessor::PeerStats & p) { return String(p.packetsResent); });
+    perPeer("sonobus_peer_bytes_sent_total", "counter", "Bytes sent to the peer including UDP overhead",
+            [](const SonobusAudioProcessor::PeerStats & p) { return String(p.bytesSent); });
+    perPeer("sonobus_peer_bytes_received_total", "counter", "Bytes received from the peer including UDP overhead",
+            [](const SonobusAudioProcessor::PeerStats & p) { return String(p.bytesReceived); });
+    perPeer("sonobus_peer_jitter_buffer_fill_ratio", "gauge", "Average fill ratio of the receive jitter buffer",
+            [](const SonobusAudioProcessor::PeerStats & p) { return String(p.fillRatio); });
+    perPeer("sonobus_peer_jitter_buffer_ms", "gauge", "Size of the receive jitter buffer in milliseconds",
+            [](const SonobusAudioProcessor::PeerStats & p) { return String(p.bufferTimeMs); });
+    perPeer("sonobus_peer_ping_ms", "gauge", "Smoothed network round trip time in milliseconds",
+            [](const SonobusAudioProcessor::PeerStats & p) { return String(p.latency.pingMs); });
+    perPeer("sonobus_peer_latency_outgoing_ms", "gauge", "Estimated one-way latency to the peer in milliseconds",
+            [](const SonobusAudioProcessor::PeerStats & p) { return String(p.latency.outgoingMs); });
+    perPeer("sonobus_peer_latency_incoming_ms", "gauge", "Estimated one-way latency from the peer in milliseconds",
+            [](const SonobusAudioProcessor::PeerStats & p) { return String(p.latency.incomingMs); });
+
+    const auto & audio = processor.getAudioThreadStats();
+    using AudioThreadStats = SonobusAudioProcessor::AudioThreadStats;
+
+    header("sonobus_process_block_seconds", "histogram", "Time spent in the audio callback");
+    uint64 cumulative = 0;
+    for (int i = 0; i <= AudioThreadStats::NumDurationBuckets; ++i) {
+        cumulative += audio.durationCounts[i].load(std::memory_order_relaxed);
+        String bound = i < AudioThreadStats::NumDurationBuckets ? String(AudioThreadStats::DurationBucketBoundsSec[i]) : String("+Inf");
+        out << "sonobus_process_block_seconds_bucket{le=\"" << bound << "\"} " << String(cumulative) << "\n";
+    }
+    out << "sonobus_process_block_seconds_sum " << String(audio.durationSumUs.load(std::memory_order_relaxed) * 1e-6) << "\n";
+    out << "sonobus_process_block_seconds_count " << String(cumulative) << "\n";
+
+    header("sonobus_process_block_late_total", "counter", "Audio callbacks that took longer than the audio they produce");
+    out << "sonobus_process_block_late_total " << String(audio.lateBlocks.load(std::memory_order_relaxed)) << "\n";
+
+    header("sonobus_recording_dropped_samples_total", "counter", "Recorded samples replaced by silence because the recorder could not keep up");
+    out << "sonobus_recording_dropped_samples_total " << String(processor.getRecordingDroppedSamples()) << "\n";
+
+    const int xruns = xrunCount.load();
+    if (xruns >= 0) {
+        header("sonobus_audio_device_xruns_total", "counter", "Xruns reported by the audio device");
+        out << "sonobus_audio_device_xruns_total " << xruns << "\n";
+    }
+
+    return out;
+}
+
+String MetricsExporter::getJson() const
+{
+    Array<SonobusAudioProcessor::PeerStats> peers;
+    processor.getAllRemotePeerStats(peers);
+
+    juce::var peerlist = juce::var(Array<juce::var>());
+
+    for (auto & peer : peers) {
+        DynamicObject::Ptr item = new DynamicObject();
+        item->setProperty("name", String::fromUTF8(peer.userName));
+        item->setProperty("id", (int64) peer.viewId);
+        item->setProperty("sendCodec", String::fromUTF8(peer.sendCodec));
+        item->setProperty("recvCodec", String::fromUTF8(peer.recvCodec));
+        item->setProperty("packetsSent", (int64) peer.packetsSent);
+        item->setProperty("packetsReceived", (int64) peer.packetsReceived);
+        item->setProperty("packetsDropped", (int64) peer.packetsDropped);
+        item->setProperty("packetsResent", (int64) peer.packetsResent);
+        item->setProperty("bytesSent", (int64) peer.bytesSent);
+        item->setProperty("bytesReceived", (int64) peer.bytesReceived);
+        item->setProperty("fillRatio", peer.fillRatio);
+        item->setProperty("fillRatioStdDev", peer.fillRatioStdDev);
+        item->setProperty("bufferMs", peer.bufferTimeMs);
+        item->setProperty("pingMs", peer.latency.pingMs);
+        item->setProperty("outgoingMs", peer.latency.outgoingMs);
+        item->setProperty("incomingMs", peer.latency.incomingMs);
+        peerlist.append(item.get());
+    }
+
+    const auto & audio = processor.getAudioThreadStats();
+    using AudioThreadStats = SonobusAudioProcessor::AudioThreadStats;
+
+    juce::var buckets = juce::var(Array<juce::var>());
+    for (int i = 0; i <= AudioThreadStats::NumDurationBuckets; ++i) {
+        DynamicObject::Ptr bucket = new DynamicObject();
+        if (i < AudioThreadStats::NumDurationBuckets) {
+            bucket->setProperty("le", AudioThreadStats::DurationBucketBoundsSec[i]);
+        } else {
+            bucket->setProperty("le", "+Inf");
+        }
+        bucket->setProperty("count", (int64) audio.durationCounts[i].load(std::memory_order_relaxed));
+        buckets.append(bucket.get());
+    }
+
+    DynamicObject::Ptr audioobj = new DynamicObject();
+    audioobj->setProperty("blocks", (int64) audio.blocks.load(std::memory_order_relaxed));
+    audioobj->setProperty("lateBlocks", (int64) audio.lateBlocks.load(std::memory_order_relaxed));
+    audioobj->setProperty("processSecondsSum", audio.durationSumUs.load(std::memory_order_relaxed) * 1e-6);
+    audioobj->setProperty("processSecondsBuckets", buckets);
+    audioobj->setProperty("recordingDroppedSamples", (int64) processor.getRecordingDroppedSamples());
+    if (xrunCount.load() >= 0) {
+        audioobj->setProperty("xruns", xrunCount.load());
+    }
+
+    DynamicObject::Ptr root = new DynamicObject();
+    root->setProperty("peers", peerlist);
+    root->setProperty("audio", audioobj.get());
+
+    return JSON::toString(juce::var(root.get())) + "\n";
+}
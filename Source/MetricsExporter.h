@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include "SonobusPluginProcessor.h"
+
+namespace SonoAudio {
+
+// Opt-in local metrics endpoint, mostly for headless instances.
+//
+// Serves per-peer network stats and audio thread health over plain HTTP, either on a
+// loopback TCP port or on a UNIX domain socket:
+//   GET /metrics       Prometheus text format
+//   GET /metrics.json  the same as JSON
+//   GET /trace         Chrome trace of the recent past, if tracing is enabled
+//
+// Everything comes from the processor's lock-free stats snapshot and audio thread
+// counters, so a scrape never waits on (or for) the audio thread.
+
+class MetricsExporter : private Thread, private Timer
+{
+public:
+    MetricsExporter(SonobusAudioProcessor & processor);
+    ~MetricsExporter() override;
+
+    // listens on 127.0.0.1 only
+    bool startListening(int port);
+    // not available on Windows
+    bool startListening(const String & socketPath);
+    void stopListening();
+
+    bool isListening() const { return isThreadRunning(); }
+
+    // optional, polled on the message thread since the audio device can't be touched from elsewhere
+    std::function<int()> getXRunCount;
+
+    String getPrometheusText() const;
+    String getJson() const;
+
+private:
+    void run() override;
+    void timerCallback() override;
+
+    void serveTcp();
+    void serveUnixSocket();
+
+    String handleRequest(const String & request) const;
+
+    SonobusAudioProcessor & processor;
+
+    std::unique_ptr<StreamingSocket> listener;
+    int unixSocketFd = -1;
+    String unixSocketPath;
+
+    std::atomic<int> xrunCount { -1 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MetricsExporter)
+};
+
+}
@@ -0,0 +1,334 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+
+#include "MultiTrackRecorder.h"
+
+using namespace SonoAudio;
+
+namespace {
+
+// wraps a regular AudioFormatWriter (wav, flac, ogg)
+class AudioFormatTrackWriter : public MultiTrackRecorder::TrackWriter
+{
+public:
+    AudioFormatTrackWriter(std::unique_ptr<AudioFormatWriter> writer_) : writer(std::move(writer_)) {}
+
+    int getNumChannels() const override { return writer->getNumChannels(); }
+
+    bool writeSamples(const float* const* data, int numSamples) override {
+        return writer->writeFromFloatArrays(data, (int) writer->getNumChannels(), numSamples);
+    }
+
+    bool finish() override {
+        return writer->flush();
+    }
+
+private:
+    std::unique_ptr<AudioFormatWriter> writer;
+};
+
+}
+
+class MultiTrackRecorder::EncoderThread : public Thread
+{
+public:
+    EncoderThread(MultiTrackRecorder & owner_, int index_, int numThreads_)
+    : Thread("Recording Encoder " + String(index_)), owner(owner_), index(index_), numThreads(numThreads_) {}
+
+    void run() override
+    {
+        while (!threadShouldExit()) {
+            if (!owner.serviceTracks(index, numThreads, false)) {
+                wakeEvent.wait(50);
+            }
+        }
+    }
+
+    void wake() { wakeEvent.signal(); }
+
+private:
+    MultiTrackRecorder & owner;
+    const int index;
+    const int numThreads;
+    WaitableEvent wakeEvent;
+};
+
+
+MultiTrackRecorder::MultiTrackRecorder(int numEncoderThreads)
+: requestedThreads(numEncoderThreads)
+{
+}
+
+MultiTrackRecorder::~MultiTrackRecorder()
+{
+    stop();
+}
+
+int MultiTrackRecorder::addTrack(std::unique_ptr<TrackWriter> writer, const String & name, double sampleRate, int fifoSamples)
+{
+    if (running.load() || !writer || writer->getNumChannels() <= 0 || writer->getNumChannels() > MAX_CHANNELS_PER_TRACK) {
+        return -1;
+    }
+
+    if (fifoSamples <= 0) {
+        fifoSamples = (int) (sampleRate * 4.0);
+    }
+    fifoSamples = jmax(fifoSamples, 4 * batchSamples);
+
+    auto * track = new Track();
+    track->name = name;
+    track->numChannels = writer->getNumChannels();
+    track->writer = std::move(writer);
+    track->fifoBuffer.setSize(track->numChannels, fifoSamples + 1);
+    track->fifoBuffer.clear();
+    track->fifo = std::make_unique<AbstractFifo>(fifoSamples + 1);
+
+    tracks.add(track);
+
+    return tracks.size() - 1;
+}
+
+int MultiTrackRecorder::addTrack(std::unique_ptr<AudioFormatWriter> writer, const String & name, int fifoSamples)
+{
+    if (!writer) return -1;
+
+    double samplerate = writer->getSampleRate();
+    return addTrack(std::make_unique<AudioFormatTrackWriter>(std::move(writer)), name, samplerate, fifoSamples);
+}
+
+bool MultiTrackRecorder::start()
+{
+    if (running.load()) return true;
+    if (tracks.isEmpty()) return false;
+
+    int numthreads = requestedThreads > 0 ? requestedThreads : jmax(1, SystemStats::getNumCpus() - 1);
+    numthreads = jlimit(1, tracks.size(), numthreads);
+
+    encoderThreads.clear();
+    for (int i=0; i < numthreads; ++i) {
+        encoderThreads.add(new EncoderThread(*this, i, numthreads));
+    }
+    activeThreadCount = numthreads;
+
+    for (auto * thread : encoderThreads) {
+        thread->startThread();
+    }
+
+    DBG("Started recorder with " << tracks.size() << " tracks on " << numthreads << " encoder threads");
+
+    running.store(true);
+    return true;
+}
+
+void MultiTrackRecorder::stop()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    // wait for any audio thread writes in progress to finish
+    while (writersInside.load() > 0) {
+        Thread::yield();
+    }
+
+    for (auto * thread : encoderThreads) {
+        thread->signalThreadShouldExit();
+        thread->wake();
+    }
+    for (auto * thread : encoderThreads) {
+        thread->stopThread(4000);
+    }
+    encoderThreads.clear();
+    activeThreadCount = 0;
+
+    // flush everything that is left and close the files
+    for (auto * track : tracks) {
+        drainTrack(*track, true);
+
+        if (track->writer) {
+            track->writer->finish();
+            track->writer.reset();
+        }
+
+        if (track->droppedSamples.load() > 0) {
+            DBG("Recording track " << track->name << " had " << track->overruns.load() << " overruns, "
+                << track->droppedSamples.load() << " samples replaced by silence");
+        }
+    }
+}
+
+bool MultiTrackRecorder::write(int track, const float* const* data, int numChannels, int numSamples)
+{
+    writersInside.fetch_add(1);
+
+    if (!running.load() || !isPositiveAndBelow(track, tracks.size())) {
+        writersInside.fetch_sub(1);
+        return false;
+    }
+
+    auto & tr = *tracks.getUnchecked(track);
+    auto & fifo = *tr.fifo;
+    int freespace = fifo.getFreeSpace();
+    int start1, size1, start2, size2;
+
+    // first fill in silence for any previously dropped samples to keep the timeline intact
+    if (tr.pendingGap > 0 && freespace > 0) {
+        const int gapnow = (int) jmin(tr.pendingGap, (int64) freespace);
+        fifo.prepareToWrite(gapnow, start1, size1, start2, size2);
+        if (size1 > 0) tr.fifoBuffer.clear(start1, size1);
+        if (size2 > 0) tr.fifoBuffer.clear(start2, size2);
+        fifo.finishedWrite(size1 + size2);
+        tr.pendingGap -= size1 + size2;
+        freespace -= size1 + size2;
+    }
+
+    auto * thread = activeThreadCount > 0 ? encoderThreads.getUnchecked(track % activeThreadCount) : nullptr;
+
+    if (tr.pendingGap > 0 || freespace < numSamples) {
+        // overrun, account for it
+        tr.pendingGap += numSamples;
+        tr.droppedSamples.fetch_add(numSamples, std::memory_order_relaxed);
+        lifetimeDroppedSamples.fetch_add(numSamples, std::memory_order_relaxed);
+        if (!tr.inOverrun) {
+            tr.overruns.fetch_add(1, std::memory_order_relaxed);
+            tr.inOverrun = true;
+        }
+        if (thread) thread->wake();
+
+        writersInside.fetch_sub(1);
+        return false;
+    }
+
+    tr.inOverrun = false;
+
+    fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+    for (int ch=0; ch < tr.numChannels; ++ch) {
+        if (ch < numChannels && data[ch] != nullptr) {
+            if (size1 > 0) tr.fifoBuffer.copyFrom(ch, start1, data[ch], size1);
+            if (size2 > 0) tr.fifoBuffer.copyFrom(ch, start2, data[ch] + size1, size2);
+        }
+        else {
+            if (size1 > 0) tr.fifoBuffer.clear(ch, start1, size1);
+            if (size2 > 0) tr.fifoBuffer.clear(ch, start2, size2);
+        }
+    }
+
+    fifo.finishedWrite(size1 + size2);
+
+    const int ready = fifo.getNumReady();
+    if (ready > tr.maxFifoUsed.load(std::memory_order_relaxed)) {
+        tr.maxFifoUsed.store(ready, std::memory_order_relaxed);
+    }
+
+    // only wake the encoder when crossing the batch threshold
+    if (thread && ready >= batchSamples && ready - numSamples < batchSamples) {
+        thread->wake();
+    }
+
+    writersInside.fetch_sub(1);
+    return true;
+}
+
+bool MultiTrackRecorder::drainTrack(Track & track, bool flush)
+{
+    auto & fifo = *track.fifo;
+    int ready = fifo.getNumReady();
+    bool didwork = false;
+
+    const float * readptrs[MAX_CHANNELS_PER_TRACK];
+    const int numchans = jmin(track.numChannels, MAX_CHANNELS_PER_TRACK);
+
+    while (ready >= batchSamples || (flush && ready > 0)) {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(jmin(ready, batchSamples), start1, size1, start2, size2);
+
+        for (auto seg : { std::make_pair(start1, size1), std::make_pair(start2, size2) }) {
+            if (seg.second <= 0) continue;
+
+            for (int ch=0; ch < numchans; ++ch) {
+                readptrs[ch] = track.fifoBuffer.getReadPointer(ch, seg.first);
+            }
+
+            if (!track.writeFailed && track.writer && track.writer->writeSamples(readptrs, seg.second)) {
+                track.samplesWritten.fetch_add(seg.second, std::memory_order_relaxed);
+            }
+            else {
+                if (!track.writeFailed) {
+                    DBG("Error writing recording track " << track.name);
+                    track.writeFailed = true;
+                }
+                track.droppedSamples.fetch_add(seg.second, std::memory_order_relaxed);
+                lifetimeDroppedSamples.fetch_add(seg.second, std::memory_order_relaxed);
+            }
+        }
+
+        fifo.finishedRead(size1 + size2);
+        ready -= size1 + size2;
+        didwork = true;
+    }
+
+    return didwork;
+}
+
+bool MultiTrackRecorder::serviceTracks(int threadIndex, int numThreads, bool flush)
+{
+    bool didwork = false;
+
+    for (int i = threadIndex; i < tracks.size(); i += numThreads) {
+        auto & track = *tracks.getUnchecked(i);
+
+        didwork |= drainTrack(track, flush);
+
+        const int overruns = track.overruns.load(std::memory_order_relaxed);
+        if (overruns != track.reportedOverruns) {
+            DBG("Recording track " << track.name << " overrun, total dropped samples: " << track.droppedSamples.load());
+            track.reportedOverruns = overruns;
+        }
+    }
+
+    return didwork;
+}
+
+int MultiTrackRecorder::getTrackNumChannels(int track) const
+{
+    if (!isPositiveAndBelow(track, tracks.size())) return 0;
+    return tracks.getUnchecked(track)->numChannels;
+}
+
+String MultiTrackRecorder::getTrackName(int track) const
+{
+    if (!isPositiveAndBelow(track, tracks.size())) return {};
+    return tracks.getUnchecked(track)->name;
+}
+
+MultiTrackRecorder::TrackStats MultiTrackRecorder::getTrackStats(int track) const
+{
+    TrackStats stats;
+    if (!isPositiveAndBelow(track, tracks.size())) return stats;
+
+    auto & tr = *tracks.getUnchecked(track);
+    stats.samplesWritten = tr.samplesWritten.load();
+    stats.droppedSamples = tr.droppedSamples.load();
+    stats.overruns = tr.overruns.load();
+    stats.maxFifoUsed = tr.maxFifoUsed.load();
+    stats.fifoSize = tr.fifo->getTotalSize() - 1;
+    return stats;
+}
+
+int64 MultiTrackRecorder::getTotalDroppedSamples() const
+{
+    int64 total = 0;
+    for (auto * track : tracks) {
+        total += track->droppedSamples.load();
+    }
+    return total;
+}
+
+void MultiTrackRecorder::clearTracks()
+{
+    if (running.load()) return;
+
+    tracks.clear();
+}
@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace SonoAudio {
+
+#ifndef MAX_CHANNELS_PER_TRACK
+#define MAX_CHANNELS_PER_TRACK 64
+#endif
+
+// Records any number of tracks to disk.
+// Each track has its own single-producer/single-consumer FIFO that the audio thread
+// writes into without locking or waiting. A pool of encoder threads (sized to the
+// number of cores) drains the FIFOs in large batches into the track writers.
+// Each track is serviced by exactly one encoder thread.
+//
+// If a FIFO overruns, the lost samples are counted per track and replaced with
+// silence once there is room again, so tracks stay sample aligned and drops are reported.
+
+class MultiTrackRecorder
+{
+public:
+
+    // destination for the samples of a track, called only from encoder threads
+    class TrackWriter
+    {
+    public:
+        virtual ~TrackWriter() = default;
+        virtual int getNumChannels() const = 0;
+        virtual bool writeSamples(const float* const* data, int numSamples) = 0;
+        // called once after all data was written, before destruction
+        virtual bool finish() { return true; }
+    };
+
+    struct TrackStats
+    {
+        int64 samplesWritten = 0;
+        int64 droppedSamples = 0;
+        int overruns = 0;
+        int maxFifoUsed = 0;
+        int fifoSize = 0;
+    };
+
+    // numEncoderThreads of 0 uses the number of cores
+    MultiTrackRecorder(int numEncoderThreads = 0);
+    ~MultiTrackRecorder();
+
+    // add tracks while not running, returns track index or -1 on failure
+    // fifoSamples of 0 uses about 4 seconds
+    int addTrack(std::unique_ptr<TrackWriter> writer, const String & name, double sampleRate, int fifoSamples = 0);
+    int addTrack(std::unique_ptr<AudioFormatWriter> writer, const String & name, int fifoSamples = 0);
+
+    // starts the encoder threads, after which write() is allowed
+    bool start();
+
+    // stops accepting audio, flushes everything to the writers, and closes them.
+    // blocks until done, never call from the audio thread
+    void stop();
+
+    bool isRunning() const { return running.load(); }
+
+    // removes all (stopped) tracks, stats are kept until this is called
+    void clearTracks();
+
+    // realtime safe, each track must only be written from a single thread
+    // returns false if the samples could not be queued (and were counted as dropped)
+    bool write(int track, const float* const* data, int numChannels, int numSamples);
+
+    int getNumTracks() const { return tracks.size(); }
+    int getTrackNumChannels(int track) const;
+    String getTrackName(int track) const;
+
+    TrackStats getTrackStats(int track) const;
+    int64 getTotalDroppedSamples() const;
+
+    // dropped samples of all tracks since the recorder was created, never reset, safe from any thread
+    int64 getLifetimeDroppedSamples() const { return lifetimeDroppedSamples.load(std::memory_order_relaxed); }
+
+    // number of frames written per batch by the encoder threads
+    static const int batchSamples = 16384;
+
+private:
+
+    struct Track
+    {
+        String name;
+        std::unique_ptr<TrackWriter> writer;
+        int numChannels = 0;
+
+        // SPSC fifo, written by audio thread, read by one encoder thread
+        AudioBuffer<float> fifoBuffer;
+        std::unique_ptr<AbstractFifo> fifo;
+
+        // audio thread only
+        int64 pendingGap = 0;
+        bool inOverrun = false;
+
+        // stats
+        std::atomic<int64> samplesWritten { 0 };
+        std::atomic<int64> droppedSamples { 0 };
+        std::atomic<int> overruns { 0 };
+        std::atomic<int> maxFifoUsed { 0 };
+        int reportedOverruns = 0; // encoder thread only
+        bool writeFailed = false; // encoder thread only
+    };
+
+    class EncoderThread;
+
+    // returns true if any work was done
+    bool serviceTracks(int threadIndex, int numThreads, bool flush);
+    bool drainTrack(Track & track, bool flush);
+
+    int requestedThreads = 0;
+    OwnedArray<Track> tracks;
+    OwnedArray<EncoderThread> encoderThreads;
+    int activeThreadCount = 0;
+
+    std::atomic<bool> running { false };
+    std::atomic<int> writersInside { 0 };
+    std::atomic<int64> lifetimeDroppedSamples { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MultiTrackRecorder)
+};
+
+}
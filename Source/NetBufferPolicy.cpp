@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+
+#include "NetBufferPolicy.h"
+
+using namespace SonoAudio;
+
+bool NetBufferPolicy::blocksLost(NetBufferState & state, int count, double nowtime, const Settings & settings)
+{
+    state.dataPacketsDropped += count;
+
+    if (settings.mode == ModeOff) {
+        return false;
+    }
+
+    // see if our drop rate exceeds threshold, and increase buffersize if so
+    const float dropratethresh = settings.mode == ModeInitAuto ? 1.0f : settings.dropRateThreshold;
+    const float adjustlimit = 0.5f; // don't adjust more often than once every 0.5 seconds
+
+    bool autoinitdone = settings.mode == ModeInitAuto && state.autoNetbufInitCompleted;
+    bool increased = false;
+
+    if (state.lastDroptime > 0 && !autoinitdone) {
+        double deltatime = (nowtime - state.lastDroptime) * 1e-3;
+        if (deltatime > adjustlimit) {
+            //float droprate =  (state.dataPacketsDropped - state.lastDropCount) / deltatime;
+            float droprate =  1.0f / deltatime; // treat any drops as one instance
+            if (droprate > dropratethresh) {
+                state.buffertimeMs += settings.blockMs;
+                increased = true;
+
+                DBG("AUTO-Increasing buffer time by " << settings.blockMs << " ms to " << (int)state.buffertimeMs << " droprate: " << droprate);
+
+                if (settings.mode == ModeAutoFull) {
+
+                    const float timesincedecrthresh = 2.0;
+                    if (state.lastNetBufDecrTime > 0 && (nowtime - state.lastNetBufDecrTime)*1e-3 < timesincedecrthresh ) {
+                        state.netBufAutoBaseline = state.buffertimeMs;
+                        DBG("Got drop within short time thresh, setting minimum baseline for future decr to " << state.netBufAutoBaseline);
+                    }
+                }
+            }
+
+            float realdroprate =  (state.dataPacketsDropped - state.lastDropCount) / deltatime;
+            state.fastDropRate.push(realdroprate);
+
+            state.lastDroptime = nowtime;
+            state.lastDropCount = state.dataPacketsDropped;
+        }
+    }
+    else {
+        if (state.lastDroptime > 0) {
+            double deltatime = (nowtime - state.lastDroptime) * 1e-3;
+            float droprate =  (state.dataPacketsDropped - state.lastDropCount) / deltatime;
+            state.fastDropRate.push(droprate);
+        }
+
+        state.lastDroptime = nowtime;
+        state.lastDropCount = state.dataPacketsDropped;
+    }
+
+    return increased;
+}
+
+bool NetBufferPolicy::pingReceived(NetBufferState & state, double nowtime, const Settings & settings)
+{
+    double deltadroptime = state.lastDroptime > 0 ? (nowtime - state.lastDroptime) * 1e-3 : (nowtime - state.resetDroptime) * 1e-3;
+
+    if (settings.mode != ModeOff) {
+        if (!state.autoNetbufInitCompleted) {
+            const float nodropsthresh = 7.0;
+
+            if (deltadroptime > nodropsthresh) {
+                state.autoNetbufInitCompleted = true;
+                state.resetSafetyMuted = false;
+                DBG("Netbuf Initial auto time is done after no drops in " << nodropsthresh);
+
+                // clear drop count
+                state.dataPacketsResent = 0;
+                state.dataPacketsDropped = 0;
+                state.lastDropCount = 0;
+                state.resetDroptime = nowtime;
+                state.fastDropRate.resetInitVal(0.0f);
+            }
+        }
+    }
+    else {
+        // manual mode
+        state.resetSafetyMuted = false;
+    }
+
+    if (settings.mode != ModeAutoFull) {
+        return false;
+    }
+
+    // possibly adjust net buffer down, if it has been longer than threshold since last drop
+    const float nodropsthresh = 10.0; // no drops in 10 seconds
+    const float adjustlimit = 10; // don't adjust more often than once every 10 seconds
+
+    if (state.lastNetBufDecrTime > 0 && state.buffertimeMs > state.netBufAutoBaseline && !state.latencyMatched) {
+        double deltatime = (nowtime - state.lastNetBufDecrTime) * 1e-3;
+        deltadroptime = (nowtime - state.lastDroptime) * 1e-3;
+
+        if (deltatime > adjustlimit && deltadroptime > nodropsthresh) {
+            state.buffertimeMs -= settings.blockMs;
+            state.buffertimeMs = std::max(state.buffertimeMs, state.netBufAutoBaseline);
+
+            DBG("AUTO-Decreasing buffer time by " << settings.blockMs << " ms to " << (int) state.buffertimeMs);
+
+            state.lastNetBufDecrTime = nowtime;
+            return true;
+        }
+    }
+    else {
+        state.lastNetBufDecrTime = nowtime;
+    }
+
+    return false;
+}
+
+void NetBufferPolicy::updateSafetyMuting(NetBufferState & state, double nowtime)
+{
+    //const float droprate =  (state.dataPacketsDropped) / ((nowtime - state.resetDroptime)*1e-3);
+    const float droprate = state.fastDropRate.xbar;
+    const float safetyunmutethreshrate = 2.0f;
+    const float safetyunmutethreshmintime = 0.5f;
+    const float safetyunmutethreshtime = 0.75f;
+    const float jitterbufthresh = 15.0f;
+
+    double timesincereset = (nowtime - state.resetDroptime) * 1e-3;
+    double deltadroptime = state.lastDroptime > 0 ? (nowtime - state.lastDroptime) * 1e-3 : timesincereset;
+
+
+    if ((timesincereset > safetyunmutethreshmintime)
+        && ((droprate > 0.0f && droprate < safetyunmutethreshrate)
+            || (droprate == 0.0f && deltadroptime > safetyunmutethreshtime)
+            || (state.buffertimeMs > jitterbufthresh))) {
+        DBG("Droprate: " << droprate << "  deltatime: " << deltadroptime << " buftimems: " << state.buffertimeMs);
+        DBG("Unmuting after reset drop");
+        state.resetSafetyMuted = false;
+    }
+
+    state.fastDropRate.Z *= 0.965;
+
+    float realdroprate =  (state.dataPacketsDropped - state.lastDropCount) / deltadroptime;
+    state.fastDropRate.push(realdroprate);
+}
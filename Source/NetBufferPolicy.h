@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include "RunCumulantor.h"
+
+namespace SonoAudio {
+
+// Receive side jitter buffer state of one remote peer, as far as the automatic buffer sizing
+// and the safety muting after a reset need it.
+struct NetBufferState
+{
+    float buffertimeMs = 0.0f;
+    int64_t dataPacketsDropped = 0;
+    int64_t dataPacketsResent = 0;
+    double lastDroptime = 0;
+    double resetDroptime = 0;
+    int64_t lastDropCount = 0;
+    double lastNetBufDecrTime = 0;
+    float netBufAutoBaseline = 0.0f;
+    bool autoNetbufInitCompleted = false;
+    bool latencyMatched = false;
+    bool resetSafetyMuted = true;
+    stats::RunCumulantor1D  fastDropRate;
+};
+
+// The decisions for automatic jitter buffer sizing and safety muting, made on the sink events
+// at an explicit time in ms. The processor runs them on the real clock, the packet capture
+// replay on its virtual one. Applying a changed buffer time to the sinks is up to the caller.
+class NetBufferPolicy
+{
+public:
+    // same values as SonobusAudioProcessor::AutoNetBufferMode
+    enum Mode {
+        ModeOff = 0,
+        ModeAutoIncreaseOnly,
+        ModeAutoFull,
+        ModeInitAuto
+    };
+
+    struct Settings
+    {
+        Mode mode = ModeAutoFull;
+        // drop instances per second that increase the buffer
+        float dropRateThreshold = 0.5f;
+        // one audio block, the step for every change
+        float blockMs = 0.0f;
+    };
+
+    // a block lost event, returns true if the buffer time was increased
+    static bool blocksLost(NetBufferState & state, int count, double nowMs, const Settings & settings);
+
+    // a ping event, completes the initial auto sizing and returns true if the buffer time was decreased
+    static bool pingReceived(NetBufferState & state, double nowMs, const Settings & settings);
+
+    // for every data packet received while state.resetSafetyMuted, clears it once the drops settle
+    static void updateSafetyMuting(NetBufferState & state, double nowMs);
+};
+
+}
@@ -0,0 +1,485 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+
+#include "NetworkSimulator.h"
+
+#include "aoo/aoo.hpp"
+#include "aoo/aoo_pcm.h"
+#include "aoo/aoo_opus.h"
+
+using namespace SonoAudio;
+
+namespace {
+
+const double toneFrequency = 440.0;
+const float toneLevel = 0.25f;
+const double markerFrequency = 2000.0;
+const float markerLevel = 0.9f;
+const double markerLengthMs = 5.0;
+
+// output below this rms is a dropout, marker peaks above this are detected
+const float dropoutRms = 0.02f;
+const float markerThreshold = 0.6f;
+
+std::atomic<int64> underrunCount { 0 };
+
+void countUnderruns(const char * name, char phase, int32_t, int64_t)
+{
+    if (phase == 'i' && strcmp(name, "aoo buffer underrun") == 0) {
+        underrunCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void addStats(SimulatedLink::Stats & dest, const SimulatedLink::Stats & src)
+{
+    dest.sent += src.sent;
+    dest.delivered += src.delivered;
+    dest.lost += src.lost;
+    dest.queueDropped += src.queueDropped;
+    dest.reordered += src.reordered;
+    dest.duplicated += src.duplicated;
+    dest.bytes += src.bytes;
+}
+
+struct SimPair
+{
+    SimPair(const SimulatedLink::Params & params, int64 seed)
+    : forward(params, seed), back(params, seed + 1) {}
+
+    SimulatedLink forward;
+    SimulatedLink back;
+    aoo::isource::pointer source;
+    aoo::isink::pointer sink;
+
+    AudioBuffer<float> input;
+    AudioBuffer<float> output;
+    double phase = 0.0;
+    double markerPhase = 0.0;
+
+    bool audible = false;
+    int64 lastMarkerSample = -1;
+
+    NetworkSimulator::Result * result = nullptr;
+};
+
+int32_t handleSimSinkEvents(void * user, const aoo_event ** events, int32_t n)
+{
+    auto & result = *static_cast<SimPair*>(user)->result;
+
+    for (int i = 0; i < n; ++i) {
+        switch (events[i]->type) {
+            case AOO_BLOCK_LOST_EVENT:
+                result.blocksLost += ((const aoo_block_lost_event *) events[i])->count;
+                break;
+            case AOO_BLOCK_REORDERED_EVENT:
+                result.blocksReordered += ((const aoo_block_reordered_event *) events[i])->count;
+                break;
+            case AOO_BLOCK_RESENT_EVENT:
+                result.blocksResent += ((const aoo_block_resent_event *) events[i])->count;
+                break;
+            case AOO_BLOCK_GAP_EVENT:
+                result.blocksGap += ((const aoo_block_gap_event *) events[i])->count;
+                break;
+            default:
+                break;
+        }
+    }
+    return 1;
+}
+
+int32_t ignoreEvents(void *, const aoo_event **, int32_t)
+{
+    return 1;
+}
+
+bool setupFormat(aoo::isource * source, NetworkSimulator::Codec codec, const NetworkSimulator::Options & options)
+{
+    aoo_format_storage f;
+
+    if (codec == NetworkSimulator::CodecPCM16) {
+        aoo_format_pcm *fmt = (aoo_format_pcm *)&f;
+        fmt->header.codec = AOO_CODEC_PCM;
+        fmt->header.blocksize = options.blockSize;
+        fmt->header.samplerate = (int32_t) options.sampleRate;
+        fmt->header.nchannels = options.numChannels;
+        fmt->bitdepth = AOO_PCM_INT16;
+    }
+    else {
+        aoo_format_opus *fmt = (aoo_format_opus *)&f;
+        fmt->header.codec = AOO_CODEC_OPUS;
+        fmt->header.blocksize = options.blockSize;
+        fmt->header.samplerate = (int32_t) options.sampleRate;
+        fmt->header.nchannels = options.numChannels;
+        fmt->bitrate = 96000 * options.numChannels;
+        fmt->complexity = 0;
+        fmt->signal_type = OPUS_SIGNAL_MUSIC;
+        fmt->application_type = OPUS_APPLICATION_RESTRICTED_LOWDELAY;
+    }
+
+    return source->set_format(f.header) > 0;
+}
+
+}
+
+SimulatedLink::SimulatedLink(const Params & params_, int64 seed)
+: params(params_), random(seed)
+{
+}
+
+int32_t SimulatedLink::send(void * user, const char * data, int32_t size)
+{
+    static_cast<SimulatedLink*>(user)->push(data, size);
+    return size;
+}
+
+double SimulatedLink::nextJitter()
+{
+    if (params.jitterMs <= 0.0) return 0.0;
+
+    switch (params.jitterDistribution) {
+        case JitterNormal:
+        {
+            // Box-Muller
+            const double u1 = jmax(1e-12, (double) random.nextDouble());
+            const double u2 = random.nextDouble();
+            return std::abs(std::sqrt(-2.0 * std::log(u1)) * std::cos(MathConstants<double>::twoPi * u2)) * params.jitterMs;
+        }
+        case JitterPareto:
+        {
+            // shape 2.5, scaled so the median is around jitterMs / 3, capped at 20x
+            const double u = jmax(1e-12, (double) random.nextDouble());
+            return jmin(20.0 * params.jitterMs, params.jitterMs * (std::pow(u, -1.0 / 2.5) - 1.0));
+        }
+        case JitterUniform:
+        default:
+            return random.nextDouble() * params.jitterMs;
+    }
+}
+
+void SimulatedLink::push(const char * data, int size)
+{
+    ++stats.sent;
+    stats.bytes += size;
+
+    // Gilbert-Elliott state, then loss in that state
+    badState = badState ? random.nextDouble() >= params.badToGood : random.nextDouble() < params.goodToBad;
+    if (random.nextDouble() < (badState ? params.lossBad : params.lossGood)) {
+        ++stats.lost;
+        return;
+    }
+
+    double sentMs = currentMs;
+    if (params.bandwidthKbps > 0.0) {
+        // serialization at the bottleneck, drop-tail once the backlog is too long
+        const double startMs = jmax(currentMs, linkFreeMs);
+        if (startMs - currentMs > params.queueLimitMs) {
+            ++stats.queueDropped;
+            return;
+        }
+        linkFreeMs = startMs + size * 8.0 / params.bandwidthKbps;
+        sentMs = linkFreeMs;
+    }
+
+    const int copies = random.nextDouble() < params.duplicateProbability ? 2 : 1;
+    if (copies > 1) ++stats.duplicated;
+
+    for (int i = 0; i < copies; ++i) {
+        double dueMs = sentMs + params.delayMs + nextJitter();
+
+        if (random.nextDouble() < params.reorderProbability) {
+            dueMs += params.reorderDelayMs;
+            ++stats.reordered;
+        }
+        else {
+            // jitter alone doesn't reorder, a path mostly keeps packets in order
+            dueMs = jmax(dueMs, lastDueMs);
+            lastDueMs = dueMs;
+        }
+
+        inFlight.push({ dueMs, packetOrder++, std::vector<char>(data, data + size) });
+    }
+}
+
+
+//////////////////////////
+
+Array<NetworkSimulator::Scenario> NetworkSimulator::getBuiltinScenarios()
+{
+    Array<Scenario> scenarios;
+
+    {
+        Scenario s;
+        s.name = "clean";
+        s.link.delayMs = 5.0;
+        s.bufferTimeMs = 10.0f;
+        s.maxDropoutPercent = 0.1;
+        s.maxLatencyMs = 40.0;
+        scenarios.add(s);
+    }
+    {
+        Scenario s;
+        s.name = "lan";
+        s.link.delayMs = 1.0;
+        s.link.jitterMs = 1.0;
+        s.bufferTimeMs = 10.0f;
+        s.maxDropoutPercent = 0.5;
+        s.maxLatencyMs = 40.0;
+        scenarios.add(s);
+    }
+    {
+        Scenario s;
+        s.name = "internet";
+        s.link.delayMs = 30.0;
+        s.link.jitterMs = 4.0;
+        s.link.jitterDistribution = SimulatedLink::JitterNormal;
+        s.link.lossGood = 0.001;
+        s.bufferTimeMs = 25.0f;
+        s.maxDropoutPercent = 2.0;
+        s.maxLatencyMs = 100.0;
+        scenarios.add(s);
+    }
+    {
+        Scenario s;
+        s.name = "wifi";
+        s.link.delayMs = 5.0;
+        s.link.jitterMs = 6.0;
+        s.link.jitterDistribution = SimulatedLink::JitterPareto;
+        s.bufferTimeMs = 40.0f;
+        s.maxDropoutPercent = 3.0;
+        s.maxLatencyMs = 120.0;
+        scenarios.add(s);
+    }
+    {
+        Scenario s;
+        s.name = "burst-loss";
+        s.link.delayMs = 20.0;
+        s.link.jitterMs = 2.0;
+        s.link.goodToBad = 0.01;
+        s.link.badToGood = 0.3;
+        s.link.lossBad = 0.5;
+        s.bufferTimeMs = 30.0f;
+        s.maxDropoutPercent = 5.0;
+        s.maxLatencyMs = 100.0;
+        scenarios.add(s);
+    }
+    {
+        Scenario s;
+        s.name = "reorder";
+        s.link.delayMs = 20.0;
+        s.link.jitterMs = 2.0;
+        s.link.reorderProbability = 0.05;
+        s.link.reorderDelayMs = 8.0;
+        s.bufferTimeMs = 30.0f;
+        s.maxDropoutPercent = 2.0;
+        s.maxLatencyMs = 90.0;
+        scenarios.add(s);
+    }
+    {
+        Scenario s;
+        s.name = "duplicate";
+        s.link.delayMs = 20.0;
+        s.link.duplicateProbability = 0.1;
+        s.bufferTimeMs = 20.0f;
+        s.maxDropoutPercent = 0.5;
+        s.maxLatencyMs = 80.0;
+        scenarios.add(s);
+    }
+    {
+        // uncompressed stereo is about 1.6 Mbit/s with headers
+        Scenario s;
+        s.name = "bandwidth";
+        s.link.delayMs = 10.0;
+        s.link.bandwidthKbps = 2500.0;
+        s.link.queueLimitMs = 50.0;
+        s.codec = CodecPCM16;
+        s.bufferTimeMs = 20.0f;
+        s.maxDropoutPercent = 1.0;
+        s.maxLatencyMs = 120.0;
+        scenarios.add(s);
+    }
+
+    return scenarios;
+}
+
+bool NetworkSimulator::run(const Scenario & scenario, const Options & options, Result & result, String & error)
+{
+    result = Result();
+    result.scenarioName = scenario.name;
+    result.numPairs = options.numPairs;
+
+    if (options.numPairs <= 0 || options.sampleRate <= 0.0 || options.blockSize <= 0 || options.numChannels <= 0) {
+        error = TRANS("Invalid simulation options");
+        return false;
+    }
+
+    const double blockMs = 1000.0 * options.blockSize / options.sampleRate;
+    const int64 markerPeriod = (int64) options.sampleRate;
+    const int64 markerLength = (int64) (markerLengthMs * 1e-3 * options.sampleRate);
+    const int32 sinkId = 1;
+    const int32 sourceId = 1;
+
+    OwnedArray<SimPair> pairs;
+
+    for (int p = 0; p < options.numPairs; ++p) {
+        auto * pair = pairs.add(new SimPair(scenario.link, options.seed * 1000 + p * 2));
+        pair->result = &result;
+        pair->input.setSize(options.numChannels, options.blockSize);
+        pair->output.setSize(options.numChannels, options.blockSize);
+
+        // set up like a peer's source and sink in the processor
+        pair->source.reset(aoo::isource::create(sourceId));
+        if (!setupFormat(pair->source.get(), scenario.codec, options)) {
+            error = TRANS("Codec not available");
+            return false;
+        }
+        pair->source->setup((int32_t) options.sampleRate, options.blockSize, options.numChannels);
+        pair->source->set_buffersize((int32_t) jmax(10.0, 2.0 * blockMs));
+
+        pair->sink.reset(aoo::isink::create(sinkId));
+        pair->sink->setup((int32_t) options.sampleRate, options.blockSize, options.numChannels);
+        pair->sink->set_buffersize((int32_t) scenario.bufferTimeMs);
+        int32_t flags = AOO_PROTOCOL_FLAG_COMPACT_DATA | AOO_PROTOCOL_FLAG_SILENT_BLOCKS | AOO_PROTOCOL_FLAG_BINARY_DATA;
+        pair->sink->set_option(aoo_opt_protocol_flags, &flags, sizeof(int32_t));
+
+        // the source reaches the sink through the forward link, the sink answers through the back link
+        pair->source->add_sink(&pair->forward, sinkId, SimulatedLink::send);
+        pair->source->start();
+    }
+
+    underrunCount = 0;
+    aoo_set_tracefn(countUnderruns);
+
+    const uint64_t baseTime = aoo_osctime_get();
+    const int64 numBlocks = (int64) (options.seconds * 1000.0 / blockMs);
+    double latencySumMs = 0.0;
+
+    for (int64 block = 0; block < numBlocks; ++block) {
+        const double nowMs = block * blockMs;
+        const int64 firstSample = block * options.blockSize;
+        const uint64_t t = baseTime + aoo_osctime_fromseconds(nowMs * 1e-3);
+
+        const auto startTicks = Time::getHighResolutionTicks();
+
+        for (auto * pair : pairs) {
+            pair->forward.setTime(nowMs);
+            pair->back.setTime(nowMs);
+
+            // test signal, a quiet tone with a loud marker at the start of every period
+            for (int i = 0; i < options.blockSize; ++i) {
+                const bool marker = (firstSample + i) % markerPeriod < markerLength;
+                const float value = marker ? markerLevel * (float) std::sin(pair->markerPhase) : toneLevel * (float) std::sin(pair->phase);
+                pair->phase += MathConstants<double>::twoPi * toneFrequency / options.sampleRate;
+                pair->markerPhase += MathConstants<double>::twoPi * markerFrequency / options.sampleRate;
+                for (int ch = 0; ch < options.numChannels; ++ch) {
+                    pair->input.setSample(ch, i, value);
+                }
+            }
+
+            pair->back.deliverDue([&](const char * data, int size) {
+                pair->source->handle_message(data, size, &pair->forward, SimulatedLink::send);
+            });
+
+            pair->source->process((const aoo_sample **) pair->input.getArrayOfReadPointers(), options.blockSize, t);
+            pair->source->send();
+
+            pair->forward.deliverDue([&](const char * data, int size) {
+                pair->sink->handle_message(data, size, &pair->back, SimulatedLink::send);
+            });
+
+            pair->sink->process(const_cast<aoo_sample**>(pair->output.getArrayOfWritePointers()), options.blockSize, t);
+            pair->sink->send();
+
+            if (pair->source->events_available() > 0) {
+                pair->source->handle_events(ignoreEvents, nullptr);
+            }
+            if (pair->sink->events_available() > 0) {
+                pair->sink->handle_events(handleSimSinkEvents, pair);
+            }
+        }
+
+        result.cpuSeconds += Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks);
+
+        // analysis, outside of the timed part
+        for (auto * pair : pairs) {
+            const float rms = pair->output.getRMSLevel(0, 0, options.blockSize);
+
+            if (!pair->audible) {
+                pair->audible = rms >= dropoutRms;
+                if (!pair->audible) continue;
+            }
+
+            ++result.outputBlocks;
+            if (rms < dropoutRms) {
+                ++result.dropoutBlocks;
+            }
+
+            const float * out = pair->output.getReadPointer(0);
+            for (int i = 0; i < options.blockSize; ++i) {
+                const int64 sample = firstSample + i;
+                if (std::abs(out[i]) < markerThreshold) continue;
+                if (pair->lastMarkerSample >= 0 && sample - pair->lastMarkerSample < markerPeriod / 2) continue;
+
+                pair->lastMarkerSample = sample;
+
+                // only unambiguous while the latency stays below the marker period
+                const double latencyMs = 1000.0 * (sample % markerPeriod) / options.sampleRate;
+                result.minLatencyMs = result.latencyMeasurements == 0 ? latencyMs : jmin(result.minLatencyMs, latencyMs);
+                result.maxLatencyMs = jmax(result.maxLatencyMs, latencyMs);
+                latencySumMs += latencyMs;
+                ++result.latencyMeasurements;
+            }
+        }
+    }
+
+    aoo_set_tracefn(nullptr);
+    result.underruns = underrunCount.load();
+
+    for (auto * pair : pairs) {
+        addStats(result.forward, pair->forward.getStats());
+        addStats(result.back, pair->back.getStats());
+    }
+
+    result.simulatedSeconds = numBlocks * blockMs * 1e-3;
+    if (result.latencyMeasurements > 0) {
+        result.meanLatencyMs = latencySumMs / result.latencyMeasurements;
+    }
+
+    if (result.outputBlocks == 0 || result.latencyMeasurements == 0) {
+        result.failures.add("no audio received");
+    }
+    if (result.getDropoutPercent() > scenario.maxDropoutPercent) {
+        result.failures.add("dropouts above " + String(scenario.maxDropoutPercent, 2) + "%");
+    }
+    if (result.maxLatencyMs > scenario.maxLatencyMs) {
+        result.failures.add("latency above " + String(scenario.maxLatencyMs, 1) + " ms");
+    }
+    if (result.getRealtimeFactor() < options.minRealtimeFactor) {
+        result.failures.add("cpu below " + String(options.minRealtimeFactor, 1) + "x realtime per pair");
+    }
+
+    result.passed = result.failures.isEmpty();
+
+    return true;
+}
+
+String NetworkSimulator::Result::toString() const
+{
+    String out;
+    out << "scenario " << scenarioName << ": " << (passed ? "PASS" : "FAIL") << "  (" << numPairs << " pairs, "
+        << String(simulatedSeconds, 1) << " s)" << newLine;
+    out << "  link: sent " << forward.sent << "  lost " << forward.lost << "  queue dropped " << forward.queueDropped
+        << "  reordered " << forward.reordered << "  duplicated " << forward.duplicated
+        << "  (back: sent " << back.sent << " lost " << back.lost << ")" << newLine;
+    out << "  sink: lost " << blocksLost << "  resent " << blocksResent << "  reordered " << blocksReordered
+        << "  gaps " << blocksGap << "  underruns " << underruns << newLine;
+    out << "  dropouts: " << dropoutBlocks << " of " << outputBlocks << " blocks (" << String(getDropoutPercent(), 2) << "%)" << newLine;
+    out << "  latency ms min/mean/max: " << String(minLatencyMs, 1) << "/" << String(meanLatencyMs, 1) << "/" << String(maxLatencyMs, 1)
+        << "  (" << latencyMeasurements << " markers)" << newLine;
+    out << "  cpu: " << String(cpuSeconds, 3) << " s (" << String(getRealtimeFactor(), 1)
+        << "x realtime per pair)" << newLine;
+    if (!failures.isEmpty()) {
+        out << "  failed: " << failures.joinIntoString(", ") << newLine;
+    }
+    return out;
+}
@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include <queue>
+#include <vector>
+
+namespace SonoAudio {
+
+// Simulated network path for aoo, in-process and on a virtual clock.
+//
+// A link is used as the aoo endpoint itself, with SimulatedLink::send as the reply function,
+// so sources and sinks send into it exactly like they do into endpoint_send. Every packet gets
+// a delivery time from the configured delay, jitter, loss, reordering, duplication and
+// bandwidth cap, and deliverDue() hands over whatever is due at the current virtual time.
+
+class SimulatedLink
+{
+public:
+    enum JitterDistribution {
+        JitterUniform = 0,  // 0 .. jitterMs
+        JitterNormal,       // |N(0, jitterMs)|
+        JitterPareto        // heavy tail, mostly small with the occasional long spike
+    };
+
+    struct Params
+    {
+        double delayMs = 10.0;
+        double jitterMs = 0.0;
+        JitterDistribution jitterDistribution = JitterUniform;
+
+        // Gilbert-Elliott loss, per packet: the chance to move between the good and bad state,
+        // and the loss probability in each state
+        double goodToBad = 0.0;
+        double badToGood = 1.0;
+        double lossGood = 0.0;
+        double lossBad = 0.0;
+
+        // a reordered packet is held back this much longer, so the following ones overtake it
+        double reorderProbability = 0.0;
+        double reorderDelayMs = 10.0;
+
+        double duplicateProbability = 0.0;
+
+        // 0 is unlimited, beyond queueLimitMs of backlog packets are dropped (drop-tail)
+        double bandwidthKbps = 0.0;
+        double queueLimitMs = 200.0;
+    };
+
+    struct Stats
+    {
+        int64 sent = 0;
+        int64 delivered = 0;
+        int64 lost = 0;
+        int64 queueDropped = 0;
+        int64 reordered = 0;
+        int64 duplicated = 0;
+        int64 bytes = 0;
+    };
+
+    SimulatedLink(const Params & params, int64 seed);
+
+    // aoo_replyfn, user is the link
+    static int32_t send(void * user, const char * data, int32_t size);
+
+    void setTime(double nowMs) { currentMs = nowMs; }
+
+    // calls fn(data, size) for every packet due by the current time, in delivery order
+    template <typename Fn>
+    void deliverDue(Fn && fn)
+    {
+        while (!inFlight.empty() && inFlight.top().dueMs <= currentMs) {
+            // moved out first, fn may send into this link again
+            auto data = std::move(const_cast<Packet&>(inFlight.top()).data);
+            inFlight.pop();
+            ++stats.delivered;
+            fn(data.data(), (int) data.size());
+        }
+    }
+
+    const Stats & getStats() const { return stats; }
+
+private:
+    struct Packet
+    {
+        double dueMs;
+        uint64 order;
+        std::vector<char> data;
+
+        bool operator> (const Packet & other) const { return dueMs > other.dueMs || (dueMs == other.dueMs && order > other.order); }
+    };
+
+    void push(const char * data, int size);
+    double nextJitter();
+
+    Params params;
+    Random random;
+    Stats stats;
+
+    double currentMs = 0.0;
+    double lastDueMs = 0.0;
+    double linkFreeMs = 0.0;
+    bool badState = false;
+    uint64 packetOrder = 0;
+
+    std::priority_queue<Packet, std::vector<Packet>, std::greater<Packet>> inFlight;
+};
+
+
+// Runs aoo source/sink pairs over simulated links, faster than real time, and checks how the
+// receiving side copes: lost and resent blocks, dropouts in the received audio, latency and CPU.
+// Built as its own console app (the NetSim target), which the build registers as a test.
+//
+// Each source sends a quiet sine with a short loud marker once a second. The sinks' output is
+// checked for blocks that went silent, and the delay of each marker gives the real end to end latency.
+
+class NetworkSimulator
+{
+public:
+    enum Codec {
+        CodecPCM16 = 0,
+        CodecOpus
+    };
+
+    struct Scenario
+    {
+        String name;
+        // both directions
+        SimulatedLink::Params link;
+        Codec codec = CodecOpus;
+        float bufferTimeMs = 20.0f;
+        // the run fails above this share of dropout blocks
+        double maxDropoutPercent = 1.0;
+        // or when a marker arrives later than this
+        double maxLatencyMs = 100.0;
+    };
+
+    static Array<Scenario> getBuiltinScenarios();
+
+    struct Options
+    {
+        int numPairs = 4;
+        double seconds = 10.0;
+        double sampleRate = 48000.0;
+        int blockSize = 256;
+        int numChannels = 2;
+        int64 seed = 1;
+        // the run fails when a pair is processed slower than this many times real time
+        double minRealtimeFactor = 5.0;
+    };
+
+    struct Result
+    {
+        String scenarioName;
+        int numPairs = 0;
+        double simulatedSeconds = 0.0;
+
+        SimulatedLink::Stats forward; // source to sink, summed over all pairs
+        SimulatedLink::Stats back;
+
+        int64 blocksLost = 0;
+        int64 blocksResent = 0;
+        int64 blocksReordered = 0;
+        int64 blocksGap = 0;
+        int64 underruns = 0;
+
+        // output blocks of a playing stream that came out silent
+        int64 dropoutBlocks = 0;
+        int64 outputBlocks = 0;
+
+        int64 latencyMeasurements = 0;
+        double minLatencyMs = 0.0;
+        double meanLatencyMs = 0.0;
+        double maxLatencyMs = 0.0;
+
+        double cpuSeconds = 0.0;
+
+        bool passed = false;
+        StringArray failures;
+
+        double getDropoutPercent() const { return outputBlocks > 0 ? 100.0 * dropoutBlocks / outputBlocks : 0.0; }
+        double getRealtimeFactor() const { return cpuSeconds > 0.0 ? simulatedSeconds * numPairs / cpuSeconds : 0.0; }
+        String toString() const;
+    };
+
+    // needs the aoo codecs to be registered (aoo_initialize)
+    static bool run(const Scenario & scenario, const Options & options, Result & result, String & error);
+};
+
+}
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+// Network simulation test, the NetSim target. Runs the builtin scenarios (or one of them)
+// over simulated links, prints the results, and exits with an error if any scenario failed
+// its dropout, latency or CPU limits. Registered with ctest by the build.
+
+#include "JuceHeader.h"
+
+#include "NetworkSimulator.h"
+
+#include "aoo/aoo.h"
+
+#include <iostream>
+
+using namespace SonoAudio;
+
+int main (int argc, char * argv[])
+{
+    ArgumentList arglist(argc, argv);
+
+    StringArray scenarioNames;
+    for (auto & scenario : NetworkSimulator::getBuiltinScenarios()) {
+        scenarioNames.add(scenario.name);
+    }
+
+    if (arglist.containsOption("--help|-h")) {
+        std::cout << "usage: " << arglist.executableName << " [<scenario|all>] [--pairs <count>] [--seconds <seconds>] [--min-realtime <factor>]" << std::endl;
+        std::cout << "scenarios: " << scenarioNames.joinIntoString(", ") << std::endl;
+        return 0;
+    }
+
+    NetworkSimulator::Options options;
+
+    auto pairs = arglist.removeValueForOption("--pairs");
+    if (pairs.isNotEmpty()) {
+        options.numPairs = pairs.getIntValue();
+    }
+    auto seconds = arglist.removeValueForOption("--seconds");
+    if (seconds.isNotEmpty()) {
+        options.seconds = seconds.getDoubleValue();
+    }
+    auto minrealtime = arglist.removeValueForOption("--min-realtime");
+    if (minrealtime.isNotEmpty()) {
+        options.minRealtimeFactor = minrealtime.getDoubleValue();
+    }
+
+    const String scenarioName = arglist.size() > 0 ? arglist[0].text : String("all");
+
+    // registers the codecs
+    aoo_initialize();
+
+    bool found = false;
+    bool allpassed = true;
+
+    for (auto & scenario : NetworkSimulator::getBuiltinScenarios()) {
+        if (scenarioName != "all" && scenario.name != scenarioName) continue;
+        found = true;
+
+        NetworkSimulator::Result result;
+        String error;
+        if (NetworkSimulator::run(scenario, options, result, error)) {
+            std::cout << result.toString();
+            allpassed &= result.passed;
+        }
+        else {
+            std::cout << "Error: " << error << std::endl;
+            allpassed = false;
+        }
+    }
+
+    aoo_terminate();
+
+    if (!found) {
+        std::cout << "Error: unknown scenario " << scenarioName << std::endl;
+        return 1;
+    }
+
+    return allpassed ? 0 : 1;
+}
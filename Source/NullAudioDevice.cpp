@@ -0,0 +1,311 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+
+#include "NullAudioDevice.h"
+
+#if JUCE_LINUX
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+using namespace SonoAudio;
+
+namespace {
+
+#if JUCE_LINUX
+int64 monotonicNowNs()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+#endif
+
+}
+
+const char * const NullAudioDevice::typeName = "Null";
+const char * const NullAudioDevice::deviceName = "Null Audio Device";
+
+NullAudioDevice::NullAudioDevice(int numInputChannels, int numOutputChannels)
+: AudioIODevice(deviceName, typeName), Thread("NullAudioDevice"),
+  totalInputs(numInputChannels), totalOutputs(numOutputChannels)
+{
+}
+
+NullAudioDevice::~NullAudioDevice()
+{
+    close();
+}
+
+StringArray NullAudioDevice::getOutputChannelNames()
+{
+    StringArray names;
+    for (int i = 0; i < totalOutputs; ++i) {
+        names.add("Output " + String(i + 1));
+    }
+    return names;
+}
+
+StringArray NullAudioDevice::getInputChannelNames()
+{
+    StringArray names;
+    for (int i = 0; i < totalInputs; ++i) {
+        names.add("Input " + String(i + 1));
+    }
+    return names;
+}
+
+Array<double> NullAudioDevice::getAvailableSampleRates()
+{
+    return { 44100.0, 48000.0, 88200.0, 96000.0 };
+}
+
+Array<int> NullAudioDevice::getAvailableBufferSizes()
+{
+    return { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 1024, 2048 };
+}
+
+String NullAudioDevice::open(const BigInteger & inputChannels, const BigInteger & outputChannels, double newSampleRate, int bufferSizeSamples)
+{
+    close();
+
+    activeInputs = inputChannels;
+    activeInputs.setRange(totalInputs, jmax(0, activeInputs.getHighestBit() + 1 - totalInputs), false);
+    activeOutputs = outputChannels;
+    activeOutputs.setRange(totalOutputs, jmax(0, activeOutputs.getHighestBit() + 1 - totalOutputs), false);
+
+    sampleRate = newSampleRate > 0.0 ? newSampleRate : 48000.0;
+    bufferSize = bufferSizeSamples > 0 ? bufferSizeSamples : getDefaultBufferSize();
+
+    inputBuffer.setSize(activeInputs.countNumberOfSetBits(), bufferSize);
+    outputBuffer.setSize(activeOutputs.countNumberOfSetBits(), bufferSize);
+    inputBuffer.clear();
+
+    lastError.clear();
+    opened = true;
+
+    return lastError;
+}
+
+void NullAudioDevice::close()
+{
+    stop();
+    opened = false;
+}
+
+void NullAudioDevice::start(AudioIODeviceCallback * newCallback)
+{
+    if (!opened || newCallback == nullptr) return;
+
+    if (newCallback != callback) {
+        stop();
+
+        newCallback->audioDeviceAboutToStart(this);
+
+        {
+            const ScopedLock sl (callbackLock);
+            callback = newCallback;
+        }
+    }
+
+    if (!isThreadRunning()) {
+        xruns = 0;
+        callbackCount = 0;
+        latenessSumNs = 0;
+        latenessMaxNs = 0;
+
+#if JUCE_LINUX
+        // switched to SCHED_FIFO with our own priority once running
+        startThread(Thread::Priority::highest);
+#else
+        Thread::RealtimeOptions options;
+        options.priority = 8;
+        options.workDurationMs = (uint32_t) jmax(1, roundToInt(1000.0 * bufferSize / sampleRate));
+
+        if (!startRealtimeThread(options)) {
+            // no permission for realtime scheduling, run anyway
+            startThread(Thread::Priority::highest);
+        }
+#endif
+    }
+}
+
+void NullAudioDevice::stop()
+{
+    stopThread(1000);
+
+    AudioIODeviceCallback * oldCallback = nullptr;
+
+    {
+        const ScopedLock sl (callbackLock);
+        std::swap(oldCallback, callback);
+    }
+
+    if (oldCallback != nullptr) {
+        oldCallback->audioDeviceStopped();
+    }
+}
+
+NullAudioDevice::TimingStats NullAudioDevice::getTimingStats() const
+{
+    TimingStats stats;
+    stats.callbacks = callbackCount.load();
+    stats.meanLatenessUs = stats.callbacks > 0 ? 1e-3 * latenessSumNs.load() / stats.callbacks : 0.0;
+    stats.maxLatenessUs = 1e-3 * latenessMaxNs.load();
+    stats.fifoScheduling = fifoActive.load();
+    return stats;
+}
+
+String NullAudioDevice::TimingStats::toString() const
+{
+    String out;
+    out << callbacks << " callbacks, started " << String(meanLatenessUs, 1) << " us late on average, "
+        << String(maxLatenessUs, 1) << " us at most" << (fifoScheduling ? " (SCHED_FIFO)" : " (no realtime scheduling)");
+    return out;
+}
+
+void NullAudioDevice::run()
+{
+#if JUCE_LINUX
+    runWithTimer();
+#else
+    runWithSleep();
+#endif
+}
+
+void NullAudioDevice::processNextBlock(int64 deadlineNs)
+{
+    const ScopedLock sl (callbackLock);
+
+    if (callback != nullptr) {
+        uint64_t hostTimeNs = (uint64_t) deadlineNs;
+        AudioIODeviceCallbackContext context;
+        context.hostTimeNs = deadlineNs > 0 ? &hostTimeNs : nullptr;
+
+        // the callback is allowed to scribble in its inputs
+        inputBuffer.clear();
+        callback->audioDeviceIOCallbackWithContext(inputBuffer.getArrayOfReadPointers(), inputBuffer.getNumChannels(),
+                                                   outputBuffer.getArrayOfWritePointers(), outputBuffer.getNumChannels(),
+                                                   bufferSize, context);
+    }
+
+    callbackCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void NullAudioDevice::runWithTimer()
+{
+#if JUCE_LINUX
+    sched_param param {};
+    param.sched_priority = jlimit(sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO), realtimePriority);
+    fifoActive = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+    if (!fifoActive) {
+        DBG("NullAudioDevice: no permission for SCHED_FIFO, timing will be less steady");
+    }
+
+    const int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timerFd < 0) {
+        runWithSleep();
+        return;
+    }
+
+    // the device's own clock, fast or slow by the drift
+    const double periodNs = 1e9 * bufferSize / (sampleRate * (1.0 + driftPpm * 1e-6));
+
+    int64 startNs = monotonicNowNs();
+    int64 blocks = 0;
+
+    while (!threadShouldExit()) {
+        // from the start every time, so the rounding never adds up
+        const int64 deadlineNs = startNs + (int64) (periodNs * (double) blocks);
+
+        itimerspec spec {};
+        spec.it_value.tv_sec = (time_t) (deadlineNs / 1000000000);
+        spec.it_value.tv_nsec = (long) (deadlineNs % 1000000000);
+
+        if (timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr) == 0) {
+            uint64_t expirations = 0;
+            if (::read(timerFd, &expirations, sizeof(expirations)) < 0 && errno != EINTR) {
+                break;
+            }
+        }
+
+        const int64 latenessNs = jmax((int64) 0, monotonicNowNs() - deadlineNs);
+        int64 blockTimeNs = deadlineNs;
+
+        if (latenessNs > (int64) periodNs) {
+            // more than a block behind, don't try to catch up in a burst
+            xruns.fetch_add(1, std::memory_order_relaxed);
+            startNs = blockTimeNs = deadlineNs + latenessNs;
+            blocks = 0;
+        }
+        else {
+            latenessSumNs.fetch_add(latenessNs, std::memory_order_relaxed);
+            if (latenessNs > latenessMaxNs.load(std::memory_order_relaxed)) {
+                latenessMaxNs.store(latenessNs, std::memory_order_relaxed);
+            }
+        }
+
+        processNextBlock(blockTimeNs);
+        ++blocks;
+    }
+
+    ::close(timerFd);
+#else
+    runWithSleep();
+#endif
+}
+
+void NullAudioDevice::runWithSleep()
+{
+    const double blockMs = 1000.0 * bufferSize / (sampleRate * (1.0 + driftPpm * 1e-6));
+    double nextMs = Time::getMillisecondCounterHiRes();
+
+    while (!threadShouldExit()) {
+        processNextBlock(0);
+
+        nextMs += blockMs;
+        const double nowMs = Time::getMillisecondCounterHiRes();
+
+        if (nowMs > nextMs + blockMs) {
+            // more than a block behind, don't try to catch up in a burst
+            xruns.fetch_add(1, std::memory_order_relaxed);
+            nextMs = nowMs;
+            continue;
+        }
+
+        // absolute deadlines, so the rounding here doesn't add up
+        const int waitMs = (int) (nextMs - nowMs);
+        if (waitMs > 0) {
+            wait(waitMs);
+        }
+    }
+}
+
+
+NullAudioDeviceType::NullAudioDeviceType(int numInputChannels, int numOutputChannels)
+: AudioIODeviceType(NullAudioDevice::typeName), numInputs(numInputChannels), numOutputs(numOutputChannels)
+{
+}
+
+StringArray NullAudioDeviceType::getDeviceNames(bool) const
+{
+    return { NullAudioDevice::deviceName };
+}
+
+int NullAudioDeviceType::getIndexOfDevice(AudioIODevice * device, bool) const
+{
+    return dynamic_cast<NullAudioDevice*>(device) != nullptr ? 0 : -1;
+}
+
+AudioIODevice * NullAudioDeviceType::createDevice(const String & outputDeviceName, const String & inputDeviceName)
+{
+    if (outputDeviceName.isNotEmpty() && outputDeviceName != NullAudioDevice::deviceName) return nullptr;
+    if (inputDeviceName.isNotEmpty() && inputDeviceName != NullAudioDevice::deviceName) return nullptr;
+
+    return new NullAudioDevice(numInputs, numOutputs);
+}
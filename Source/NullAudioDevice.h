@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace SonoAudio {
+
+// Audio device without any hardware behind it, for servers and other machines without a sound card.
+// Its inputs are silent, its outputs go nowhere, and the callback is driven from its own
+// thread at the requested sample rate and block size.
+//
+// On Linux the thread runs SCHED_FIFO and sleeps on a CLOCK_MONOTONIC timerfd until the exact
+// deadline of each block, computed from the start time so nothing accumulates, which keeps the
+// callback timing steady to well under a millisecond. Elsewhere it falls back to a plain sleep.
+// A drift can be set to run the device clock fast or slow, like a real sound card's crystal.
+
+class NullAudioDevice : public AudioIODevice, private Thread
+{
+public:
+    static const char * const typeName;
+    static const char * const deviceName;
+
+    NullAudioDevice(int numInputChannels = 2, int numOutputChannels = 2);
+    ~NullAudioDevice() override;
+
+    StringArray getOutputChannelNames() override;
+    StringArray getInputChannelNames() override;
+    Array<double> getAvailableSampleRates() override;
+    Array<int> getAvailableBufferSizes() override;
+    int getDefaultBufferSize() override { return 256; }
+
+    String open(const BigInteger & inputChannels, const BigInteger & outputChannels, double sampleRate, int bufferSizeSamples) override;
+    void close() override;
+    bool isOpen() override { return opened; }
+
+    void start(AudioIODeviceCallback * callback) override;
+    void stop() override;
+    bool isPlaying() override { return isThreadRunning(); }
+
+    String getLastError() override { return lastError; }
+
+    int getCurrentBufferSizeSamples() override { return bufferSize; }
+    double getCurrentSampleRate() override { return sampleRate; }
+    int getCurrentBitDepth() override { return 32; }
+
+    BigInteger getActiveOutputChannels() const override { return activeOutputs; }
+    BigInteger getActiveInputChannels() const override { return activeInputs; }
+
+    int getOutputLatencyInSamples() override { return 0; }
+    int getInputLatencyInSamples() override { return 0; }
+
+    int getXRunCount() const noexcept override { return xruns.load(); }
+
+    // device clock error in parts per million, positive runs fast, set before start()
+    void setDriftPpm(double ppm) { driftPpm = ppm; }
+    double getDriftPpm() const { return driftPpm; }
+
+    // SCHED_FIFO priority of the callback thread (Linux), set before start()
+    void setRealtimePriority(int priority) { realtimePriority = priority; }
+
+    struct TimingStats
+    {
+        int64 callbacks = 0;
+        // how long after its deadline each callback started
+        double meanLatenessUs = 0.0;
+        double maxLatenessUs = 0.0;
+        bool fifoScheduling = false;
+
+        String toString() const;
+    };
+
+    TimingStats getTimingStats() const;
+
+private:
+    void run() override;
+    void runWithTimer();
+    void runWithSleep();
+    void processNextBlock(int64 deadlineNs);
+
+    const int totalInputs;
+    const int totalOutputs;
+
+    BigInteger activeInputs;
+    BigInteger activeOutputs;
+    double sampleRate = 48000.0;
+    int bufferSize = 256;
+    bool opened = false;
+    String lastError;
+
+    AudioBuffer<float> inputBuffer;
+    AudioBuffer<float> outputBuffer;
+
+    CriticalSection callbackLock;
+    AudioIODeviceCallback * callback = nullptr;
+
+    double driftPpm = 0.0;
+    // below the kernel's irq threads (50) on PREEMPT_RT, the network needs to keep up too
+    int realtimePriority = 40;
+
+    std::atomic<int> xruns { 0 };
+    std::atomic<int64> callbackCount { 0 };
+    std::atomic<int64> latenessSumNs { 0 };
+    std::atomic<int64> latenessMaxNs { 0 };
+    std::atomic<bool> fifoActive { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NullAudioDevice)
+};
+
+
+class NullAudioDeviceType : public AudioIODeviceType
+{
+public:
+    NullAudioDeviceType(int numInputChannels = 2, int numOutputChannels = 2);
+
+    void scanForDevices() override {}
+    StringArray getDeviceNames(bool wantInputNames = false) const override;
+    int getDefaultDeviceIndex(bool) const override { return 0; }
+    int getIndexOfDevice(AudioIODevice * device, bool asInput) const override;
+    bool hasSeparateInputsAndOutputs() const override { return false; }
+    AudioIODevice * createDevice(const String & outputDeviceName, const String & inputDeviceName) override;
+
+private:
+    const int numInputs;
+    const int numOutputs;
+};
+
+}
@@ -177,6 +177,9 @@ OptionsView::OptionsView(SonobusAudioProcessor& proc, std::function<AudioDeviceM
     mOptionsRecFinishOpenButton = std::make_unique<ToggleButton>(TRANS("Open finished recording for playback"));
     mOptionsRecFinishOpenButton->addListener(this);
 
+    mOptionsRecCrashSafeButton = std::make_unique<ToggleButton>(TRANS("Crash-safe recording (finalize after stopping)"));
+    mOptionsRecCrashSafeButton->addListener(this);
+
 
     mOptionsRecFilesStaticLabel = std::make_unique<Label>("", TRANS("Record feature creates the following files:"));
     configLabel(mOptionsRecFilesStaticLabel.get(), false);
@@ -194,6 +197,9 @@ OptionsView::OptionsView(SonobusAudioProcessor& proc, std::function<AudioDeviceM
     mOptionsRecOthersButton = std::make_unique<ToggleButton>(TRANS("Each Connected User"));
     mOptionsRecOthersButton->addListener(this);
 
+    mOptionsRecOthersRawButton = std::make_unique<ToggleButton>(TRANS("Each Connected User (raw network stream, decode later)"));
+    mOptionsRecOthersRawButton->addListener(this);
+
     mOptionsRecSelfPostFxButton = std::make_unique<ToggleButton>(TRANS("Record yourself including input FX"));
     mOptionsRecSelfPostFxButton->addListener(this);
 
@@ -382,11 +388,15 @@ OptionsView::OptionsView(SonobusAudioProcessor& proc, std::function<AudioDeviceM
 
     mRecOptionsComponent->addAndMakeVisible(mOptionsMetRecordedButton.get());
     mRecOptionsComponent->addAndMakeVisible(mOptionsRecFinishOpenButton.get());
+#if !(JUCE_ANDROID)
+    mRecOptionsComponent->addAndMakeVisible(mOptionsRecCrashSafeButton.get());
+#endif
     mRecOptionsComponent->addAndMakeVisible(mOptionsRecFilesStaticLabel.get());
     mRecOptionsComponent->addAndMakeVisible(mOptionsRecMixButton.get());
     mRecOptionsComponent->addAndMakeVisible(mOptionsRecSelfButton.get());
     mRecOptionsComponent->addAndMakeVisible(mOptionsRecMixMinusButton.get());
     mRecOptionsComponent->addAndMakeVisible(mOptionsRecOthersButton.get());
+    mRecOptionsComponent->addAndMakeVisible(mOptionsRecOthersRawButton.get());
     mRecOptionsComponent->addAndMakeVisible(mOptionsRecSelfPostFxButton.get());
     mRecOptionsComponent->addAndMakeVisible(mRecFormatChoice.get());
     mRecOptionsComponent->addAndMakeVisible(mRecBitsChoice.get());
@@ -621,6 +631,7 @@ void OptionsView::updateState(bool ignorecheck)
     uint32 recmask = processor.getDefaultRecordingOptions();
 
     mOptionsRecOthersButton->setToggleState((recmask & SonobusAudioProcessor::RecordIndividualUsers) != 0, dontSendNotification);
+    mOptionsRecOthersRawButton->setToggleState((recmask & SonobusAudioProcessor::RecordIndividualUsersRaw) != 0, dontSendNotification);
     mOptionsRecMixButton->setToggleState((recmask & SonobusAudioProcessor::RecordMix) != 0, dontSendNotification);
     mOptionsRecMixMinusButton->setToggleState((recmask & SonobusAudioProcessor::RecordMixMinusSelf) != 0, dontSendNotification);
     mOptionsRecSelfButton->setToggleState((recmask & SonobusAudioProcessor::RecordSelf) != 0, dontSendNotification);
@@ -628,6 +639,7 @@ void OptionsView::updateState(bool ignorecheck)
     mOptionsRecSelfPostFxButton->setToggleState(!processor.getSelfRecordingPreFX(), dontSendNotification);
 
     mOptionsRecFinishOpenButton->setToggleState(processor.getRecordFinishOpens(), dontSendNotification);
+    mOptionsRecCrashSafeButton->setToggleState(processor.getRecordCrashSafe(), dontSendNotification);
 
     mRecFormatChoice->setSelectedId((int)processor.getDefaultRecordingFormat(), dontSendNotification);
     mRecBitsChoice->setSelectedId((int)processor.getDefaultRecordingBitsPerSample(), dontSendNotification);
@@ -868,6 +880,11 @@ void OptionsView::updateLayout()
     optionsRecOthersBox.items.add(FlexItem(indentw, 12));
     optionsRecOthersBox.items.add(FlexItem(minButtonWidth, minpassheight, *mOptionsRecOthersButton).withMargin(0).withFlex(1));
 
+    optionsRecOthersRawBox.items.clear();
+    optionsRecOthersRawBox.flexDirection = FlexBox::Direction::row;
+    optionsRecOthersRawBox.items.add(FlexItem(indentw, 12));
+    optionsRecOthersRawBox.items.add(FlexItem(minButtonWidth, minpassheight, *mOptionsRecOthersRawButton).withMargin(0).withFlex(1));
+
     optionsRecordSelfPostFxBox.items.clear();
     optionsRecordSelfPostFxBox.flexDirection = FlexBox::Direction::row;
     optionsRecordSelfPostFxBox.items.add(FlexItem(10, 12));
@@ -878,6 +895,11 @@ void OptionsView::updateLayout()
     optionsRecordFinishBox.items.add(FlexItem(10, 12));
     optionsRecordFinishBox.items.add(FlexItem(minButtonWidth, minpassheight, *mOptionsRecFinishOpenButton).withMargin(0).withFlex(1));
 
+    optionsRecordCrashSafeBox.items.clear();
+    optionsRecordCrashSafeBox.flexDirection = FlexBox::Direction::row;
+    optionsRecordCrashSafeBox.items.add(FlexItem(10, 12));
+    optionsRecordCrashSafeBox.items.add(FlexItem(minButtonWidth, minpassheight, *mOptionsRecCrashSafeButton).withMargin(0).withFlex(1));
+
 
     recOptionsBox.items.clear();
     recOptionsBox.flexDirection = FlexBox::Direction::column;
@@ -893,10 +915,14 @@ void OptionsView::updateLayout()
     recOptionsBox.items.add(FlexItem(100, minpassheight, optionsRecMixMinusBox).withMargin(2).withFlex(0));
     recOptionsBox.items.add(FlexItem(100, minpassheight, optionsRecSelfBox).withMargin(2).withFlex(0));
     recOptionsBox.items.add(FlexItem(100, minpassheight, optionsRecOthersBox).withMargin(2).withFlex(0));
+    recOptionsBox.items.add(FlexItem(100, minpassheight, optionsRecOthersRawBox).withMargin(2).withFlex(0));
     recOptionsBox.items.add(FlexItem(4, 4));
     recOptionsBox.items.add(FlexItem(100, minpassheight, optionsMetRecordBox).withMargin(2).withFlex(0));
     recOptionsBox.items.add(FlexItem(100, minpassheight, optionsRecordSelfPostFxBox).withMargin(2).withFlex(0));
     recOptionsBox.items.add(FlexItem(100, minpassheight, optionsRecordFinishBox).withMargin(2).withFlex(0));
+#if !(JUCE_ANDROID)
+    recOptionsBox.items.add(FlexItem(100, minpassheight, optionsRecordCrashSafeBox).withMargin(2).withFlex(0));
+#endif
     minRecOptionsHeight = 0;
     for (auto & item : recOptionsBox.items) {
         minRecOptionsHeight += item.minHeight + item.margin.top + item.margin.bottom;
@@ -1053,11 +1079,13 @@ void OptionsView::buttonClicked (Button* buttonThatWasClicked)
     else if (buttonThatWasClicked == mOptionsRecMixButton.get()
              || buttonThatWasClicked == mOptionsRecSelfButton.get()
              || buttonThatWasClicked == mOptionsRecOthersButton.get()
+             || buttonThatWasClicked == mOptionsRecOthersRawButton.get()
              || buttonThatWasClicked == mOptionsRecMixMinusButton.get()
              ) {
         uint32 recmask = 0;
         recmask |= (mOptionsRecMixButton->getToggleState() ? SonobusAudioProcessor::RecordMix : 0);
         recmask |= (mOptionsRecOthersButton->getToggleState() ? SonobusAudioProcessor::RecordIndividualUsers : 0);
+        recmask |= (mOptionsRecOthersRawButton->getToggleState() ? SonobusAudioProcessor::RecordIndividualUsersRaw : 0);
         recmask |= (mOptionsRecSelfButton->getToggleState() ? SonobusAudioProcessor::RecordSelf : 0);
         recmask |= (mOptionsRecMixMinusButton->getToggleState() ? SonobusAudioProcessor::RecordMixMinusSelf : 0);
 
@@ -1078,6 +1106,9 @@ void OptionsView::buttonClicked (Button* buttonThatWasClicked)
     else if (buttonThatWasClicked == mOptionsRecFinishOpenButton.get()) {
         processor.setRecordFinishOpens(mOptionsRecFinishOpenButton->getToggleState());
     }
+    else if (buttonThatWasClicked == mOptionsRecCrashSafeButton.get()) {
+        processor.setRecordCrashSafe(mOptionsRecCrashSafeButton->getToggleState());
+    }
     else if (buttonThatWasClicked == mOptionsUseSpecificUdpPortButton.get()) {
         if (!mOptionsUseSpecificUdpPortButton->getToggleState()) {
             // toggled off, change back to use system chosen port
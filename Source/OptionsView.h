@@ -155,6 +155,7 @@ protected:
     std::unique_ptr<ToggleButton> mOptionsRecMixMinusButton;
     std::unique_ptr<ToggleButton> mOptionsRecSelfButton;
     std::unique_ptr<ToggleButton> mOptionsRecOthersButton;
+    std::unique_ptr<ToggleButton> mOptionsRecOthersRawButton;
     std::unique_ptr<ToggleButton> mOptionsRecSelfPostFxButton;
     std::unique_ptr<SonoChoiceButton> mRecFormatChoice;
     std::unique_ptr<SonoChoiceButton> mRecBitsChoice;
@@ -162,6 +163,7 @@ protected:
     std::unique_ptr<Label> mRecLocationStaticLabel;
     std::unique_ptr<TextButton> mRecLocationButton;
     std::unique_ptr<ToggleButton> mOptionsRecFinishOpenButton;
+    std::unique_ptr<ToggleButton> mOptionsRecCrashSafeButton;
 
 
     FlexBox mainBox;
@@ -191,10 +193,12 @@ protected:
     FlexBox optionsRecSelfBox;
     FlexBox optionsRecMixMinusBox;
     FlexBox optionsRecOthersBox;
+    FlexBox optionsRecOthersRawBox;
     FlexBox optionsMetRecordBox;
     FlexBox optionsRecordDirBox;
     FlexBox optionsRecordSelfPostFxBox;
     FlexBox optionsRecordFinishBox;
+    FlexBox optionsRecordCrashSafeBox;
 
 
     std::unique_ptr<TabbedComponent> mSettingsTab;
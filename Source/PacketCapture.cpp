@@ -0,0 +1,643 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+
+#include "PacketCapture.h"
+
+#include "aoo/aoo.hpp"
+
+using namespace SonoAudio;
+
+namespace {
+
+const char fileMagic[8] = { 'S', 'B', 'P', 'K', 'T', 'C', 'A', 'P' };
+const int formatVersion = 1;
+
+// record types, each record is: type (1 byte), body size (int32), body
+const char recordEndpoint = 'E';
+const char recordPacket = 'P';
+
+const int recordHeaderBytes = 5;
+const int endpointBodyBytes = 2 + 4 + 1; // without address
+const int packetBodyBytes = 8 + 2; // without data
+
+const int maxEndpoints = 65535;
+
+// keep processing this long after the last packet, so the buffers play out
+const double replayTailMs = 1000.0;
+
+template <typename T>
+char * put (char * dest, T value)
+{
+    memcpy(dest, &value, sizeof(T)); // little-endian platforms only, same as the aoo wire format
+    return dest + sizeof(T);
+}
+
+template <typename T>
+T get (const char *& src)
+{
+    T value;
+    memcpy(&value, src, sizeof(T));
+    src += sizeof(T);
+    return value;
+}
+
+class PacketReader
+{
+public:
+    PacketReader(const File & file) : in(file)
+    {
+        if (in.failedToOpen()) return;
+
+        char magic[sizeof(fileMagic)];
+        if (in.read(magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, fileMagic, sizeof(fileMagic)) != 0) return;
+        if (in.readInt() != formatVersion) return;
+
+        captureStartMillis = in.readInt64();
+        sampleRate = in.readDouble();
+        blockSize = in.readInt();
+        numChannels = in.readInt();
+
+        valid = true;
+    }
+
+    struct Packet
+    {
+        double arrivalMs = 0.0;
+        int endpoint = 0;
+        const char * data = nullptr;
+        int size = 0;
+    };
+
+    // skips over endpoint records, collecting them.
+    // returns false at the end, or at an incomplete record (cut off capture)
+    bool next(Packet & packet)
+    {
+        while (valid && in.getNumBytesRemaining() >= recordHeaderBytes) {
+            const char type = in.readByte();
+            const int size = in.readInt();
+            if (size < 0 || in.getNumBytesRemaining() < size) return false;
+
+            body.setSize((size_t) size, false);
+            if (in.read(body.getData(), size) != size) return false;
+
+            const char * ptr = static_cast<const char*>(body.getData());
+
+            if (type == recordEndpoint && size >= endpointBodyBytes) {
+                const int index = get<uint16>(ptr);
+                const int port = get<int32>(ptr);
+                const int addrlen = (uint8) get<char>(ptr);
+                if (endpointBodyBytes + addrlen > size) return false;
+
+                while (endpoints.size() <= index) {
+                    endpoints.add({});
+                }
+                endpoints.getReference(index) = String(ptr, (size_t) addrlen) + ":" + String(port);
+            }
+            else if (type == recordPacket && size >= packetBodyBytes) {
+                packet.arrivalMs = get<int64>(ptr) * 1e-3;
+                packet.endpoint = get<uint16>(ptr);
+                packet.data = ptr;
+                packet.size = size - packetBodyBytes;
+                return packet.endpoint < endpoints.size();
+            }
+        }
+
+        return false;
+    }
+
+    FileInputStream in;
+    bool valid = false;
+    int64 captureStartMillis = 0;
+    double sampleRate = 0.0;
+    int blockSize = 0;
+    int numChannels = 0;
+
+    StringArray endpoints;
+
+private:
+    MemoryBlock body;
+};
+
+// aoo endpoints in a replay are just these, nothing ever gets sent to them
+struct ReplayEndpoint
+{
+    int index = 0;
+};
+
+int32_t discardReply(void *, const char *, int32_t size)
+{
+    return size;
+}
+
+struct ReplaySource
+{
+    void * endpoint = nullptr;
+    int32 id = 0;
+    bool playing = false;
+    double bufferedSumMs = 0.0;
+    int reportIndex = 0;
+};
+
+struct ReplaySink
+{
+    aoo::isink::pointer sink;
+    int endpointIndex = 0;
+    int32 id = 0;
+    Array<ReplaySource> sources;
+
+    PacketCaptureReplayer::Report * report = nullptr;
+    StringArray * endpointNames = nullptr;
+    const double * nowMs = nullptr;
+
+    NetBufferState netbuf;
+    NetBufferPolicy::Settings netbufSettings;
+    float maxBufferTimeMs = 0.0f;
+    int bufferIncreases = 0;
+    int bufferDecreases = 0;
+    double safetyMutedMs = 0.0;
+
+    void applyBufferTime()
+    {
+        sink->set_buffersize((int32_t) netbuf.buffertimeMs);
+        maxBufferTimeMs = jmax(maxBufferTimeMs, netbuf.buffertimeMs);
+    }
+
+    ReplaySource * findSource(void * endpoint, int32 sourceId)
+    {
+        for (auto & src : sources) {
+            if (src.endpoint == endpoint && src.id == sourceId) return &src;
+        }
+        return nullptr;
+    }
+};
+
+int32_t handleReplaySinkEvents(void * user, const aoo_event ** events, int32_t n)
+{
+    auto * rs = static_cast<ReplaySink*>(user);
+    auto & report = *rs->report;
+
+    for (int i = 0; i < n; ++i) {
+        auto * e = (const aoo_source_event *) events[i];
+        auto * src = rs->findSource(e->endpoint, e->id);
+
+        if (events[i]->type == AOO_SOURCE_ADD_EVENT) {
+            if (!src) {
+                PacketCaptureReplayer::SourceReport sr;
+                sr.endpoint = (*rs->endpointNames)[static_cast<ReplayEndpoint*>(e->endpoint)->index];
+                sr.sinkId = rs->id;
+                sr.sourceId = e->id;
+
+                ReplaySource newsrc;
+                newsrc.endpoint = e->endpoint;
+                newsrc.id = e->id;
+                newsrc.reportIndex = report.sources.size();
+                report.sources.add(sr);
+                rs->sources.add(newsrc);
+            }
+            continue;
+        }
+
+        if (!src) continue;
+        auto & sr = report.sources.getReference(src->reportIndex);
+
+        switch (events[i]->type) {
+            case AOO_SOURCE_STATE_EVENT:
+            {
+                auto * se = (const aoo_source_state_event *) events[i];
+                src->playing = se->state == AOO_SOURCE_STATE_PLAY;
+                if (!src->playing) ++sr.stops;
+                break;
+            }
+            case AOO_BLOCK_LOST_EVENT:
+            {
+                const int count = ((const aoo_block_lost_event *) events[i])->count;
+                sr.blocksLost += count;
+                if (NetBufferPolicy::blocksLost(rs->netbuf, count, *rs->nowMs, rs->netbufSettings)) {
+                    rs->applyBufferTime();
+                    ++rs->bufferIncreases;
+                }
+                break;
+            }
+            case AOO_BLOCK_REORDERED_EVENT:
+                sr.blocksReordered += ((const aoo_block_reordered_event *) events[i])->count;
+                break;
+            case AOO_BLOCK_RESENT_EVENT:
+                sr.blocksResent += ((const aoo_block_resent_event *) events[i])->count;
+                break;
+            case AOO_BLOCK_GAP_EVENT:
+                sr.blocksGap += ((const aoo_block_gap_event *) events[i])->count;
+                break;
+            case AOO_PING_EVENT:
+                if (NetBufferPolicy::pingReceived(rs->netbuf, *rs->nowMs, rs->netbufSettings)) {
+                    rs->applyBufferTime();
+                    ++rs->bufferDecreases;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return 1;
+}
+
+// the replay runs on a single thread, so a plain pointer is enough to route the aoo trace hook
+std::map<String, int64> * currentTraceCounts = nullptr;
+
+void countTraceEvent(const char * name, char phase, int32_t, int64_t)
+{
+    if (phase == 'i' && currentTraceCounts) {
+        (*currentTraceCounts)[String(name)] += 1;
+    }
+}
+
+}
+
+const char * PacketCaptureWriter::fileExtension = ".sbpkt";
+
+PacketCaptureWriter::PacketCaptureWriter(std::unique_ptr<OutputStream> stream_, double sampleRate, int blockSize, int numChannels, int fifoBytes)
+: stream(std::move(stream_)), fifo(fifoBytes), startTimeMs(Time::getMillisecondCounterHiRes())
+{
+    fifoData.calloc((size_t) fifoBytes);
+
+    if (!stream) {
+        ok = false;
+        return;
+    }
+
+    stream->write(fileMagic, sizeof(fileMagic));
+    stream->writeInt(formatVersion);
+    stream->writeInt64(Time::currentTimeMillis());
+    stream->writeDouble(sampleRate);
+    stream->writeInt(blockSize);
+    ok = stream->writeInt(numChannels);
+}
+
+PacketCaptureWriter::~PacketCaptureWriter()
+{
+}
+
+void PacketCaptureWriter::capture(const void * endpointKey, const String & address, int port, const char * data, int size)
+{
+    const double arrivalMs = Time::getMillisecondCounterHiRes() - startTimeMs;
+
+    auto found = endpointIndices.find(endpointKey);
+    if (found == endpointIndices.end()) {
+        const int index = (int) endpointIndices.size();
+        if (index >= maxEndpoints) {
+            droppedPackets.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        char header[recordHeaderBytes + endpointBodyBytes];
+        auto addr = address.toUTF8();
+        const int addrlen = jmin(255, (int) addr.sizeInBytes() - 1);
+
+        char * ptr = header;
+        ptr = put<char>(ptr, recordEndpoint);
+        ptr = put<int32>(ptr, endpointBodyBytes + addrlen);
+        ptr = put<uint16>(ptr, (uint16) index);
+        ptr = put<int32>(ptr, port);
+        ptr = put<char>(ptr, (char) addrlen);
+
+        // only known once it's in the file
+        if (!pushRecord(header, (int) sizeof(header), addr.getAddress(), addrlen)) {
+            droppedPackets.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        found = endpointIndices.emplace(endpointKey, index).first;
+    }
+
+    char header[recordHeaderBytes + packetBodyBytes];
+
+    char * ptr = header;
+    ptr = put<char>(ptr, recordPacket);
+    ptr = put<int32>(ptr, packetBodyBytes + size);
+    ptr = put<int64>(ptr, (int64) (arrivalMs * 1e3));
+    ptr = put<uint16>(ptr, (uint16) found->second);
+
+    if (pushRecord(header, (int) sizeof(header), data, size)) {
+        capturedPackets.fetch_add(1, std::memory_order_relaxed);
+    }
+    else {
+        droppedPackets.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool PacketCaptureWriter::pushRecord(const void * header, int headerSize, const void * payload, int payloadSize)
+{
+    if (!ok || fifo.getFreeSpace() < headerSize + payloadSize) {
+        return false;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(headerSize + payloadSize, start1, size1, start2, size2);
+
+    // copy header and payload as one contiguous span across the two fifo segments
+    auto copySpan = [&](const char * src, int srcsize, int offset) {
+        while (srcsize > 0) {
+            const bool first = offset < size1;
+            const int segstart = first ? start1 + offset : start2 + (offset - size1);
+            const int segleft = first ? size1 - offset : size2 - (offset - size1);
+            const int n = jmin(srcsize, segleft);
+            memcpy(fifoData.get() + segstart, src, (size_t) n);
+            src += n;
+            srcsize -= n;
+            offset += n;
+        }
+    };
+
+    copySpan(static_cast<const char*>(header), headerSize, 0);
+    if (payloadSize > 0) {
+        copySpan(static_cast<const char*>(payload), payloadSize, headerSize);
+    }
+
+    fifo.finishedWrite(size1 + size2);
+    return true;
+}
+
+bool PacketCaptureWriter::drain()
+{
+    const ScopedLock sl (drainLock);
+
+    const int ready = fifo.getNumReady();
+    if (ready <= 0 || !stream) return false;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(ready, start1, size1, start2, size2);
+
+    if (size1 > 0) ok &= stream->write(fifoData.get() + start1, (size_t) size1);
+    if (size2 > 0) ok &= stream->write(fifoData.get() + start2, (size_t) size2);
+
+    fifo.finishedRead(size1 + size2);
+    return true;
+}
+
+int PacketCaptureWriter::useTimeSlice()
+{
+    return drain() ? 20 : 100;
+}
+
+bool PacketCaptureWriter::finish()
+{
+    drain();
+
+    const ScopedLock sl (drainLock);
+    if (stream) {
+        stream->flush();
+    }
+
+    if (droppedPackets.load() > 0) {
+        DBG("Packet capture dropped " << droppedPackets.load() << " packets");
+    }
+
+    return ok;
+}
+
+
+//////////////////////////
+
+bool PacketCaptureReplayer::replay(const File & source, const Options & options, Report & report, String & error)
+{
+    PacketReader reader(source);
+    if (!reader.valid) {
+        error = TRANS("Not a packet capture file: ") + source.getFullPathName();
+        return false;
+    }
+
+    report = Report();
+    report.sampleRate = options.sampleRate > 0.0 ? options.sampleRate : (reader.sampleRate > 0.0 ? reader.sampleRate : 48000.0);
+    report.blockSize = options.blockSize > 0 ? options.blockSize : (reader.blockSize > 0 ? reader.blockSize : 256);
+    report.bufferTimeMs = options.bufferTimeMs;
+    report.autoBufferMode = options.autoBufferMode;
+    const int numChannels = options.numChannels > 0 ? options.numChannels : jmax(2, reader.numChannels);
+
+    const double blockMs = 1000.0 * report.blockSize / report.sampleRate;
+    const double endMs = options.maxSeconds > 0.0 ? options.maxSeconds * 1000.0 : std::numeric_limits<double>::max();
+
+    AudioBuffer<float> work(numChannels, report.blockSize);
+    HeapBlock<aoo_sample*> channelPtrs((size_t) numChannels);
+    for (int ch = 0; ch < numChannels; ++ch) {
+        channelPtrs[ch] = work.getWritePointer(ch);
+    }
+
+    OwnedArray<ReplayEndpoint> endpoints;
+    OwnedArray<ReplaySink> sinks;
+    Array<double> lastArrivalMs;
+
+    // virtual clock, arrival times are relative to the start of the capture
+    double nowMs = 0.0;
+
+    auto getEndpoint = [&](int index) {
+        while (endpoints.size() <= index) {
+            auto * endpoint = new ReplayEndpoint();
+            endpoint->index = endpoints.size();
+            endpoints.add(endpoint);
+            lastArrivalMs.add(-1.0);
+        }
+        return endpoints.getUnchecked(index);
+    };
+
+    auto findOrAddSink = [&](int endpointIndex, int32 id) {
+        for (auto * rs : sinks) {
+            if (rs->endpointIndex == endpointIndex && rs->id == id) return rs;
+        }
+
+        // same setup as a peer's sink in the processor
+        auto * rs = sinks.add(new ReplaySink());
+        rs->sink.reset(aoo::isink::create(id));
+        rs->endpointIndex = endpointIndex;
+        rs->id = id;
+        rs->report = &report;
+        rs->endpointNames = &reader.endpoints;
+        rs->nowMs = &nowMs;
+
+        rs->netbufSettings.mode = options.autoBufferMode;
+        rs->netbufSettings.dropRateThreshold = options.dropRateThreshold;
+        rs->netbufSettings.blockMs = (float) blockMs;
+        rs->netbuf.buffertimeMs = options.autoBufferMode == NetBufferPolicy::ModeInitAuto ? 0.0f : options.bufferTimeMs;
+        rs->netbuf.netBufAutoBaseline = (float) blockMs; // at least a process block
+        rs->netbuf.resetDroptime = nowMs;
+        rs->netbuf.fastDropRate.resetInitVal(0.0f);
+        rs->netbuf.resetSafetyMuted = rs->netbuf.buffertimeMs < 3.0f;
+
+        rs->sink->setup((int32_t) report.sampleRate, report.blockSize, numChannels);
+        rs->applyBufferTime();
+        int32_t flags = AOO_PROTOCOL_FLAG_COMPACT_DATA | AOO_PROTOCOL_FLAG_SILENT_BLOCKS | AOO_PROTOCOL_FLAG_BINARY_DATA;
+        rs->sink->set_option(aoo_opt_protocol_flags, &flags, sizeof(int32_t));
+        rs->sink->set_dynamic_resampling(options.dynamicResampling ? 1 : 0);
+        return rs;
+    };
+
+    auto received = [&](ReplaySink * rs) {
+        if (rs->netbuf.resetSafetyMuted) {
+            NetBufferPolicy::updateSafetyMuting(rs->netbuf, nowMs);
+        }
+    };
+
+    auto deliver = [&](const PacketReader::Packet & packet) {
+        auto * endpoint = getEndpoint(packet.endpoint);
+
+        auto & last = lastArrivalMs.getReference(packet.endpoint);
+        if (last >= 0.0) {
+            report.largestArrivalGapMs = jmax(report.largestArrivalGapMs, packet.arrivalMs - last);
+        }
+        last = packet.arrivalMs;
+
+        int32_t type, id;
+        if (aoo_parse_pattern(packet.data, packet.size, &type, &id) <= 0 || type != AOO_TYPE_SINK) {
+            // peer, latency and server traffic
+            ++report.unhandledPackets;
+            return;
+        }
+
+        if (id == AOO_ID_NONE) {
+            // compact data message, whichever sink knows the source takes it
+            for (auto * rs : sinks) {
+                if (rs->endpointIndex == packet.endpoint
+                    && rs->sink->handle_message(packet.data, packet.size, endpoint, discardReply)) {
+                    received(rs);
+                    return;
+                }
+            }
+            ++report.unhandledPackets;
+            return;
+        }
+
+        if (id == AOO_ID_WILDCARD) {
+            for (auto * rs : sinks) {
+                if (rs->endpointIndex == packet.endpoint
+                    && rs->sink->handle_message(packet.data, packet.size, endpoint, discardReply)) {
+                    received(rs);
+                }
+            }
+            return;
+        }
+
+        auto * rs = findOrAddSink(packet.endpoint, id);
+        if (rs->sink->handle_message(packet.data, packet.size, endpoint, discardReply)) {
+            received(rs);
+        }
+    };
+
+    std::map<String, int64> traceCounts;
+    currentTraceCounts = &traceCounts;
+    aoo_set_tracefn(countTraceEvent);
+
+    const uint64_t baseTime = aoo_osctime_get();
+    double lastPacketMs = 0.0;
+
+    PacketReader::Packet packet;
+    bool havePacket = reader.next(packet);
+
+    while (nowMs < endMs && (havePacket || nowMs < lastPacketMs + replayTailMs)) {
+        const auto startTicks = Time::getHighResolutionTicks();
+
+        while (havePacket && packet.arrivalMs <= nowMs) {
+            ++report.packets;
+            report.bytes += packet.size;
+            lastPacketMs = packet.arrivalMs;
+
+            deliver(packet);
+            havePacket = reader.next(packet);
+        }
+
+        const uint64_t t = baseTime + aoo_osctime_fromseconds(nowMs * 1e-3);
+
+        for (auto * rs : sinks) {
+            rs->sink->process(channelPtrs.get(), report.blockSize, t);
+            rs->sink->send(); // resend requests and pings, nobody is listening
+
+            if (rs->sink->events_available() > 0) {
+                rs->sink->handle_events(handleReplaySinkEvents, rs);
+            }
+        }
+
+        const double blockCpuMs = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks) * 1e3;
+        report.cpuSeconds += blockCpuMs * 1e-3;
+        report.worstBlockCpuMs = jmax(report.worstBlockCpuMs, blockCpuMs);
+
+        for (auto * rs : sinks) {
+            bool playing = false;
+
+            for (auto & src : rs->sources) {
+                if (!src.playing) continue;
+                playing = true;
+
+                float ratio = 0.0f;
+                rs->sink->get_sourceoption(src.endpoint, src.id, aoo_opt_buffer_fill_ratio, AOO_ARG(ratio));
+                const double bufferedMs = ratio * rs->netbuf.buffertimeMs;
+
+                auto & sr = report.sources.getReference(src.reportIndex);
+                sr.minBufferedMs = sr.playingBlocks == 0 ? bufferedMs : jmin(sr.minBufferedMs, bufferedMs);
+                sr.maxBufferedMs = jmax(sr.maxBufferedMs, bufferedMs);
+                src.bufferedSumMs += bufferedMs;
+                ++sr.playingBlocks;
+            }
+
+            if (playing && rs->netbuf.resetSafetyMuted) {
+                rs->safetyMutedMs += blockMs;
+            }
+        }
+
+        nowMs += blockMs;
+    }
+
+    aoo_set_tracefn(nullptr);
+    currentTraceCounts = nullptr;
+
+    for (auto * rs : sinks) {
+        for (auto & src : rs->sources) {
+            auto & sr = report.sources.getReference(src.reportIndex);
+            if (sr.playingBlocks > 0) {
+                sr.meanBufferedMs = src.bufferedSumMs / sr.playingBlocks;
+            }
+            sr.finalBufferTimeMs = rs->netbuf.buffertimeMs;
+            sr.maxBufferTimeMs = rs->maxBufferTimeMs;
+            sr.bufferIncreases = rs->bufferIncreases;
+            sr.bufferDecreases = rs->bufferDecreases;
+            sr.safetyMutedMs = rs->safetyMutedMs;
+        }
+    }
+
+    for (auto & item : traceCounts) {
+        report.traceCounts.set(item.first, String(item.second));
+    }
+
+    report.capturedSeconds = lastPacketMs * 1e-3;
+    report.replayedSeconds = nowMs * 1e-3;
+
+    return true;
+}
+
+String PacketCaptureReplayer::Report::toString() const
+{
+    String out;
+    const char * modeNames[] = { "off", "increase", "full", "initial" };
+    out << "samplerate: " << sampleRate << "  blocksize: " << blockSize << "  buffer: " << bufferTimeMs << " ms"
+        << "  auto: " << modeNames[jlimit(0, 3, (int) autoBufferMode)] << newLine;
+    out << "packets: " << packets << " (" << unhandledPackets << " not for a sink)  bytes: " << bytes
+        << "  captured: " << String(capturedSeconds, 2) << " s  largest arrival gap: " << String(largestArrivalGapMs, 1) << " ms" << newLine;
+
+    out << "cpu: " << String(cpuSeconds, 3) << " s for " << String(replayedSeconds, 2) << " s of audio ("
+        << String(cpuSeconds > 0.0 ? replayedSeconds / cpuSeconds : 0.0, 1)
+        << "x realtime)  worst block: " << String(worstBlockCpuMs, 3) << " ms" << newLine;
+
+    for (auto & sr : sources) {
+        out << "source " << sr.sourceId << " from " << sr.endpoint << " (sink " << sr.sinkId << "): "
+            << "lost " << sr.blocksLost << "  reordered " << sr.blocksReordered << "  resent " << sr.blocksResent
+            << "  gaps " << sr.blocksGap << "  stops " << sr.stops
+            << "  buffered ms mean/min/max " << String(sr.meanBufferedMs, 1) << "/" << String(sr.minBufferedMs, 1) << "/" << String(sr.maxBufferedMs, 1)
+            << "  buffer ms final/max " << String(sr.finalBufferTimeMs, 1) << "/" << String(sr.maxBufferTimeMs, 1)
+            << " (+" << sr.bufferIncreases << " -" << sr.bufferDecreases << ")"
+            << "  safety muted " << String(sr.safetyMutedMs * 1e-3, 2) << " s"
+            << newLine;
+    }
+
+    for (auto & key : traceCounts.getAllKeys()) {
+        out << key << ": " << traceCounts[key] << newLine;
+    }
+
+    return out;
+}
@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include "NetBufferPolicy.h"
+
+#include <map>
+
+namespace SonoAudio {
+
+// Network packet capture (.sbpkt)
+//
+// Logs every received datagram exactly as it came off the socket, with its arrival time
+// (monotonic, relative to the start of the capture) and the sender. Endpoints are written
+// once and referred to by index afterwards, which keeps the file small.
+//
+// The receive threads only copy the packet into a FIFO, a TimeSliceThread writes it to disk.
+// Captures can be replayed through the aoo sinks with PacketCaptureReplayer, to compare
+// jitter buffer settings on the same real network conditions.
+
+class PacketCaptureWriter : public TimeSliceClient
+{
+public:
+    // the audio settings are stored as the defaults for the replay
+    PacketCaptureWriter(std::unique_ptr<OutputStream> stream, double sampleRate, int blockSize, int numChannels,
+                        int fifoBytes = 4 << 20);
+    ~PacketCaptureWriter() override;
+
+    bool isOk() const { return stream != nullptr && ok; }
+
+    // the endpoint key identifies the sender for the lifetime of the capture, address and
+    // port are only looked at the first time a key shows up.
+    // calls must be serialized by the caller
+    void capture(const void * endpointKey, const String & address, int port, const char * data, int size);
+
+    // writes everything still queued and flushes the file, call after the last capture() returned
+    bool finish();
+
+    // packets that did not fit into the fifo
+    int64 getDroppedPackets() const { return droppedPackets.load(); }
+    int64 getCapturedPackets() const { return capturedPackets.load(); }
+
+    int useTimeSlice() override;
+
+    static const char * fileExtension; // ".sbpkt"
+
+private:
+    bool pushRecord(const void * header, int headerSize, const void * payload, int payloadSize);
+    bool drain();
+
+    std::unique_ptr<OutputStream> stream;
+    AbstractFifo fifo;
+    HeapBlock<char> fifoData;
+    double startTimeMs;
+    bool ok = true;
+
+    std::map<const void*, int> endpointIndices;
+
+    std::atomic<int64> droppedPackets { 0 };
+    std::atomic<int64> capturedPackets { 0 };
+    CriticalSection drainLock;
+};
+
+
+// Feeds a packet capture through aoo sinks set up like the processor's peer sinks, under a
+// virtual clock that advances one audio block at a time. Packets are delivered at the block
+// their arrival time falls into, so a replay is deterministic and runs as fast as the CPU allows.
+// The automatic jitter buffer sizing and safety muting run on the sink events like in the
+// processor, through NetBufferPolicy on the virtual clock.
+
+class PacketCaptureReplayer
+{
+public:
+    struct Options
+    {
+        // 0 uses the values stored in the capture
+        double sampleRate = 0.0;
+        int blockSize = 0;
+        int numChannels = 0;
+
+        // starting size, changed by the auto sizing unless that is off
+        float bufferTimeMs = 20.0f;
+        NetBufferPolicy::Mode autoBufferMode = NetBufferPolicy::ModeAutoFull;
+        float dropRateThreshold = 0.5f;
+        bool dynamicResampling = false;
+        // only the first this many seconds, 0 for all
+        double maxSeconds = 0.0;
+    };
+
+    struct SourceReport
+    {
+        String endpoint;
+        int32 sinkId = 0;
+        int32 sourceId = 0;
+
+        int64 blocksLost = 0;
+        int64 blocksReordered = 0;
+        int64 blocksResent = 0;
+        int64 blocksGap = 0;
+        // stream went to stopped, either the sender stopped or the jitter buffer ran dry for
+        // too long. the individual underruns are in the trace counts
+        int64 stops = 0;
+
+        // buffered audio, sampled every block while playing
+        double meanBufferedMs = 0.0;
+        double minBufferedMs = 0.0;
+        double maxBufferedMs = 0.0;
+        int64 playingBlocks = 0;
+
+        // jitter buffer of its sink, as the auto sizing left it
+        float finalBufferTimeMs = 0.0f;
+        float maxBufferTimeMs = 0.0f;
+        int bufferIncreases = 0;
+        int bufferDecreases = 0;
+        // output held muted after the start while playing, until the drops settled
+        double safetyMutedMs = 0.0;
+    };
+
+    struct Report
+    {
+        double sampleRate = 0.0;
+        int blockSize = 0;
+        float bufferTimeMs = 0.0f;
+        NetBufferPolicy::Mode autoBufferMode = NetBufferPolicy::ModeOff;
+
+        int64 packets = 0;
+        int64 unhandledPackets = 0;
+        int64 bytes = 0;
+        double capturedSeconds = 0.0;
+        double replayedSeconds = 0.0;
+        double largestArrivalGapMs = 0.0;
+
+        // wall clock time spent in the sinks
+        double cpuSeconds = 0.0;
+        double worstBlockCpuMs = 0.0;
+
+        Array<SourceReport> sources;
+
+        // aoo trace instants seen during the replay (xrun reasons etc.), by name
+        StringPairArray traceCounts;
+
+        String toString() const;
+    };
+
+    // needs the aoo codecs to be registered (aoo_initialize).
+    // returns false if the file isn't a valid capture
+    static bool replay(const File & source, const Options & options, Report & report, String & error);
+};
+
+}
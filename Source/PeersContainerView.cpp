@@ -672,6 +672,57 @@ PeerViewInfo * PeersContainerView::createPeerViewInfo()
 
     pvf->fullMode = peerModeFull;
 
+    pvf->addAndMakeVisible(pvf->channelGroups.get());
+    pvf->channelGroups->addMouseListener(this, true);
+
+    pvf->addAndMakeVisible(pvf->sendStatsBg.get());
+    pvf->addAndMakeVisible(pvf->recvStatsBg.get());
+    pvf->addAndMakeVisible(pvf->pingBg.get());
+    //pvf->addAndMakeVisible(pvf->sendMutedButton.get());
+    pvf->addAndMakeVisible(pvf->recvMutedButton.get());
+    pvf->addAndMakeVisible(pvf->recvSoloButton.get());
+    pvf->addAndMakeVisible(pvf->latActiveButton.get());
+
+
+    pvf->addAndMakeVisible(pvf->sendOptionsButton.get());
+    pvf->addAndMakeVisible(pvf->recvOptionsButton.get());
+    pvf->addAndMakeVisible(pvf->staticLatencyLabel.get());
+    pvf->addAndMakeVisible(pvf->staticPingLabel.get());
+    pvf->addAndMakeVisible(pvf->latencyLabel.get());
+    pvf->addAndMakeVisible(pvf->pingLabel.get());
+
+    pvf->addAndMakeVisible(pvf->statusLabel.get());
+    pvf->addAndMakeVisible(pvf->jitterBufferMeter.get());
+    pvf->addAndMakeVisible(pvf->staticSendQualLabel.get());
+    pvf->addAndMakeVisible(pvf->staticBufferLabel.get());
+    pvf->addAndMakeVisible(pvf->sendQualityLabel.get());
+    pvf->addAndMakeVisible(pvf->bufferLabel.get());
+    pvf->addAndMakeVisible(pvf->bufferMinFrontButton.get());
+    pvf->addAndMakeVisible(pvf->recvButtonImage.get());
+    pvf->addAndMakeVisible(pvf->sendButtonImage.get());
+
+    pvf->recvOptionsContainer->addAndMakeVisible(pvf->addrLabel.get());
+    pvf->recvOptionsContainer->addAndMakeVisible(pvf->staticAddrLabel.get());
+    pvf->recvOptionsContainer->addAndMakeVisible(pvf->autosizeButton.get());
+    pvf->recvOptionsContainer->addAndMakeVisible(pvf->bufferTimeLabel.get());
+    pvf->recvOptionsContainer->addAndMakeVisible(pvf->bufferTimeSlider.get());
+    pvf->recvOptionsContainer->addAndMakeVisible(pvf->bufferMinButton.get());
+    pvf->recvOptionsContainer->addAndMakeVisible(pvf->optionsResetDropButton.get());
+    pvf->recvOptionsContainer->addAndMakeVisible(pvf->remoteSendFormatChoiceButton.get());
+    pvf->recvOptionsContainer->addAndMakeVisible(pvf->staticRemoteSendFormatChoiceLabel.get());
+    pvf->recvOptionsContainer->addAndMakeVisible(pvf->changeAllRecvFormatButton.get());
+
+    pvf->sendOptionsContainer->addAndMakeVisible(pvf->formatChoiceButton.get());
+    pvf->sendOptionsContainer->addAndMakeVisible(pvf->changeAllFormatButton.get());
+    pvf->sendOptionsContainer->addAndMakeVisible(pvf->staticFormatChoiceLabel.get());
+    pvf->sendOptionsContainer->addAndMakeVisible(pvf->sendMutedButton.get());
+    pvf->sendOptionsContainer->addAndMakeVisible(pvf->optionsRemoveButton.get());
+    pvf->sendOptionsContainer->addAndMakeVisible(pvf->optionsBlockButton.get());
+
+    //pvf->addAndMakeVisible(pvf->recvMeter.get());
+    pvf->addAndMakeVisible(pvf->sendActualBitrateLabel.get());
+    pvf->addAndMakeVisible(pvf->recvActualBitrateLabel.get());
+
     return pvf;
 }
     
@@ -717,6 +768,7 @@ void PeersContainerView::nameLabelClicked(ChannelGroupsView *comp)
         PeerViewInfo * pvf = mPeerViews.getUnchecked(i);
         if (pvf->channelGroups.get() == comp) {
             pvf->fullMode = !pvf->fullMode;
+            pvf->needsSetup = true;
             break;
         }
     }
@@ -777,6 +829,7 @@ void PeersContainerView::setPeerDisplayMode(SonobusAudioProcessor::PeerDisplayMo
         PeerViewInfo * pvf = mPeerViews.getUnchecked(i);
 
         pvf->fullMode = (mode == SonobusAudioProcessor::PeerDisplayModeFull);
+        pvf->needsSetup = true;
     }
 
     peerModeFull = (mode == SonobusAudioProcessor::PeerDisplayModeFull);
@@ -791,18 +844,8 @@ void PeersContainerView::rebuildPeerViews()
     
     showSendOptions(0, false);
     showRecvOptions(0, false);
-    
-    while (mPeerViews.size() < numpeers) {
-        mPeerViews.add(createPeerViewInfo());
-    }
-    while (mPeerViews.size() > numpeers) {
-        mPeerViews.removeLast();
-    }
-
-    bool anyfull = false;
 
-    for (int i=0; i < mPeerViews.size(); ++i) {
-        PeerViewInfo * pvf = mPeerViews.getUnchecked(i);
+    for (int i=0; i < numpeers; ++i) {
         String username = processor.getRemotePeerUserName(i);
         // remove from pending if necessary
         mPendingUsers.erase(username);
@@ -811,97 +854,54 @@ void PeersContainerView::rebuildPeerViews()
         if (prio >= 0) {
             mPeerPriorityOrdering[username] = prio;
         }
+    }
+
+    updatePeerOrdering();
 
+    // views are kept per peer, so only the rows of peers that joined or changed get set up,
+    // whatever is left in mPeerViews afterwards belongs to peers that are gone
+    OwnedArray<PeerViewInfo> peerviews;
+    bool anyfull = false;
 
-        pvf->channelGroups->getAudioDeviceManager = getAudioDeviceManager;
+    for (int di=0; di < (int) mPeerUpdateOrdering.size(); ++di) {
+        int i = mPeerUpdateOrdering[di];
+        uint32 viewid = processor.getRemotePeerViewId(i);
 
-        pvf->addAndMakeVisible(pvf->channelGroups.get());
-        pvf->channelGroups->setPeerMode(true, i);
-        pvf->channelGroups->setNarrowMode(isNarrow);
-        pvf->channelGroups->rebuildChannelViews();
+        PeerViewInfo * pvf = nullptr;
+        for (int j=0; j < mPeerViews.size(); ++j) {
+            if (mPeerViews.getUnchecked(j)->peerViewId == viewid) {
+                pvf = mPeerViews.removeAndReturn(j);
+                break;
+            }
+        }
 
-        pvf->channelGroups->addMouseListener(this, true);
-        
-        pvf->addAndMakeVisible(pvf->sendStatsBg.get());
-        pvf->addAndMakeVisible(pvf->recvStatsBg.get());
-        pvf->addAndMakeVisible(pvf->pingBg.get());
-        //pvf->addAndMakeVisible(pvf->sendMutedButton.get());
-        pvf->addAndMakeVisible(pvf->recvMutedButton.get());
-        pvf->addAndMakeVisible(pvf->recvSoloButton.get());
-        pvf->addAndMakeVisible(pvf->latActiveButton.get());
-
-
-        pvf->addAndMakeVisible(pvf->sendOptionsButton.get());
-        pvf->addAndMakeVisible(pvf->recvOptionsButton.get());
-        pvf->addAndMakeVisible(pvf->staticLatencyLabel.get());
-        pvf->addAndMakeVisible(pvf->staticPingLabel.get());
-        pvf->addAndMakeVisible(pvf->latencyLabel.get());
-        pvf->addAndMakeVisible(pvf->pingLabel.get());
-
-        pvf->addAndMakeVisible(pvf->statusLabel.get());
-        pvf->addAndMakeVisible(pvf->jitterBufferMeter.get());
-        pvf->addAndMakeVisible(pvf->staticSendQualLabel.get());
-        pvf->addAndMakeVisible(pvf->staticBufferLabel.get());
-        pvf->addAndMakeVisible(pvf->sendQualityLabel.get());
-        pvf->addAndMakeVisible(pvf->bufferLabel.get());
-        pvf->addAndMakeVisible(pvf->bufferMinFrontButton.get());
-        pvf->addAndMakeVisible(pvf->recvButtonImage.get());
-        pvf->addAndMakeVisible(pvf->sendButtonImage.get());
-
-        pvf->recvOptionsContainer->addAndMakeVisible(pvf->addrLabel.get());
-        pvf->recvOptionsContainer->addAndMakeVisible(pvf->staticAddrLabel.get());
-        pvf->recvOptionsContainer->addAndMakeVisible(pvf->autosizeButton.get());
-        pvf->recvOptionsContainer->addAndMakeVisible(pvf->bufferTimeLabel.get());
-        pvf->recvOptionsContainer->addAndMakeVisible(pvf->bufferTimeSlider.get());
-        pvf->recvOptionsContainer->addAndMakeVisible(pvf->bufferMinButton.get());
-        pvf->recvOptionsContainer->addAndMakeVisible(pvf->optionsResetDropButton.get());
-        pvf->recvOptionsContainer->addAndMakeVisible(pvf->remoteSendFormatChoiceButton.get());
-        pvf->recvOptionsContainer->addAndMakeVisible(pvf->staticRemoteSendFormatChoiceLabel.get());
-        pvf->recvOptionsContainer->addAndMakeVisible(pvf->changeAllRecvFormatButton.get());
-
-        pvf->sendOptionsContainer->addAndMakeVisible(pvf->formatChoiceButton.get());
-        pvf->sendOptionsContainer->addAndMakeVisible(pvf->changeAllFormatButton.get());
-        pvf->sendOptionsContainer->addAndMakeVisible(pvf->staticFormatChoiceLabel.get());
-        pvf->sendOptionsContainer->addAndMakeVisible(pvf->sendMutedButton.get());
-        pvf->sendOptionsContainer->addAndMakeVisible(pvf->optionsRemoveButton.get());
-        pvf->sendOptionsContainer->addAndMakeVisible(pvf->optionsBlockButton.get());
-
-        //pvf->addAndMakeVisible(pvf->recvMeter.get());
-        pvf->addAndMakeVisible(pvf->sendActualBitrateLabel.get());
-        pvf->addAndMakeVisible(pvf->recvActualBitrateLabel.get());
+        if (!pvf) {
+            pvf = createPeerViewInfo();
+            pvf->peerViewId = viewid;
+            addAndMakeVisible(pvf);
+        }
 
-        auto fullmode = pvf->fullMode;
+        peerviews.add(pvf);
 
-        // visibility based on peerdisplay mode
-        pvf->sendQualityLabel->setVisible(fullmode);
-        pvf->bufferLabel->setVisible(fullmode);
-        pvf->bufferMinFrontButton->setVisible(fullmode);
-        pvf->latencyLabel->setVisible(fullmode);
-        pvf->latActiveButton->setVisible(fullmode);
-        pvf->sendActualBitrateLabel->setVisible(fullmode);
-        pvf->recvActualBitrateLabel->setVisible(fullmode);
-        pvf->recvStatsBg->setVisible(fullmode);
-        pvf->sendStatsBg->setVisible(fullmode);
-        pvf->staticSendQualLabel->setVisible(fullmode);
-        pvf->staticLatencyLabel->setVisible(fullmode);
-        pvf->staticPingLabel->setVisible(fullmode);
-        pvf->staticBufferLabel->setVisible(fullmode);
-        pvf->pingBg->setVisible(fullmode);
-        pvf->recvButtonImage->setVisible(fullmode);
-        pvf->sendButtonImage->setVisible(fullmode);
-        pvf->jitterBufferMeter->setVisible(fullmode);
-        pvf->pingLabel->setVisible(fullmode);
-        pvf->sendOptionsButton->setVisible(fullmode);
-        pvf->recvOptionsButton->setVisible(fullmode);
-        pvf->latActiveButton->setVisible(fullmode);
-
-        if (fullmode) {
-            anyfull = true;
+        bool layoutchanged = (processor.fetchRemotePeerViewChanges(i) & SonobusAudioProcessor::PeerViewChangeLayout) != 0;
+
+        if (pvf->needsSetup || layoutchanged) {
+            setupPeerView(pvf, i);
+        }
+        else if (pvf->peerIndex != i) {
+            // same peer, others before it came or went
+            pvf->channelGroups->setPeerMode(true, i);
+            pvf->peerIndex = i;
         }
 
-        addAndMakeVisible(pvf);
+        if (pvf->fullMode) {
+            anyfull = true;
+        }
     }
-    
+
+    mPeerViews.swapWith(peerviews);
+    peerviews.clear();
+
     while (mPendingPeerViews.size() < mPendingUsers.size()) {
         mPendingPeerViews.add(createPendingPeerViewInfo());
     }
@@ -924,13 +924,48 @@ void PeersContainerView::rebuildPeerViews()
         stopTimer(FillRatioUpdateTimerId);
     }
 
-    updatePeerOrdering();
-
     updatePeerViews();
     updateLayout();
     resized();
 }
 
+void PeersContainerView::setupPeerView(PeerViewInfo * pvf, int peerindex)
+{
+    pvf->channelGroups->getAudioDeviceManager = getAudioDeviceManager;
+
+    pvf->channelGroups->setPeerMode(true, peerindex);
+    pvf->channelGroups->setNarrowMode(isNarrow);
+    pvf->channelGroups->rebuildChannelViews();
+
+    auto fullmode = pvf->fullMode;
+
+    // visibility based on peerdisplay mode
+    pvf->sendQualityLabel->setVisible(fullmode);
+    pvf->bufferLabel->setVisible(fullmode);
+    pvf->bufferMinFrontButton->setVisible(fullmode);
+    pvf->latencyLabel->setVisible(fullmode);
+    pvf->latActiveButton->setVisible(fullmode);
+    pvf->sendActualBitrateLabel->setVisible(fullmode);
+    pvf->recvActualBitrateLabel->setVisible(fullmode);
+    pvf->recvStatsBg->setVisible(fullmode);
+    pvf->sendStatsBg->setVisible(fullmode);
+    pvf->staticSendQualLabel->setVisible(fullmode);
+    pvf->staticLatencyLabel->setVisible(fullmode);
+    pvf->staticPingLabel->setVisible(fullmode);
+    pvf->staticBufferLabel->setVisible(fullmode);
+    pvf->pingBg->setVisible(fullmode);
+    pvf->recvButtonImage->setVisible(fullmode);
+    pvf->sendButtonImage->setVisible(fullmode);
+    pvf->jitterBufferMeter->setVisible(fullmode);
+    pvf->pingLabel->setVisible(fullmode);
+    pvf->sendOptionsButton->setVisible(fullmode);
+    pvf->recvOptionsButton->setVisible(fullmode);
+    pvf->latActiveButton->setVisible(fullmode);
+
+    pvf->peerIndex = peerindex;
+    pvf->needsSetup = false;
+}
+
 void PeersContainerView::updatePeerOrdering()
 {
     mPeerUpdateOrdering.clear();
@@ -1569,11 +1604,23 @@ void PeersContainerView::applyToAllSliders(std::function<void(Slider *)> & routi
     }
 }
 
+bool PeersContainerView::getPeerStats(int peerindex, const PeerViewInfo * pvf, SonobusAudioProcessor::PeerStats & retstats)
+{
+    if (peerindex >= 0 && peerindex < mPeerStats.size() && mPeerStats.getReference(peerindex).viewId == pvf->peerViewId) {
+        retstats = mPeerStats.getReference(peerindex);
+        return true;
+    }
+
+    return processor.getRemotePeerStats(peerindex, retstats);
+}
+
 void PeersContainerView::updatePeerViews(int specific)
 {
     uint32 nowstampms = Time::getMillisecondCounter();
     bool needsUpdateLayout = false;
 
+    processor.getAllRemotePeerStats(mPeerStats);
+
 
     //    for (int i=0; i < mPeerViews.size(); ++i) {
     for (int di=0; di < mPeerUpdateOrdering.size(); ++di) {
@@ -1586,6 +1633,9 @@ void PeersContainerView::updatePeerViews(int specific)
         }
         PeerViewInfo * pvf = mPeerViews.getUnchecked(di);
 
+        SonobusAudioProcessor::PeerStats stats;
+        getPeerStats(i, pvf, stats);
+
         pvf->channelGroups->setPeerMode(true, i);
 
         bool connected = processor.getRemotePeerConnected(i);
@@ -1621,8 +1671,8 @@ void PeersContainerView::updatePeerViews(int specific)
         
         if (lastUpdateTimestampMs > 0) {
             double timedelta = (nowstampms - lastUpdateTimestampMs) * 1e-3;
-            int64_t nbs = processor.getRemotePeerBytesSent(i);
-            int64_t nbr = processor.getRemotePeerBytesReceived(i);
+            int64_t nbs = stats.bytesSent;
+            int64_t nbr = stats.bytesReceived;
             
             sendrate = (nbs - pvf->lastBytesSent) / timedelta;
             recvrate = (nbr - pvf->lastBytesRecv) / timedelta;
@@ -1660,7 +1710,7 @@ void PeersContainerView::updatePeerViews(int specific)
             << recvfinfo.name
             << String::formatted(" | %d kb/s", lrintf(recvrate * 8 * 1e-3));
 
-            int64_t dropped = processor.getRemotePeerPacketsDropped(i);
+            int64_t dropped = stats.packetsDropped;
             if (dropped > 0) {
                 recvtext += String::formatted(" | %d drop", dropped);
             }
@@ -1670,7 +1720,7 @@ void PeersContainerView::updatePeerViews(int specific)
                 pvf->lastDroppedChangedTimestampMs = nowstampms;
             }
 
-            int64_t resent = processor.getRemotePeerPacketsResent(i);
+            int64_t resent = stats.packetsResent;
             if (resent > 0) {
                 recvtext += String::formatted(" | %d resent", resent);
             }
@@ -1701,8 +1751,7 @@ void PeersContainerView::updatePeerViews(int specific)
         pvf->sendActualBitrateLabel->setText(sendtext, dontSendNotification);
         pvf->recvActualBitrateLabel->setText(recvtext, dontSendNotification);
 
-        SonobusAudioProcessor::LatencyInfo latinfo;
-        processor.getRemotePeerLatencyInfo(i, latinfo);
+        const SonobusAudioProcessor::LatencyInfo & latinfo = stats.latency;
         
         //pvf->pingLabel->setText(String::formatted("%d ms", (int)latinfo.pingMs ), dontSendNotification);
         pvf->pingLabel->setText(String::formatted("%d", (int)lrintf(latinfo.pingMs) ), dontSendNotification);
@@ -1759,7 +1808,8 @@ void PeersContainerView::updatePeerViews(int specific)
         
         // pvf->recvMeter->setMeterSource (processor.getRemotePeerRecvMeterSource(i));
 
-        if (chcnt != pvf->channelGroups->getGroupViewsCount()) {
+        if (chcnt != pvf->channelGroups->getGroupViewsCount()
+            || (processor.fetchRemotePeerViewChanges(i) & SonobusAudioProcessor::PeerViewChangeLayout)) {
             pvf->channelGroups->rebuildChannelViews();
             needsUpdateLayout = true;
         } else {
@@ -1882,13 +1932,18 @@ String PeersContainerView::generateLatencyMessage(const SonobusAudioProcessor::L
 void PeersContainerView::timerCallback(int timerId)
 {
     if (timerId == FillRatioUpdateTimerId) {
-        for (int di=0; di < mPeerViews.size(); ++di) {
+        // nothing new since the last tick
+        auto version = processor.getAllRemotePeerStats(mPeerStats);
+        if (version != 0 && version == mLastPeerStatsVersion) return;
+        mLastPeerStatsVersion = version;
+
+        for (int di=0; di < mPeerViews.size() && di < (int) mPeerUpdateOrdering.size(); ++di) {
             PeerViewInfo * pvf = mPeerViews.getUnchecked(di);
             int i = mPeerUpdateOrdering[di];
 
-            float ratio, stdev;
-            if (processor.getRemotePeerReceiveBufferFillRatio(i, ratio, stdev)) {
-                pvf->jitterBufferMeter->setFillRatio(ratio, stdev);
+            SonobusAudioProcessor::PeerStats stats;
+            if (getPeerStats(i, pvf, stats)) {
+                pvf->jitterBufferMeter->setFillRatio(stats.fillRatio, stats.fillRatioStdDev);
             }
         }
     }
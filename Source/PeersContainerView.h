@@ -145,6 +145,10 @@ public:
     bool isNarrow = false;
     bool fullMode = true;
     bool addrClicked = false;
+
+    uint32 peerViewId = 0; // of the peer this row shows
+    int peerIndex = -1;
+    bool needsSetup = true;
     
     Colour bgColor;
     Colour borderColor;
@@ -217,6 +221,7 @@ public:
     void peerLeftGroup(String & group, String & user);
     int getPendingPeerCount() const { return (int)mPendingUsers.size(); }
     
+    // creates rows for new peers, removes those of departed ones, and only sets up what changed
     void rebuildPeerViews();
     void updatePeerViews(int specific=-1);
     
@@ -258,6 +263,7 @@ protected:
 
     
     PeerViewInfo * createPeerViewInfo();
+    void setupPeerView(PeerViewInfo * pvf, int peerindex);
 
     PendingPeerViewInfo * createPendingPeerViewInfo();
     
@@ -266,6 +272,8 @@ protected:
     void showRecvOptions(int index, bool flag, Component * fromView=nullptr);
 
     void updatePeerOrdering();
+    // from the last snapshot, or straight from the processor if the snapshot doesn't know the peer yet
+    bool getPeerStats(int peerindex, const PeerViewInfo * pvf, SonobusAudioProcessor::PeerStats & retstats);
     int getPeerFromIndex(int index);
     juce::Rectangle<int> getBoundsForPeer(int chgroup);
     int getPeerForPoint(Point<int> pos, bool inbetween);
@@ -280,6 +288,9 @@ protected:
     
     std::vector<int> mPeerUpdateOrdering;
 
+    Array<SonobusAudioProcessor::PeerStats> mPeerStats;
+    uint32 mLastPeerStatsVersion = 0;
+
     std::unique_ptr<BubbleMessageComponent> popTip;
 
     struct PendingUserInfo {
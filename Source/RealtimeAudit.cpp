@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+
+#include "RealtimeAudit.h"
+
+#if SONOBUS_RT_AUDIT && (JUCE_LINUX || JUCE_MAC)
+#include <execinfo.h>
+#define SONO_RT_AUDIT_BACKTRACE 1
+#else
+#define SONO_RT_AUDIT_BACKTRACE 0
+#endif
+
+using namespace SonoAudio;
+
+namespace {
+
+const int maxStacks = 1024; // power of two
+const int maxFrames = 24;
+// the interposer and noteCall itself
+const int skipFrames = 2;
+
+struct StackEntry
+{
+    std::atomic<uint64> key { 0 };
+    std::atomic<bool> ready { false };
+    std::atomic<int64> count { 0 };
+    int kind = 0;
+    const char * scope = nullptr;
+    int numFrames = 0;
+    void * frames[maxFrames];
+};
+
+StackEntry stackTable[maxStacks];
+std::atomic<int64> kindCounts[RealtimeAudit::NumKinds];
+std::atomic<int64> tableFull { 0 };
+
+// innermost marked scope of this thread, null outside of any
+thread_local const char * currentScope = nullptr;
+// set while recording, anything the recording itself calls is not the callback's fault
+thread_local bool recording = false;
+
+const char * kindNames[RealtimeAudit::NumKinds] = {
+    "malloc", "free", "mutex lock", "mutex trylock", "condition wait", "sleep/yield", "read/write"
+};
+
+uint64 hashStack(int kind, void ** frames, int numFrames)
+{
+    // FNV-1a, never 0 so 0 can mark an empty slot
+    uint64 hash = 14695981039346656037ull ^ (uint64) kind;
+    for (int i = 0; i < numFrames; ++i) {
+        hash = (hash ^ (uint64) (pointer_sized_uint) frames[i]) * 1099511628211ull;
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+}
+
+std::atomic<bool> RealtimeAudit::hooksActive { false };
+
+RealtimeAudit::Scope::Scope(const char * name) : previous(currentScope)
+{
+    currentScope = name;
+}
+
+RealtimeAudit::Scope::~Scope()
+{
+    currentScope = previous;
+}
+
+bool RealtimeAudit::isActive()
+{
+    return hooksActive.load();
+}
+
+void RealtimeAudit::noteCall(Kind kind)
+{
+    if (currentScope == nullptr || recording) return;
+
+    recording = true;
+    kindCounts[kind].fetch_add(1, std::memory_order_relaxed);
+
+#if SONO_RT_AUDIT_BACKTRACE
+    void * frames[maxFrames + skipFrames];
+    const int total = backtrace(frames, maxFrames + skipFrames);
+    const int numFrames = jmax(0, total - skipFrames);
+    void ** stack = frames + jmin(skipFrames, total);
+
+    const uint64 key = hashStack(kind, stack, numFrames);
+
+    for (int probe = 0; probe < maxStacks; ++probe) {
+        auto & entry = stackTable[(key + probe) & (maxStacks - 1)];
+        uint64 existing = entry.key.load(std::memory_order_acquire);
+
+        if (existing == 0) {
+            if (entry.key.compare_exchange_strong(existing, key)) {
+                entry.kind = kind;
+                entry.scope = currentScope;
+                entry.numFrames = numFrames;
+                memcpy(entry.frames, stack, sizeof(void*) * (size_t) numFrames);
+                entry.count.fetch_add(1, std::memory_order_relaxed);
+                entry.ready.store(true, std::memory_order_release);
+                break;
+            }
+        }
+        if (existing == key) {
+            entry.count.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+        if (probe == maxStacks - 1) {
+            tableFull.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+#endif
+
+    recording = false;
+}
+
+int64 RealtimeAudit::getTotalCount(Kind kind)
+{
+    return kindCounts[kind].load();
+}
+
+int64 RealtimeAudit::getTotalCount()
+{
+    int64 total = 0;
+    for (int k = 0; k < NumKinds; ++k) {
+        total += kindCounts[k].load();
+    }
+    return total;
+}
+
+const char * RealtimeAudit::getKindName(Kind kind)
+{
+    return kind >= 0 && kind < NumKinds ? kindNames[kind] : "unknown";
+}
+
+String RealtimeAudit::createReport(int maxReported)
+{
+    ignoreUnused(maxReported);
+
+    String out;
+    out << "Realtime audit: ";
+
+    if (!isActive()) {
+        out << "not active in this build" << newLine;
+        return out;
+    }
+
+    const int64 total = getTotalCount();
+    out << total << " unsafe calls in marked audio code" << newLine;
+
+    for (int k = 0; k < NumKinds; ++k) {
+        if (kindCounts[k].load() > 0) {
+            out << "  " << kindNames[k] << ": " << kindCounts[k].load() << newLine;
+        }
+    }
+
+    if (tableFull.load() > 0) {
+        out << "  (" << tableFull.load() << " calls with too many distinct stacks to keep)" << newLine;
+    }
+
+#if SONO_RT_AUDIT_BACKTRACE
+    Array<StackEntry*> entries;
+    for (auto & entry : stackTable) {
+        if (entry.ready.load(std::memory_order_acquire)) {
+            entries.add(&entry);
+        }
+    }
+
+    std::sort(entries.begin(), entries.end(), [](StackEntry * a, StackEntry * b) {
+        return a->count.load() > b->count.load();
+    });
+
+    for (int i = 0; i < entries.size() && i < maxReported; ++i) {
+        auto * entry = entries.getUnchecked(i);
+        out << newLine << entry->count.load() << "x " << kindNames[entry->kind] << " in " << entry->scope << newLine;
+
+        if (char ** symbols = backtrace_symbols(entry->frames, entry->numFrames)) {
+            for (int f = 0; f < entry->numFrames; ++f) {
+                out << "    " << symbols[f] << newLine;
+            }
+            free(symbols);
+        }
+    }
+
+    if (entries.size() > maxReported) {
+        out << newLine << "... and " << (entries.size() - maxReported) << " more call stacks" << newLine;
+    }
+#endif
+
+    return out;
+}
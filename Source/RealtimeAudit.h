@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include <atomic>
+
+namespace SonoAudio {
+
+// Realtime safety audit, only in builds with SONOBUS_RT_AUDIT (cmake -DSONOBUS_RT_AUDIT=ON).
+//
+// Code marked with SONO_RT_AUDIT_SCOPE (the audio callback and the aoo process calls in it)
+// must not allocate, lock, wait or do io. The standalone app interposes malloc/free, the pthread
+// mutex and condition calls, sleeping and read/write, and every one of them made inside a marked
+// scope is recorded with its call stack. The report groups them by call stack, most frequent first.
+//
+// The interposers are Linux only, and only linked into the standalone app (installHooks pulls them in),
+// never into plugins. Recording is lock-free, but takes a backtrace, so expect the callback to get slower.
+
+class RealtimeAudit
+{
+public:
+    enum Kind {
+        KindAlloc = 0,
+        KindFree,
+        KindLock,
+        KindTryLock,
+        KindWait,
+        KindSleep,
+        KindIO,
+        NumKinds
+    };
+
+    // true if the interposers are linked in and active
+    static bool isActive();
+
+    // links in and arms the interposers, call early in the standalone app
+    static void installHooks();
+
+    struct Scope
+    {
+        Scope(const char * name);
+        ~Scope();
+
+        const char * previous;
+    };
+
+    // called by the interposers, records the call if the current thread is in a marked scope
+    static void noteCall(Kind kind);
+
+    static int64 getTotalCount(Kind kind);
+    static int64 getTotalCount();
+
+    // safe to call any time, resolves symbols so don't call it from the audio thread
+    static String createReport(int maxReported = 40);
+
+    static const char * getKindName(Kind kind);
+
+private:
+    static std::atomic<bool> hooksActive;
+};
+
+}
+
+#if SONOBUS_RT_AUDIT
+#define SONO_RT_AUDIT_SCOPE(name)  SonoAudio::RealtimeAudit::Scope JUCE_JOIN_MACRO (sonoRtAuditScope_, __LINE__) (name)
+#else
+#define SONO_RT_AUDIT_SCOPE(name)
+#endif
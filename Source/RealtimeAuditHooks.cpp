@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+// Interposers for the realtime audit. Nothing in here is referenced except installHooks(),
+// which only the standalone app calls, so plugins never get their malloc replaced.
+
+#include "RealtimeAudit.h"
+
+#if SONOBUS_RT_AUDIT && JUCE_LINUX
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace SonoAudio;
+
+extern "C" {
+
+// glibc's own allocator entry points, no dlsym needed (which would allocate itself)
+void * __libc_malloc(size_t size);
+void * __libc_calloc(size_t count, size_t size);
+void * __libc_realloc(void * ptr, size_t size);
+void * __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void * ptr);
+
+}
+
+namespace {
+
+template <typename FnType>
+FnType resolveNext(FnType & cached, const char * name)
+{
+    if (cached == nullptr) {
+        cached = reinterpret_cast<FnType>(dlsym(RTLD_NEXT, name));
+    }
+    return cached;
+}
+
+int (*realMutexLock)(pthread_mutex_t *) = nullptr;
+int (*realMutexTryLock)(pthread_mutex_t *) = nullptr;
+int (*realCondWait)(pthread_cond_t *, pthread_mutex_t *) = nullptr;
+int (*realCondTimedWait)(pthread_cond_t *, pthread_mutex_t *, const struct timespec *) = nullptr;
+int (*realNanoSleep)(const struct timespec *, struct timespec *) = nullptr;
+int (*realUSleep)(useconds_t) = nullptr;
+int (*realSchedYield)() = nullptr;
+ssize_t (*realRead)(int, void *, size_t) = nullptr;
+ssize_t (*realWrite)(int, const void *, size_t) = nullptr;
+
+}
+
+extern "C" {
+
+void * malloc(size_t size)
+{
+    RealtimeAudit::noteCall(RealtimeAudit::KindAlloc);
+    return __libc_malloc(size);
+}
+
+void * calloc(size_t count, size_t size)
+{
+    RealtimeAudit::noteCall(RealtimeAudit::KindAlloc);
+    return __libc_calloc(count, size);
+}
+
+void * realloc(void * ptr, size_t size)
+{
+    RealtimeAudit::noteCall(RealtimeAudit::KindAlloc);
+    return __libc_realloc(ptr, size);
+}
+
+void * memalign(size_t alignment, size_t size)
+{
+    RealtimeAudit::noteCall(RealtimeAudit::KindAlloc);
+    return __libc_memalign(alignment, size);
+}
+
+void * aligned_alloc(size_t alignment, size_t size)
+{
+    RealtimeAudit::noteCall(RealtimeAudit::KindAlloc);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void ** result, size_t alignment, size_t size)
+{
+    RealtimeAudit::noteCall(RealtimeAudit::KindAlloc);
+    *result = __libc_memalign(alignment, size);
+    return *result != nullptr || size == 0 ? 0 : ENOMEM;
+}
+
+void free(void * ptr)
+{
+    if (ptr != nullptr) {
+        RealtimeAudit::noteCall(RealtimeAudit::KindFree);
+    }
+    __libc_free(ptr);
+}
+
+int pthread_mutex_lock(pthread_mutex_t * mutex)
+{
+    RealtimeAudit::noteCall(RealtimeAudit::KindLock);
+    return resolveNext(realMutexLock, "pthread_mutex_lock")(mutex);
+}
+
+int pthread_mutex_trylock(pthread_mutex_t * mutex)
+{
+    RealtimeAudit::noteCall(RealtimeAudit::KindTryLock);
+    return resolveNext(realMutexTryLock, "pthread_mutex_trylock")(mutex);
+}
+
+int pthread_cond_wait(pthread_cond_t * cond, pthread_mutex_t * mutex)
+{
+    RealtimeAudit::noteCall(RealtimeAudit::KindWait);
+    return resolveNext(realCondWait, "pthread_cond_wait")(cond, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t * cond, pthread_mutex_t * mutex, const struct timespec * abstime)
+{
+    RealtimeAudit::noteCall(RealtimeAudit::KindWait);
+    return resolveNext(realCondTimedWait, "pthread_cond_timedwait")(cond, mutex, abstime);
+}
+
+int nanosleep(const struct timespec * req, struct timespec * rem)
+{
+    RealtimeAudit::noteCall(RealtimeAudit::KindSleep);
+    return resolveNext(realNanoSleep, "nanosleep")(req, rem);
+}
+
+int usleep(useconds_t usec)
+{
+    RealtimeAudit::noteCall(RealtimeAudit::KindSleep);
+    return resolveNext(realUSleep, "usleep")(usec);
+}
+
+int sched_yield()
+{
+    RealtimeAudit::noteCall(RealtimeAudit::KindSleep);
+    return resolveNext(realSchedYield, "sched_yield")();
+}
+
+ssize_t read(int fd, void * buf, size_t count)
+{
+    RealtimeAudit::noteCall(RealtimeAudit::KindIO);
+    return resolveNext(realRead, "read")(fd, buf, count);
+}
+
+ssize_t write(int fd, const void * buf, size_t count)
+{
+    RealtimeAudit::noteCall(RealtimeAudit::KindIO);
+    return resolveNext(realWrite, "write")(fd, buf, count);
+}
+
+}
+
+void RealtimeAudit::installHooks()
+{
+    // resolve everything now, so the first call on the audio thread doesn't end up in dlsym
+    resolveNext(realMutexLock, "pthread_mutex_lock");
+    resolveNext(realMutexTryLock, "pthread_mutex_trylock");
+    resolveNext(realCondWait, "pthread_cond_wait");
+    resolveNext(realCondTimedWait, "pthread_cond_timedwait");
+    resolveNext(realNanoSleep, "nanosleep");
+    resolveNext(realUSleep, "usleep");
+    resolveNext(realSchedYield, "sched_yield");
+    resolveNext(realRead, "read");
+    resolveNext(realWrite, "write");
+
+    // the first backtrace loads the unwinder
+    void * frames[4];
+    backtrace(frames, 4);
+
+    hooksActive = true;
+}
+
+#else
+
+void SonoAudio::RealtimeAudit::installHooks()
+{
+}
+
+#endif
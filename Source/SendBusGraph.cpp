@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+
+#include "SendBusGraph.h"
+
+using namespace SonoAudio;
+
+void SendBusGraph::clear()
+{
+    buses.clear();
+    order.clearQuick();
+}
+
+int SendBusGraph::addBus(const String & name, int numChannels, BusProcessor processor)
+{
+    int existing = getBusIndex(name);
+    if (existing >= 0) {
+        buses[existing]->processor = std::move(processor);
+        return existing;
+    }
+
+    auto * bus = buses.add(new Bus());
+    bus->name = name;
+    bus->numChannels = jmax(1, numChannels);
+    bus->processor = std::move(processor);
+
+    if (preparedSamples > 0) {
+        bus->buffer.setSize(jmax(bus->numChannels, preparedChannels), preparedSamples, false, true, true);
+    }
+
+    updateOrder();
+
+    return buses.size() - 1;
+}
+
+int SendBusGraph::getBusIndex(const String & name) const
+{
+    for (int i=0; i < buses.size(); ++i) {
+        if (buses.getUnchecked(i)->name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool SendBusGraph::dependsOn(int bus, int upstreamBus) const
+{
+    if (bus == upstreamBus) return true;
+
+    for (auto & route : buses.getUnchecked(bus)->inputs) {
+        if (dependsOn(route.fromBus, upstreamBus)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SendBusGraph::addRoute(int fromBus, int toBus, float gain)
+{
+    if (!isPositiveAndBelow(fromBus, buses.size()) || !isPositiveAndBelow(toBus, buses.size())) {
+        return false;
+    }
+
+    // would create a cycle
+    if (dependsOn(fromBus, toBus)) {
+        DBG("SendBusGraph: refusing cyclic route " << buses[fromBus]->name << " -> " << buses[toBus]->name);
+        return false;
+    }
+
+    for (auto & route : buses.getUnchecked(toBus)->inputs) {
+        if (route.fromBus == fromBus) {
+            route.gain = gain;
+            return true;
+        }
+    }
+
+    buses.getUnchecked(toBus)->inputs.add({ fromBus, gain });
+
+    updateOrder();
+    return true;
+}
+
+void SendBusGraph::removeRoutesTo(int toBus)
+{
+    if (!isPositiveAndBelow(toBus, buses.size())) return;
+
+    buses.getUnchecked(toBus)->inputs.clearQuick();
+    updateOrder();
+}
+
+void SendBusGraph::updateOrder()
+{
+    // Kahn's algorithm
+    const int numbuses = buses.size();
+    Array<int> indegree;
+    indegree.insertMultiple(0, 0, numbuses);
+
+    for (int i=0; i < numbuses; ++i) {
+        indegree.set(i, buses.getUnchecked(i)->inputs.size());
+    }
+
+    order.clearQuick();
+    order.ensureStorageAllocated(numbuses);
+
+    for (int i=0; i < numbuses; ++i) {
+        if (indegree[i] == 0) order.add(i);
+    }
+
+    for (int n=0; n < order.size(); ++n) {
+        const int done = order.getUnchecked(n);
+        for (int i=0; i < numbuses; ++i) {
+            for (auto & route : buses.getUnchecked(i)->inputs) {
+                if (route.fromBus == done) {
+                    indegree.set(i, indegree[i] - 1);
+                    if (indegree[i] == 0) order.add(i);
+                }
+            }
+        }
+    }
+
+    jassert(order.size() == numbuses); // cycles are rejected in addRoute
+}
+
+void SendBusGraph::prepare(int numSamples, int minBufferChannels)
+{
+    for (auto * bus : buses) {
+        const int numchans = jmax(bus->numChannels, minBufferChannels);
+        if (bus->buffer.getNumSamples() < numSamples || bus->buffer.getNumChannels() != numchans) {
+            bus->buffer.setSize(numchans, numSamples, false, true, true);
+        }
+    }
+    preparedSamples = jmax(preparedSamples, numSamples);
+    preparedChannels = minBufferChannels;
+}
+
+void SendBusGraph::beginBlock(int numSamples)
+{
+    for (auto * bus : buses) {
+        bus->processed = false;
+        if (bus->enabled || bus->lastEnabled) {
+            bus->buffer.clear(0, numSamples);
+        }
+    }
+}
+
+void SendBusGraph::doProcessBus(int bus, int numSamples)
+{
+    auto * b = buses.getUnchecked(bus);
+    b->processed = true;
+
+    // mix in returns from upstream buses (already processed)
+    for (auto & route : b->inputs) {
+        auto * from = buses.getUnchecked(route.fromBus);
+        if (!(from->enabled || from->lastEnabled)) continue;
+
+        for (int ch=0; ch < b->numChannels; ++ch) {
+            const int fromch = ch % from->numChannels;
+            b->buffer.addFrom(ch, 0, from->buffer, fromch, 0, numSamples, route.gain);
+        }
+    }
+
+    if ((b->enabled || b->lastEnabled) && b->processor) {
+        b->processor(b->buffer, numSamples, b->enabled, b->lastEnabled);
+    }
+}
+
+void SendBusGraph::processBus(int bus, int numSamples)
+{
+    if (!isPositiveAndBelow(bus, buses.size()) || buses.getUnchecked(bus)->processed) return;
+
+    // upstream first
+    for (auto & route : buses.getUnchecked(bus)->inputs) {
+        processBus(route.fromBus, numSamples);
+    }
+
+    doProcessBus(bus, numSamples);
+}
+
+void SendBusGraph::processAll(int numSamples)
+{
+    for (auto busindex : order) {
+        if (!buses.getUnchecked(busindex)->processed) {
+            doProcessBus(busindex, numSamples);
+        }
+    }
+}
+
+void SendBusGraph::endBlock()
+{
+    for (auto * bus : buses) {
+        bus->lastEnabled = bus->enabled;
+    }
+}
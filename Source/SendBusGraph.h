@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include <functional>
+
+namespace SonoAudio {
+
+// A small graph of named effect send buses (reverbs, etc).
+// Every source adds its send contribution exactly once into a bus buffer,
+// each bus is processed once per block, and a bus return can feed
+// other buses. Evaluation follows a topological order, so the cost per block
+// is O(sources + buses) regardless of how many consumers read a return.
+//
+// The graph structure (buses and routes) must only be changed while audio
+// is not being processed, per-block calls are realtime safe.
+
+class SendBusGraph
+{
+public:
+    // processes the bus buffer in place, enabled/wasEnabled are the current and previous block enable states
+    typedef std::function<void(AudioBuffer<float>& buffer, int numSamples, bool enabled, bool wasEnabled)> BusProcessor;
+
+    SendBusGraph() = default;
+
+    void clear();
+
+    // returns new bus index, or existing index if the name already exists
+    int addBus(const String & name, int numChannels, BusProcessor processor);
+
+    // returns -1 if not found
+    int getBusIndex(const String & name) const;
+    const String & getBusName(int bus) const { return buses[bus]->name; }
+    int getNumBuses() const { return buses.size(); }
+
+    // route the processed return of one bus into the input of another
+    // returns false if the route would create a cycle
+    bool addRoute(int fromBus, int toBus, float gain = 1.0f);
+    void removeRoutesTo(int toBus);
+
+    // allocates bus buffers, call from prepareToPlay/ensureBuffers
+    // buffers get at least minBufferChannels (extra channels stay silent) so they can be read like the output
+    void prepare(int numSamples, int minBufferChannels = 0);
+
+    // per-block methods
+    void setBusEnabled(int bus, bool enabled) { buses[bus]->enabled = enabled; }
+    bool isBusEnabled(int bus) const { return buses[bus]->enabled; }
+    bool wasBusEnabled(int bus) const { return buses[bus]->lastEnabled; }
+    // active if enabled now or last block (to allow for fading out)
+    bool isBusActive(int bus) const { return buses[bus]->enabled || buses[bus]->lastEnabled; }
+
+    // clears all active bus buffers, call once before any sends are added
+    void beginBlock(int numSamples);
+
+    AudioBuffer<float> & getBusBuffer(int bus) { return buses[bus]->buffer; }
+    int getBusNumChannels(int bus) const { return buses[bus]->numChannels; }
+
+    // processes the bus (after any upstream buses feeding it), at most once per block
+    void processBus(int bus, int numSamples);
+
+    // processes all remaining buses in topological order
+    void processAll(int numSamples);
+
+    // updates last enable state, call at the end of the block
+    void endBlock();
+
+private:
+
+    struct Route {
+        int fromBus;
+        float gain;
+    };
+
+    struct Bus {
+        String name;
+        int numChannels = 2;
+        AudioBuffer<float> buffer;
+        BusProcessor processor;
+        Array<Route> inputs;
+        bool enabled = false;
+        bool lastEnabled = false;
+        bool processed = false;
+    };
+
+    bool dependsOn(int bus, int upstreamBus) const;
+    void updateOrder();
+    void doProcessBus(int bus, int numSamples);
+
+    OwnedArray<Bus> buses;
+    Array<int> order; // topologically sorted bus indices
+    int preparedSamples = 0;
+    int preparedChannels = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SendBusGraph)
+};
+
+}
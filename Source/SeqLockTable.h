@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+namespace SonoAudio {
+
+// Fixed capacity table of entries published as a whole by a single writer thread,
+// readable by any number of threads without locking (sequence lock).
+//
+// The writer makes the sequence odd while it copies, readers copy the table and
+// retry if the sequence was odd or changed under them. Readers never block the writer.
+
+template <typename EntryType, int MaxEntries>
+class SeqLockTable
+{
+public:
+    static_assert(std::is_trivially_copyable<EntryType>::value, "entries are copied with memcpy");
+
+    // writer only, count is clamped to MaxEntries
+    void publish(const EntryType * src, int count)
+    {
+        count = jlimit(0, MaxEntries, count);
+
+        auto seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        numEntries.store(count, std::memory_order_relaxed);
+        std::memcpy(entries, src, sizeof(EntryType) * (size_t) count);
+
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    // copies the table into dest (which must hold MaxEntries), returns the number of entries.
+    // retversion is bumped by one for every publish, 0 means nothing was published yet
+    int read(EntryType * dest, uint32 & retversion) const
+    {
+        for (;;) {
+            auto seq = sequence.load(std::memory_order_acquire);
+            if (seq & 1) {
+                // writer is in the middle of it, it won't take long
+                Thread::yield();
+                continue;
+            }
+
+            int count = jlimit(0, MaxEntries, numEntries.load(std::memory_order_relaxed));
+            std::memcpy(dest, entries, sizeof(EntryType) * (size_t) count);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == seq) {
+                retversion = seq / 2;
+                return count;
+            }
+        }
+    }
+
+    uint32 getVersion() const { return sequence.load(std::memory_order_acquire) / 2; }
+
+private:
+    std::atomic<uint32> sequence { 0 };
+    std::atomic<int> numEntries { 0 };
+    EntryType entries[MaxEntries];
+};
+
+}
@@ -0,0 +1,496 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+
+#include "SessionRecording.h"
+
+using namespace SonoAudio;
+
+namespace {
+
+const char fileMagic[8] = { 'S', 'B', 'R', 'E', 'C', 'O', 'R', 'D' };
+const uint32 chunkMagic = 0x4b434253; // "SBCK"
+const uint32 formatVersion = 1;
+const int fileHeaderBytes = 4096;
+const int chunkHeaderBytes = 64;
+const int chunkAlignment = 4096;
+const int maxTrackNameBytes = 255;
+
+uint32 crc32 (const void * data, size_t numBytes, uint32 crc = 0)
+{
+    static uint32 table[256] = { 0 };
+    static bool tableReady = [] {
+        for (uint32 i = 0; i < 256; ++i) {
+            uint32 c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+            }
+            table[i] = c;
+        }
+        return true;
+    }();
+    ignoreUnused(tableReady);
+
+    auto * bytes = static_cast<const uint8 *>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < numBytes; ++i) {
+        crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+size_t calcChunkBytes (int chunkFrames, int numChannels)
+{
+    size_t bytes = chunkHeaderBytes + (size_t) chunkFrames * (size_t) numChannels * sizeof(float);
+    return ((bytes + chunkAlignment - 1) / chunkAlignment) * chunkAlignment;
+}
+
+}
+
+const char * SessionChunkWriter::fileExtension = ".sbrec";
+
+SessionChunkWriter::SessionChunkWriter(std::unique_ptr<FileOutputStream> stream_, const String & trackName,
+                                       double sampleRate, int numChannels_, int64 trackStartSample, int64 sessionStartMillis,
+                                       int chunkFrames_)
+: stream(std::move(stream_)), numChannels(jmax(1, numChannels_)), chunkFrames(jmax(256, chunkFrames_)), nextSamplePos(trackStartSample)
+{
+    chunkBytes = calcChunkBytes(chunkFrames, numChannels);
+    chunkData.calloc(chunkBytes);
+
+    if (stream == nullptr || stream->failedToOpen()) {
+        ok = false;
+        return;
+    }
+
+    ok = writeHeader(trackName, sampleRate, sessionStartMillis);
+    lastSyncMs = Time::getMillisecondCounter();
+}
+
+SessionChunkWriter::~SessionChunkWriter()
+{
+}
+
+bool SessionChunkWriter::writeHeader(const String & trackName, double sampleRate, int64 sessionStartMillis)
+{
+    MemoryOutputStream header(fileHeaderBytes);
+
+    header.write(fileMagic, sizeof(fileMagic));
+    header.writeInt((int) formatVersion);
+    header.writeInt(numChannels);
+    header.writeDouble(sampleRate);
+    header.writeInt(chunkFrames);
+    header.writeInt(0);
+    header.writeInt64(sessionStartMillis);
+    header.writeInt64(nextSamplePos);
+
+    auto name = trackName.toUTF8();
+    auto namelen = jmin((int) name.sizeInBytes() - 1, maxTrackNameBytes);
+    header.writeInt(namelen);
+    header.write(name.getAddress(), (size_t) namelen);
+
+    header.writeRepeatedByte(0, fileHeaderBytes - sizeof(uint32) - header.getDataSize());
+
+    const uint32 crc = crc32(header.getData(), header.getDataSize());
+    header.writeInt((int) crc);
+
+    jassert(header.getDataSize() == fileHeaderBytes);
+
+    if (!stream->write(header.getData(), header.getDataSize())) {
+        return false;
+    }
+    stream->flush();
+    return stream->getStatus().wasOk();
+}
+
+bool SessionChunkWriter::writeSamples(const float* const* data, int numSamples)
+{
+    if (!ok) return false;
+
+    auto * payload = reinterpret_cast<float*>(chunkData.get() + chunkHeaderBytes);
+    int done = 0;
+
+    while (done < numSamples) {
+        const int todo = jmin(numSamples - done, chunkFrames - framesInChunk);
+
+        // interleave
+        for (int ch=0; ch < numChannels; ++ch) {
+            const float * src = data[ch] + done;
+            float * dst = payload + (size_t) framesInChunk * numChannels + ch;
+            for (int i=0; i < todo; ++i) {
+                dst[(size_t) i * numChannels] = src[i];
+            }
+        }
+
+        framesInChunk += todo;
+        done += todo;
+
+        if (framesInChunk == chunkFrames) {
+            if (!writeChunk()) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool SessionChunkWriter::writeChunk()
+{
+    if (framesInChunk == 0) return true;
+
+    auto * payload = chunkData.get() + chunkHeaderBytes;
+    const size_t payloadBytes = (size_t) framesInChunk * numChannels * sizeof(float);
+
+    // zero the unused part of a partial (final) chunk
+    memset(payload + payloadBytes, 0, chunkBytes - chunkHeaderBytes - payloadBytes);
+
+    auto * header = chunkData.get();
+    memset(header, 0, chunkHeaderBytes);
+    *reinterpret_cast<uint32*>(header + 0) = ByteOrder::swapIfBigEndian(chunkMagic);
+    *reinterpret_cast<uint32*>(header + 4) = ByteOrder::swapIfBigEndian(chunkIndex);
+    *reinterpret_cast<int64*>(header + 8) = (int64) ByteOrder::swapIfBigEndian((uint64) nextSamplePos);
+    *reinterpret_cast<uint32*>(header + 16) = ByteOrder::swapIfBigEndian((uint32) framesInChunk);
+    *reinterpret_cast<uint32*>(header + 20) = ByteOrder::swapIfBigEndian((uint32) numChannels);
+    *reinterpret_cast<uint32*>(header + 24) = ByteOrder::swapIfBigEndian(crc32(payload, payloadBytes));
+    *reinterpret_cast<uint32*>(header + 28) = ByteOrder::swapIfBigEndian(crc32(header, 28));
+
+    // one large aligned sequential write per chunk, bigger than the stream's buffer so it
+    // goes straight to the OS and survives the process crashing
+    if (!stream->write(chunkData.get(), chunkBytes)) {
+        ok = false;
+        return false;
+    }
+
+    // flushing a FileOutputStream fsyncs it, only do that now and then
+    const uint32 now = Time::getMillisecondCounter();
+    if (now - lastSyncMs >= (uint32) syncIntervalMs) {
+        stream->flush();
+        lastSyncMs = now;
+    }
+
+    nextSamplePos += framesInChunk;
+    framesInChunk = 0;
+    ++chunkIndex;
+
+    return ok = stream->getStatus().wasOk();
+}
+
+bool SessionChunkWriter::finish()
+{
+    if (!ok) return false;
+
+    bool ret = writeChunk();
+    stream->flush();
+    return ret;
+}
+
+
+//////////////////////////
+
+SessionRecordingReader::SessionRecordingReader(const File & file_)
+: file(file_)
+{
+    FileInputStream in(file);
+    if (in.failedToOpen()) return;
+
+    HeapBlock<char> header;
+    header.calloc(fileHeaderBytes);
+    if (in.read(header.get(), fileHeaderBytes) != fileHeaderBytes) return;
+
+    if (memcmp(header.get(), fileMagic, sizeof(fileMagic)) != 0) return;
+
+    const uint32 crc = ByteOrder::littleEndianInt(header.get() + fileHeaderBytes - sizeof(uint32));
+    if (crc != crc32(header.get(), fileHeaderBytes - sizeof(uint32))) {
+        DBG("Session recording header checksum mismatch: " << file.getFullPathName());
+        return;
+    }
+
+    MemoryInputStream hin(header.get() + sizeof(fileMagic), fileHeaderBytes - sizeof(fileMagic), false);
+    const uint32 version = (uint32) hin.readInt();
+    if (version != formatVersion) return;
+
+    numChannels = hin.readInt();
+    sampleRate = hin.readDouble();
+    chunkFrames = hin.readInt();
+    hin.readInt(); // reserved
+    sessionStartMillis = hin.readInt64();
+    trackStartSample = hin.readInt64();
+    trackEndSample = trackStartSample;
+    const int namelen = jlimit(0, maxTrackNameBytes, hin.readInt());
+    HeapBlock<char> name;
+    name.calloc((size_t) namelen + 1);
+    hin.read(name.get(), namelen);
+    trackName = String::fromUTF8(name.get(), namelen);
+
+    if (numChannels <= 0 || chunkFrames <= 0 || sampleRate <= 0.0) return;
+
+    chunkBytes = calcChunkBytes(chunkFrames, numChannels);
+    valid = true;
+}
+
+bool SessionRecordingReader::readChunkHeader(InputStream & in, int64 offset, ChunkInfo & info, HeapBlock<char> & buffer)
+{
+    if (!in.setPosition(offset)) return false;
+    if (in.read(buffer.get(), (int) chunkBytes) != (int) chunkBytes) return false;
+
+    const auto * header = buffer.get();
+    if (ByteOrder::littleEndianInt(header) != chunkMagic) return false;
+    if (ByteOrder::littleEndianInt(header + 28) != crc32(header, 28)) return false;
+
+    info.fileOffset = offset;
+    info.samplePos = (int64) ByteOrder::littleEndianInt64(header + 8);
+    info.numFrames = (int) ByteOrder::littleEndianInt(header + 16);
+    const int chans = (int) ByteOrder::littleEndianInt(header + 20);
+
+    if (chans != numChannels || info.numFrames <= 0 || info.numFrames > chunkFrames) return false;
+
+    const size_t payloadBytes = (size_t) info.numFrames * numChannels * sizeof(float);
+    return ByteOrder::littleEndianInt(header + 24) == crc32(header + chunkHeaderBytes, payloadBytes);
+}
+
+int SessionRecordingReader::scanChunks()
+{
+    chunks.clearQuick();
+    truncated = false;
+
+    if (!valid) return 0;
+
+    FileInputStream in(file);
+    if (in.failedToOpen()) return 0;
+
+    HeapBlock<char> buffer;
+    buffer.calloc(chunkBytes);
+
+    const int64 total = in.getTotalLength();
+    int64 offset = fileHeaderBytes;
+
+    while (offset + (int64) chunkBytes <= total) {
+        ChunkInfo info;
+        if (!readChunkHeader(in, offset, info, buffer)) {
+            truncated = true;
+            break;
+        }
+        chunks.add(info);
+        offset += (int64) chunkBytes;
+    }
+
+    if (offset < total) {
+        // partially written last chunk
+        truncated = true;
+    }
+
+    if (!chunks.isEmpty()) {
+        trackStartSample = chunks.getFirst().samplePos;
+        trackEndSample = chunks.getLast().samplePos + chunks.getLast().numFrames;
+    }
+
+    return chunks.size();
+}
+
+bool SessionRecordingReader::renderTo(AudioFormatWriter & writer, int64 alignStartSample, std::function<bool()> shouldExit)
+{
+    if (!valid) return false;
+
+    FileInputStream in(file);
+    if (in.failedToOpen()) return false;
+
+    HeapBlock<char> buffer;
+    buffer.calloc(chunkBytes);
+
+    AudioBuffer<float> work(numChannels, chunkFrames);
+    int64 pos = alignStartSample;
+
+    for (auto & chunk : chunks) {
+        if (shouldExit && shouldExit()) return false;
+
+        // fill any gap with silence
+        if (chunk.samplePos > pos) {
+            work.clear();
+            while (pos < chunk.samplePos) {
+                const int n = (int) jmin((int64) chunkFrames, chunk.samplePos - pos);
+                if (!writer.writeFromAudioSampleBuffer(work, 0, n)) return false;
+                pos += n;
+            }
+        }
+
+        if (!in.setPosition(chunk.fileOffset) || in.read(buffer.get(), (int) chunkBytes) != (int) chunkBytes) {
+            return false;
+        }
+
+        // deinterleave
+        const auto * payload = reinterpret_cast<const float*>(buffer.get() + chunkHeaderBytes);
+        for (int ch=0; ch < numChannels; ++ch) {
+            auto * dst = work.getWritePointer(ch);
+            for (int i=0; i < chunk.numFrames; ++i) {
+                dst[i] = payload[(size_t) i * numChannels + ch];
+            }
+        }
+
+        // skip any overlap
+        const int skip = (int) jlimit((int64) 0, (int64) chunk.numFrames, pos - chunk.samplePos);
+        if (chunk.numFrames - skip > 0) {
+            if (!writer.writeFromAudioSampleBuffer(work, skip, chunk.numFrames - skip)) return false;
+        }
+        pos = jmax(pos, chunk.samplePos + chunk.numFrames);
+    }
+
+    return writer.flush();
+}
+
+
+//////////////////////////
+
+namespace {
+
+// sessions held in this process, the InterProcessLock can't tell them apart
+CriticalSection heldSessionsLock;
+Array<int64> heldSessions;
+
+}
+
+SessionRecordingLock::SessionRecordingLock(int64 sessionStartMillis)
+: session(sessionStartMillis), lock("CoLabsSession_" + String(sessionStartMillis))
+{
+}
+
+SessionRecordingLock::~SessionRecordingLock()
+{
+    if (held) {
+        lock.exit();
+
+        const ScopedLock sl (heldSessionsLock);
+        heldSessions.removeFirstMatchingValue(session);
+    }
+}
+
+std::unique_ptr<SessionRecordingLock> SessionRecordingLock::tryAcquire(int64 sessionStartMillis)
+{
+    const ScopedLock sl (heldSessionsLock);
+
+    if (heldSessions.contains(sessionStartMillis)) {
+        return nullptr;
+    }
+
+    std::unique_ptr<SessionRecordingLock> sessionLock (new SessionRecordingLock(sessionStartMillis));
+    if (!sessionLock->lock.enter(0)) {
+        return nullptr;
+    }
+
+    sessionLock->held = true;
+    heldSessions.add(sessionStartMillis);
+    return sessionLock;
+}
+
+
+//////////////////////////
+
+SessionRecordingFinalizer::SessionRecordingFinalizer(const Array<File> & sourceFiles, StemFormat stemFormat_, int bitsPerSample_, bool deleteSourceOnSuccess,
+                                                     std::function<void(const Array<File> &, const String &)> onDone,
+                                                     std::unique_ptr<SessionRecordingLock> sessionLock)
+: ThreadPoolJob("Finalize session recording"), sources(sourceFiles), stemFormat(stemFormat_), bitsPerSample(bitsPerSample_),
+  deleteSource(deleteSourceOnSuccess), doneCallback(std::move(onDone)), lock(std::move(sessionLock))
+{
+}
+
+Array<File> SessionRecordingFinalizer::findSessionFiles(const File & directory)
+{
+    return directory.findChildFiles(File::findFiles, false, String("*") + SessionChunkWriter::fileExtension);
+}
+
+bool SessionRecordingFinalizer::renderFile(const File & source, const File & dest, AudioFormat & format, int bitsPerSample,
+                                           int64 alignStartSample, String & error, std::function<bool()> shouldExit)
+{
+    SessionRecordingReader reader(source);
+
+    if (!reader.isValid()) {
+        error = TRANS("Invalid session recording file: ") + source.getFullPathName();
+        return false;
+    }
+
+    reader.scanChunks();
+
+    if (reader.wasTruncated()) {
+        DBG("Session recording " << source.getFileName() << " was cut off, recovered up to sample " << reader.getTrackEndSample());
+    }
+
+    std::unique_ptr<OutputStream> outstream (dest.createOutputStream(1 << 18));
+    if (!outstream) {
+        error = TRANS("Error creating output file: ") + dest.getFullPathName();
+        return false;
+    }
+
+    std::unique_ptr<AudioFormatWriter> writer (format.createWriterFor(outstream.get(), reader.getSampleRate(), (unsigned int) reader.getNumChannels(), bitsPerSample, {}, 0));
+    if (!writer) {
+        error = TRANS("Error creating writer for ") + dest.getFullPathName();
+        return false;
+    }
+    outstream.release(); // owned by writer now
+
+    if (!reader.renderTo(*writer, jmin(alignStartSample, reader.getTrackStartSample()), shouldExit)) {
+        error = TRANS("Error rendering session recording: ") + source.getFullPathName();
+        return false;
+    }
+
+    return true;
+}
+
+ThreadPoolJob::JobStatus SessionRecordingFinalizer::runJob()
+{
+    Array<File> results;
+    String error;
+
+    // stems of a session all start at the earliest track start, so they line up
+    int64 alignstart = std::numeric_limits<int64>::max();
+    for (auto & source : sources) {
+        SessionRecordingReader reader(source);
+        if (reader.isValid()) {
+            alignstart = jmin(alignstart, reader.getTrackStartSample());
+        }
+    }
+    if (alignstart == std::numeric_limits<int64>::max()) {
+        alignstart = 0;
+    }
+
+    FlacAudioFormat flacFormat;
+    WavAudioFormat wavFormat;
+
+    for (auto & source : sources) {
+        if (shouldExit()) break;
+
+        SessionRecordingReader reader(source);
+        if (!reader.isValid()) {
+            error = TRANS("Invalid session recording file: ") + source.getFullPathName();
+            continue;
+        }
+
+        // flac only supports up to 8 channels
+        AudioFormat * format = (stemFormat == StemFormatFLAC && reader.getNumChannels() <= 8) ? (AudioFormat*) &flacFormat : (AudioFormat*) &wavFormat;
+        int bits = format == &flacFormat ? jmin(24, bitsPerSample) : bitsPerSample;
+
+        File dest = source.withFileExtension(format->getFileExtensions()[0]);
+        if (dest.exists()) {
+            dest = dest.getNonexistentSibling();
+        }
+
+        String ferror;
+        if (renderFile(source, dest, *format, bits, alignstart, ferror, [this]() { return shouldExit(); })) {
+            results.add(dest);
+            DBG("Finalized session recording: " << dest.getFullPathName());
+
+            if (deleteSource) {
+                source.deleteFile();
+            }
+        }
+        else {
+            error = ferror;
+            DBG(ferror);
+            dest.deleteFile();
+        }
+    }
+
+    if (doneCallback) {
+        doneCallback(results, error);
+    }
+
+    return jobHasFinished;
+}
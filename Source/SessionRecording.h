@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include "MultiTrackRecorder.h"
+
+namespace SonoAudio {
+
+// Crash-safe session recording format (.sbrec)
+//
+// One file per track: a 4096 byte file header followed by append-only, fixed size,
+// 4096 byte aligned chunks. Each chunk carries its own sample position on the shared
+// session clock and a CRC32 of its header and payload, so a file cut off by a crash
+// is valid up to the last complete chunk and needs no repair before reading.
+// The payload is interleaved 32-bit float samples.
+// Writes happen on the recorder's encoder threads, which also sync the file to disk
+// every syncIntervalMs so a power loss can't take more than that with it.
+//
+// SessionRecordingFinalizer renders these files into aligned regular audio stems,
+// either right after recording or later to recover an interrupted session.
+
+class SessionChunkWriter : public MultiTrackRecorder::TrackWriter
+{
+public:
+    // trackStartSample is the session clock position of the first sample written
+    SessionChunkWriter(std::unique_ptr<FileOutputStream> stream, const String & trackName,
+                       double sampleRate, int numChannels, int64 trackStartSample, int64 sessionStartMillis,
+                       int chunkFrames = defaultChunkFrames);
+    ~SessionChunkWriter() override;
+
+    bool isOk() const { return stream != nullptr && ok; }
+
+    int getNumChannels() const override { return numChannels; }
+    bool writeSamples(const float* const* data, int numSamples) override;
+    bool finish() override;
+
+    static const int defaultChunkFrames = 16384;
+    static const int syncIntervalMs = 1000;
+    static const char * fileExtension; // ".sbrec"
+
+private:
+    bool writeHeader(const String & trackName, double sampleRate, int64 sessionStartMillis);
+    bool writeChunk();
+
+    std::unique_ptr<FileOutputStream> stream;
+    int numChannels;
+    int chunkFrames;
+    size_t chunkBytes;
+    int64 nextSamplePos;
+    uint32 chunkIndex = 0;
+    int framesInChunk = 0;
+    uint32 lastSyncMs = 0;
+    HeapBlock<char> chunkData;
+    bool ok = true;
+};
+
+
+class SessionRecordingReader
+{
+public:
+    SessionRecordingReader(const File & file);
+
+    // true if the file header is valid
+    bool isValid() const { return valid; }
+
+    const String & getTrackName() const { return trackName; }
+    double getSampleRate() const { return sampleRate; }
+    int getNumChannels() const { return numChannels; }
+    int64 getSessionStartMillis() const { return sessionStartMillis; }
+
+    // scans all chunks, stopping at the first incomplete or corrupt one
+    // returns the number of valid chunks
+    int scanChunks();
+    int64 getTrackStartSample() const { return trackStartSample; }
+    int64 getTrackEndSample() const { return trackEndSample; }
+    bool wasTruncated() const { return truncated; }
+
+    // renders valid chunks to the writer, with silence before the first chunk
+    // starting at alignStartSample on the session clock, and filling any gaps
+    bool renderTo(AudioFormatWriter & writer, int64 alignStartSample, std::function<bool()> shouldExit = nullptr);
+
+private:
+    struct ChunkInfo {
+        int64 fileOffset;
+        int64 samplePos;
+        int numFrames;
+    };
+
+    bool readChunkHeader(InputStream & in, int64 offset, ChunkInfo & info, HeapBlock<char> & buffer);
+
+    File file;
+    bool valid = false;
+    bool truncated = false;
+    String trackName;
+    double sampleRate = 0.0;
+    int numChannels = 0;
+    int chunkFrames = 0;
+    size_t chunkBytes = 0;
+    int64 sessionStartMillis = 0;
+    int64 trackStartSample = 0;
+    int64 trackEndSample = 0;
+    Array<ChunkInfo> chunks;
+};
+
+
+// Held for as long as a session's files are written or finalized, so recovery leaves them alone.
+// Other processes see it as an InterProcessLock, which the OS drops if the holder dies, other
+// instances in this process (where that lock would be granted again) in a shared list.
+class SessionRecordingLock
+{
+public:
+    ~SessionRecordingLock();
+
+    // nullptr if the session is still held by its writer, or being recovered elsewhere
+    static std::unique_ptr<SessionRecordingLock> tryAcquire(int64 sessionStartMillis);
+
+private:
+    SessionRecordingLock(int64 sessionStartMillis);
+
+    int64 session;
+    InterProcessLock lock;
+    bool held = false;
+};
+
+
+// renders a set of .sbrec files (a session) to aligned stems in the background
+class SessionRecordingFinalizer : public ThreadPoolJob
+{
+public:
+    enum StemFormat {
+        StemFormatFLAC = 0,
+        StemFormatWAV
+    };
+
+    // the session lock, if given, is released once the job is done with the files
+    SessionRecordingFinalizer(const Array<File> & sourceFiles, StemFormat stemFormat, int bitsPerSample, bool deleteSourceOnSuccess,
+                              std::function<void(const Array<File> & results, const String & error)> onDone = nullptr,
+                              std::unique_ptr<SessionRecordingLock> sessionLock = nullptr);
+
+    JobStatus runJob() override;
+
+    // finds all .sbrec files in a directory (e.g. left over from a crash)
+    static Array<File> findSessionFiles(const File & directory);
+
+    // renders a single file synchronously, all stems rendered with the same
+    // alignStartSample will line up
+    static bool renderFile(const File & source, const File & dest, AudioFormat & format, int bitsPerSample,
+                           int64 alignStartSample, String & error, std::function<bool()> shouldExit = nullptr);
+
+private:
+    Array<File> sources;
+    StemFormat stemFormat;
+    int bitsPerSample;
+    bool deleteSource;
+    std::function<void(const Array<File> &, const String &)> doneCallback;
+    std::unique_ptr<SessionRecordingLock> lock;
+};
+
+}
@@ -0,0 +1,641 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+// Headless server app, the CoLabsServer target, built with SONOBUS_HEADLESS_SERVER.
+// It runs the processor straight off an audio device callback, without the standalone
+// plugin holder, the editor, the look and feel, or any of the font and image data,
+// so it starts quickly and stays small. Everything is set from the command line,
+// or from a config file with the same option names.
+
+#include "JuceHeader.h"
+
+#include "SonobusPluginProcessor.h"
+#include "NullAudioDevice.h"
+#include "MetricsExporter.h"
+#include "TraceRecorder.h"
+#include "RealtimeAudit.h"
+
+#if JUCE_LINUX || JUCE_MAC
+#include <signal.h>
+#endif
+
+using namespace SonoAudio;
+
+namespace {
+
+std::atomic<bool> quitRequested { false };
+
+// in place of AudioProcessorPlayer, which lives in juce_audio_utils
+class ProcessorDriver : public AudioIODeviceCallback
+{
+public:
+    ProcessorDriver(AudioProcessor & processorToUse) : processor(processorToUse) {}
+
+    void audioDeviceAboutToStart(AudioIODevice * device) override
+    {
+        const double sampleRate = device->getCurrentSampleRate();
+        maxBlockSize = jmax(1, device->getCurrentBufferSizeSamples());
+
+        processor.setRateAndBufferSizeDetails(sampleRate, maxBlockSize);
+        processor.prepareToPlay(sampleRate, maxBlockSize);
+
+        buffer.setSize(jmax(processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels()), maxBlockSize);
+        midi.ensureSize(256);
+    }
+
+    void audioDeviceStopped() override
+    {
+        processor.releaseResources();
+    }
+
+    void audioDeviceIOCallbackWithContext(const float * const * inputs, int numInputs, float * const * outputs, int numOutputs,
+                                          int numSamples, const AudioIODeviceCallbackContext &) override
+    {
+        // some devices call back with more than they announced
+        for (int offset = 0; offset < numSamples; offset += maxBlockSize) {
+            processChunk(inputs, numInputs, outputs, numOutputs, offset, jmin(maxBlockSize, numSamples - offset));
+        }
+    }
+
+private:
+    void processChunk(const float * const * inputs, int numInputs, float * const * outputs, int numOutputs, int offset, int numSamples)
+    {
+        const int procInputs = processor.getTotalNumInputChannels();
+        const int procOutputs = processor.getTotalNumOutputChannels();
+
+        AudioBuffer<float> block (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), numSamples);
+
+        for (int ch = 0; ch < block.getNumChannels(); ++ch) {
+            if (ch < procInputs && ch < numInputs && inputs[ch] != nullptr) {
+                block.copyFrom(ch, 0, inputs[ch] + offset, numSamples);
+            } else {
+                block.clear(ch, 0, numSamples);
+            }
+        }
+
+        {
+            const ScopedLock sl (processor.getCallbackLock());
+
+            if (processor.isSuspended()) {
+                block.clear();
+            } else {
+                processor.processBlock(block, midi);
+            }
+        }
+
+        midi.clear();
+
+        for (int ch = 0; ch < numOutputs; ++ch) {
+            if (outputs[ch] == nullptr) continue;
+
+            if (ch < procOutputs) {
+                FloatVectorOperations::copy(outputs[ch] + offset, block.getReadPointer(ch), numSamples);
+            } else {
+                FloatVectorOperations::clear(outputs[ch] + offset, numSamples);
+            }
+        }
+    }
+
+    AudioProcessor & processor;
+    AudioBuffer<float> buffer;
+    MidiBuffer midi;
+    int maxBlockSize = 256;
+};
+
+// plain "name = value" lines, # starts a comment
+StringPairArray loadConfigFile(const File & file, String & error)
+{
+    StringPairArray values;
+
+    StringArray lines;
+    file.readLines(lines);
+
+    for (int i = 0; i < lines.size(); ++i) {
+        auto line = lines[i].upToFirstOccurrenceOf("#", false, false).trim();
+        if (line.isEmpty()) continue;
+
+        if (!line.containsChar('=')) {
+            error << file.getFileName() << ":" << (i + 1) << ": expected name = value" << newLine;
+            continue;
+        }
+
+        values.set(line.upToFirstOccurrenceOf("=", false, false).trim(),
+                   line.fromFirstOccurrenceOf("=", false, false).trim().unquoted());
+    }
+
+    return values;
+}
+
+}
+
+
+class SonobusServerApp : public JUCEApplication, private Timer, private SonobusAudioProcessor::ClientListener
+{
+public:
+    SonobusServerApp()
+    {
+        PluginHostType::jucePlugInClientCurrentWrapperType = AudioProcessor::wrapperType_Standalone;
+    }
+
+    const String getApplicationName() override              { return JucePlugin_Name " Server"; }
+    const String getApplicationVersion() override           { return ProjectInfo::versionString; }
+    bool moreThanOneInstanceAllowed() override              { return true; }
+
+    void initialise (const String&) override
+    {
+        if (!handleCommandLine()) {
+            quit();
+            return;
+        }
+
+#if SONOBUS_RT_AUDIT
+        RealtimeAudit::installHooks();
+#endif
+
+#if JUCE_LINUX || JUCE_MAC
+        signal(SIGINT, [](int) { quitRequested = true; });
+        signal(SIGTERM, [](int) { quitRequested = true; });
+#endif
+
+        if (traceDirectory.isNotEmpty()) {
+            TraceRecorder::setDumpDirectory(File::getCurrentWorkingDirectory().getChildFile(traceDirectory));
+            TraceRecorder::setEnabled(true);
+#if JUCE_LINUX || JUCE_MAC
+            signal(SIGUSR1, [](int) { TraceRecorder::requestDump(); });
+#endif
+        }
+
+        processor = std::make_unique<SonobusAudioProcessor>();
+        processor->disableNonMainBuses();
+
+        if (loadSetupFilename.isNotEmpty() && !loadSetupFile(File::getCurrentWorkingDirectory().getChildFile(loadSetupFilename))) {
+            fail();
+            return;
+        }
+
+        driver = std::make_unique<ProcessorDriver>(*processor);
+
+        if (!startAudio()) {
+            fail();
+            return;
+        }
+
+        if (metricsPort > 0 || metricsSocketPath.isNotEmpty()) {
+            metricsExporter = std::make_unique<MetricsExporter>(*processor);
+            metricsExporter->getXRunCount = [this]() {
+                auto * device = nullDevice != nullptr ? nullDevice.get() : deviceManager != nullptr ? deviceManager->getCurrentAudioDevice() : nullptr;
+                return device ? device->getXRunCount() : -1;
+            };
+
+            bool ok = metricsSocketPath.isNotEmpty() ? metricsExporter->startListening(metricsSocketPath) : metricsExporter->startListening(metricsPort);
+            if (!ok) {
+                std::cerr << "Could not start metrics endpoint on " << (metricsSocketPath.isNotEmpty() ? metricsSocketPath : String(metricsPort)) << std::endl;
+                metricsExporter.reset();
+            }
+        }
+
+        if (packetCaptureFilename.isNotEmpty()) {
+            auto file = File::getCurrentWorkingDirectory().getChildFile(packetCaptureFilename);
+            if (!processor->startPacketCapture(file)) {
+                std::cerr << "Could not start packet capture to " << file.getFullPathName() << std::endl;
+            }
+        }
+
+        DBG("CONNECTING SERVER INITIAL");
+        processor->addClientListener(this);
+        processor->connectToServer(connInfo.serverHost, connInfo.serverPort, connInfo.userName, connInfo.userPassword);
+
+        // the group is joined from the timer, once the connect event came in
+        startTimer(200);
+    }
+
+    void shutdown() override
+    {
+        stopTimer();
+
+        // before the processor goes away
+        metricsExporter = nullptr;
+
+        if (nullDevice != nullptr) {
+            std::cerr << "Null audio timing: " << nullDevice->getTimingStats().toString() << ", " << nullDevice->getXRunCount() << " xruns" << std::endl;
+            nullDevice->close();
+            nullDevice = nullptr;
+        }
+        if (deviceManager != nullptr) {
+            deviceManager->removeAudioCallback(driver.get());
+            deviceManager->closeAudioDevice();
+            deviceManager = nullptr;
+        }
+
+        if (processor != nullptr) {
+            processor->removeClientListener(this);
+            processor->stopPacketCapture();
+        }
+
+        driver = nullptr;
+        processor = nullptr;
+
+#if SONOBUS_RT_AUDIT
+        std::cerr << RealtimeAudit::createReport() << std::endl;
+#endif
+    }
+
+    void systemRequestedQuit() override
+    {
+        quit();
+    }
+
+    void anotherInstanceStarted (const String&) override {}
+
+private:
+    void timerCallback() override
+    {
+        if (quitRequested.exchange(false)) {
+            std::cerr << "Shutting down" << std::endl;
+            systemRequestedQuit();
+            return;
+        }
+
+        const int state = connectState.load();
+        if (state == ConnectSucceeded || state == ConnectFailed) {
+            connectState = ConnectHandled;
+
+            if (state == ConnectSucceeded) {
+                joinGroup();
+            }
+            else {
+                fail();
+            }
+        }
+    }
+
+    // from the aoo client event thread
+    void aooClientConnected(SonobusAudioProcessor *, bool success, const String & errmesg) override
+    {
+        if (!success) {
+            std::cerr << "Could not connect to " << connInfo.serverHost << ":" << connInfo.serverPort << ": " << errmesg << std::endl;
+        }
+
+        int expected = ConnectPending;
+        connectState.compare_exchange_strong(expected, success ? ConnectSucceeded : ConnectFailed);
+    }
+
+    void joinGroup()
+    {
+        connInfo.timestamp = Time::getCurrentTime().toMilliseconds();
+        processor->addRecentServerConnectionInfo(connInfo);
+        processor->setWatchPublicGroups(false);
+        processor->joinServerGroup(connInfo.groupName, connInfo.groupPassword, connInfo.groupIsPublic);
+
+        std::cerr << getApplicationName() << " running, group " << connInfo.groupName << " on " << connInfo.serverHost << ":" << connInfo.serverPort << std::endl;
+    }
+
+    void fail()
+    {
+        setApplicationReturnValue(1);
+        quit();
+    }
+
+    // false if the app should quit right away
+    bool handleCommandLine()
+    {
+        ConsoleApplication app;
+
+        const String versionSpec("-v|--version");
+        const String helpSpec("-h|--help");
+
+        const String configSpec("--config");
+        const String configSpecDesc("--config <filename>");
+
+        const String serverSpec("-c|--connectionserver");
+        const String serverSpecDesc("-c|--connectionserver <address[:port]>");
+
+        const String groupSpec("-g|--group");
+        const String groupSpecDesc("-g|--group <groupname>");
+
+        const String groupPassSpec("-p|--group-password");
+        const String groupPassSpecDesc("-p|--group-password <password>");
+
+        const String userNameSpec("-n|--username");
+        const String userNameSpecDesc("-n|--username <username>");
+
+        const String loadSetupSpec("-l|--load-setup");
+        const String loadSetupSpecDesc("-l|--load-setup <setup-filename>");
+
+        const String nullAudioSpec("--null-audio");
+
+        const String nullDriftSpec("--null-audio-drift-ppm");
+        const String nullDriftSpecDesc("--null-audio-drift-ppm <ppm>");
+
+        const String nullPrioritySpec("--null-audio-priority");
+        const String nullPrioritySpecDesc("--null-audio-priority <1-99>");
+
+        const String deviceTypeSpec("--audio-device-type");
+        const String deviceTypeSpecDesc("--audio-device-type <type>");
+
+        const String deviceSpec("--audio-device");
+        const String deviceSpecDesc("--audio-device <name>");
+
+        const String sampleRateSpec("--samplerate");
+        const String sampleRateSpecDesc("--samplerate <rate>");
+
+        const String blockSizeSpec("--blocksize");
+        const String blockSizeSpecDesc("--blocksize <samples>");
+
+        const String metricsPortSpec("--metrics-port");
+        const String metricsPortSpecDesc("--metrics-port <port>");
+
+        const String metricsSocketSpec("--metrics-socket");
+        const String metricsSocketSpecDesc("--metrics-socket <path>");
+
+        const String traceSpec("--trace");
+        const String traceSpecDesc("--trace <directory>");
+
+        const String capturePacketsSpec("--capture-packets");
+        const String capturePacketsSpecDesc("--capture-packets <filename>");
+
+        app.addCommand ({ helpSpec, helpSpec, "Prints the list of commands", {}, nullptr });
+        app.addCommand ({ versionSpec, versionSpec, "Prints the current version number only", {}, nullptr });
+
+        app.addCommand ({ configSpec, configSpecDesc,
+            "Read options from a config file (optional).",
+            "One option per line as name = value, using the long option names without the dashes, e.g. group = myband. Options given on the command line win over the config file.",
+            nullptr
+        });
+        app.addCommand ({ groupSpec, groupSpecDesc, "The group name to connect to (required)", {}, nullptr });
+        app.addCommand ({ userNameSpec, userNameSpecDesc, "The displayed username when connecting to the group", {}, nullptr });
+        app.addCommand ({ groupPassSpec, groupPassSpecDesc, "The password for the group (optional)", {}, nullptr });
+        app.addCommand ({ serverSpec, serverSpecDesc, "The connection server to use (optional)", {}, nullptr });
+        app.addCommand ({ loadSetupSpec, loadSetupSpecDesc,
+            "The filename of a setup file to load (optional).",
+            "Setup files are made with the Save Setup feature of the full application. Its audio device selection is ignored here.",
+            nullptr
+        });
+        app.addCommand ({ nullAudioSpec, nullAudioSpec,
+            "Don't use an audio device, run on an internal clock with silent inputs (optional).",
+            "For machines without audio hardware. On Linux the processing is paced by a CLOCK_MONOTONIC timer on a SCHED_FIFO thread, exactly as by a device at the given sample rate and block size.",
+            nullptr
+        });
+        app.addCommand ({ nullDriftSpec, nullDriftSpecDesc,
+            "Run the --null-audio clock fast (positive) or slow (negative) by this many parts per million (optional).",
+            "For testing how the peers' time filters and jitter buffers cope with a drifting sound card clock.",
+            nullptr
+        });
+        app.addCommand ({ nullPrioritySpec, nullPrioritySpecDesc, "SCHED_FIFO priority of the --null-audio thread (optional, default 40, needs rtprio permission)", {}, nullptr });
+        app.addCommand ({ deviceTypeSpec, deviceTypeSpecDesc, "The audio device type to use, e.g. ALSA, JACK or Null (optional)", {}, nullptr });
+        app.addCommand ({ deviceSpec, deviceSpecDesc, "The audio device to use (optional, default device otherwise)", {}, nullptr });
+        app.addCommand ({ sampleRateSpec, sampleRateSpecDesc, "Sample rate (optional, default 48000)", {}, nullptr });
+        app.addCommand ({ blockSizeSpec, blockSizeSpecDesc, "Block size in samples (optional, default 256)", {}, nullptr });
+        app.addCommand ({ metricsPortSpec, metricsPortSpecDesc, "Serve metrics for monitoring on the given local TCP port (optional)", {}, nullptr });
+        app.addCommand ({ metricsSocketSpec, metricsSocketSpecDesc, "Serve metrics for monitoring on a UNIX domain socket at the given path (optional)", {}, nullptr });
+        app.addCommand ({ traceSpec, traceSpecDesc, "Keep a trace of the audio and network threads, and dump it to the directory around audio glitches (optional)", {}, nullptr });
+        app.addCommand ({ capturePacketsSpec, capturePacketsSpecDesc, "Capture every received network packet with its arrival time to a file (optional)", {}, nullptr });
+
+        ArgumentList arglist(getApplicationName(), getCommandLineParameterArray());
+
+        if (arglist.removeOptionIfFound(versionSpec)) {
+            std::cout << getApplicationName() << " version " << getApplicationVersion() << std::endl;
+            return false;
+        }
+
+        if (arglist.removeOptionIfFound(helpSpec)) {
+            std::cout << getApplicationName() << " version " << getApplicationVersion() << std::endl << std::endl;
+            for (auto & command : app.getCommands()) {
+                std::cout << "  " << command.argumentDescription.paddedRight(' ', 42) << command.shortDescription << std::endl;
+                if (command.longDescription.isNotEmpty()) {
+                    std::cout << "     " << command.longDescription << std::endl;
+                }
+            }
+            return false;
+        }
+
+        StringPairArray config;
+        auto configfile = arglist.removeValueForOption(configSpec);
+        if (configfile.isNotEmpty()) {
+            File file = File::getCurrentWorkingDirectory().getChildFile(configfile);
+            if (!file.existsAsFile()) {
+                std::cerr << "Config file does not exist: " << configfile << std::endl;
+                setApplicationReturnValue(1);
+                return false;
+            }
+
+            String error;
+            config = loadConfigFile(file, error);
+            if (error.isNotEmpty()) {
+                std::cerr << error;
+                setApplicationReturnValue(1);
+                return false;
+            }
+        }
+
+        // command line first, then the config file under the long option name
+        auto getOption = [&](const String & spec) {
+            auto value = arglist.removeValueForOption(spec);
+            return value.isNotEmpty() ? value : config[spec.fromLastOccurrenceOf("--", false, false)];
+        };
+        auto getFlag = [&](const String & spec) {
+            return arglist.removeOptionIfFound(spec) || config[spec.fromLastOccurrenceOf("--", false, false)].getIntValue() != 0;
+        };
+
+        connInfo.userName = SystemStats::getFullUserName();
+        if (connInfo.userName.isEmpty()) {
+            connInfo.userName = SystemStats::getComputerName();
+        }
+        connInfo.serverHost = DEFAULT_SERVER_HOST;
+        connInfo.serverPort = DEFAULT_SERVER_PORT;
+
+        auto connserv = getOption(serverSpec);
+        if (connserv.isNotEmpty()) {
+            connInfo.serverHost = connserv.upToFirstOccurrenceOf(":", false, true);
+            int port = connserv.fromFirstOccurrenceOf(":", false, false).getIntValue();
+            connInfo.serverPort = port > 0 ? port : DEFAULT_SERVER_PORT;
+        }
+
+        connInfo.groupName = getOption(groupSpec);
+        connInfo.groupPassword = getOption(groupPassSpec);
+
+        auto username = getOption(userNameSpec);
+        if (username.isNotEmpty()) {
+            connInfo.userName = username;
+        }
+
+        loadSetupFilename = getOption(loadSetupSpec);
+
+        useNullDevice = getFlag(nullAudioSpec);
+        nullDriftPpm = getOption(nullDriftSpec).getDoubleValue();
+        nullPriority = getOption(nullPrioritySpec).getIntValue();
+        deviceType = getOption(deviceTypeSpec);
+        deviceName = getOption(deviceSpec);
+
+        auto samplerate = getOption(sampleRateSpec);
+        if (samplerate.isNotEmpty()) {
+            sampleRate = samplerate.getDoubleValue();
+        }
+        auto blocksize = getOption(blockSizeSpec);
+        if (blocksize.isNotEmpty()) {
+            blockSize = blocksize.getIntValue();
+        }
+
+        metricsPort = getOption(metricsPortSpec).getIntValue();
+        metricsSocketPath = getOption(metricsSocketSpec);
+        traceDirectory = getOption(traceSpec);
+        packetCaptureFilename = getOption(capturePacketsSpec);
+
+        if (connInfo.groupName.isEmpty()) {
+            std::cerr << "Error: you need to specify a group to connect to, with --group or in the config file. See --help." << std::endl;
+            setApplicationReturnValue(1);
+            return false;
+        }
+
+        if (sampleRate <= 0.0 || blockSize <= 0) {
+            std::cerr << "Error: invalid sample rate or block size" << std::endl;
+            setApplicationReturnValue(1);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool loadSetupFile(const File & file)
+    {
+        PropertiesFile::Options opts;
+        PropertiesFile propfile (file, opts);
+
+        if (!file.existsAsFile() || !propfile.isValidFile()) {
+            std::cerr << "Could not read setup file: " << file.getFullPathName() << std::endl;
+            return false;
+        }
+
+        MemoryBlock data;
+
+        if (propfile.containsKey("filterStateXML")) {
+            String filtxml = propfile.getValue ("filterStateXML");
+            data.replaceAll(filtxml.toUTF8(), filtxml.getNumBytesAsUTF8());
+            if (data.getSize() > 0) {
+                processor->setStateInformationWithOptions (data.getData(), (int) data.getSize(), false, true, true);
+                return true;
+            }
+        }
+        else if (data.fromBase64Encoding (propfile.getValue ("filterState")) && data.getSize() > 0) {
+            processor->setStateInformationWithOptions (data.getData(), (int) data.getSize(), false, true);
+            return true;
+        }
+
+        std::cerr << "Error while loading setup, invalid setup: " << file.getFullPathName() << std::endl;
+        return false;
+    }
+
+    bool startAudio()
+    {
+        const int numInputs = processor->getMainBusNumInputChannels();
+        const int numOutputs = processor->getMainBusNumOutputChannels();
+
+        if (useNullDevice) {
+            nullDevice = std::make_unique<NullAudioDevice>(numInputs, numOutputs);
+            nullDevice->setDriftPpm(nullDriftPpm);
+            if (nullPriority > 0) {
+                nullDevice->setRealtimePriority(nullPriority);
+            }
+
+            BigInteger inputs, outputs;
+            inputs.setRange(0, numInputs, true);
+            outputs.setRange(0, numOutputs, true);
+
+            auto error = nullDevice->open(inputs, outputs, sampleRate, blockSize);
+            if (error.isNotEmpty()) {
+                std::cerr << "Could not open null audio device: " << error << std::endl;
+                return false;
+            }
+
+            nullDevice->start(driver.get());
+            return true;
+        }
+
+        deviceManager = std::make_unique<AudioDeviceManager>();
+
+        // --audio-device-type Null, the same as --null-audio but with the default clock settings.
+        // the platform types are only created while the list is empty, so they have to come first,
+        // and it's only added when asked for, so it never ends up as the default device
+        deviceManager->getAvailableDeviceTypes();
+        if (deviceType == NullAudioDevice::typeName) {
+            deviceManager->addAudioDeviceType(std::make_unique<NullAudioDeviceType>(numInputs, numOutputs));
+        }
+
+        AudioDeviceManager::AudioDeviceSetup setup;
+        setup.sampleRate = sampleRate;
+        setup.bufferSize = blockSize;
+        setup.inputDeviceName = deviceName;
+        setup.outputDeviceName = deviceName;
+
+        std::unique_ptr<XmlElement> xml;
+
+        if (deviceType.isNotEmpty()) {
+            AudioIODeviceType * type = nullptr;
+            for (auto * available : deviceManager->getAvailableDeviceTypes()) {
+                if (available->getTypeName() == deviceType) {
+                    type = available;
+                }
+            }
+
+            if (type == nullptr) {
+                std::cerr << "Unknown audio device type: " << deviceType << std::endl;
+                return false;
+            }
+
+            String name = deviceName;
+            if (name.isEmpty()) {
+                type->scanForDevices();
+                name = type->getDeviceNames()[type->getDefaultDeviceIndex(false)];
+            }
+
+            // selects the type up front, instead of opening the default type's device first
+            xml = std::make_unique<XmlElement>("DEVICESETUP");
+            xml->setAttribute("deviceType", deviceType);
+            xml->setAttribute("audioDeviceName", name);
+            xml->setAttribute("audioDeviceRate", sampleRate);
+            xml->setAttribute("audioDeviceBufferSize", blockSize);
+        }
+
+        auto error = deviceManager->initialise(numInputs, numOutputs, xml.get(), false, {}, &setup);
+
+        if (error.isNotEmpty() || deviceManager->getCurrentAudioDevice() == nullptr) {
+            std::cerr << "Could not open audio device: " << (error.isNotEmpty() ? error : String("none available")) << ", use --null-audio on machines without audio hardware" << std::endl;
+            return false;
+        }
+
+        deviceManager->addAudioCallback(driver.get());
+        return true;
+    }
+
+    AooServerConnectionInfo connInfo;
+    String loadSetupFilename;
+
+    bool useNullDevice = false;
+    double nullDriftPpm = 0.0;
+    int nullPriority = 0;
+    String deviceType;
+    String deviceName;
+    double sampleRate = 48000.0;
+    int blockSize = 256;
+
+    int metricsPort = 0;
+    String metricsSocketPath;
+    String traceDirectory;
+    String packetCaptureFilename;
+
+    std::unique_ptr<SonobusAudioProcessor> processor;
+    std::unique_ptr<ProcessorDriver> driver;
+    std::unique_ptr<NullAudioDevice> nullDevice;
+    std::unique_ptr<AudioDeviceManager> deviceManager;
+    std::unique_ptr<MetricsExporter> metricsExporter;
+
+    enum ConnectState {
+        ConnectPending = 0,
+        ConnectSucceeded,
+        ConnectFailed,
+        ConnectHandled
+    };
+    std::atomic<int> connectState { ConnectPending };
+};
+
+START_JUCE_APPLICATION (SonobusServerApp);
@@ -58,6 +58,15 @@ extern juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
 #include "SonoLookAndFeel.h"
 
 #include "SonobusPluginEditor.h"
+#include "StreamCapture.h"
+#include "PacketCapture.h"
+#include "MetricsExporter.h"
+#include "TraceRecorder.h"
+#include "RealtimeAudit.h"
+
+#if JUCE_LINUX || JUCE_MAC
+#include <signal.h>
+#endif
 
 #if JUCE_ANDROID
 #include "android/SonoBusActivity.h"
@@ -126,6 +135,10 @@ public:
     bool doHeadless = false;
     String loadSetupFilename;
     String cmdlineArgUrl;
+    int metricsPort = 0;
+    String metricsSocketPath;
+    String traceDirectory;
+    String packetCaptureFilename;
 
     virtual StandalonePluginHolder* createHeadlessPlugin ()
     {
@@ -315,6 +328,30 @@ public:
         const String loadSetupSpec("-l|--load-setup");
         const String loadSetupSpecDesc("-l|--load-setup <setup-filename>");
 
+        const String decodeCapturesSpec("-d|--decode-captures");
+        const String decodeCapturesSpecDesc("-d|--decode-captures <directory>");
+
+        const String metricsPortSpec("--metrics-port");
+        const String metricsPortSpecDesc("--metrics-port <port>");
+
+        const String metricsSocketSpec("--metrics-socket");
+        const String metricsSocketSpecDesc("--metrics-socket <path>");
+
+        const String traceSpec("--trace");
+        const String traceSpecDesc("--trace <directory>");
+
+        const String capturePacketsSpec("--capture-packets");
+        const String capturePacketsSpecDesc("--capture-packets <filename>");
+
+        const String replayPacketsSpec("--replay-packets");
+        const String replayPacketsSpecDesc("--replay-packets <filename>");
+
+        const String replayBufferSpec("--replay-buffer-ms");
+        const String replayBufferSpecDesc("--replay-buffer-ms <ms>");
+
+        const String replayAutoBufferSpec("--replay-auto-buffer");
+        const String replayAutoBufferSpecDesc("--replay-auto-buffer <off|increase|full|initial>");
+
         
 
         app.addCommand ({ helpSpec, helpSpec, TRANS("Prints the list of commands"), {}, nullptr });
@@ -350,6 +387,52 @@ public:
             nullptr
         });
 
+        app.addCommand ({ decodeCapturesSpec, decodeCapturesSpecDesc,
+            TRANS("Decodes the raw network stream captures in a recording directory to aligned audio files, then quits."),
+            TRANS("Raw stream captures (.sbcap) are made when recording each connected user as a raw network stream."),
+            nullptr
+        });
+
+        app.addCommand ({ metricsPortSpec, metricsPortSpecDesc,
+            TRANS("Serve metrics for monitoring on the given local TCP port (optional)."),
+            TRANS("Per-peer network stats and audio thread health are served at /metrics in Prometheus text format, and at /metrics.json as JSON. Only listens on 127.0.0.1."),
+            nullptr
+        });
+
+        app.addCommand ({ metricsSocketSpec, metricsSocketSpecDesc,
+            TRANS("Serve metrics for monitoring on a UNIX domain socket at the given path (optional)."),
+            TRANS("Same content as --metrics-port, e.g. curl --unix-socket <path> http://localhost/metrics"),
+            nullptr
+        });
+
+        app.addCommand ({ traceSpec, traceSpecDesc,
+            TRANS("Keep a trace of the audio and network threads, and dump it to the directory around audio glitches (optional)."),
+            TRANS("The dumps are Chrome trace JSON files, for chrome://tracing or ui.perfetto.dev. A dump can also be requested with SIGUSR1, or fetched from /trace on the metrics endpoint."),
+            nullptr
+        });
+
+        app.addCommand ({ capturePacketsSpec, capturePacketsSpecDesc,
+            TRANS("Capture every received network packet with its arrival time to a file (optional)."),
+            TRANS("The capture can be replayed offline with --replay-packets, to compare jitter buffer settings on the same network conditions."),
+            nullptr
+        });
+
+        app.addCommand ({ replayPacketsSpec, replayPacketsSpecDesc,
+            TRANS("Replays a packet capture through the receiving side as fast as possible, prints a report, then quits."),
+            TRANS("The report lists lost, reordered and resent blocks, buffer underruns, buffered latency and CPU time per received stream. Use --replay-buffer-ms to set the starting jitter buffer size (default 20)."),
+            nullptr
+        });
+
+        app.addCommand ({ replayBufferSpec, replayBufferSpecDesc,
+            TRANS("Jitter buffer size in milliseconds for --replay-packets (optional)."), {},
+            nullptr
+        });
+
+        app.addCommand ({ replayAutoBufferSpec, replayAutoBufferSpecDesc,
+            TRANS("Automatic jitter buffer sizing for --replay-packets, same as the per-user setting (optional, default full)."), {},
+            nullptr
+        });
+
         app.addCommand ({ headlessSpec, headlessSpecDesc,
             TRANS("If specified, no GUI will be used and the application will be run headless."),
             TRANS("You'll need to use other command-line options to connect to a group... eventually there will be an OSC remote control interface."),
@@ -374,6 +457,35 @@ public:
             return;
         }
 
+        auto capturedir = arglist.removeValueForOption(decodeCapturesSpec);
+        if (capturedir.isNotEmpty()) {
+            decodeStreamCaptures(File::getCurrentWorkingDirectory().getChildFile(capturedir));
+            doImmediateQuit = true;
+            return;
+        }
+
+        auto replayfile = arglist.removeValueForOption(replayPacketsSpec);
+        if (replayfile.isNotEmpty()) {
+            SonoAudio::PacketCaptureReplayer::Options options;
+            auto bufferms = arglist.removeValueForOption(replayBufferSpec);
+            if (bufferms.isNotEmpty()) {
+                options.bufferTimeMs = bufferms.getFloatValue();
+            }
+            auto automode = arglist.removeValueForOption(replayAutoBufferSpec);
+            if (automode.isNotEmpty()) {
+                const int index = StringArray { "off", "increase", "full", "initial" }.indexOf(automode, true);
+                if (index < 0) {
+                    std::cout << TRANS("Error: ") << TRANS("Unknown auto buffer mode: ") << automode << std::endl;
+                    doImmediateQuit = true;
+                    return;
+                }
+                options.autoBufferMode = (SonoAudio::NetBufferPolicy::Mode) index;
+            }
+            replayPacketCapture(File::getCurrentWorkingDirectory().getChildFile(replayfile), options);
+            doImmediateQuit = true;
+            return;
+        }
+
         setupDefaultConnInfo();
 
         auto connserv = arglist.removeValueForOption(serverSpec);
@@ -414,6 +526,17 @@ public:
         }
 
 
+        auto metricsport = arglist.removeValueForOption(metricsPortSpec);
+        if (metricsport.isNotEmpty()) {
+            metricsPort = metricsport.getIntValue();
+        }
+
+        metricsSocketPath = arglist.removeValueForOption(metricsSocketSpec);
+
+        traceDirectory = arglist.removeValueForOption(traceSpec);
+
+        packetCaptureFilename = arglist.removeValueForOption(capturePacketsSpec);
+
         if (arglist.removeOptionIfFound(headlessSpec)) {
 
             doHeadless = true;
@@ -431,6 +554,38 @@ public:
 
     }
 
+    void decodeStreamCaptures(const File & dir)
+    {
+        // registers the codecs
+        aoo_initialize();
+
+        Array<File> results;
+        String error;
+        bool ok = SonoAudio::StreamCaptureDecoder::decodeDirectory(dir, SonoAudio::SessionRecordingFinalizer::StemFormatFLAC, 24, results, error);
+
+        for (auto & file : results) {
+            std::cout << TRANS("Decoded: ") << file.getFullPathName() << std::endl;
+        }
+        if (!ok) {
+            std::cout << TRANS("Error: ") << error << std::endl;
+        }
+    }
+
+    void replayPacketCapture(const File & file, const SonoAudio::PacketCaptureReplayer::Options & options)
+    {
+        // registers the codecs
+        aoo_initialize();
+
+        SonoAudio::PacketCaptureReplayer::Report report;
+        String error;
+        if (SonoAudio::PacketCaptureReplayer::replay(file, options, report, error)) {
+            std::cout << report.toString();
+        }
+        else {
+            std::cout << TRANS("Error: ") << error << std::endl;
+        }
+    }
+
     //==============================================================================
     void initialise (const String&) override
     {
@@ -442,6 +597,18 @@ public:
             return;
         };
 
+#if SONOBUS_RT_AUDIT
+        SonoAudio::RealtimeAudit::installHooks();
+#endif
+
+
+        if (traceDirectory.isNotEmpty()) {
+            SonoAudio::TraceRecorder::setDumpDirectory(File::getCurrentWorkingDirectory().getChildFile(traceDirectory));
+            SonoAudio::TraceRecorder::setEnabled(true);
+#if JUCE_LINUX || JUCE_MAC
+            signal(SIGUSR1, [](int) { SonoAudio::TraceRecorder::requestDump(); });
+#endif
+        }
 
         if (!doHeadless) {
             mainWindow.reset (createWindow());
@@ -564,6 +731,19 @@ public:
 
         }
 
+        if (metricsPort > 0 || metricsSocketPath.isNotEmpty()) {
+            startMetricsExporter();
+        }
+
+        if (packetCaptureFilename.isNotEmpty()) {
+            StandalonePluginHolder * plugHolder = mainWindow != nullptr ? mainWindow->pluginHolder.get() : pluginHolder.get();
+            auto * processor = plugHolder ? dynamic_cast<SonobusAudioProcessor*>(plugHolder->processor.get()) : nullptr;
+            auto file = File::getCurrentWorkingDirectory().getChildFile(packetCaptureFilename);
+            if (!processor || !processor->startPacketCapture(file)) {
+                std::cerr << "Could not start packet capture to " << file.getFullPathName() << std::endl;
+            }
+        }
+
 
 #if JUCE_MAC
         disableAppNap();
@@ -572,6 +752,27 @@ public:
     }
 
 
+    void startMetricsExporter()
+    {
+        StandalonePluginHolder * plugHolder = mainWindow != nullptr ? mainWindow->pluginHolder.get() : pluginHolder.get();
+        if (plugHolder == nullptr) return;
+
+        auto * processor = dynamic_cast<SonobusAudioProcessor*>(plugHolder->processor.get());
+        if (processor == nullptr) return;
+
+        metricsExporter = std::make_unique<SonoAudio::MetricsExporter>(*processor);
+        metricsExporter->getXRunCount = [plugHolder]() {
+            auto * device = plugHolder->deviceManager.getCurrentAudioDevice();
+            return device ? device->getXRunCount() : -1;
+        };
+
+        bool ok = metricsSocketPath.isNotEmpty() ? metricsExporter->startListening(metricsSocketPath) : metricsExporter->startListening(metricsPort);
+        if (!ok) {
+            std::cerr << "Could not start metrics endpoint on " << (metricsSocketPath.isNotEmpty() ? metricsSocketPath : String(metricsPort)) << std::endl;
+            metricsExporter.reset();
+        }
+    }
+
     bool loadSettingsFromFile(const File & file)
     {
         SonobusAudioProcessor * processor = nullptr;
@@ -687,12 +888,18 @@ public:
   #endif
 #endif
 
+        // before the processor goes away
+        metricsExporter = nullptr;
+
         mainWindow = nullptr;
 
         pluginHolder = nullptr;
 
         appProperties.saveIfNeeded();
 
+#if SONOBUS_RT_AUDIT
+        std::cerr << SonoAudio::RealtimeAudit::createReport() << std::endl;
+#endif
     }
     
     void urlOpened(const URL & url) override {
@@ -882,6 +1089,8 @@ protected:
     // used only in headless mode
     std::unique_ptr<StandalonePluginHolder> pluginHolder;
 
+    std::unique_ptr<SonoAudio::MetricsExporter> metricsExporter;
+
 };
 
 } // namespace juce
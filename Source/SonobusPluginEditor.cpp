@@ -2130,7 +2130,8 @@ void SonobusAudioProcessorEditor::buttonClicked (Button* buttonThatWasClicked)
             //});
 
 
-            if (processor.getRecordFinishOpens()) {
+            // crash-safe recordings are still being finalized in the background, nothing to load yet
+            if (processor.getRecordFinishOpens() && !processor.isFinalizingRecordings()) {
                 // load up recording
                 loadAudioFromURL(lastRecordedFile);
                 if (lastRecordedFile.isLocalFile()) {
@@ -3766,16 +3767,14 @@ void SonobusAudioProcessorEditor::handleAsyncUpdate()
         newevents = clientEvents;
         clientEvents.clearQuick();
     }
+
+    // peer changes are gathered and the views updated once for the whole batch
+    bool peerUpdateNeeded = false;
     
     for (auto & ev : newevents) {
         if (ev.type == ClientEvent::PeerChangedState) {
             peerStateUpdated = true;
-            //mPeerContainer->updateLayout();
-            //mPeerContainer->resized();
-            //Timer::callAfterDelay(100, [this](){
-            updatePeerState(true);
-            updateState(false);
-            //});
+            peerUpdateNeeded = true;
         }
         else if (ev.type == ClientEvent::ConnectEvent) {
             String statstr;
@@ -3934,11 +3933,15 @@ void SonobusAudioProcessorEditor::handleAsyncUpdate()
                 mChatView->addNewChatMessage(SBChatEvent(SBChatEvent::SystemType, ev.group, ev.user, "", "", mesg));
             }
 
-            // delay update
-            Timer::callAfterDelay(200, [this] {
-                updatePeerState(true);
-                updateState(false);
-            });
+            // delay update, one for all peers joining around the same time
+            if (!mPeerJoinUpdatePending) {
+                mPeerJoinUpdatePending = true;
+                Timer::callAfterDelay(200, [this] {
+                    mPeerJoinUpdatePending = false;
+                    updatePeerState(true);
+                    updateState(false);
+                });
+            }
         }
         else if (ev.type == ClientEvent::PeerLeaveEvent) {
             if (!currConnectionInfo.groupIsPublic) {
@@ -3949,8 +3952,7 @@ void SonobusAudioProcessorEditor::handleAsyncUpdate()
 
             mPeerContainer->peerLeftGroup(ev.group, ev.user);
 
-            updatePeerState(true);
-            updateState(false);
+            peerUpdateNeeded = true;
         }
         else if (ev.type == ClientEvent::PeerPendingJoinEvent) {
             mPeerContainer->peerPendingJoin(ev.group, ev.user);
@@ -3966,10 +3968,15 @@ void SonobusAudioProcessorEditor::handleAsyncUpdate()
             showLatencyMatchPrompt(ev.message, ev.floatVal);
         }
         else if (ev.type == ClientEvent::PeerBlockedInfoChangedEvent) {
-            updatePeerState(true);
+            peerUpdateNeeded = true;
         }
     }
 
+    if (peerUpdateNeeded) {
+        updatePeerState(true);
+        updateState(false);
+    }
+
     if (haveNewChatEvents.compareAndSetBool(false, true))
     {
         mChatView->refreshMessages();
@@ -495,6 +495,7 @@ private:
    bool mSoundboardWasVisible = false;
 
     bool peerStateUpdated = false;
+    bool mPeerJoinUpdatePending = false;
     double serverStatusFadeTimestamp = 0;
 
     std::unique_ptr<Component> mTopLevelContainer;
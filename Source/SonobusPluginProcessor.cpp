@@ -4,7 +4,9 @@
 
 
 #include "SonobusPluginProcessor.h"
+#if !SONOBUS_HEADLESS_SERVER
 #include "SonobusPluginEditor.h"
+#endif
 
 #include "RunCumulantor.h"
 
@@ -12,6 +14,7 @@
 #include "aoo/aoo_net.h"
 #include "aoo/aoo_pcm.h"
 #include "aoo/aoo_opus.h"
+#include "aoo/aoo_lossless.h"
 
 #include "oscpack/osc/OscOutboundPacketStream.h"
 #include "oscpack/osc/OscReceivedElements.h"
@@ -33,10 +36,89 @@ typedef int socklen_t;
 #else
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #endif
 
+static void setDontFragment(int sockfd, bool flag)
+{
+    int opterr = 0;
+#if JUCE_WINDOWS
+    DWORD val = flag ? 1 : 0;
+    opterr = setsockopt(sockfd, IPPROTO_IP, IP_DONTFRAGMENT, (const char *) &val, sizeof(val));
+#elif defined(IP_MTU_DISCOVER) && defined(IP_PMTUDISC_PROBE)
+    // PROBE sets DF, but doesn't limit our packets to the MTU cached by the kernel.
+    // WANT is the default
+    int val = flag ? IP_PMTUDISC_PROBE : IP_PMTUDISC_WANT;
+    opterr = setsockopt(sockfd, IPPROTO_IP, IP_MTU_DISCOVER, &val, sizeof(val));
+#elif defined(IP_DONTFRAG)
+    int val = flag ? 1 : 0;
+    opterr = setsockopt(sockfd, IPPROTO_IP, IP_DONTFRAG, &val, sizeof(val));
+#endif
+    if (opterr != 0) {
+        DBG("Error setting don't fragment on socket: " << opterr);
+    }
+}
+
+// /aoo/sink/<id>/probe, the path MTU probes of our sources
+static bool isProbeMessage(const char *data, int32_t size)
+{
+    const int prefixlen = AOO_MSG_DOMAIN_LEN + AOO_MSG_SINK_LEN;
+    if (size < prefixlen + AOO_MSG_PROBE_LEN || memcmp(data, AOO_MSG_DOMAIN AOO_MSG_SINK, prefixlen) != 0) {
+        return false;
+    }
+
+    // the address is null terminated, and a sink id is at most a few chars
+    const char * addrend = (const char *) memchr(data + prefixlen, 0, jmin(size - prefixlen, 24));
+    return addrend != nullptr && addrend - data >= prefixlen + AOO_MSG_PROBE_LEN
+        && memcmp(addrend - AOO_MSG_PROBE_LEN, AOO_MSG_PROBE, AOO_MSG_PROBE_LEN) == 0;
+}
+
+// only the probes go out with don't fragment, everything else on the socket may still
+// need IP fragmentation (e.g. the peer info). a probe has the socket to itself meanwhile
+static ReadWriteLock dontFragmentLock;
+
+#if JUCE_LINUX && defined(SO_REUSEPORT)
+// several receive sockets share our port, the kernel hashes each remote
+// address to one of them so a peer's sink is only ever fed by one thread
+#define SONOBUS_RECV_SHARDING 1
+#endif
+
+#define MAX_RECV_SHARDS 4
+
+static int getNumRecvShards()
+{
+#if SONOBUS_RECV_SHARDING
+    return jlimit(1, MAX_RECV_SHARDS, SystemStats::getNumCpus() / 2);
+#else
+    return 1;
+#endif
+}
+
+static bool setReusePort(int sockfd)
+{
+#if SONOBUS_RECV_SHARDING
+    int val = 1;
+    int opterr = setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &val, sizeof(val));
+    if (opterr != 0) {
+        DBG("Error setting reuseport on socket: " << opterr);
+        return false;
+    }
+    return true;
+#else
+    ignoreUnused(sockfd);
+    return false;
+#endif
+}
+
+static bool isUdpPortFree(int port)
+{
+    // a plain socket can't join a reuseport group, so this fails if anyone has the port
+    DatagramSocket probe;
+    return probe.bindToPort(port);
+}
+
 #define MAX_DELAY_SAMPLES 192000
 #define SENDBUFSIZE_SCALAR 2.0f
 #define PEER_PING_INTERVAL_MS 2000.0
@@ -87,11 +169,14 @@ static String extraStateCollectionKey("ExtraState");
 static String useSpecificUdpPortKey("UseUdpPort");
 static String changeQualForAllKey("ChangeQualForAll");
 static String changeRecvQualForAllKey("ChangeRecvQualForAll");
+static String adaptiveBitrateMinKey("AdaptiveBitrateMin");
+static String autoPacketsizeKey("AutoPacketsize");
 static String defRecordOptionsKey("DefaultRecordingOptions");
 static String defRecordFormatKey("DefaultRecordingFormat");
 static String defRecordBitsKey("DefaultRecordingBitsPerSample");
 static String recordSelfPreFxKey("RecordSelfPreFx");
 static String recordFinishOpenKey("RecordFinishOpen");
+static String recordCrashSafeKey("RecordCrashSafe");
 static String defRecordDirKey("DefaultRecordDir");
 static String defRecordDirURLKey("DefaultRecordDirURL");
 static String lastBrowseDirKey("LastBrowseDir");
@@ -151,6 +236,8 @@ static String peerOrderPriorityKey("orderpriority");
 
 
 #define METER_RMS_SEC 0.03
+// meters don't need updating more often than this, tiny blocks get gathered
+#define METER_UPDATE_SEC 0.002
 #define MAX_PANNERS 64
 
 #define ECHO_SINKSOURCE_ID 12321
@@ -198,6 +285,8 @@ struct SonobusAudioProcessor::EndpointState {
     
 
     DatagramSocket *owner;
+    // set if the endpoint is on this host, packets go through shared memory if the other side has a queue
+    SonoAudio::LocalTransport * localTransport = nullptr;
     //struct sockaddr_storage addr;
     //socklen_t addrlen;
     std::unique_ptr<DatagramSocket::RemoteAddrInfo> peer;
@@ -241,7 +330,7 @@ enum {
 };
 
 
-struct SonobusAudioProcessor::RemotePeer {
+struct SonobusAudioProcessor::RemotePeer : public SonoAudio::NetBufferState {
     RemotePeer(EndpointState * ep = 0, int id_=0, aoo::isink::pointer oursink_ = 0, aoo::isource::pointer oursource_ = 0) : endpoint(ep), 
         ourId(id_), 
         oursink(std::move(oursink_)), oursource(std::move(oursource_))
@@ -282,7 +371,6 @@ struct SonobusAudioProcessor::RemotePeer {
 
     float gain = 1.0f;
 
-    float buffertimeMs = 0.0f;
     float padBufferTimeMs = 0.0f;
     AutoNetBufferMode  autosizeBufferMode = AutoNetBufferModeAutoFull;
     bool sendActive = false;
@@ -297,10 +385,14 @@ struct SonobusAudioProcessor::RemotePeer {
     AudioCodecFormatInfo recvFormat;
     int reqRemoteSendFormatIndex = -1; // no pref
     int packetsize = 600;
+    bool autoPacketsize = true; // path MTU discovery, packetsize is the fallback
     int sendChannels = 1; // actual current send channel count
     int nominalSendChannels = 1; // 0 matches input, 1 is 1, 2 is 2
     int sendChannelsOverride = -1; // -1 don't override
     int recvChannels = 0;
+
+    uint32 viewId = 0;
+    std::atomic<uint32> viewChanges { PeerViewChangeNone };
     float recvPan[MAX_PANNERS];
     float recvStereoPan[MAX_PANNERS]; // only use 2
     // runtime state
@@ -310,16 +402,6 @@ struct SonobusAudioProcessor::RemotePeer {
     String groupName;
     int64_t dataPacketsReceived = 0;
     int64_t dataPacketsSent = 0;
-    int64_t dataPacketsDropped = 0;
-    int64_t dataPacketsResent = 0;
-    double lastDroptime = 0;
-    double resetDroptime = 0;
-    int64_t lastDropCount = 0;
-    double lastNetBufDecrTime = 0;
-    float netBufAutoBaseline = 0.0f;
-    bool autoNetbufInitCompleted = false;
-    bool latencyMatched = false;
-    bool resetSafetyMuted = true;
     float pingTime = 0.0f; // ms
     double lastSendPingTimeMs = -1;
     bool   gotNewStylePing = false;
@@ -327,7 +409,6 @@ struct SonobusAudioProcessor::RemotePeer {
     stats::RunCumulantor1D  smoothPingTime; // ms
     stats::RunCumulantor1D  fillRatio;
     stats::RunCumulantor1D  fillRatioSlow;
-    stats::RunCumulantor1D  fastDropRate;
     float totalEstLatency = 0.0f; // ms
     float totalLatency = 0.0f; // ms
     float bufferTimeAtRealLatency = 0.0f; // ms
@@ -362,9 +443,14 @@ struct SonobusAudioProcessor::RemotePeer {
     bool hasRemoteInfo = false;
     bool blockedUs = false;
 
-    std::unique_ptr<AudioFormatWriter::ThreadedWriter> fileWriter;
+    std::atomic<int> recordTrack { -1 }; // track index in the recorder
+    int recordTrackChannels = 0; // cached so the audio thread doesn't ask the recorder
+    SonoAudio::StreamCaptureWriter * captureWriter = nullptr; // owned by processor
 
     ReadWriteLock    sinkLock;
+    // around handle_message on this peer's sinks and sources. it's normally fed by one recv
+    // thread only, but wildcards and the local transport can come in on another one
+    CriticalSection  recvLock;
 };
 
 
@@ -373,10 +459,26 @@ static int32_t endpoint_send(void *e, const char *data, int32_t size)
 {
     SonobusAudioProcessor::EndpointState * endpoint = static_cast<SonobusAudioProcessor::EndpointState*>(e);
     int result = -1;
-    if (endpoint->peer) {
-        result = endpoint->owner->write(*(endpoint->peer), data, size);
-    } else {
-        result = endpoint->owner->write(endpoint->ipaddr, endpoint->port, data, size);
+    if (endpoint->localTransport && endpoint->localTransport->send(endpoint->port, data, size)) {
+        result = size;
+    }
+    else if (isProbeMessage(data, size)) {
+        const ScopedWriteLock sl (dontFragmentLock);
+        setDontFragment(endpoint->owner->getRawSocketHandle(), true);
+        if (endpoint->peer) {
+            result = endpoint->owner->write(*(endpoint->peer), data, size);
+        } else {
+            result = endpoint->owner->write(endpoint->ipaddr, endpoint->port, data, size);
+        }
+        setDontFragment(endpoint->owner->getRawSocketHandle(), false);
+    }
+    else {
+        const ScopedReadLock sl (dontFragmentLock);
+        if (endpoint->peer) {
+            result = endpoint->owner->write(*(endpoint->peer), data, size);
+        } else {
+            result = endpoint->owner->write(endpoint->ipaddr, endpoint->port, data, size);
+        }
     }
     
     if (result > 0) {
@@ -446,7 +548,7 @@ public:
 class SonobusAudioProcessor::RecvThread : public juce::Thread
 {
 public:
-    RecvThread(SonobusAudioProcessor & processor) : Thread("SonoBusRecvThread") , _processor(processor) 
+    RecvThread(SonobusAudioProcessor & processor, DatagramSocket & socket) : Thread("SonoBusRecvThread") , _processor(processor), _socket(socket)
     {}
     
     void run() override {
@@ -455,8 +557,8 @@ public:
 
         while (!threadShouldExit()) {
          
-            if (_processor.mUdpSocket->waitUntilReady(true, 20) == 1) {
-                _processor.doReceiveData();
+            if (_socket.waitUntilReady(true, 20) == 1) {
+                _processor.doReceiveData(_socket);
             }
         }
 
@@ -464,6 +566,28 @@ public:
     }
     
     SonobusAudioProcessor & _processor;
+    DatagramSocket & _socket;
+    
+};
+
+class SonobusAudioProcessor::LocalRecvThread : public juce::Thread
+{
+public:
+    LocalRecvThread(SonobusAudioProcessor & processor) : Thread("SonoBusLocalRecvThread") , _processor(processor)
+    {}
+    
+    void run() override {
+
+        setPriority(Thread::Priority::highest);
+
+        while (!threadShouldExit()) {
+            _processor.doReceiveLocalData();
+        }
+
+        DBG("Local recv thread finishing");
+    }
+    
+    SonobusAudioProcessor & _processor;
     
 };
 
@@ -480,6 +604,8 @@ public:
             Thread::sleep(20);
             
             _processor.handleEvents();                       
+
+            SonoAudio::TraceRecorder::serviceDumpRequests();
         }
         
         DBG("Event thread finishing");
@@ -804,6 +930,14 @@ mState (*this, &mUndoManager, "SonoBusAoO",
     mMainReverbParams.roomSize = jmap(mMainReverbSize.get(), 0.55f, 1.0f);
     mMainReverb->setParameters(mMainReverbParams);
 
+    // reverb send buses, each source adds its send once into these
+    mMainReverbBus = mSendBusGraph.addBus("main reverb", 2, [this](AudioBuffer<float>& buf, int numSamples, bool enabled, bool wasEnabled) {
+        processMainReverbBus(buf, numSamples, enabled, wasEnabled);
+    });
+    mInputReverbBus = mSendBusGraph.addBus("input reverb", 2, [this](AudioBuffer<float>& buf, int numSamples, bool enabled, bool wasEnabled) {
+        processInputReverbBus(buf, numSamples, enabled, wasEnabled);
+    });
+
 
     for (int i=0; i < MAX_CHANGROUPS; ++i) {
 
@@ -812,6 +946,8 @@ mState (*this, &mUndoManager, "SonoBusAoO",
         mInputChannelGroups[i].params.numChannels = 1;
 
         mInputChannelGroups[i].params.setToDefaults(isplugin);
+
+        mSelfRecordTracks[i] = -1;
     }
 
     mMetChannelGroup.params.name = TRANS("Metronome");
@@ -851,6 +987,8 @@ SonobusAudioProcessor::~SonobusAudioProcessor()
     mTransportSource.removeChangeListener(this);
 
     cleanupAoo();
+
+    stopPacketCapture();
 }
 
 void SonobusAudioProcessor::moveOldMisplacedFiles()
@@ -926,6 +1064,11 @@ void SonobusAudioProcessor::initializeAoo(int udpPort)
     mUdpSocket->setSendBufferSize(1048576);
     mUdpSocket->setReceiveBufferSize(1048576);
 
+    int numRecvShards = getNumRecvShards();
+    if (numRecvShards > 1 && !setReusePort(mUdpSocket->getRawSocketHandle())) {
+        numRecvShards = 1;
+    }
+
     /*
     int tos_local = 0x38; // QOS realtime DSCP
     int opterr = setsockopt(mUdpSocket->getRawSocketHandle(), IPPROTO_IP, IP_TOS,  &tos_local, sizeof(tos_local));
@@ -937,7 +1080,7 @@ void SonobusAudioProcessor::initializeAoo(int udpPort)
     if (udpport > 0) {
         int attempts = 100;
         while (attempts > 0) {
-            if (mUdpSocket->bindToPort(udpport)) {
+            if ((numRecvShards == 1 || isUdpPortFree(udpport)) && mUdpSocket->bindToPort(udpport)) {
                 udpport = mUdpSocket->getBoundPort();
                 DBG("Bound udp port to " << udpport);
                 break;
@@ -965,6 +1108,30 @@ void SonobusAudioProcessor::initializeAoo(int udpPort)
     
     mUdpLocalPort = udpport;
 
+    // the extra sockets only receive, everything is sent from mUdpSocket
+    for (int i = 1; i < numRecvShards && mUdpLocalPort > 0; ++i) {
+        auto sock = std::make_unique<DatagramSocket>();
+        sock->setSendBufferSize(1048576);
+        sock->setReceiveBufferSize(1048576);
+
+        if (!setReusePort(sock->getRawSocketHandle()) || !sock->bindToPort(mUdpLocalPort)) {
+            DBG("Could not add recv shard socket on port " << mUdpLocalPort);
+            break;
+        }
+
+        mRecvShardSockets.add(sock.release());
+    }
+
+    DBG("Receiving with " << (mRecvShardSockets.size() + 1) << " threads");
+
+    if (mUdpLocalPort > 0 && SonoAudio::LocalTransport::isSupported()) {
+        mLocalTransport = std::make_unique<SonoAudio::LocalTransport>();
+        if (!mLocalTransport->open(mUdpLocalPort)) {
+            DBG("Could not open local transport, using UDP only");
+            mLocalTransport.reset();
+        }
+    }
+
     //mLocalIPAddress = IPAddress::getLocalAddress();
 
 #if JUCE_IOS    
@@ -1005,7 +1172,13 @@ void SonobusAudioProcessor::initializeAoo(int udpPort)
 
     
     mSendThread = std::make_unique<SendThread>(*this);
-    mRecvThread = std::make_unique<RecvThread>(*this);
+    mRecvThreads.add(new RecvThread(*this, *mUdpSocket));
+    for (auto * sock : mRecvShardSockets) {
+        mRecvThreads.add(new RecvThread(*this, *sock));
+    }
+    if (mLocalTransport) {
+        mLocalRecvThread = std::make_unique<LocalRecvThread>(*this);
+    }
     mEventThread = std::make_unique<EventThread>(*this);
 
     if (mAooClient) {
@@ -1018,7 +1191,12 @@ void SonobusAudioProcessor::initializeAoo(int udpPort)
 #if JUCE_WINDOWS
     // do not use startRealtimeThread() call because it triggers the whole process to be realtime, which we don't want
     mSendThread->startThread(Thread::Priority::highest);
-    mRecvThread->startThread(Thread::Priority::highest);
+    for (auto * recvThread : mRecvThreads) {
+        recvThread->startThread(Thread::Priority::highest);
+    }
+    if (mLocalRecvThread) {
+        mLocalRecvThread->startThread(Thread::Priority::highest);
+    }
 #else
     if (!mSendThread->startRealtimeThread({ rtprio, estWorkDurationMs }))
     {
@@ -1026,10 +1204,18 @@ void SonobusAudioProcessor::initializeAoo(int udpPort)
         mSendThread->startThread(Thread::Priority::highest);
     }
 
-    if (!mRecvThread->startRealtimeThread({ rtprio, estWorkDurationMs }))
+    for (auto * recvThread : mRecvThreads) {
+        if (!recvThread->startRealtimeThread({ rtprio, estWorkDurationMs }))
+        {
+            DBG("Recv thread failed to start realtime: trying regular");
+            recvThread->startThread(Thread::Priority::highest);
+        }
+    }
+
+    if (mLocalRecvThread && !mLocalRecvThread->startRealtimeThread({ rtprio, estWorkDurationMs }))
     {
-        DBG("Recv thread failed to start realtime: trying regular");
-        mRecvThread->startThread(Thread::Priority::highest);
+        DBG("Local recv thread failed to start realtime: trying regular");
+        mLocalRecvThread->startThread(Thread::Priority::highest);
     }
 #endif
 
@@ -1045,8 +1231,21 @@ void SonobusAudioProcessor::cleanupAoo()
 {
     disconnectFromServer();
     
-    DBG("waiting on recv thread to die");
-    mRecvThread->stopThread(400);
+    DBG("waiting on recv threads to die");
+    for (auto * recvThread : mRecvThreads) {
+        recvThread->signalThreadShouldExit();
+    }
+    for (auto * recvThread : mRecvThreads) {
+        recvThread->stopThread(400);
+    }
+    mRecvThreads.clear();
+
+    if (mLocalRecvThread) {
+        mLocalRecvThread->signalThreadShouldExit();
+        mLocalTransport->wakeUp();
+        mLocalRecvThread->stopThread(400);
+        mLocalRecvThread.reset();
+    }
     DBG("waiting on send thread to die");
     mSendThread->stopThread(400);
     DBG("waiting on event thread to die");
@@ -1064,6 +1263,10 @@ void SonobusAudioProcessor::cleanupAoo()
 
         mAooClient.reset();
 
+        mRecvShardSockets.clear();
+
+        mLocalTransport.reset();
+
         mUdpSocket.reset();
         
         mAooDummySource.reset();
@@ -1304,6 +1507,9 @@ void SonobusAudioProcessor::AudioCodecFormatInfo::computeName()
     if (codec == SonobusAudioProcessor::CodecOpus) {
         name = String::formatted("%d kbps/ch", bitrate/1000);
     }
+    else if (codec == SonobusAudioProcessor::CodecLossless) {
+        name = String::formatted("Lossless %d bit", bitdepth * 8);
+    }
     else {
         if (bitdepth == 2) {
             name = "PCM 16 bit";
@@ -1340,10 +1546,14 @@ void SonobusAudioProcessor::initFormats()
     mAudioFormats.add(AudioCodecFormatInfo(4));
     //mAudioFormats.add(AudioCodecFormatInfo(CodecPCM, 8)); // insanity!
 
+    // added last to keep the indices of saved formats
+    mAudioFormats.add(AudioCodecFormatInfo(CodecLossless, 2));
+    mAudioFormats.add(AudioCodecFormatInfo(CodecLossless, 3));
+
     mDefaultAudioFormatIndex = 4; // 96kpbs/ch Opus
 }
 
-int SonobusAudioProcessor::findFormatIndex(SonobusAudioProcessor::AudioCodecFormatCodec codec, int bitrate, int bitdepth)
+int SonobusAudioProcessor::findFormatIndex(SonobusAudioProcessor::AudioCodecFormatCodec codec, int bitrate, int bitdepth) const
 {
     for (int i=0; i < mAudioFormats.size(); ++i) {
         const auto & format = mAudioFormats.getReference(i);
@@ -1488,6 +1698,22 @@ int SonobusAudioProcessor::getRemotePeerOrderPriority(int index) const
     return remote->orderPriority;
 }
 
+uint32 SonobusAudioProcessor::getRemotePeerViewId(int index) const
+{
+    if (index >= mRemotePeers.size()) return 0;
+    const ScopedReadLock sl (mCoreLock);
+    auto remote = mRemotePeers.getUnchecked(index);
+    return remote->viewId;
+}
+
+uint32 SonobusAudioProcessor::fetchRemotePeerViewChanges(int index)
+{
+    if (index >= mRemotePeers.size()) return PeerViewChangeNone;
+    const ScopedReadLock sl (mCoreLock);
+    auto remote = mRemotePeers.getUnchecked(index);
+    return remote->viewChanges.exchange(PeerViewChangeNone);
+}
+
 void SonobusAudioProcessor::setRemotePeerOrderPriority(int index, int priority)
 {
     if (index >= mRemotePeers.size()) return;
@@ -1504,6 +1730,11 @@ int SonobusAudioProcessor::getRemotePeerSendPacketsize(int index) const
     if (index >= mRemotePeers.size()) return -1;
     const ScopedReadLock sl (mCoreLock);        
     auto remote = mRemotePeers.getUnchecked(index);
+
+    int32_t cursize = 0;
+    if (remote->autoPacketsize && remote->oursource && remote->oursource->get_current_packetsize(cursize) && cursize > 0) {
+        return cursize;
+    }
     return remote->packetsize;
 }
 
@@ -1517,6 +1748,8 @@ void SonobusAudioProcessor::setRemotePeerSendPacketsize(int index, int psize)
     
     auto remote = mRemotePeers.getUnchecked(index);
     remote->packetsize = psize;
+    // an explicit size turns off discovery for this peer
+    remote->autoPacketsize = false;
     
     if (remote->oursource) {
         //setupSourceFormat(remote, remote->oursource.get());
@@ -1524,10 +1757,33 @@ void SonobusAudioProcessor::setRemotePeerSendPacketsize(int index, int psize)
         //remote->oursource->setup(getSampleRate(), remote->packetsize, getTotalNumInputChannels());
 
         remote->oursource->set_packetsize(remote->packetsize);
+        remote->oursource->set_mtu_discovery(0);
     }
     
 }
 
+bool SonobusAudioProcessor::getRemotePeerAutoPacketsize(int index) const
+{
+    if (index >= mRemotePeers.size()) return false;
+    const ScopedReadLock sl (mCoreLock);
+    auto remote = mRemotePeers.getUnchecked(index);
+    return remote->autoPacketsize;
+}
+
+void SonobusAudioProcessor::setRemotePeerAutoPacketsize(int index, bool flag)
+{
+    if (index >= mRemotePeers.size()) return;
+
+    const ScopedReadLock sl (mCoreLock);
+
+    auto remote = mRemotePeers.getUnchecked(index);
+    remote->autoPacketsize = flag;
+
+    if (remote->oursource) {
+        remote->oursource->set_mtu_discovery(flag ? 1 : 0);
+    }
+}
+
 void SonobusAudioProcessor::setRemotePeerCompressorParams(int index, int changroup, CompressorParams & params)
 {
     if (index >= mRemotePeers.size()) return;
@@ -1545,7 +1801,8 @@ void SonobusAudioProcessor::setRemotePeerCompressorParams(int index, int changro
 
     if (changroup >= 0 && changroup < MAX_CHANGROUPS) {
         remote->chanGroups[changroup].params.compressorParams = params;
-        remote->chanGroups[changroup].compressorParamsChanged = true;
+        remote->chanGroups[changroup].commitCompressorParams();
+        remote->chanGroups[changroup].reserveEffects();
     }
 }
 
@@ -1575,7 +1832,8 @@ void SonobusAudioProcessor::setRemotePeerExpanderParams(int index, int changroup
 
     if (changroup >= 0 && changroup < MAX_CHANGROUPS) {
         remote->chanGroups[changroup].params.expanderParams = params;
-        remote->chanGroups[changroup].expanderParamsChanged = true;
+        remote->chanGroups[changroup].commitExpanderParams();
+        remote->chanGroups[changroup].reserveEffects();
     }
 }
 
@@ -1601,7 +1859,8 @@ void SonobusAudioProcessor::setRemotePeerEqParams(int index, int changroup, Sono
 
     if (changroup >= 0 && changroup < MAX_CHANGROUPS) {
         remote->chanGroups[changroup].params.eqParams = params;
-        remote->chanGroups[changroup].eqParamsChanged = true;
+        remote->chanGroups[changroup].commitEqParams();
+        remote->chanGroups[changroup].reserveEffects();
     }
 }
 
@@ -1772,7 +2031,8 @@ void SonobusAudioProcessor::setInputCompressorParams(int changroup, CompressorPa
 
     if (changroup >= 0 && changroup < MAX_CHANGROUPS) {
         mInputChannelGroups[changroup].params.compressorParams = params;
-        mInputChannelGroups[changroup].compressorParamsChanged = true;
+        mInputChannelGroups[changroup].commitCompressorParams();
+        mInputChannelGroups[changroup].reserveEffects();
     }
 }
 
@@ -1792,7 +2052,8 @@ void SonobusAudioProcessor::setInputLimiterParams(int changroup, CompressorParam
 
     if (changroup >= 0 && changroup < MAX_CHANGROUPS) {
         mInputChannelGroups[changroup].params.limiterParams = params;
-        mInputChannelGroups[changroup].limiterParamsChanged = true;
+        mInputChannelGroups[changroup].commitLimiterParams();
+        mInputChannelGroups[changroup].reserveEffects();
     }
 }
 
@@ -1832,7 +2093,8 @@ void SonobusAudioProcessor::setInputExpanderParams(int changroup, CompressorPara
 
     if (changroup >= 0 && changroup < MAX_CHANGROUPS) {
         mInputChannelGroups[changroup].params.expanderParams = params;
-        mInputChannelGroups[changroup].expanderParamsChanged = true;
+        mInputChannelGroups[changroup].commitExpanderParams();
+        mInputChannelGroups[changroup].reserveEffects();
     }
 }
 
@@ -1849,7 +2111,8 @@ void SonobusAudioProcessor::setInputEqParams(int changroup, ParametricEqParams &
 {
     if (changroup >= 0 && changroup < MAX_CHANGROUPS) {
         mInputChannelGroups[changroup].params.eqParams = params;
-        mInputChannelGroups[changroup].eqParamsChanged = true;
+        mInputChannelGroups[changroup].commitEqParams();
+        mInputChannelGroups[changroup].reserveEffects();
     }
 }
 
@@ -2220,6 +2483,9 @@ SonobusAudioProcessor::EndpointState * SonobusAudioProcessor::findOrAddEndpoint(
         endpoint = mEndpoints.add(new EndpointState(host, port));
         endpoint->owner = mUdpSocket.get();
         endpoint->peer = std::make_unique<DatagramSocket::RemoteAddrInfo>(host, port);
+        if (mLocalTransport && mLocalTransport->isLocalAddress(host)) {
+            endpoint->localTransport = mLocalTransport.get();
+        }
         DBG("Added new endpoint for " << host << ":" << port);
     }
     return endpoint;
@@ -2228,54 +2494,100 @@ SonobusAudioProcessor::EndpointState * SonobusAudioProcessor::findOrAddEndpoint(
 void SonobusAudioProcessor::updateSafetyMuting(RemotePeer * peer)
 {
     // assumed corelock already held
-    //const float droprate =  (peer->dataPacketsDropped) / ((nowtime - peer->resetDroptime)*1e-3);
-    const float droprate = peer->fastDropRate.xbar;
-    const float safetyunmutethreshrate = 2.0f;
-    const float safetyunmutethreshmintime = 0.5f;
-    const float safetyunmutethreshtime = 0.75f;
-    const float jitterbufthresh = 15.0f;
+    NetBufferPolicy::updateSafetyMuting(*peer, Time::getMillisecondCounterHiRes());
+}
 
-    double nowtime = Time::getMillisecondCounterHiRes();
-    double timesincereset = (nowtime - peer->resetDroptime) * 1e-3;
-    double deltadroptime = peer->lastDroptime > 0 ? (nowtime - peer->lastDroptime) * 1e-3 : timesincereset;
+NetBufferPolicy::Settings SonobusAudioProcessor::getNetBufferSettings(const RemotePeer * peer) const
+{
+    NetBufferPolicy::Settings settings;
+    settings.mode = (NetBufferPolicy::Mode) peer->autosizeBufferMode;
+    settings.dropRateThreshold = mAutoresizeDropRateThresh;
+    settings.blockMs = 1000.0f * currSamplesPerBlock / getSampleRate();
+    return settings;
+}
 
+void SonobusAudioProcessor::applyAutoBufferTime(RemotePeer * peer)
+{
+    peer->totalEstLatency = peer->smoothPingTime.xbar + 2*peer->buffertimeMs + (1e3*currSamplesPerBlock/getSampleRate());
+    peer->oursink->set_buffersize(peer->buffertimeMs);
+    peer->echosink->set_buffersize(peer->buffertimeMs);
+    peer->latencysink->set_buffersize(peer->buffertimeMs);
+    peer->latencyDirty = true;
+    peer->fillRatioSlow.reset();
+    peer->fillRatio.reset();
 
-    if ((timesincereset > safetyunmutethreshmintime)
-        && ((droprate > 0.0f && droprate < safetyunmutethreshrate)
-            || (droprate == 0.0f && deltadroptime > safetyunmutethreshtime)
-            || (peer->buffertimeMs > jitterbufthresh))) {
-        DBG("Droprate: " << droprate << "  deltatime: " << deltadroptime << " buftimems: " << peer->buffertimeMs);
-        DBG("Unmuting after reset drop");
-        peer->resetSafetyMuted = false;
+    if (peer->hasRealLatency) {
+        peer->totalEstLatency = peer->totalLatency + (peer->buffertimeMs - peer->bufferTimeAtRealLatency);
     }
 
-    peer->fastDropRate.Z *= 0.965;
-
-    float realdroprate =  (peer->dataPacketsDropped - peer->lastDropCount) / deltadroptime;
-    peer->fastDropRate.push(realdroprate);
-
+    sendRemotePeerInfoUpdate(-1, peer); // send to this peer
 }
 
-void SonobusAudioProcessor::doReceiveData()
+void SonobusAudioProcessor::doReceiveData(DatagramSocket & socket)
 {
     // receive from udp port, and parse packet
     char buf[AOO_MAXPACKETSIZE];
     String senderIP;
     int senderPort;
     
-    int nbytes = mUdpSocket->read(buf, AOO_MAXPACKETSIZE, false, senderIP, senderPort);
+    int nbytes = socket.read(buf, AOO_MAXPACKETSIZE, false, senderIP, senderPort);
 
     if (nbytes == 0) return;
     else if (nbytes < 0) {
         DBG("Error receiving UDP");
         return;
     }
+
+    SONO_TRACE_SCOPE("doReceiveData");
     
     // find endpoint from sender info
     EndpointState * endpoint = findOrAddEndpoint(senderIP, senderPort);
     
     endpoint->recvBytes += nbytes + UDP_OVERHEAD_BYTES;
     
+    handleReceivedData(endpoint, buf, nbytes);
+}
+
+void SonobusAudioProcessor::doReceiveLocalData()
+{
+    char buf[AOO_MAXPACKETSIZE];
+    int senderPort = 0;
+
+    int nbytes = mLocalTransport->receive(buf, AOO_MAXPACKETSIZE, senderPort, 20);
+    if (nbytes <= 0) return;
+
+    SONO_TRACE_SCOPE("doReceiveLocalData");
+
+    // the sender may be known by any of our addresses, use that endpoint so it matches the peer
+    EndpointState * endpoint = nullptr;
+    {
+        const ScopedLock sl (mEndpointsLock);
+        for (auto ep : mEndpoints) {
+            if (ep->port == senderPort && ep->localTransport) {
+                endpoint = ep;
+                break;
+            }
+        }
+    }
+
+    if (!endpoint) {
+        endpoint = findOrAddEndpoint("127.0.0.1", senderPort);
+    }
+
+    endpoint->recvBytes += nbytes;
+
+    handleReceivedData(endpoint, buf, nbytes);
+}
+
+void SonobusAudioProcessor::handleReceivedData(EndpointState * endpoint, char * buf, int nbytes)
+{
+    if (mPacketCaptureActive.load(std::memory_order_relaxed)) {
+        const SpinLock::ScopedLockType sl (mPacketCaptureLock);
+        if (mPacketCapture) {
+            mPacketCapture->capture(endpoint, endpoint->ipaddr, endpoint->port, buf, nbytes);
+        }
+    }
+
     // parse packet for AOO events
     
     int32_t type, id, dummyid;
@@ -2291,6 +2603,8 @@ void SonobusAudioProcessor::doReceiveData()
                 for (auto & remote : mRemotePeers) {
                     if (!remote->oursink) continue;
                     
+                    const ScopedLock rl (remote->recvLock);
+
                     if (id == AOO_ID_NONE) {
                         // this is a compact data message, try them all
                         if (remote->oursink->handle_message(buf, nbytes, endpoint, endpoint_send)) {
@@ -2315,7 +2629,7 @@ void SonobusAudioProcessor::doReceiveData()
                                 updateSafetyMuting(remote);
                             }
                         }
-                        
+
                         if (id != AOO_ID_WILDCARD) break;
                     }
                     
@@ -2337,11 +2651,14 @@ void SonobusAudioProcessor::doReceiveData()
                 
                 if (mAooDummySource->get_id(dummyid) && id == dummyid) {
                     // this is the special one that can accept blind invites
+                    const ScopedLock rsl (mRecvSharedLock);
                     mAooDummySource->handle_message(buf, nbytes, endpoint, endpoint_send);
                 }
                 else {
                     for (auto & remote : mRemotePeers) {
                         if (!remote->oursource) continue;
+                        const ScopedLock rl (remote->recvLock);
+
                         if (id == AOO_ID_WILDCARD || (remote->oursource->get_id(dummyid) && id == dummyid)) {
                             remote->oursource->handle_message(buf, nbytes, endpoint, endpoint_send);
                             if (id != AOO_ID_WILDCARD) break;
@@ -2365,6 +2682,8 @@ void SonobusAudioProcessor::doReceiveData()
                 //DBG("Got AOO_CLIENT or PEER data");
 
                 if (mAooClient) {
+                    // server and peer messages can come in on any recv thread
+                    const ScopedLock rsl (mRecvSharedLock);
                     mAooClient->handle_message(buf, nbytes, endpoint->getRawAddr());
                 }
                 
@@ -2395,13 +2714,15 @@ void SonobusAudioProcessor::doReceiveData()
         // notify send thread
         notifySendThread();
 
-    }
-    else if (handleOtherMessage(endpoint, buf, nbytes)) {
-
     }
     else {
-        // not a valid AoO OSC message
-        DBG("SonoBus: not a valid AOO message!");
+        // our own messages touch shared state, one recv thread at a time
+        const ScopedLock rsl (mRecvSharedLock);
+
+        if (!handleOtherMessage(endpoint, buf, nbytes)) {
+            // not a valid AoO OSC message
+            DBG("SonoBus: not a valid AOO message!");
+        }
     }
         
 }
@@ -3133,6 +3454,8 @@ int32_t SonobusAudioProcessor::sendPeerMessage(RemotePeer * peer, const char *ms
 
 void SonobusAudioProcessor::doSendData()
 {
+    SONO_TRACE_SCOPE("doSendData");
+
     // just try to send for everybody
     const ScopedReadLock sl (mCoreLock);        
 
@@ -3243,6 +3566,7 @@ static int32_t gHandleClientEvents(void * user, const aoo_event ** events, int32
 
 void SonobusAudioProcessor::handleEvents()
 {
+    SONO_TRACE_SCOPE("handleEvents");
     const ScopedReadLock sl (mCoreLock);        
     int32_t dummy = 0;
     
@@ -3300,6 +3624,26 @@ void SonobusAudioProcessor::handleEvents()
         
     }
 
+    // joins and leaves show up right away, everything else once per interval
+    auto nowms = Time::getMillisecondCounterHiRes();
+    if (nowms - mLastPeerStatsPublishMs >= PEER_STATS_INTERVAL_MS || mRemotePeers.size() != mLastPeerStatsCount) {
+        publishPeerStats();
+        mLastPeerStatsPublishMs = nowms;
+    }
+}
+
+void SonobusAudioProcessor::publishPeerStats()
+{
+    // called with mCoreLock read-locked, from the event thread only
+    PeerStats stats[MAX_PEERS];
+    int count = jmin(mRemotePeers.size(), MAX_PEERS);
+
+    for (int i=0; i < count; ++i) {
+        fillRemotePeerStats(i, stats[i]);
+    }
+
+    mPeerStatsTable.publish(stats, count);
+    mLastPeerStatsCount = mRemotePeers.size();
 }
 
 void SonobusAudioProcessor::sendPingEvent(RemotePeer * peer)
@@ -3574,7 +3918,7 @@ int32_t SonobusAudioProcessor::handleSourceEvents(const aoo_event ** events, int
                     peer->latencysource->set_format(fmt.header);
                     peer->echosource->set_format(fmt.header);
 
-                    AudioCodecFormatCodec codec = String(fmt.header.codec) == AOO_CODEC_OPUS ? CodecOpus : CodecPCM;
+                    AudioCodecFormatCodec codec = String(fmt.header.codec) == AOO_CODEC_OPUS ? CodecOpus : String(fmt.header.codec) == AOO_CODEC_LOSSLESS ? CodecLossless : CodecPCM;
                     if (codec == CodecOpus) {
                         aoo_format_opus *ofmt = (aoo_format_opus *)&fmt;
                         int retindex = findFormatIndex(codec, ofmt->bitrate / ofmt->header.nchannels, 0);
@@ -3590,6 +3934,13 @@ int32_t SonobusAudioProcessor::handleSourceEvents(const aoo_event ** events, int
                             peer->formatIndex = retindex; // new sending format index
                         }                        
                     }
+                    else if (codec == CodecLossless) {
+                        aoo_format_lossless *lfmt = (aoo_format_lossless *)&fmt;
+                        int retindex = findFormatIndex(codec, 0, lfmt->bitdepth == AOO_LOSSLESS_INT24 ? 3 : 2);
+                        if (retindex >= 0) {
+                            peer->formatIndex = retindex; // new sending format index
+                        }
+                    }
                 }
                 
 
@@ -3663,7 +4014,7 @@ int32_t SonobusAudioProcessor::handleSinkEvents(const aoo_event ** events, int32
                 aoo_format_storage f;
                 if (peer->oursink->get_source_format(e->endpoint, e->id, f) > 0) {
                     DBG("Got source format event from " << es->ipaddr << ":" << es->port << "  " <<  e->id  << "  channels: " << f.header.nchannels);
-                    peer->recvMeterSource.resize(f.header.nchannels, meterRmsWindow);
+                    peer->recvMeterSource.resize(f.header.nchannels, meterRmsWindow, meterDecimation);
 
                     // check for layout
                     bool gotuserformat = false;
@@ -3697,7 +4048,8 @@ int32_t SonobusAudioProcessor::handleSinkEvents(const aoo_event ** events, int32
 
                             peer->oursink->setup(getSampleRate(), currSamplesPerBlock, sinkchan);
                         }
-                        peer->recvMeterSource.resize (peer->recvChannels, meterRmsWindow);
+                        peer->recvMeterSource.resize (peer->recvChannels, meterRmsWindow, meterDecimation);
+                        peer->viewChanges |= PeerViewChangeLayout;
 
                         // for now if > 2, all on own changroup (by default)
 
@@ -3745,11 +4097,14 @@ int32_t SonobusAudioProcessor::handleSinkEvents(const aoo_event ** events, int32
 
 
                     
-                    AudioCodecFormatCodec codec = String(f.header.codec) == AOO_CODEC_OPUS ? CodecOpus : CodecPCM;
+                    AudioCodecFormatCodec codec = String(f.header.codec) == AOO_CODEC_OPUS ? CodecOpus : String(f.header.codec) == AOO_CODEC_LOSSLESS ? CodecLossless : CodecPCM;
                     if (codec == CodecOpus) {
                         aoo_format_opus *fmt = (aoo_format_opus *)&f;
                         peer->recvFormat = AudioCodecFormatInfo(fmt->bitrate/fmt->header.nchannels, fmt->complexity, fmt->signal_type);
                         //peer->recvFormatIndex = findFormatIndex(codec, fmt->bitrate / fmt->header.nchannels, 0);
+                    } else if (codec == CodecLossless) {
+                        aoo_format_lossless *fmt = (aoo_format_lossless *)&f;
+                        peer->recvFormat = AudioCodecFormatInfo(CodecLossless, fmt->bitdepth == AOO_LOSSLESS_INT24 ? 3 : 2);
                     } else {
                         aoo_format_pcm *fmt = (aoo_format_pcm *)&f;
                         int bitdepth = fmt->bitdepth == AOO_PCM_INT16 ? 2 : fmt->bitdepth == AOO_PCM_INT24  ? 3  : fmt->bitdepth == AOO_PCM_FLOAT32 ? 4 : fmt->bitdepth == AOO_PCM_FLOAT64  ? 8 : 2;
@@ -3801,72 +4156,8 @@ int32_t SonobusAudioProcessor::handleSinkEvents(const aoo_event ** events, int32
             const ScopedReadLock sl (mCoreLock);                    
             RemotePeer * peer = findRemotePeer(es, sinkId);
             if (peer) {
-                peer->dataPacketsDropped += e->count;
-                
-                if (peer->autosizeBufferMode != AutoNetBufferModeOff) {
-                    // see if our drop rate exceeds threshold, and increase buffersize if so
-                    double nowtime = Time::getMillisecondCounterHiRes();
-                    const float dropratethresh = peer->autosizeBufferMode == AutoNetBufferModeInitAuto ? 1.0f : mAutoresizeDropRateThresh;
-                    const float adjustlimit = 0.5f; // don't adjust more often than once every 0.5 seconds
-
-                    bool autoinitdone = peer->autosizeBufferMode == AutoNetBufferModeInitAuto && peer->autoNetbufInitCompleted;
-                    
-                    if (peer->lastDroptime > 0 && !autoinitdone) {
-                        double deltatime = (nowtime - peer->lastDroptime) * 1e-3;  
-                        if (deltatime > adjustlimit) {
-                            //float droprate =  (peer->dataPacketsDropped - peer->lastDropCount) / deltatime;
-                            float droprate =  1.0f / deltatime; // treat any drops as one instance
-                            if (droprate > dropratethresh) {
-                                float adjms = 1000.0f * currSamplesPerBlock / getSampleRate();
-                                peer->buffertimeMs += adjms;
-                                peer->totalEstLatency = peer->smoothPingTime.xbar + 2*peer->buffertimeMs + (1e3*currSamplesPerBlock/getSampleRate());
-                                peer->oursink->set_buffersize(peer->buffertimeMs);
-                                peer->echosink->set_buffersize(peer->buffertimeMs);
-                                peer->latencysink->set_buffersize(peer->buffertimeMs);
-                                peer->latencyDirty = true;
-                                peer->fillRatioSlow.reset();
-                                peer->fillRatio.reset();
-
-                                DBG("AUTO-Increasing buffer time by " << adjms << " ms to " << (int)peer->buffertimeMs << " droprate: " << droprate);
-
-                                if (peer->hasRealLatency) {
-                                    peer->totalEstLatency = peer->totalLatency + (peer->buffertimeMs - peer->bufferTimeAtRealLatency);
-                                }
-
-                                if (peer->autosizeBufferMode == AutoNetBufferModeAutoFull) {
-
-                                    const float timesincedecrthresh = 2.0;
-                                    if (peer->lastNetBufDecrTime > 0 && (nowtime - peer->lastNetBufDecrTime)*1e-3 < timesincedecrthresh ) {
-                                        peer->netBufAutoBaseline = peer->buffertimeMs;
-                                        DBG("Got drop within short time thresh, setting minimum baseline for future decr to " << peer->netBufAutoBaseline);
-                                    }
-                                }
-
-                                sendRemotePeerInfoUpdate(-1, peer); // send to this peer
-
-                            }
-
-                            float realdroprate =  (peer->dataPacketsDropped - peer->lastDropCount) / deltatime;
-                            peer->fastDropRate.push(realdroprate);
-
-                            peer->lastDroptime = nowtime;
-                            peer->lastDropCount = peer->dataPacketsDropped;
-                        }
-                    }
-                    else {
-                        if (peer->lastDroptime > 0) {
-                            double deltatime = (nowtime - peer->lastDroptime) * 1e-3;
-                            float droprate =  (peer->dataPacketsDropped - peer->lastDropCount) / deltatime;
-                            peer->fastDropRate.push(droprate);
-                        }
-
-                        peer->lastDroptime = nowtime;
-                        peer->lastDropCount = peer->dataPacketsDropped;
-                    }
-                    
-
-                    
-                    //peer->lastNetBufDecrTime = 0; // reset auto-decr
+                if (NetBufferPolicy::blocksLost(*peer, e->count, Time::getMillisecondCounterHiRes(), getNetBufferSettings(peer))) {
+                    applyAutoBufferTime(peer);
                 }
             }
             
@@ -3920,83 +4211,8 @@ int32_t SonobusAudioProcessor::handleSinkEvents(const aoo_event ** events, int32
             if (peer) {
                 const ScopedReadLock sl (mCoreLock);
 
-                double nowtime = Time::getMillisecondCounterHiRes();
-
-                double deltadroptime = peer->lastDroptime > 0 ? (nowtime - peer->lastDroptime) * 1e-3 : (nowtime - peer->resetDroptime) * 1e-3;
-
-                if (peer->autosizeBufferMode != AutoNetBufferModeOff) {
-                    if (!peer->autoNetbufInitCompleted) {
-                        const float nodropsthresh = 7.0;
-
-                        if (deltadroptime > nodropsthresh) {
-                            peer->autoNetbufInitCompleted = true;
-                            peer->resetSafetyMuted = false;
-                            DBG("Netbuf Initial auto time is done after no drops in " << nodropsthresh);
-
-                            // clear drop count
-                            peer->dataPacketsResent = 0;
-                            peer->dataPacketsDropped = 0;
-                            peer->lastDropCount = 0;
-                            peer->resetDroptime = nowtime;
-                            peer->fastDropRate.resetInitVal(0.0f);
-                            //peer->lastDroptime = 0;
-                        }
-
-                    }
-
-                }
-                else {
-                    // manual mode
-                    peer->resetSafetyMuted = false;
-                }
-
-
-                if (peer->autosizeBufferMode == AutoNetBufferModeAutoFull) {
-                    // possibly adjust net buffer down, if it has been longer than threshold since last drop
-                    double nowtime = Time::getMillisecondCounterHiRes();
-                    const float nodropsthresh = 10.0; // no drops in 10 seconds
-                    const float adjustlimit = 10; // don't adjust more often than once every 10 seconds
-
-                    if (peer->lastNetBufDecrTime > 0 && peer->buffertimeMs > peer->netBufAutoBaseline && !peer->latencyMatched) {
-                        double deltatime = (nowtime - peer->lastNetBufDecrTime) * 1e-3;
-                        double deltadroptime = (nowtime - peer->lastDroptime) * 1e-3;
-                        if (deltatime > adjustlimit) {
-                            //float droprate =  (peer->dataPacketsDropped - peer->lastDropCount) / deltatime;
-                            //if (droprate < dropratethresh) {
-                            if (deltadroptime > nodropsthresh) {
-                                float adjms = 1000.0f * currSamplesPerBlock / getSampleRate();
-                                peer->buffertimeMs -= adjms;
-
-                                peer->buffertimeMs = std::max(peer->buffertimeMs, peer->netBufAutoBaseline);
-
-                                peer->totalEstLatency = peer->smoothPingTime.xbar + 2*peer->buffertimeMs + (1e3*currSamplesPerBlock/getSampleRate());
-                                peer->oursink->set_buffersize(peer->buffertimeMs);
-                                peer->echosink->set_buffersize(peer->buffertimeMs);
-                                peer->latencysink->set_buffersize(peer->buffertimeMs);
-                                peer->latencyDirty = true;
-
-                                peer->fillRatioSlow.reset();
-                                peer->fillRatio.reset();
-
-                                if (peer->hasRealLatency) {
-                                    peer->totalEstLatency = peer->totalLatency + (peer->buffertimeMs - peer->bufferTimeAtRealLatency);
-                                }
-
-                                DBG("AUTO-Decreasing buffer time by " << adjms << " ms to " << (int) peer->buffertimeMs);
-
-                                peer->lastNetBufDecrTime = nowtime;
-
-                                sendRemotePeerInfoUpdate(-1, peer); // send to this peer
-
-                            }
-
-                            //peer->lastNetBufDropCount = peer->dataPacketsDropped;
-                        }
-                    }
-                    else {
-                        peer->lastNetBufDecrTime = nowtime;
-                    }
-
+                if (NetBufferPolicy::pingReceived(*peer, Time::getMillisecondCounterHiRes(), getNetBufferSettings(peer))) {
+                    applyAutoBufferTime(peer);
                 }
             }
 
@@ -5068,6 +5284,33 @@ int SonobusAudioProcessor::getRemotePeerActualSendChannelCount(int index) const
 }
 
 
+void SonobusAudioProcessor::setAutoPacketsizeEnabled(bool flag)
+{
+    mAutoPacketsize = flag;
+
+    const ScopedReadLock sl (mCoreLock);
+    for (int i=0; i < mRemotePeers.size(); ++i) {
+        RemotePeer * remote = mRemotePeers.getUnchecked(i);
+        remote->autoPacketsize = flag;
+        if (remote->oursource) {
+            remote->oursource->set_mtu_discovery(flag ? 1 : 0);
+        }
+    }
+}
+
+void SonobusAudioProcessor::setAdaptiveSendBitrateMin(int bitrate)
+{
+    mAdaptiveSendBitrateMin = jmax(0, bitrate);
+
+    const ScopedReadLock sl (mCoreLock);
+    for (int i=0; i < mRemotePeers.size(); ++i) {
+        RemotePeer * remote = mRemotePeers.getUnchecked(i);
+        if (remote->oursource) {
+            remote->oursource->set_adaptive_bitrate(mAdaptiveSendBitrateMin);
+        }
+    }
+}
+
 void SonobusAudioProcessor::updateDynamicResampling()
 {
     const ScopedReadLock sl (mCoreLock);
@@ -5630,13 +5873,58 @@ bool SonobusAudioProcessor::getRemotePeerLatencyInfo(int index, LatencyInfo & re
     return false;          
 }
 
-bool SonobusAudioProcessor::isRemotePeerLatencyTestActive(int index)
+void SonobusAudioProcessor::fillRemotePeerStats(int index, PeerStats & retstats) const
 {
-    const ScopedReadLock sl (mCoreLock);        
-    if (index < mRemotePeers.size()) {
-        RemotePeer * remote = mRemotePeers.getUnchecked(index);
-        return remote->activeLatencyTest;
-    }
+    // mCoreLock must be held, index must be valid
+    RemotePeer * remote = mRemotePeers.getUnchecked(index);
+
+    retstats.viewId = remote->viewId;
+    retstats.fillRatio = remote->fillRatio.xbar;
+    retstats.fillRatioStdDev = remote->fillRatioSlow.s2xx;
+    retstats.bufferTimeMs = jmax((double)remote->buffertimeMs, 1000.0f * currSamplesPerBlock / getSampleRate());
+    retstats.packetsReceived = remote->dataPacketsReceived;
+    retstats.packetsSent = remote->dataPacketsSent;
+    retstats.bytesReceived = remote->endpoint ? (int64_t) remote->endpoint->recvBytes : 0;
+    retstats.bytesSent = remote->endpoint ? (int64_t) remote->endpoint->sentBytes : 0;
+    retstats.packetsDropped = remote->dataPacketsDropped;
+    retstats.packetsResent = remote->dataPacketsResent;
+
+    remote->userName.copyToUTF8(retstats.userName, sizeof(retstats.userName));
+    const int sendFormatIndex = getSendFormatIndex(remote);
+    if (sendFormatIndex < mAudioFormats.size()) {
+        mAudioFormats.getReference(sendFormatIndex).name.copyToUTF8(retstats.sendCodec, sizeof(retstats.sendCodec));
+    }
+    remote->recvFormat.name.copyToUTF8(retstats.recvCodec, sizeof(retstats.recvCodec));
+
+    getRemotePeerLatencyInfo(index, retstats.latency);
+}
+
+bool SonobusAudioProcessor::getRemotePeerStats(int index, PeerStats & retstats) const
+{
+    const ScopedReadLock sl (mCoreLock);
+    if (index < mRemotePeers.size()) {
+        fillRemotePeerStats(index, retstats);
+        return true;
+    }
+    return false;
+}
+
+uint32 SonobusAudioProcessor::getAllRemotePeerStats(Array<PeerStats> & retstats) const
+{
+    uint32 version = 0;
+    retstats.resize(MAX_PEERS);
+    int count = mPeerStatsTable.read(retstats.getRawDataPointer(), version);
+    retstats.resize(count);
+    return version;
+}
+
+bool SonobusAudioProcessor::isRemotePeerLatencyTestActive(int index)
+{
+    const ScopedReadLock sl (mCoreLock);        
+    if (index < mRemotePeers.size()) {
+        RemotePeer * remote = mRemotePeers.getUnchecked(index);
+        return remote->activeLatencyTest;
+    }
     return false;      
 }
 
@@ -5894,6 +6182,7 @@ SonobusAudioProcessor::RemotePeer * SonobusAudioProcessor::doAddRemotePeerIfNece
         adjustRemoteSendMatrix(mRemotePeers.size(), false);
 
         retpeer = new RemotePeer(endpoint, newid);
+        retpeer->viewId = mNextPeerViewId++;
 
 
         retpeer->userName = username;
@@ -5925,7 +6214,7 @@ SonobusAudioProcessor::RemotePeer * SonobusAudioProcessor::doAddRemotePeerIfNece
         retpeer->oursink->setup(getSampleRate(), currSamplesPerBlock, getMainBusNumOutputChannels());
         retpeer->oursink->set_buffersize(retpeer->buffertimeMs);
 
-        int32_t flags = AOO_PROTOCOL_FLAG_COMPACT_DATA;
+        int32_t flags = AOO_PROTOCOL_FLAG_COMPACT_DATA | AOO_PROTOCOL_FLAG_SILENT_BLOCKS | AOO_PROTOCOL_FLAG_BINARY_DATA;
         retpeer->oursink->set_option(aoo_opt_protocol_flags, &flags, sizeof(int32_t));
 
         retpeer->nominalSendChannels = mSendChannels.get();
@@ -5967,6 +6256,11 @@ SonobusAudioProcessor::RemotePeer * SonobusAudioProcessor::doAddRemotePeerIfNece
         retpeer->echosource->set_ping_interval(2000);
 
         retpeer->oursource->set_respect_codec_change_requests(1);
+        retpeer->oursource->set_adaptive_bitrate(mAdaptiveSendBitrateMin);
+        retpeer->autoPacketsize = mAutoPacketsize;
+        retpeer->oursource->set_mtu_discovery(mAutoPacketsize ? 1 : 0);
+        // don't encode muted or silent input, sinks supporting it get empty blocks
+        retpeer->oursource->set_silence_threshold(Decibels::decibelsToGain(-90.0f));
         retpeer->latencysource->set_respect_codec_change_requests(1);
         retpeer->echosource->set_respect_codec_change_requests(1);
         
@@ -5981,8 +6275,8 @@ SonobusAudioProcessor::RemotePeer * SonobusAudioProcessor::doAddRemotePeerIfNece
 
         int outchannels = getMainBusNumOutputChannels();
         
-        retpeer->recvMeterSource.resize (outchannels, meterRmsWindow);
-        retpeer->sendMeterSource.resize (retpeer->sendChannels, meterRmsWindow);
+        retpeer->recvMeterSource.resize (outchannels, meterRmsWindow, meterDecimation);
+        retpeer->sendMeterSource.resize (retpeer->sendChannels, meterRmsWindow, meterDecimation);
 
         retpeer->sendAllow = !mMainSendMute.get();
         retpeer->sendAllowCache = true; // cache is allowed for new ones, so when it is unmuted it actually does
@@ -6239,17 +6533,38 @@ bool SonobusAudioProcessor::formatInfoToAooFormat(const AudioCodecFormatInfo & i
             
             return true;
         }
+        else if (info.codec == CodecLossless) {
+            aoo_format_lossless *fmt = (aoo_format_lossless *)&retformat;
+            fmt->header.codec = AOO_CODEC_LOSSLESS;
+            fmt->header.blocksize = currSamplesPerBlock >= info.min_preferred_blocksize ? currSamplesPerBlock : info.min_preferred_blocksize;
+            fmt->header.samplerate = getSampleRate();
+            fmt->header.nchannels = channels;
+            fmt->bitdepth = info.bitdepth == 3 ? AOO_LOSSLESS_INT24 : AOO_LOSSLESS_INT16;
+
+            return true;
+        }
     
     return false;
 }
     
     
-void SonobusAudioProcessor::setupSourceFormat(SonobusAudioProcessor::RemotePeer * peer, aoo::isource * source, bool latencymode)
+int SonobusAudioProcessor::getSendFormatIndex(const SonobusAudioProcessor::RemotePeer * peer, bool latencymode) const
 {
     // have choice and parameters
     int formatIndex = (!peer || peer->formatIndex < 0) ? mDefaultAudioFormatIndex : peer->formatIndex;
+
+    if (peer && peer->formatIndex < 0 && !latencymode && peer->endpoint && peer->endpoint->localTransport) {
+        // same host, no point in encoding anything, just pass the floats
+        formatIndex = findFormatIndex(CodecPCM, 0, 4);
+    }
+
     if (formatIndex < 0 || formatIndex >= mAudioFormats.size()) formatIndex = 4; //emergency default
-    const AudioCodecFormatInfo & info =  mAudioFormats.getReference(formatIndex);
+    return formatIndex;
+}
+
+void SonobusAudioProcessor::setupSourceFormat(SonobusAudioProcessor::RemotePeer * peer, aoo::isource * source, bool latencymode)
+{
+    const AudioCodecFormatInfo & info =  mAudioFormats.getReference(getSendFormatIndex(peer, latencymode));
     
     aoo_format_storage f;
     int channels = latencymode ? 1  :  peer ? peer->sendChannels : getMainBusNumInputChannels();
@@ -6391,6 +6706,8 @@ void SonobusAudioProcessor::restoreLayoutFormatForPeer(RemotePeer * remote, bool
     if (resetmulti) {
         remote->modifiedMultiChanGroups = false;
     }
+
+    remote->viewChanges |= PeerViewChangeLayout;
 }
 
 void SonobusAudioProcessor::applyLayoutFormatToPeer(RemotePeer * remote, const ValueTree & valtree)
@@ -6453,6 +6770,7 @@ void SonobusAudioProcessor::applyLayoutFormatToPeer(RemotePeer * remote, const V
             }
             remote->numChanGroups = remote->lastMultiNumChanGroups;
             remote->modifiedChanGroups = true;
+            remote->viewChanges |= PeerViewChangeLayout;
             doapply = false;
         }
     }
@@ -6920,6 +7238,7 @@ void SonobusAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBloc
     }
 
     meterRmsWindow = sampleRate * METER_RMS_SEC / currSamplesPerBlock;
+    meterDecimation = jmax(1, (int) (sampleRate * METER_UPDATE_SEC / currSamplesPerBlock));
 
     int totsendchans = 0;
     int fileplaychans = mCurrentAudioFileSource ? mCurrentAudioFileSource->getAudioFormatReader()->numChannels : 2;
@@ -6946,14 +7265,14 @@ void SonobusAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBloc
     int realsendchans = mSendChannels.get() <= 0 ? totsendchans : mSendChannels.get();
     mActiveSendChannels = totsendchans;
 
-    inputMeterSource.resize (inchannels, meterRmsWindow);
-    outputMeterSource.resize (outchannels, meterRmsWindow);
-    postinputMeterSource.resize (totsendchans, meterRmsWindow);
-    metMeterSource.resize (1, 2*meterRmsWindow);
-    filePlaybackMeterSource.resize (fileplaychans, meterRmsWindow);
+    inputMeterSource.resize (inchannels, meterRmsWindow, meterDecimation);
+    outputMeterSource.resize (outchannels, meterRmsWindow, meterDecimation);
+    postinputMeterSource.resize (totsendchans, meterRmsWindow, meterDecimation);
+    metMeterSource.resize (1, 2*meterRmsWindow, meterDecimation);
+    filePlaybackMeterSource.resize (fileplaychans, meterRmsWindow, meterDecimation);
 
     if (sendMeterSource.getNumChannels() < realsendchans) {
-        sendMeterSource.resize (realsendchans, meterRmsWindow);
+        sendMeterSource.resize (realsendchans, meterRmsWindow, meterDecimation);
     }
 
     setupSourceFormatsForAll();
@@ -7052,7 +7371,7 @@ void SonobusAudioProcessor::setupSourceFormatsForAll()
             //s->latencyMeasurer.reset(new LatencyMeasurer());
         }
 
-        s->recvMeterSource.resize (s->recvChannels, meterRmsWindow);
+        s->recvMeterSource.resize (s->recvChannels, meterRmsWindow, meterDecimation);
         //s->sendMeterSource.resize (s->sendChannels, meterRmsWindow);
 
         // XXX
@@ -7067,6 +7386,16 @@ void SonobusAudioProcessor::setupSourceFormatsForAll()
         ++i;
     }
 
+    // take the effects of the groups in use now, so the audio thread doesn't have to ask for them
+    for (int i=0; i < mInputChannelGroupCount && i < MAX_CHANGROUPS; ++i) {
+        mInputChannelGroups[i].reserveEffects();
+    }
+    for (auto s : mRemotePeers) {
+        for (int i=0; i < s->numChanGroups && i < MAX_CHANGROUPS; ++i) {
+            s->chanGroups[i].reserveEffects();
+        }
+    }
+
     updateRemotePeerUserFormat();
 
 }
@@ -7139,6 +7468,7 @@ void SonobusAudioProcessor::ensureBuffers(int numSamples)
     }
 
     meterRmsWindow = getSampleRate() * METER_RMS_SEC / currSamplesPerBlock;
+    meterDecimation = jmax(1, (int) (getSampleRate() * METER_UPDATE_SEC / currSamplesPerBlock));
 
     int soundboardplaychans = soundboardChannelProcessor->getFileSourceNumberOfChannels();
 
@@ -7161,11 +7491,11 @@ void SonobusAudioProcessor::ensureBuffers(int numSamples)
     mActiveInputChannels = selfrecchans;
 
     if (sendMeterSource.getNumChannels() < realsendchans) {
-        sendMeterSource.resize (realsendchans, meterRmsWindow);
+        sendMeterSource.resize (realsendchans, meterRmsWindow, meterDecimation);
     }
 
     if (filePlaybackMeterSource.getNumChannels() < fileplaychans) {
-        filePlaybackMeterSource.resize (fileplaychans, meterRmsWindow);
+        filePlaybackMeterSource.resize (fileplaychans, meterRmsWindow, meterDecimation);
     }
 
 
@@ -7205,12 +7535,7 @@ void SonobusAudioProcessor::ensureBuffers(int numSamples)
     if (metBuffer.getNumSamples() < numSamples || metBuffer.getNumChannels() != maxchans) {
         metBuffer.setSize(maxchans, numSamples, false, false, true);
     }
-    if (mainFxBuffer.getNumSamples() < numSamples || mainFxBuffer.getNumChannels() != maxchans) {
-        mainFxBuffer.setSize(maxchans, numSamples, false, false, true);
-    }
-    if (inputRevBuffer.getNumSamples() < numSamples || inputRevBuffer.getNumChannels() != maxchans) {
-        inputRevBuffer.setSize(maxchans, numSamples, false, false, true);
-    }
+    mSendBusGraph.prepare(numSamples, maxchans);
     if (silentBuffer.getNumSamples() < numSamples) {
         silentBuffer.setSize(1, numSamples, false, false, true);
         silentBuffer.clear();
@@ -7230,9 +7555,80 @@ void SonobusAudioProcessor::ensureBuffers(int numSamples)
 }
 
 
+void SonobusAudioProcessor::processMainReverbBus(AudioBuffer<float>& fxbuffer, int numSamples, bool enabled, bool wasEnabled)
+{
+    // assumes reverb is NO dry
+    auto mainBusOutputChannels = getMainBusNumOutputChannels();
+
+    if (enabled && !wasEnabled) {
+        mMainReverb->reset();
+        mMReverb.reset();
+        mZitaReverb.instanceClear();
+    }
+
+    if (mReverbParamsChanged) {
+        mMainReverb->setParameters(mMainReverbParams);
+        mReverbParamsChanged = false;
+    }
+
+    if (mLastReverbModel != mMainReverbModel.get()) {
+        mMReverb.reset();
+        mMainReverb->reset();
+        mZitaReverb.instanceClear();
+    }
+
+    if (mMainReverbModel.get() == ReverbModelMVerb) {
+        if (mainBusOutputChannels > 1) {
+            mMReverb.process((float **)fxbuffer.getArrayOfWritePointers(), (float **)fxbuffer.getArrayOfWritePointers(), numSamples);
+        }
+    }
+    else if (mMainReverbModel.get() == ReverbModelZita) {
+        if (mainBusOutputChannels > 1) {
+            mZitaReverb.compute(numSamples, (float **)fxbuffer.getArrayOfWritePointers(), (float **)fxbuffer.getArrayOfWritePointers());
+        }
+    }
+    else {
+        if (mainBusOutputChannels > 1) {
+            mMainReverb->processStereo(fxbuffer.getWritePointer(0), fxbuffer.getWritePointer(1), numSamples);
+        } else {
+            mMainReverb->processMono(fxbuffer.getWritePointer(0), numSamples);
+        }
+    }
+
+    mLastReverbModel = (ReverbModel) mMainReverbModel.get();
+
+    if (enabled && !wasEnabled) {
+        // fade in
+        fxbuffer.applyGainRamp(0, numSamples, 0.0f, 1.0f);
+    }
+}
+
+void SonobusAudioProcessor::processInputReverbBus(AudioBuffer<float>& revbuffer, int numSamples, bool enabled, bool wasEnabled)
+{
+    if (enabled && !wasEnabled) {
+        mInputReverb.reset();
+    }
+
+    mInputReverb.process((float **)revbuffer.getArrayOfWritePointers(), (float **)revbuffer.getArrayOfWritePointers(), numSamples);
+
+    if (enabled != wasEnabled) {
+        float sgain = enabled ? 0.0f : 1.0f;
+        float egain = enabled ? 1.0f : 0.0f;
+
+        revbuffer.applyGainRamp(0, numSamples, sgain, egain);
+    }
+}
+
 void SonobusAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
 {
+    const int64 blockStartTicks = Time::getHighResolutionTicks();
     ScopedNoDenormals noDenormals;
+
+    if (SonoAudio::TraceRecorder::isEnabled()) {
+        SonoAudio::TraceRecorder::nameCurrentThread("Audio");
+    }
+    SONO_TRACE_SCOPE("processBlock");
+    SONO_RT_AUDIT_SCOPE("processBlock");
     auto totalInputChannels  = getTotalNumInputChannels();
     auto mainBusInputChannels  = getMainBusNumInputChannels();
     auto mainBusOutputChannels = getMainBusNumOutputChannels();
@@ -7360,6 +7756,8 @@ void SonobusAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer
 
     uint64_t t = aoo_osctime_get();
 
+    SONO_TRACE_BEGIN("input");
+
     // meter input pre everything
     inputMeterSource.measureBlock (buffer, 0, numSamples);
 
@@ -7378,12 +7776,17 @@ void SonobusAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer
         }
     }
 
-    bool doinreverb = inReverbEnabled || mLastInputReverbEnabled;
-    int revfxchannels = 2;
+    bool mainReverbEnabled = mMainReverbEnabled.get();
+
+    mSendBusGraph.setBusEnabled(mInputReverbBus, inReverbEnabled);
+    mSendBusGraph.setBusEnabled(mMainReverbBus, mainReverbEnabled);
+    mSendBusGraph.beginBlock(numSamples);
 
-    if (doinreverb) {
-        inputRevBuffer.clear(0, numSamples);
-    }
+    auto & inputRevBuffer = mSendBusGraph.getBusBuffer(mInputReverbBus);
+    auto & mainFxBuffer = mSendBusGraph.getBusBuffer(mMainReverbBus);
+
+    bool doinreverb = mSendBusGraph.isBusActive(mInputReverbBus);
+    int revfxchannels = mSendBusGraph.getBusNumChannels(mInputReverbBus);
 
 
     // Input Gain and FX processing
@@ -7458,12 +7861,9 @@ void SonobusAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer
     }
 
     // MAIN EFFECTS BUS
-    bool mainReverbEnabled = mMainReverbEnabled.get();
-    bool doreverb = mainReverbEnabled || mLastMainReverbEnabled;
+    bool doreverb = mSendBusGraph.isBusActive(mMainReverbBus);
     bool hasmainfx = doreverb;
-    int fxchannels = 2;
-
-    mainFxBuffer.clear(0, numSamples);
+    int fxchannels = mSendBusGraph.getBusNumChannels(mMainReverbBus);
 
 
     // handle what's going to be monitored
@@ -7515,6 +7915,9 @@ void SonobusAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer
      */
 
     
+    SONO_TRACE_END("input");
+    SONO_TRACE_BEGIN("playback");
+
     // file playback goes to everyone
 
     bool hasfiledata = false;
@@ -7661,18 +8064,7 @@ void SonobusAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer
     // process and mix in input reverb into sendworkbuffer (if sending mono or stereo)
     if (doinreverb) {
 
-        if (inReverbEnabled != mLastInputReverbEnabled && inReverbEnabled) {
-            mInputReverb.reset();
-        }
-
-        mInputReverb.process((float **)inputRevBuffer.getArrayOfWritePointers(), (float **)inputRevBuffer.getArrayOfWritePointers(), numSamples);
-
-        if (inReverbEnabled != mLastInputReverbEnabled ) {
-            float sgain = inReverbEnabled ? 0.0f : 1.0f;
-            float egain = inReverbEnabled ? 1.0f : 0.0f;
-
-            inputRevBuffer.applyGainRamp(0, numSamples, sgain, egain);
-        }
+        mSendBusGraph.processBus(mInputReverbBus, numSamples);
 
         if (sendCh == 1 || sendCh == 2) {
             // mix it into send workbuffer
@@ -7682,8 +8074,6 @@ void SonobusAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer
         }
     }
 
-    mLastInputReverbEnabled = inReverbEnabled;
-
 
     // send meter post panning (and post file and met)
     sendMeterSource.measureBlock (sendWorkBuffer, 0, numSamples);
@@ -7694,8 +8084,11 @@ void SonobusAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer
     bool anysoloed = mMainMonitorSolo.get();
 
 
+    SONO_TRACE_END("playback");
+
     // push data for going out
     {
+        SONO_TRACE_SCOPE("peers");
         const ScopedReadLock sl (mCoreLock);        
         
         //mAooSource->process( buffer.getArrayOfReadPointers(), numSamples, t);
@@ -7752,28 +8145,28 @@ void SonobusAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer
 
                 remote->workBuffer.clear(0, numSamples);
 
-                remote->oursink->process((float **)remote->workBuffer.getArrayOfWritePointers(), numSamples, t);
+                {
+                    SONO_RT_AUDIT_SCOPE("aoo sink process");
+                    remote->oursink->process((float **)remote->workBuffer.getArrayOfWritePointers(), numSamples, t);
+                }
             }
 
             
             // record individual tracks pre-compressor/level/pan, ignoring muting/solo, raw material
 
-            if (userwritingpossible) {
-                const ScopedTryLock sl (writerLock);
-                if (sl.isLocked() && remote->fileWriter)
-                {
-                    float *tmpbuf[MAX_PANNERS];
-                    int numchan = remote->fileWriter->getWriter()->getNumChannels();
-                    for (int i = 0; i < numchan && i < MAX_PANNERS; ++i) {
-                        if (i < remote->recvChannels) {
-                            tmpbuf[i] = remote->workBuffer.getWritePointer(i);
-                        }
-                        else {
-                            tmpbuf[i] = silentBuffer.getWritePointer(0);
-                        }
+            const int remotetrack = userwritingpossible ? remote->recordTrack.load() : -1;
+            if (remotetrack >= 0) {
+                const float *tmpbuf[MAX_PANNERS];
+                int numchan = jmin(MAX_PANNERS, remote->recordTrackChannels);
+                for (int i = 0; i < numchan; ++i) {
+                    if (i < remote->recvChannels) {
+                        tmpbuf[i] = remote->workBuffer.getReadPointer(i);
+                    }
+                    else {
+                        tmpbuf[i] = silentBuffer.getReadPointer(0);
                     }
-                    remote->fileWriter->write (tmpbuf, numSamples);
                 }
+                writeToRecorder (remotetrack, tmpbuf, numchan, numSamples);
             }
 
             // write out per-user output bus
@@ -7922,7 +8315,10 @@ void SonobusAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer
                 }
                 
                 
-                remote->oursource->process((const float **)workBuffer.getArrayOfReadPointers(), numSamples, t);
+                {
+                    SONO_RT_AUDIT_SCOPE("aoo source process");
+                    remote->oursource->process((const float **)workBuffer.getArrayOfReadPointers(), numSamples, t);
+                }
                 
                 //remote->sendMeterSource.measureBlock (workBuffer);
                 
@@ -7982,6 +8378,7 @@ void SonobusAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer
 
 
     // BEGIN MAIN OUTPUT BUFFER WRITING
+    SONO_TRACE_BEGIN("output");
 
 
     bool inrevdirect = !(anysoloed && !mMainMonitorSolo.get()) && drynow == 0.0;
@@ -8001,54 +8398,6 @@ void SonobusAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer
         }
     }
 
-    // EFFECTS
-
-
-    // TODO other main FX
-    if (mainReverbEnabled != mLastMainReverbEnabled) {
-
-        float sgain = mainReverbEnabled ? 0.0f : 1.0f;
-        float egain = mainReverbEnabled ? 1.0f : 0.0f;
-        
-        if (mainReverbEnabled) {
-            mMainReverb->reset();
-            mMReverb.reset();
-            mZitaReverb.instanceClear();
-        }
-
-        /*
-        for (int channel = 0; channel < mainBusOutputChannels; ++channel) {
-            // others
-            mainFxBuffer.addFromWithRamp(channel, 0, tempBuffer.getReadPointer(channel), numSamples, sgain, egain);
-
-            // input
-            if (inrevdirect) {
-                mainFxBuffer.addFromWithRamp(channel, 0, inputBuffer.getReadPointer(channel), numSamples, sgain, egain);
-            } else {
-                mainFxBuffer.addFromWithRamp(channel, 0, buffer.getReadPointer(channel), numSamples, sgain, egain);                
-            }
-        }
-         */
-    }
-    else if (mainReverbEnabled){
-
-        /*
-        for (int channel = 0; channel < mainBusOutputChannels; ++channel) {
-            // others
-            mainFxBuffer.addFrom(channel, 0, tempBuffer, channel, 0, numSamples);
-
-            // input
-            if (inrevdirect) {
-                mainFxBuffer.addFrom(channel, 0, inputBuffer, channel, 0, numSamples);
-            } else {
-                mainFxBuffer.addFrom(channel, 0, buffer, channel, 0, numSamples);                
-            }
-        }
-         */
-
-    }
-    
-    
     // add from tempBuffer (audio from remote peers)
     for (int channel = 0; channel < totalOutputChannels; ++channel) {
 
@@ -8057,50 +8406,11 @@ void SonobusAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer
     
     
 
-    if (doreverb) {
-        // assumes reverb is NO dry
-        
-        if (mReverbParamsChanged) {
-            mMainReverb->setParameters(mMainReverbParams);
-            mReverbParamsChanged = false;
-        }
-        
-        if (mLastReverbModel != mMainReverbModel.get()) {
-            mMReverb.reset();
-            mMainReverb->reset();
-            mZitaReverb.instanceClear();
-        }
-        
-        if (mMainReverbModel.get() == ReverbModelMVerb) {
-            if (mainBusOutputChannels > 1) {            
-                mMReverb.process((float **)mainFxBuffer.getArrayOfWritePointers(), (float **)mainFxBuffer.getArrayOfWritePointers(), numSamples);
-            } 
-        }
-        else if (mMainReverbModel.get() == ReverbModelZita) {
-            if (mainBusOutputChannels > 1) {            
-                mZitaReverb.compute(numSamples, (float **)mainFxBuffer.getArrayOfWritePointers(), (float **)mainFxBuffer.getArrayOfWritePointers());
-            }
-        }
-        else {
-            if (mainBusOutputChannels > 1) {            
-                mMainReverb->processStereo(mainFxBuffer.getWritePointer(0), mainFxBuffer.getWritePointer(1), numSamples);
-            } else {
-                mMainReverb->processMono(mainFxBuffer.getWritePointer(0), numSamples);
-            }            
-        }
-    }
-
-    if (mLastHasMainFx != hasmainfx) {
-        float sgain = hasmainfx ? 0.0f : 1.0f;
-        float egain = hasmainfx ? 1.0f : 0.0f;
-
-        mainFxBuffer.applyGainRamp(0, numSamples, sgain, egain);
-    } 
+    // EFFECTS
+    // process any send buses not already done (main reverb)
+    mSendBusGraph.processAll(numSamples);
+    mSendBusGraph.endBlock();
 
-    mLastHasMainFx = hasmainfx;
-    mLastMainReverbEnabled = mainReverbEnabled;
-    mLastReverbModel = (ReverbModel) mMainReverbModel.get();
-    
     // add from main FX
     if (hasmainfx) {
         for (int channel = 0; channel < mainBusOutputChannels; ++channel) {
@@ -8168,124 +8478,122 @@ void SonobusAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer
     
     outputMeterSource.measureBlock (buffer, 0, numSamples);
 
+    SONO_TRACE_END("output");
+
     // output to file writer if necessary
     if (writingpossible) {
-        const ScopedTryLock sl (writerLock);
-        if (sl.isLocked())
-        {
-            if (activeMixWriter.load() != nullptr 
-                || activeMixMinusWriter.load() != nullptr
-                || activeSelfWriters[0].load() != nullptr
-                )
-            {
-                // write the raw (pre or post FX) input
-                if (activeSelfWriters[0].load() != nullptr) {
-                    const float * const* inbufs = mRecordInputPreFX ? inputPreBuffer.getArrayOfReadPointers() : inputPostBuffer.getArrayOfReadPointers();
-                    int chindex = 0;
-                    for (int i=0; i < mInputChannelGroupCount; ++i) {
-                        int chcnt = mInputChannelGroups[i].params.numChannels;
-                        if (activeSelfWriters[i].load() != nullptr) {
-                            // we need to make sure the writer has at least all the inputs it expects
-                            const float * useinbufs[MAX_PANNERS];
-                            for (int j=0; j < mSelfRecordChans[i] && j < MAX_PANNERS; ++j) {
-                                useinbufs[j] = j < chcnt ? inbufs[chindex+j] : silentBuffer.getReadPointer(0);
-                            }
-                            activeSelfWriters[i].load()->write (useinbufs, numSamples);
-                        }
-                        chindex += chcnt;
+        SONO_TRACE_SCOPE("recording");
+        const int mixtrack = mMixRecordTrack.load();
+        const int mixminustrack = mMixMinusRecordTrack.load();
+
+        // write the raw (pre or post FX) input
+        if (mSelfRecordTracks[0].load() >= 0) {
+            const float * const* inbufs = mRecordInputPreFX ? inputPreBuffer.getArrayOfReadPointers() : inputPostBuffer.getArrayOfReadPointers();
+            int chindex = 0;
+            for (int i=0; i < mInputChannelGroupCount; ++i) {
+                int chcnt = mInputChannelGroups[i].params.numChannels;
+                const int selftrack = i < MAX_CHANGROUPS ? mSelfRecordTracks[i].load() : -1;
+                if (selftrack >= 0) {
+                    // we need to make sure the writer has at least all the inputs it expects
+                    const float * useinbufs[MAX_PANNERS];
+                    int usechans = jmin(mSelfRecordChans[i], MAX_PANNERS);
+                    for (int j=0; j < usechans; ++j) {
+                        useinbufs[j] = j < chcnt ? inbufs[chindex+j] : silentBuffer.getReadPointer(0);
                     }
+                    writeToRecorder (selftrack, useinbufs, usechans, numSamples);
                 }
+                chindex += chcnt;
+            }
+        }
 
-                // we need to mix the input, audio from remote peers, and the file playback together here
-                workBuffer.clear(0, numSamples);
-
+        // we need to mix the input, audio from remote peers, and the file playback together here
+        workBuffer.clear(0, numSamples);
 
-                bool rampit =  (fabsf(wetnow - mLastWet) > 0.00001);
-                
-                for (int channel = 0; channel < totalRecordingChannels; ++channel) {
-                    
-                    // apply Main out gain to audio from remote peers and file playback (should we?)
-                    if (rampit) {
-                        workBuffer.addFromWithRamp(channel, 0, tempBuffer.getReadPointer(channel), numSamples, mLastWet, wetnow);
-                        if (hasmainfx) {
-                            workBuffer.addFromWithRamp(channel, 0, mainFxBuffer.getReadPointer(channel), numSamples, mLastWet, wetnow);
-                        }
-                   }
-                    else {
-                        workBuffer.addFrom(channel, 0, tempBuffer, channel, 0, numSamples, wetnow);
 
-                        if (hasmainfx) {
-                            workBuffer.addFrom(channel, 0, mainFxBuffer, channel, 0, numSamples, wetnow);
-                        }
-                    }
+        bool rampit =  (fabsf(wetnow - mLastWet) > 0.00001);
+        
+        for (int channel = 0; channel < totalRecordingChannels; ++channel) {
+            
+            // apply Main out gain to audio from remote peers and file playback (should we?)
+            if (rampit) {
+                workBuffer.addFromWithRamp(channel, 0, tempBuffer.getReadPointer(channel), numSamples, mLastWet, wetnow);
+                if (hasmainfx) {
+                    workBuffer.addFromWithRamp(channel, 0, mainFxBuffer.getReadPointer(channel), numSamples, mLastWet, wetnow);
                 }
+           }
+            else {
+                workBuffer.addFrom(channel, 0, tempBuffer, channel, 0, numSamples, wetnow);
 
-                if (hasfiledata) {
-                    int dstch = mRecFilePlaybackChannelGroup.params.monDestStartIndex;
-                    int dstcnt = jmin(totalOutputChannels, mRecFilePlaybackChannelGroup.params.monDestChannels);
-                    auto fgain = mRecFilePlaybackChannelGroup.params.gain * wetnow;
-                    // process the monitor part of the metchannelgroup
-                    mRecFilePlaybackChannelGroup.processMonitor(fileBuffer, 0, workBuffer, dstch, dstcnt, numSamples, fgain);
+                if (hasmainfx) {
+                    workBuffer.addFrom(channel, 0, mainFxBuffer, channel, 0, numSamples, wetnow);
                 }
+            }
+        }
 
-                if (hassoundboarddata) {
-                    soundboardChannelProcessor->processMonitor(workBuffer, numSamples, totalOutputChannels, wetnow);
-                }
+        if (hasfiledata) {
+            int dstch = mRecFilePlaybackChannelGroup.params.monDestStartIndex;
+            int dstcnt = jmin(totalOutputChannels, mRecFilePlaybackChannelGroup.params.monDestChannels);
+            auto fgain = mRecFilePlaybackChannelGroup.params.gain * wetnow;
+            // process the monitor part of the metchannelgroup
+            mRecFilePlaybackChannelGroup.processMonitor(fileBuffer, 0, workBuffer, dstch, dstcnt, numSamples, fgain);
+        }
 
-                if (metenabled && metrecorded) {
-                    int dstch = mRecMetChannelGroup.params.monDestStartIndex;
-                    int dstcnt = jmin(totalOutputChannels, mRecMetChannelGroup.params.monDestChannels);
-                    auto fgain = mRecMetChannelGroup.params.gain * wetnow;
+        if (hassoundboarddata) {
+            soundboardChannelProcessor->processMonitor(workBuffer, numSamples, totalOutputChannels, wetnow);
+        }
 
-                    // process the monitor part of the metchannelgroup
-                    mRecMetChannelGroup.processMonitor(metBuffer, 0, workBuffer, dstch, dstcnt, numSamples, fgain);
-                }
+        if (metenabled && metrecorded) {
+            int dstch = mRecMetChannelGroup.params.monDestStartIndex;
+            int dstcnt = jmin(totalOutputChannels, mRecMetChannelGroup.params.monDestChannels);
+            auto fgain = mRecMetChannelGroup.params.gain * wetnow;
 
-                if (activeMixMinusWriter.load() != nullptr) {
-                    activeMixMinusWriter.load()->write (workBuffer.getArrayOfReadPointers(), numSamples);
-                }
+            // process the monitor part of the metchannelgroup
+            mRecMetChannelGroup.processMonitor(metBuffer, 0, workBuffer, dstch, dstcnt, numSamples, fgain);
+        }
 
-                // mix in input
-                for (int channel = 0; channel < totalRecordingChannels; ++channel) {
-                    if (channel >= inputBuffer.getNumChannels()) continue;
-                    //int usechan = channel < mainBusInputChannels ? channel : channel > 0 ? channel-1 : 0;
-                    auto usechan = channel;
+        if (mixminustrack >= 0) {
+            writeToRecorder (mixminustrack, workBuffer.getArrayOfReadPointers(), totalRecordingChannels, numSamples);
+        }
 
-                    if (mDry.get() > 0.0f) {
-                        // copy input with monitor gain if > 0
-                        if (dryrampit) {
-                            workBuffer.addFromWithRamp(channel, 0, inputBuffer.getReadPointer(usechan), numSamples, mLastDry, drynow);
+        // mix in input
+        for (int channel = 0; channel < totalRecordingChannels; ++channel) {
+            if (channel >= inputBuffer.getNumChannels()) continue;
+            //int usechan = channel < mainBusInputChannels ? channel : channel > 0 ? channel-1 : 0;
+            auto usechan = channel;
 
-                            if (doinreverb && channel < 2) {
-                                workBuffer.addFromWithRamp(channel, 0, inputRevBuffer.getReadPointer(channel), numSamples, mLastDry, drynow);
-                            }
-                        }
-                        else {
-                            workBuffer.addFrom(channel, 0, inputBuffer.getReadPointer(usechan), numSamples, drynow);
+            if (mDry.get() > 0.0f) {
+                // copy input with monitor gain if > 0
+                if (dryrampit) {
+                    workBuffer.addFromWithRamp(channel, 0, inputBuffer.getReadPointer(usechan), numSamples, mLastDry, drynow);
 
-                            if (doinreverb && channel < 2) {
-                                workBuffer.addFrom(channel, 0, inputRevBuffer.getReadPointer(usechan), numSamples, drynow);
-                            }
-                        }
+                    if (doinreverb && channel < 2) {
+                        workBuffer.addFromWithRamp(channel, 0, inputRevBuffer.getReadPointer(channel), numSamples, mLastDry, drynow);
                     }
-                    else if (!anysoloed || mMainMonitorSolo.get()) {
-                        // monitoring is off, we just mix it into written file at full volume, as long as no one else is soloed
-                        workBuffer.addFrom(channel, 0, inputBuffer.getReadPointer(usechan), numSamples);
+                }
+                else {
+                    workBuffer.addFrom(channel, 0, inputBuffer.getReadPointer(usechan), numSamples, drynow);
 
-                        if (doinreverb && channel < 2) {
-                            workBuffer.addFrom(channel, 0, inputRevBuffer.getReadPointer(usechan), numSamples);
-                        }
+                    if (doinreverb && channel < 2) {
+                        workBuffer.addFrom(channel, 0, inputRevBuffer.getReadPointer(usechan), numSamples, drynow);
                     }
-
                 }
+            }
+            else if (!anysoloed || mMainMonitorSolo.get()) {
+                // monitoring is off, we just mix it into written file at full volume, as long as no one else is soloed
+                workBuffer.addFrom(channel, 0, inputBuffer.getReadPointer(usechan), numSamples);
 
-                if (activeMixWriter.load() != nullptr) {
-                    // write out full mix
-                    activeMixWriter.load()->write (workBuffer.getArrayOfReadPointers(), numSamples);
+                if (doinreverb && channel < 2) {
+                    workBuffer.addFrom(channel, 0, inputRevBuffer.getReadPointer(usechan), numSamples);
                 }
-                
             }
+
         }
+
+        if (mixtrack >= 0) {
+            // write out full mix
+            writeToRecorder (mixtrack, workBuffer.getArrayOfReadPointers(), totalRecordingChannels, numSamples);
+        }
+        
     }
 
     if (writingpossible || userwritingpossible) {
@@ -8306,17 +8614,57 @@ void SonobusAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer
     mAnythingSoloed =  anysoloed;
 
     mTransportWasPlaying = mTransportSource.isPlaying();
+
+    updateAudioThreadStats(blockStartTicks, numSamples);
+}
+
+void SonobusAudioProcessor::updateAudioThreadStats(int64 blockStartTicks, int numSamples)
+{
+    const double elapsed = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - blockStartTicks);
+    auto & stats = mAudioThreadStats;
+
+    int bucket = 0;
+    while (bucket < AudioThreadStats::NumDurationBuckets && elapsed > AudioThreadStats::DurationBucketBoundsSec[bucket]) {
+        ++bucket;
+    }
+
+    stats.durationCounts[bucket].fetch_add(1, std::memory_order_relaxed);
+    stats.durationSumUs.fetch_add((uint64) (elapsed * 1e6), std::memory_order_relaxed);
+    stats.blocks.fetch_add(1, std::memory_order_relaxed);
+
+    const double samplerate = getSampleRate();
+    if (samplerate > 0.0 && elapsed > numSamples / samplerate) {
+        stats.lateBlocks.fetch_add(1, std::memory_order_relaxed);
+
+        SonoAudio::TraceRecorder::instant("late block", 0, (int64) (elapsed * 1e6));
+        SonoAudio::TraceRecorder::requestDump();
+    }
+}
+
+void SonobusAudioProcessor::writeToRecorder(int track, const float* const* data, int numChannels, int numSamples)
+{
+    // an overrun is counted by the recorder itself
+    mRecorder->write (track, data, numChannels, numSamples);
 }
 
 //==============================================================================
 bool SonobusAudioProcessor::hasEditor() const
 {
+#if SONOBUS_HEADLESS_SERVER
+    // the server build doesn't compile in any of the gui
+    return false;
+#else
     return true; // (change this to false if you choose to not supply an editor)
+#endif
 }
 
 AudioProcessorEditor* SonobusAudioProcessor::createEditor()
 {
+#if SONOBUS_HEADLESS_SERVER
+    return nullptr;
+#else
     return new SonobusAudioProcessorEditor (*this);
+#endif
 }
 
 AudioProcessorValueTreeState& SonobusAudioProcessor::getValueTreeState()
@@ -8407,11 +8755,14 @@ void SonobusAudioProcessor::getStateInformationWithOptions(MemoryBlock& destData
     extraTree.setProperty(useSpecificUdpPortKey, mUseSpecificUdpPort, nullptr);
     extraTree.setProperty(changeQualForAllKey, mChangingDefaultAudioCodecChangesAll, nullptr);
     extraTree.setProperty(changeRecvQualForAllKey, mChangingDefaultRecvAudioCodecChangesAll, nullptr);
+    extraTree.setProperty(adaptiveBitrateMinKey, mAdaptiveSendBitrateMin, nullptr);
+    extraTree.setProperty(autoPacketsizeKey, mAutoPacketsize, nullptr);
     extraTree.setProperty(defRecordOptionsKey, var((int)mDefaultRecordingOptions), nullptr);
     extraTree.setProperty(defRecordFormatKey, var((int)mDefaultRecordingFormat), nullptr);
     extraTree.setProperty(defRecordBitsKey, var((int)mDefaultRecordingBitsPerSample), nullptr);
     extraTree.setProperty(recordSelfPreFxKey, mRecordInputPreFX, nullptr);
     extraTree.setProperty(recordFinishOpenKey, mRecordFinishOpens, nullptr);
+    extraTree.setProperty(recordCrashSafeKey, mRecordCrashSafe, nullptr);
 
     if (mDefaultRecordDir.isLocalFile()) {
         // backwards compat
@@ -8539,6 +8890,12 @@ void SonobusAudioProcessor::setStateInformationWithOptions (const void* data, in
             bool chrqual = extraTree.getProperty(changeRecvQualForAllKey, mChangingDefaultRecvAudioCodecChangesAll);
             setChangingDefaultRecvAudioCodecSetsExisting(chrqual);
 
+            int adaptmin = extraTree.getProperty(adaptiveBitrateMinKey, mAdaptiveSendBitrateMin);
+            setAdaptiveSendBitrateMin(adaptmin);
+
+            bool autopsize = extraTree.getProperty(autoPacketsizeKey, mAutoPacketsize);
+            setAutoPacketsizeEnabled(autopsize);
+
             uint32 opts = (uint32)(int) extraTree.getProperty(defRecordOptionsKey, (int)mDefaultRecordingOptions);
             setDefaultRecordingOptions(opts);
 
@@ -8555,6 +8912,7 @@ void SonobusAudioProcessor::setStateInformationWithOptions (const void* data, in
             setSelfRecordingPreFX(prefx);
 
             setRecordFinishOpens(extraTree.getProperty(recordFinishOpenKey, mRecordFinishOpens));
+            setRecordCrashSafe(extraTree.getProperty(recordCrashSafeKey, mRecordCrashSafe));
 
 
 #if !(JUCE_IOS)
@@ -8977,13 +9335,22 @@ StringArray SonobusAudioProcessor::getAllBlockedAddresses() const
 
 bool SonobusAudioProcessor::startRecordingToFile(const URL & recordLocationUrl, const String & filename, URL & mainreturl, uint32 recordOptions, RecordFileFormat fileformat)
 {
-    if (!recordingThread) {
-        recordingThread = std::make_unique<TimeSliceThread>("Recording Thread");
-        recordingThread->startThread();        
+    if (!mRecorder) {
+        mRecorder = std::make_unique<SonoAudio::MultiTrackRecorder>();
     }
     
     stopRecordingToFile();
 
+    // invalidate the indices before the tracks go away, a block still in flight may be reading them
+    mMixRecordTrack = -1;
+    mMixMinusRecordTrack = -1;
+    for (int i=0; i < MAX_CHANGROUPS; ++i) {
+        mSelfRecordTracks[i] = -1;
+    }
+    mRecorder->clearTracks();
+    mSessionRecordingFiles.clearQuick();
+    mSessionRecordingLock.reset();
+
     bool ret = false;
     
     // Now create a WAV writer object that writes to our output stream...
@@ -9044,6 +9411,38 @@ bool SonobusAudioProcessor::startRecordingToFile(const URL & recordLocationUrl,
         return false;
     }
 
+#if JUCE_ANDROID
+    // document streams can't be used for the session files
+    const bool crashsafe = false;
+#else
+    // ogg is left as is, it is already buffered heavily by the encoder
+    const bool crashsafe = mRecordCrashSafe && dynamic_cast<OggVorbisAudioFormat*>(audioFormat.get()) == nullptr;
+#endif
+    const String finalext = usefile.getFileExtension();
+
+    if (crashsafe) {
+        usefile = usefile.withFileExtension(SonoAudio::SessionChunkWriter::fileExtension);
+        mimetype = "application/octet-stream";
+
+        // what the session files get rendered to when we stop
+        mSessionRecordingFormat = dynamic_cast<WavAudioFormat*>(audioFormat.get()) != nullptr ? FileFormatWAV : FileFormatFLAC;
+        mSessionRecordingBitsPerSample = bitsPerSample;
+
+        // render anything left over from a crashed session first
+        if (mDefaultRecordDir.isLocalFile() && !isFinalizingRecordings()) {
+            recoverSessionRecordings(mDefaultRecordDir.getLocalFile());
+        }
+    }
+
+    // every track shares the session clock, so they line up when finalized
+    mElapsedRecordSamples = 0;
+    const int64 sessionStartMillis = Time::currentTimeMillis();
+
+    if (crashsafe) {
+        // keeps recovery in other instances away from the files while we write them
+        mSessionRecordingLock = SonoAudio::SessionRecordingLock::tryAcquire(sessionStartMillis);
+    }
+
     bool userwriting = false;
 
     
@@ -9131,13 +9530,15 @@ bool SonobusAudioProcessor::startRecordingToFile(const URL & recordLocationUrl,
     
 #else
     
-    auto makeStream = [this](const URL & parent, String & name, URL & returl) {
+    auto makeStream = [this,crashsafe](const URL & parent, String & name, URL & returl) {
         URL fileurl = parent.getChildURL(name);
         if (fileurl.isLocalFile()) {
             auto file = fileurl.getLocalFile().getNonexistentSibling();
             name = file.getFileName();
             returl = URL(file);
-            return std::unique_ptr<OutputStream> (file.createOutputStream());
+            // large buffer so the encoder threads do big sequential writes,
+            // session chunks are big already and must not linger in the buffer
+            return std::unique_ptr<OutputStream> (file.createOutputStream(crashsafe ? (size_t) 4096 : (size_t) recordStreamBufferSize));
         }
         return std::unique_ptr<OutputStream>();
     };
@@ -9168,9 +9569,42 @@ bool SonobusAudioProcessor::startRecordingToFile(const URL & recordLocationUrl,
     };
 
 #endif
-    
-    
-    
+
+    // in crash-safe mode tracks are written as chunked session files instead, all on the same clock
+    auto addRecordTrack = [&](std::unique_ptr<OutputStream> & fileStream, AudioFormat * format, int numchans, const String & trackname) -> int {
+        if (crashsafe) {
+            if (auto * filestream = dynamic_cast<FileOutputStream*>(fileStream.get())) {
+                fileStream.release();
+                File file = filestream->getFile();
+                auto writer = std::make_unique<SonoAudio::SessionChunkWriter>(std::unique_ptr<FileOutputStream>(filestream), trackname, getSampleRate(), numchans,
+                                                                              mElapsedRecordSamples, sessionStartMillis);
+                if (!writer->isOk()) {
+                    return -1;
+                }
+                int track = mRecorder->addTrack (std::move(writer), trackname, getSampleRate());
+                if (track >= 0) {
+                    mSessionRecordingFiles.add(file);
+                }
+                return track;
+            }
+        }
+
+        if (auto writer = format->createWriterFor (fileStream.get(), getSampleRate(), numchans, bitsPerSample, {}, qualindex))
+        {
+            fileStream.release(); // (passes responsibility for deleting the stream to the writer object that is now using it)
+            return mRecorder->addTrack (std::unique_ptr<AudioFormatWriter>(writer), trackname);
+        }
+        return -1;
+    };
+
+    // in crash-safe mode, returns where the finalized file will end up
+    auto finalUrl = [&](const URL & returl) {
+        if (crashsafe && returl.isLocalFile()) {
+            return URL(returl.getLocalFile().withFileExtension(finalext));
+        }
+        return returl;
+    };
+
     if (recordOptions == RecordMix) {
 
         // Create an OutputStream to write to our destination file...
@@ -9181,17 +9615,14 @@ bool SonobusAudioProcessor::startRecordingToFile(const URL & recordLocationUrl,
         
         if (auto fileStream = makeStream(recordLocationUrl, filename, returl))
         {
-            if (auto writer = audioFormat->createWriterFor (fileStream.get(), getSampleRate(), totalRecordingChannels, bitsPerSample, {}, qualindex))
+            // the recorder buffers it and writes the data to disk on its encoder threads
+            mMixRecordTrack = addRecordTrack (fileStream, audioFormat.get(), totalRecordingChannels, filename);
+
+            if (mMixRecordTrack >= 0)
             {
-                fileStream.release(); // (passes responsibility for deleting the stream to the writer object that is now using it)
-                
-                // Now we'll create one of these helper objects which will act as a FIFO buffer, and will
-                // write the data to disk on our background thread.
-                threadedMixWriter.reset (new AudioFormatWriter::ThreadedWriter (writer, *recordingThread, 32768));
-                
                 DBG("Started recording only mix file " << returl.toString(false));
 
-                mainreturl = returl;
+                mainreturl = finalUrl(returl);
                 ret = true;
             } else {
                 mLastError.clear();
@@ -9231,17 +9662,14 @@ bool SonobusAudioProcessor::startRecordingToFile(const URL & recordLocationUrl,
             if (auto fileStream = makeStream(recdir, filename, returl))
             //if (auto fileStream = std::unique_ptr<FileOutputStream> (thefile.createOutputStream()))
             {
-                if (auto writer = audioFormat->createWriterFor (fileStream.get(), getSampleRate(), totalRecordingChannels, bitsPerSample, {}, qualindex))
-                {
-                    fileStream.release(); // (passes responsibility for deleting the stream to the writer object that is now using it)
-                    
-                    // Now we'll create one of these helper objects which will act as a FIFO buffer, and will
-                    // write the data to disk on our background thread.
-                    threadedMixMinusWriter.reset (new AudioFormatWriter::ThreadedWriter (writer, *recordingThread, 32768));
+                // the recorder buffers it and writes the data to disk on its encoder threads
+                mMixMinusRecordTrack = addRecordTrack (fileStream, audioFormat.get(), totalRecordingChannels, filename);
 
+                if (mMixMinusRecordTrack >= 0)
+                {
                     DBG("Created mix minus output file: " << returl.toString(false));
              
-                    mainreturl = returl;
+                    mainreturl = finalUrl(returl);
                     ret = true;
                 } else {
                     DBG("Error creating mix minus writer for " << returl.toString(false));
@@ -9267,17 +9695,14 @@ bool SonobusAudioProcessor::startRecordingToFile(const URL & recordLocationUrl,
                 if (auto fileStream = makeStream(recdir, filename, returl))
                 //if (auto fileStream = std::unique_ptr<FileOutputStream> (thefile.createOutputStream()))
                 {
-                    if (auto writer = audioFormat->createWriterFor (fileStream.get(), getSampleRate(), chans, bitsPerSample, {}, qualindex))
-                    {
-                        fileStream.release(); // (passes responsibility for deleting the stream to the writer object that is now using it)
-
-                        // Now we'll create one of these helper objects which will act as a FIFO buffer, and will
-                        // write the data to disk on our background thread.
-                        threadedSelfWriters.add (new AudioFormatWriter::ThreadedWriter (writer, *recordingThread, 32768));
+                    // the recorder buffers it and writes the data to disk on its encoder threads
+                    mSelfRecordTracks[i] = addRecordTrack (fileStream, audioFormat.get(), chans, filename);
 
+                    if (mSelfRecordTracks[i] >= 0)
+                    {
                         DBG("Created self output file: " << returl.toString(false));
 
-                        mainreturl = returl;
+                        mainreturl = finalUrl(returl);
                         ret = true;
 
                     } else {
@@ -9300,17 +9725,14 @@ bool SonobusAudioProcessor::startRecordingToFile(const URL & recordLocationUrl,
             //if (auto fileStream = std::unique_ptr<FileOutputStream> (thefile.createOutputStream()))
             {
 
-                if (auto writer = audioFormat->createWriterFor (fileStream.get(), getSampleRate(), totalRecordingChannels, bitsPerSample, {}, qualindex))
-                {
-                    fileStream.release(); // (passes responsibility for deleting the stream to the writer object that is now using it)
-                    
-                    // Now we'll create one of these helper objects which will act as a FIFO buffer, and will
-                    // write the data to disk on our background thread.
-                    threadedMixWriter.reset (new AudioFormatWriter::ThreadedWriter (writer, *recordingThread, 32768));
+                // the recorder buffers it and writes the data to disk on its encoder threads
+                mMixRecordTrack = addRecordTrack (fileStream, audioFormat.get(), totalRecordingChannels, filename);
 
+                if (mMixRecordTrack >= 0)
+                {
                     DBG("Created mix output file: " << returl.toString(false));
 
-                    mainreturl = returl;
+                    mainreturl = finalUrl(returl);
                     ret = true;
                 } else {
                     DBG("Error creating mix writer for " << returl.toString(false));
@@ -9334,7 +9756,7 @@ bool SonobusAudioProcessor::startRecordingToFile(const URL & recordLocationUrl,
                 AudioFormat * useformat = audioFormat.get();
                 String fileext = usefile.getFileExtension();
 
-                if (fileformat == FileFormatFLAC && numchan > 8) {
+                if (fileformat == FileFormatFLAC && numchan > 8 && !crashsafe) {
                     if (!wavAudioFormat) {
                         wavAudioFormat = std::make_unique<WavAudioFormat>();
                     }
@@ -9353,13 +9775,12 @@ bool SonobusAudioProcessor::startRecordingToFile(const URL & recordLocationUrl,
                 {
 
                     // flac has a max of FLAC__MAX_CHANNELS, if we exceed that, fallback to WAV
-                    if (auto writer = useformat->createWriterFor (fileStream.get(), getSampleRate(), numchan, bitsPerSample, {}, qualindex))
+                    // the recorder buffers it and writes the data to disk on its encoder threads
+                    remote->recordTrackChannels = numchan;
+                    remote->recordTrack = addRecordTrack (fileStream, useformat, numchan, userfilename);
+
+                    if (remote->recordTrack >= 0)
                     {
-                        fileStream.release(); // (passes responsibility for deleting the stream to the writer object that is now using it)
-                        
-                        // Now we'll create one of these helper objects which will act as a FIFO buffer, and will
-                        // write the data to disk on our background thread.
-                        remote->fileWriter = std::make_unique<AudioFormatWriter::ThreadedWriter>(writer, *recordingThread, 32768);
 
                         DBG("Created user output file: " << returl.toString(false));
                         ret = true;
@@ -9372,25 +9793,61 @@ bool SonobusAudioProcessor::startRecordingToFile(const URL & recordLocationUrl,
                 }
             }
         }
-    }
-    
-    if (ret) {
-        // And now, swap over our active writer pointers so that the audio callback will start using it..
-        const ScopedLock sl (writerLock);
-        mElapsedRecordSamples = 0;
-        activeMixWriter = threadedMixWriter.get();
-        activeMixMinusWriter = threadedMixMinusWriter.get();
 
-        for (int i=0; i < MAX_CHANGROUPS; ++i) {
-            if (i < threadedSelfWriters.size()) {
-                activeSelfWriters[i] = threadedSelfWriters.getUnchecked(i);
+        if (recordOptions & RecordIndividualUsersRaw) {
+            const ScopedReadLock sl (mCoreLock);
+
+            // shared time base so the captures can be aligned when decoding
+            const auto sessionstart = Time::currentTimeMillis();
+            const auto sessionstarthires = Time::getMillisecondCounterHiRes();
+
+            for (auto & remote : mRemotePeers) {
+                if (!remote->oursink) continue;
+
+                String capfilename = usefile.getFileNameWithoutExtension() + "-" + remote->userName + SonoAudio::StreamCaptureWriter::fileExtension;
+                capfilename = File::createLegalFileName(capfilename);
+
+                URL returl;
+
+                if (auto fileStream = makeStream(recdir, capfilename, returl))
+                {
+                    auto capture = std::make_unique<SonoAudio::StreamCaptureWriter>(std::move(fileStream), remote->userName, sessionstart, sessionstarthires);
+
+                    if (capture->isOk()) {
+                        remote->captureWriter = mStreamCaptures.add(capture.release());
+                        mCaptureThread.addTimeSliceClient(remote->captureWriter);
+
+                        // the sink hands us the encoded blocks before decoding them
+                        auto handler = remote->captureWriter->getHandler();
+                        remote->oursink->set_option(aoo_opt_capture_handler, AOO_ARG(handler));
+
+                        DBG("Created user stream capture file: " << returl.toString(false));
+                        ret = true;
+                    } else {
+                        DBG("Error writing user stream capture file: " << returl.toString(false));
+                    }
+                } else {
+                    DBG("Error creating user stream capture file: " << makeReturnUrl(recdir, capfilename).toString(false));
+                }
             }
-            else {
-                activeSelfWriters[i] = nullptr;
+
+            if (!mStreamCaptures.isEmpty() && !mCaptureThread.isThreadRunning()) {
+                mCaptureThread.startThread();
             }
         }
+    }
+    
+    if (ret && mRecorder->getNumTracks() > 0 && !mRecorder->start()) {
+        mLastError = TRANS("Error starting recorder");
+        DBG(mLastError);
+        ret = false;
+    }
 
-        writingPossible.store(activeMixWriter || threadedSelfWriters.size() || activeMixMinusWriter);
+    if (ret) {
+        // And now, let the audio callback start using the recorder tracks
+        mElapsedRecordSamples = 0;
+
+        writingPossible.store(mMixRecordTrack >= 0 || mSelfRecordTracks[0] >= 0 || mMixMinusRecordTrack >= 0);
 
         userWritingPossible.store(userwriting);
 
@@ -9404,77 +9861,194 @@ bool SonobusAudioProcessor::startRecordingToFile(const URL & recordLocationUrl,
 
 bool SonobusAudioProcessor::stopRecordingToFile()
 {
-    // First, clear this pointer to stop the audio callback from using our writer object..
+    // First, stop the audio callback from using the recorder
+
+    writingPossible.store(false);
+    userWritingPossible.store(false);
+
+    if (!isRecordingToFile()) {
+        return false;
+    }
 
-    OwnedArray<AudioFormatWriter::ThreadedWriter> userwriters;
+    // this waits for any audio callback writes in progress, then flushes remaining
+    // data to disk. It can take a little time, but doesn't block the audio callback.
+    mRecorder->stop();
 
     {
         const ScopedReadLock scl (mCoreLock);
+        aoo_capture_handler nohandler = { nullptr, nullptr, nullptr };
 
-        const ScopedLock sl (writerLock);
-        activeMixWriter = nullptr;
-        activeMixMinusWriter = nullptr;
-        for (int i=0; i < MAX_CHANGROUPS; ++i) {
-            activeSelfWriters[i] = nullptr;
+        for (auto & remote : mRemotePeers) {
+            remote->recordTrack = -1;
+            remote->recordTrackChannels = 0;
+
+            if (remote->captureWriter && remote->oursink) {
+                // no more capture callbacks after this returns
+                remote->oursink->set_option(aoo_opt_capture_handler, AOO_ARG(nohandler));
+            }
+            remote->captureWriter = nullptr;
         }
+    }
 
-        writingPossible.store(false);
-        userWritingPossible.store(false);
+    // report the first problem, later ones are only logged
+    String firstError;
 
-        // transfer ownership of writers to our temporary OwnedArray to be cleared below
-        for (auto & remote : mRemotePeers) {
-            if (remote->fileWriter) {
-                userwriters.add(std::move(remote->fileWriter));
-            }
+    for (auto * capture : mStreamCaptures) {
+        mCaptureThread.removeTimeSliceClient(capture);
+        capture->finish();
+
+        if (capture->getDroppedBlocks() > 0) {
+            String err = TRANS("Stream capture could not keep up, some blocks were lost");
+            DBG(err << " (" << capture->getDroppedBlocks() << " of " << capture->getCapturedBlocks() + capture->getDroppedBlocks() << " blocks)");
+            if (firstError.isEmpty()) firstError = err;
         }
+    }
+    mStreamCaptures.clear();
 
+    for (int i=0; i < mRecorder->getNumTracks(); ++i) {
+        auto stats = mRecorder->getTrackStats(i);
+        if (stats.droppedSamples > 0) {
+            String err = TRANS("Recording could not keep up, some audio was replaced with silence in: ") + mRecorder->getTrackName(i);
+            DBG(err << " (" << stats.droppedSamples << " samples)");
+            if (firstError.isEmpty()) firstError = err;
+        }
     }
-    
-    bool didit = false;
-    
-    if (threadedMixWriter) {
-        
-        // Now we can delete the writer object. It's done in this order because the deletion could
-        // take a little time while remaining data gets flushed to disk, and we can't be blocking
-        // the audio callback while this happens.
-        threadedMixWriter.reset();
-        
-        DBG("Stopped recording mix file");
-        didit = true;
+
+    if (firstError.isNotEmpty()) {
+        mLastError = firstError;
     }
 
-    if (!threadedSelfWriters.isEmpty()) {
-        threadedSelfWriters.clearQuick(true);
-        DBG("Stopped recording self file(s)");
-        didit = true;
+    DBG("Stopped recording " << mRecorder->getNumTracks() << " files");
+
+    if (!mSessionRecordingFiles.isEmpty()) {
+        finalizeSessionRecordings(mSessionRecordingFiles, mSessionRecordingFormat, mSessionRecordingBitsPerSample, std::move(mSessionRecordingLock));
+        mSessionRecordingFiles.clearQuick();
     }
+    mSessionRecordingLock.reset();
 
-    if (threadedMixMinusWriter) {
-        threadedMixMinusWriter.reset();
-        
-        DBG("Stopped recording mix-minus file");
-        didit = true;
+    sendRemotePeerInfoUpdate();
+
+    return true;
+}
+
+void SonobusAudioProcessor::finalizeSessionRecordings(const Array<File> & files, RecordFileFormat format, int bitsPerSample,
+                                                      std::unique_ptr<SonoAudio::SessionRecordingLock> sessionLock)
+{
+    if (!mFinalizePool) {
+        mFinalizePool = std::make_unique<ThreadPool>(1);
     }
 
-    // cleanup any user writers
-    if (!userwriters.isEmpty()) {
-        userwriters.clear();
-        DBG("Stopped recording user files");
-        didit = true;
+    auto stemformat = format == FileFormatWAV ? SonoAudio::SessionRecordingFinalizer::StemFormatWAV : SonoAudio::SessionRecordingFinalizer::StemFormatFLAC;
+
+    mFinalizePool->addJob(new SonoAudio::SessionRecordingFinalizer(files, stemformat, bitsPerSample, true,
+                                                                   [this](const Array<File> & results, const String & error) {
+        DBG("Finalized " << results.size() << " session recording files" << (error.isNotEmpty() ? (", error: " + error) : String()));
+        if (error.isNotEmpty()) {
+            // listeners deal with being called from other threads
+            clientListeners.call(&SonobusAudioProcessor::ClientListener::aooClientError, this, TRANS("Error finishing recording: ") + error);
+        }
+    }, std::move(sessionLock)), true);
+}
+
+bool SonobusAudioProcessor::recoverSessionRecordings(const File & directory)
+{
+    if (isRecordingToFile()) {
+        return false;
     }
 
-    sendRemotePeerInfoUpdate();
+    // multitrack recordings are in their own subdirectory
+    Array<File> dirs { directory };
+    dirs.addArray(directory.findChildFiles(File::findDirectories, false));
+
+    bool found = false;
+
+    for (auto & dir : dirs) {
+        // group by session, only files from the same session line up
+        std::map<int64, Array<File>> sessions;
+        for (auto & file : SonoAudio::SessionRecordingFinalizer::findSessionFiles(dir)) {
+            SonoAudio::SessionRecordingReader reader(file);
+            if (reader.isValid()) {
+                sessions[reader.getSessionStartMillis()].add(file);
+            } else {
+                DBG("Skipping invalid session recording file: " << file.getFullPathName());
+            }
+        }
+
+        for (auto & session : sessions) {
+            // only sessions whose writer is gone, another instance may still be recording this one
+            auto sessionLock = SonoAudio::SessionRecordingLock::tryAcquire(session.first);
+            if (!sessionLock) {
+                DBG("Session recording " << session.first << " is still in use, not recovering it");
+                continue;
+            }
+
+            DBG("Recovering " << session.second.size() << " session recording files in " << dir.getFullPathName());
+            finalizeSessionRecordings(session.second, mDefaultRecordingFormat, mDefaultRecordingBitsPerSample, std::move(sessionLock));
+            found = true;
+        }
+    }
 
-    return didit;
+    return found;
 }
 
 bool SonobusAudioProcessor::isRecordingToFile()
 {
-    return (activeMixWriter.load() != nullptr 
-            || threadedSelfWriters.size() > 0
-            || activeMixMinusWriter.load() != nullptr 
-            || userWritingPossible.load()
-            );
+    return (mRecorder && mRecorder->isRunning()) || !mStreamCaptures.isEmpty();
+}
+
+int64 SonobusAudioProcessor::getRecordingDroppedSamples() const
+{
+    return mRecorder ? mRecorder->getLifetimeDroppedSamples() : 0;
+}
+
+bool SonobusAudioProcessor::startPacketCapture(const File & file)
+{
+    stopPacketCapture();
+
+    file.deleteFile();
+    std::unique_ptr<OutputStream> stream = file.createOutputStream();
+    if (!stream) {
+        DBG("Could not create packet capture file: " << file.getFullPathName());
+        return false;
+    }
+
+    auto capture = std::make_unique<SonoAudio::PacketCaptureWriter>(std::move(stream), getSampleRate(), currSamplesPerBlock, getMainBusNumOutputChannels());
+    if (!capture->isOk()) {
+        return false;
+    }
+
+    mCaptureThread.addTimeSliceClient(capture.get());
+    if (!mCaptureThread.isThreadRunning()) {
+        mCaptureThread.startThread();
+    }
+
+    {
+        const SpinLock::ScopedLockType sl (mPacketCaptureLock);
+        mPacketCapture = std::move(capture);
+    }
+    mPacketCaptureActive = true;
+
+    DBG("Capturing received packets to " << file.getFullPathName());
+    return true;
+}
+
+bool SonobusAudioProcessor::stopPacketCapture()
+{
+    mPacketCaptureActive = false;
+
+    std::unique_ptr<SonoAudio::PacketCaptureWriter> capture;
+    {
+        // no receive thread is in capture() after this
+        const SpinLock::ScopedLockType sl (mPacketCaptureLock);
+        capture = std::move(mPacketCapture);
+    }
+    if (!capture) return false;
+
+    mCaptureThread.removeTimeSliceClient(capture.get());
+    bool ok = capture->finish();
+
+    DBG("Packet capture done, " << capture->getCapturedPackets() << " packets, " << capture->getDroppedPackets() << " dropped");
+    return ok;
 }
 
 void SonobusAudioProcessor::clearTransportURL()
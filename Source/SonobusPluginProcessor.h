@@ -17,6 +17,16 @@
 
 #include "EffectParams.h"
 #include "ChannelGroup.h"
+#include "SendBusGraph.h"
+#include "MultiTrackRecorder.h"
+#include "SessionRecording.h"
+#include "StreamCapture.h"
+#include "PacketCapture.h"
+#include "NetBufferPolicy.h"
+#include "LocalTransport.h"
+#include "SeqLockTable.h"
+#include "TraceRecorder.h"
+#include "RealtimeAudit.h"
 
 #include "zitaRev.h"
 
@@ -31,6 +41,7 @@ class Metronome;
 
 #define MAX_PEERS 32
 #define MAX_CHANGROUPS 64
+#define PEER_STATS_INTERVAL_MS 100
 #define DEFAULT_SERVER_PORT 10998
 #define DEFAULT_SERVER_HOST "18.190.82.203"
 
@@ -127,7 +138,7 @@ public:
         AutoNetBufferModeInitAuto
     };
     
-    enum AudioCodecFormatCodec { CodecPCM = 0, CodecOpus };
+    enum AudioCodecFormatCodec { CodecPCM = 0, CodecOpus, CodecLossless };
 
     enum ReverbModel {
         ReverbModelFreeverb = 0,
@@ -141,7 +152,9 @@ public:
         RecordMix = 1,
         RecordSelf = 2,
         RecordMixMinusSelf = 4,
-        RecordIndividualUsers = 8
+        RecordIndividualUsers = 8,
+        // encoded network streams of each user, decoded to stems later
+        RecordIndividualUsersRaw = 16
     };
     
     enum RecordFileFormat {
@@ -161,11 +174,12 @@ public:
         AudioCodecFormatInfo() {}
         AudioCodecFormatInfo(int bitdepth_) : codec(CodecPCM), bitdepth(bitdepth_), min_preferred_blocksize(16)  { computeName(); }
         AudioCodecFormatInfo(int bitrate_, int complexity_, int signaltype, int minblocksize=120) :  codec(CodecOpus), bitrate(bitrate_), complexity(complexity_), signal_type(signaltype), min_preferred_blocksize(minblocksize) { computeName(); }
+        AudioCodecFormatInfo(AudioCodecFormatCodec codec_, int bitdepth_) : codec(codec_), bitdepth(bitdepth_), min_preferred_blocksize(16)  { computeName(); }
         void computeName();
         
         String name;
         AudioCodecFormatCodec codec;
-        // PCM options
+        // PCM and lossless options
         int bitdepth = 2; // bytes
         // opus options
         int bitrate = 0;
@@ -464,6 +478,47 @@ public:
     
     bool getRemotePeerLatencyInfo(int index, LatencyInfo & retinfo) const;
 
+    // network statistics of one peer, as published by the event thread
+    struct PeerStats
+    {
+        uint32 viewId = 0; // see getRemotePeerViewId
+        float fillRatio = 0.0f;
+        float fillRatioStdDev = 0.0f;
+        float bufferTimeMs = 0.0f;
+        int64_t packetsReceived = 0;
+        int64_t packetsSent = 0;
+        int64_t bytesReceived = 0;
+        int64_t bytesSent = 0;
+        int64_t packetsDropped = 0;
+        int64_t packetsResent = 0;
+        LatencyInfo latency;
+        char userName[64] = {};
+        char sendCodec[32] = {};
+        char recvCodec[32] = {};
+    };
+
+    // current stats of one peer, goes through the core lock
+    bool getRemotePeerStats(int index, PeerStats & retstats) const;
+
+    // lock-free copy of the stats of all peers (indexed like the peers) from the last publish,
+    // which happens every PEER_STATS_INTERVAL_MS. returns the snapshot version, 0 if there is none yet
+    uint32 getAllRemotePeerStats(Array<PeerStats> & retstats) const;
+
+    // audio thread health counters, only ever bumped by the audio thread
+    struct AudioThreadStats
+    {
+        // upper bounds in seconds of the processBlock duration histogram, the last count is for anything longer
+        static constexpr int NumDurationBuckets = 9;
+        static constexpr double DurationBucketBoundsSec[NumDurationBuckets] = { 0.0001, 0.00025, 0.0005, 0.001, 0.002, 0.004, 0.008, 0.016, 0.032 };
+
+        std::atomic<uint64> durationCounts[NumDurationBuckets + 1] = {};
+        std::atomic<uint64> durationSumUs { 0 };
+        std::atomic<uint64> blocks { 0 };
+        std::atomic<uint64> lateBlocks { 0 }; // took longer than the block lasts
+    };
+
+    const AudioThreadStats & getAudioThreadStats() const { return mAudioThreadStats; }
+
     bool startRemotePeerLatencyTest(int index, float durationsec = 1.0);
     bool stopRemotePeerLatencyTest(int index);
     bool isRemotePeerLatencyTestActive(int index);
@@ -562,6 +617,14 @@ public:
     void setChangingDefaultRecvAudioCodecSetsExisting(bool flag) { mChangingDefaultRecvAudioCodecChangesAll = flag; }
     bool getChangingDefaultRecvAudioCodecSetsExisting() const { return mChangingDefaultRecvAudioCodecChangesAll;}
 
+    // lowest bitrate per channel (bits/s) an Opus send stream may drop to under congestion, 0 to always send at the chosen bitrate
+    void setAdaptiveSendBitrateMin(int bitrate);
+    int getAdaptiveSendBitrateMin() const { return mAdaptiveSendBitrateMin; }
+
+    // applies to all current and new peers
+    void setAutoPacketsizeEnabled(bool flag);
+    bool getAutoPacketsizeEnabled() const { return mAutoPacketsize; }
+
     
     String getAudioCodeFormatName(int formatIndex) const;
     bool getAudioCodeFormatInfo(int formatIndex, AudioCodecFormatInfo & retinfo) const;
@@ -608,10 +671,24 @@ public:
     
     int getRemotePeerSendPacketsize(int index) const;
     void setRemotePeerSendPacketsize(int index, int psize);
+    // discover the path MTU and send with the largest packets it allows, on by default
+    bool getRemotePeerAutoPacketsize(int index) const;
+    void setRemotePeerAutoPacketsize(int index, bool flag);
 
     int getRemotePeerOrderPriority(int index) const;
     void setRemotePeerOrderPriority(int index, int priority);
 
+    // lets the views find their peer again after others joined or left
+    uint32 getRemotePeerViewId(int index) const;
+
+    enum PeerViewChangeFlags {
+        PeerViewChangeNone = 0,
+        PeerViewChangeLayout = 1 << 0 // channel count or channel groups changed on our side
+    };
+
+    // returns the PeerViewChangeFlags set since the last call, and clears them
+    uint32 fetchRemotePeerViewChanges(int index);
+
     // select by index or by peer, or don't specify for all
     void updateRemotePeerUserFormat(int index=-1, RemotePeer * onlypeer=nullptr);
 
@@ -732,7 +809,15 @@ public:
     bool startRecordingToFile(const URL & recordLocation, const String & filename, URL & mainreturl, uint32 recordOptions=RecordDefaultOptions, RecordFileFormat fileformat=FileFormatDefault);
     bool stopRecordingToFile();
     bool isRecordingToFile();
+    // samples that had to be replaced by silence because the recorder could not keep up,
+    // counted over all recordings so far, safe to call from any thread
+    int64 getRecordingDroppedSamples() const;
     double getElapsedRecordTime() const { return mElapsedRecordSamples / getSampleRate(); }
+
+    // logs every received datagram to a .sbpkt file, for replaying with PacketCaptureReplayer
+    bool startPacketCapture(const File & file);
+    bool stopPacketCapture();
+    bool isPacketCaptureActive() const { return mPacketCaptureActive.load(); }
     String getLastErrorMessage() const { return mLastError; }
 
     void setDefaultRecordingDirectory(const URL & recdir)  { mDefaultRecordDir = recdir; }
@@ -756,6 +841,14 @@ public:
     bool getRecordFinishOpens() const { return mRecordFinishOpens; }
     void setRecordFinishOpens(bool flag) { mRecordFinishOpens = flag; }
 
+    // crash-safe recording writes chunked session files, rendered to the chosen format after stopping
+    bool getRecordCrashSafe() const { return mRecordCrashSafe; }
+    void setRecordCrashSafe(bool flag) { mRecordCrashSafe = flag; }
+
+    // renders any session files left in the directory (e.g. after a crash) in the background
+    bool recoverSessionRecordings(const File & directory);
+    bool isFinalizingRecordings() const { return mFinalizePool && mFinalizePool->getNumJobs() > 0; }
+
     bool getReconnectAfterServerLoss() const { return mReconnectAfterServerLoss.get(); }
     void setReconnectAfterServerLoss(bool flag) { mReconnectAfterServerLoss = flag; }
 
@@ -840,9 +933,16 @@ private:
     void initializeAoo(int udpPort=0);
     void cleanupAoo();
     
-    void doReceiveData();
+    void doReceiveData(DatagramSocket & socket);
+    void doReceiveLocalData();
+    void handleReceivedData(EndpointState * endpoint, char * buf, int nbytes);
     void doSendData();
     void handleEvents();
+    void publishPeerStats();
+    void fillRemotePeerStats(int index, PeerStats & retstats) const;
+
+    void updateAudioThreadStats(int64 blockStartTicks, int numSamples);
+    void writeToRecorder(int track, const float* const* data, int numChannels, int numSamples);
 
     bool handleOtherMessage(EndpointState * endpoint, const char *msg, int32_t n);
 
@@ -857,8 +957,13 @@ private:
     void sendPingEvent(RemotePeer * peer);
 
     void updateSafetyMuting(RemotePeer * peer);
+    SonoAudio::NetBufferPolicy::Settings getNetBufferSettings(const RemotePeer * peer) const;
+    // pushes a buffer time changed by the auto sizing to the sinks and the peer
+    void applyAutoBufferTime(RemotePeer * peer);
 
     void setupSourceFormat(RemotePeer * peer, aoo::isource * source, bool latencymode=false);
+    // the format actually sent to the peer, with the default (-1) resolved
+    int getSendFormatIndex(const RemotePeer * peer, bool latencymode=false) const;
     bool formatInfoToAooFormat(const AudioCodecFormatInfo & info, int channels, aoo_format_storage & retformat);
 
     void setupSourceUserFormat(RemotePeer * peer, aoo::isource * source);
@@ -899,9 +1004,11 @@ private:
 
     int connectRemotePeerRaw(void * sockaddr, const String & username = "", const String & groupname = "", bool reciprocate=true);
 
-    int findFormatIndex(AudioCodecFormatCodec codec, int bitrate, int bitdepth);
+    int findFormatIndex(AudioCodecFormatCodec codec, int bitrate, int bitdepth) const;
 
     void ensureBuffers(int samples);
+    void processMainReverbBus(AudioBuffer<float>& fxbuffer, int numSamples, bool enabled, bool wasEnabled);
+    void processInputReverbBus(AudioBuffer<float>& revbuffer, int numSamples, bool enabled, bool wasEnabled);
 
     void commitCacheForPeer(RemotePeer * peer);
     bool findAndLoadCacheForPeer(RemotePeer * peer);
@@ -934,8 +1041,10 @@ private:
     AudioSampleBuffer inputPreBuffer;
     AudioSampleBuffer fileBuffer;
     AudioSampleBuffer metBuffer;
-    AudioSampleBuffer mainFxBuffer;
-    AudioSampleBuffer inputRevBuffer;
+    // effect send buses (main reverb, input reverb)
+    SonoAudio::SendBusGraph mSendBusGraph;
+    int mMainReverbBus = -1;
+    int mInputReverbBus = -1;
     AudioSampleBuffer silentBuffer; // only ever has one channel
     int mTempBufferSamples = 0;
     int mTempBufferChannels = 0;
@@ -986,10 +1095,7 @@ private:
     float mLastInMonPan1 = -1.0f;
     float mLastInMonPan2 = 1.0f;
     bool mLastMetEnabled = false;
-    bool mLastMainReverbEnabled = false;
     bool mReverbParamsChanged = false;
-    bool mLastHasMainFx = false;
-    bool mLastInputReverbEnabled = false;
     bool mFreshInit = true;
     
     Atomic<bool>   mAnythingSoloed  { false };
@@ -999,6 +1105,8 @@ private:
     
     bool mChangingDefaultAudioCodecChangesAll = false;
     bool mChangingDefaultRecvAudioCodecChangesAll = false;
+    int mAdaptiveSendBitrateMin = 0;
+    bool mAutoPacketsize = true;
 
     RangedAudioParameter * mDefaultAutoNetbufModeParam;
     RangedAudioParameter * mTempoParameter;
@@ -1024,7 +1132,17 @@ private:
     int blocksizeCounter = -1;
     Atomic<bool> mNeedsSampleSetup  { false };
 
+    std::atomic<uint32> mNextPeerViewId { 1 };
+
+    // written only by the event thread
+    SonoAudio::SeqLockTable<PeerStats, MAX_PEERS> mPeerStatsTable;
+    double mLastPeerStatsPublishMs = 0.0;
+    int mLastPeerStatsCount = 0;
+
+    AudioThreadStats mAudioThreadStats;
+
     float meterRmsWindow = 0.0f;
+    int meterDecimation = 1; // blocks per meter update
     
     int lastInputChannels = 0;
     int lastOutputChannels = 0;
@@ -1080,16 +1198,22 @@ private:
     
     
     std::unique_ptr<DatagramSocket> mUdpSocket;
+    // extra receive-only sockets bound to the same port, one recv thread each
+    OwnedArray<DatagramSocket> mRecvShardSockets;
+    // shared memory packet queues to other instances on this host
+    std::unique_ptr<SonoAudio::LocalTransport> mLocalTransport;
     int mUdpLocalPort;
     IPAddress mLocalIPAddress;
     
     class SendThread;
     class RecvThread;
+    class LocalRecvThread;
     class EventThread;
     class ServerThread;
     class ClientThread;
     
     CriticalSection  mEndpointsLock;
+    CriticalSection  mRecvSharedLock; // for receive handling not owned by a single recv thread
     ReadWriteLock    mCoreLock;
     CriticalSection  mClientLock;
     CriticalSection  mSourceFormatLock;
@@ -1153,7 +1277,8 @@ private:
 
 
     std::unique_ptr<SendThread> mSendThread;
-    std::unique_ptr<RecvThread> mRecvThread;
+    OwnedArray<RecvThread> mRecvThreads;
+    std::unique_ptr<LocalRecvThread> mLocalRecvThread;
     std::unique_ptr<EventThread> mEventThread;
     std::unique_ptr<ServerThread> mServerThread;
     std::unique_ptr<ClientThread> mClientThread;
@@ -1161,6 +1286,7 @@ private:
 
     // Input channelgroups
     SonoAudio::ChannelGroup mInputChannelGroups[MAX_CHANGROUPS];
+    SharedResourcePointer<SonoAudio::ChannelGroupEffectPool> mChannelGroupEffectPool;
     int mInputChannelGroupCount = 0;
 
     // Effects
@@ -1194,6 +1320,7 @@ private:
     int mDefaultRecordingBitsPerSample = 16;
     bool mRecordInputPreFX = true;
     bool mRecordFinishOpens = true;
+    bool mRecordCrashSafe = false;
     URL mDefaultRecordDir;
     String mLastError;
     int mSelfRecordChannels = 2;
@@ -1204,16 +1331,33 @@ private:
     std::atomic<bool> userWritingPossible = { false };
     int totalRecordingChannels = 2;
     int64 mElapsedRecordSamples = 0;
-    std::unique_ptr<TimeSliceThread> recordingThread;
-    std::unique_ptr<AudioFormatWriter::ThreadedWriter> threadedMixWriter;
-    std::unique_ptr<AudioFormatWriter::ThreadedWriter> threadedMixMinusWriter;
-    OwnedArray<AudioFormatWriter::ThreadedWriter> threadedSelfWriters;
     int  mSelfRecordChans[MAX_CHANGROUPS] { 0 };
 
-    CriticalSection writerLock;
-    std::atomic<AudioFormatWriter::ThreadedWriter*> activeMixWriter { nullptr };
-    std::atomic<AudioFormatWriter::ThreadedWriter*> activeMixMinusWriter { nullptr };
-    std::atomic<AudioFormatWriter::ThreadedWriter*> activeSelfWriters[MAX_CHANGROUPS] { nullptr };
+    // recorder tracks, -1 if not recording that track, the audio thread loads them once per block
+    // created up front so other threads can read its counters
+    std::unique_ptr<SonoAudio::MultiTrackRecorder> mRecorder = std::make_unique<SonoAudio::MultiTrackRecorder>();
+    std::atomic<int> mMixRecordTrack { -1 };
+    std::atomic<int> mMixMinusRecordTrack { -1 };
+    std::atomic<int> mSelfRecordTracks[MAX_CHANGROUPS];
+    static const int recordStreamBufferSize = 1 << 18;
+
+    // session files of the current crash-safe recording, and the pool that finalizes them
+    Array<File> mSessionRecordingFiles;
+    RecordFileFormat mSessionRecordingFormat = FileFormatFLAC;
+    int mSessionRecordingBitsPerSample = 16;
+    std::unique_ptr<SonoAudio::SessionRecordingLock> mSessionRecordingLock;
+    std::unique_ptr<ThreadPool> mFinalizePool;
+    void finalizeSessionRecordings(const Array<File> & files, RecordFileFormat format, int bitsPerSample,
+                                   std::unique_ptr<SonoAudio::SessionRecordingLock> sessionLock = nullptr);
+
+    // raw network stream captures of the current recording
+    OwnedArray<SonoAudio::StreamCaptureWriter> mStreamCaptures;
+    TimeSliceThread mCaptureThread { "stream capture writer" };
+
+    // received packet capture, the receive threads take the spinlock around each packet
+    std::unique_ptr<SonoAudio::PacketCaptureWriter> mPacketCapture;
+    std::atomic<bool> mPacketCaptureActive { false };
+    SpinLock mPacketCaptureLock;
 
     // playing stuff
     AudioTransportSource mTransportSource;
@@ -16,60 +16,36 @@ SamplePlaybackManager::~SamplePlaybackManager()
     transportSource.removeChangeListener(this);
 }
 
-bool SamplePlaybackManager::loadFileFromSample(TimeSliceThread &fileReadThread)
+bool SamplePlaybackManager::loadFileFromSample(TimeSliceThread &fileReadThread, SoundboardSampleCache* sampleCache)
 {
     if (loaded) return true;
-    if (!fileReadThread.isThreadRunning()) return false;
 
-    AudioFormatReader* reader = nullptr;
     auto audioFileUrl = sample->getFileURL();
 
-#if ! (JUCE_IOS || JUCE_ANDROID)
-    if (audioFileUrl.isLocalFile()) {
-        reader = formatManager.createReaderFor(audioFileUrl.getLocalFile());
-    }
-    else
-#endif
-    {
-#if JUCE_ANDROID
-        auto doc = AndroidDocument::fromDocument(audioFileUrl);
-        if (!doc.hasValue()) {
-            doc = AndroidDocument::fromFile(audioFileUrl.getLocalFile());
-        }
-        
-        if (doc.hasValue()) {
-            DBG("Loading Android doc: " << doc.getInfo().getName());
-            if (doc.getInfo().canRead()) {
-                
-                if (auto strm = doc.createInputStream()) {
-                    reader = formatManager.createReaderFor (std::move(strm));
-                }
-                else {
-                    DBG("Could not load android doc with URL: " << audioFileUrl.toString(false));
-                    return false;
-                }
-            } else {
-                DBG("No permission to read android doc with URL: " << audioFileUrl.toString(false));
-                return false;
-            }
-        }
-#else
-        if (auto strm = audioFileUrl.createInputStream(URL::InputStreamOptions(URL::ParameterHandling::inAddress))) {
-            reader = formatManager.createReaderFor(std::move(strm));
-        }
-        else {
-            DBG("Could not load from URL: " << audioFileUrl.toString(false));
-            return false;
+    if (sampleCache) {
+        if (auto cached = sampleCache->get(audioFileUrl)) {
+            // already decoded or mapped, no read-ahead needed
+            auto sourceSampleRate = cached->getSampleRate();
+            currentFileSource = std::make_unique<CachedSampleSource>(std::move(cached));
+            transportSource.setSource(currentFileSource.get(), 0, nullptr, sourceSampleRate, 2);
+
+            reloadPlaybackSettingsFromSample();
+
+            loaded = true;
+            return true;
         }
-#endif
     }
 
+    if (!fileReadThread.isThreadRunning()) return false;
+
+    auto reader = SoundboardSampleCache::createReaderFor(formatManager, audioFileUrl);
     if (reader == nullptr) {
         return false;
     }
 
-    currentFileSource = std::make_unique<AudioFormatReaderSource>(reader, true);
-    transportSource.setSource(currentFileSource.get(), READ_AHEAD_BUFFER_SIZE, &fileReadThread, reader->sampleRate, 2);
+    auto sourceSampleRate = reader->sampleRate;
+    currentFileSource = std::make_unique<AudioFormatReaderSource>(reader.release(), true);
+    transportSource.setSource(currentFileSource.get(), READ_AHEAD_BUFFER_SIZE, &fileReadThread, sourceSampleRate, 2);
 
     reloadPlaybackSettingsFromSample();
 
@@ -209,7 +185,7 @@ std::optional<std::shared_ptr<SamplePlaybackManager>> SoundboardChannelProcessor
         diskThread.startThread(Thread::Priority::normal);
     }
 
-    auto loaded = manager->loadFileFromSample(diskThread);
+    auto loaded = manager->loadFileFromSample(diskThread, &sampleCache.get());
     if (!loaded) {
         return {};
     }
@@ -10,6 +10,7 @@
 #include "JuceHeader.h"
 #include "ChannelGroup.h"
 #include "Soundboard.h"
+#include "SoundboardSampleCache.h"
 
 class SoundboardChannelProcessor;
 class SamplePlaybackManager;
@@ -47,13 +48,15 @@ public:
     /**
      * Loads the file for playback.
      *
-     * When the file is already loaded, this does nothing.
+     * When the file is already loaded, this does nothing. Plays from the sample cache when the file
+     * is cached, otherwise the file is streamed from disk.
      *
      * @param fileReadThread thread to use for reading the file. The thread must be running.
+     * @param sampleCache cache of preloaded sample data, may be nullptr.
      *
      * @return True when succeeded, or false when the file could not be loaded.
      */
-    bool loadFileFromSample(TimeSliceThread& fileReadThread);
+    bool loadFileFromSample(TimeSliceThread& fileReadThread, SoundboardSampleCache* sampleCache = nullptr);
 
     /**
      * Applies playback settings from the sample to the player.
@@ -133,7 +136,7 @@ private:
     // as the transport source attempts to clean up some things in the current file source.
     // As Juce refuses to take responsibility of cleaning up the file source itself,
     // we must manage this explicitly ourselves and therefore make sure the order of the following lines does not change.
-    std::unique_ptr<AudioFormatReaderSource> currentFileSource;
+    std::unique_ptr<PositionableAudioSource> currentFileSource;
     AudioTransportSource transportSource;
 
     AudioFormatManager formatManager;
@@ -226,6 +229,11 @@ public:
 
     std::unordered_map<const SoundSample*, std::shared_ptr<SamplePlaybackManager>>& getActiveSamples() { return activeSamples; }
 
+    /**
+     * @return The sample cache, shared by all soundboard channel processors.
+     */
+    SoundboardSampleCache& getSampleCache() { return sampleCache.get(); }
+
 private:
     MixerAudioSource mixer;
     std::unordered_map<const SoundSample*, std::shared_ptr<SamplePlaybackManager>> activeSamples;
@@ -236,6 +244,7 @@ private:
     SonoAudio::ChannelGroup recordChannelGroup;
 
     TimeSliceThread diskThread { "soundboard audio file reader" };
+    SharedResourcePointer<SoundboardSampleCache> sampleCache;
 
     float lastGain = 0.0f;
 };
@@ -13,6 +13,9 @@ SoundboardProcessor::SoundboardProcessor(SoundboardChannelProcessor* channelProc
     soundboardsFile = supportDir.getChildFile("soundboards.xml");
 
     loadFromDisk();
+
+    channelProcessor->getSampleCache().setMemoryBudget((int64) sampleCacheBudgetMB * 1024 * 1024);
+    preloadSamples();
 }
 
 SoundboardProcessor::~SoundboardProcessor()
@@ -77,6 +80,7 @@ void SoundboardProcessor::deleteSoundboard(int index)
 
     reorderSoundboards();
     saveToDisk();
+    preloadSamples();
 }
 
 void SoundboardProcessor::selectSoundboard(int index)
@@ -130,6 +134,7 @@ SoundSample* SoundboardProcessor::addSoundSample(String name, String absolutePat
     sampleList.emplace_back(std::move(sampleToAdd));
 
     saveToDisk();
+    preloadSamples();
 
     return &sampleList[sampleList.size() - 1];
 }
@@ -180,6 +185,7 @@ void SoundboardProcessor::editSoundSample(SoundSample& sampleToUpdate, bool save
     }
 
     updatePlaybackSettings(sampleToUpdate);
+    preloadSamples();
 }
 
 void SoundboardProcessor::updatePlaybackSettings(SoundSample& sampleToUpdate)
@@ -244,6 +250,7 @@ bool SoundboardProcessor::deleteSoundSample(SoundSample& sampleToDelete, std::op
     }
 
     saveToDisk();
+    preloadSamples();
     return true;
 }
 
@@ -299,6 +306,7 @@ void SoundboardProcessor::writeSoundboardsToFile(const File& file)
     tree.setProperty(SELECTED_KEY, selectedSoundboardIndex.value_or(-1), nullptr);
     tree.setProperty(HOTKEYS_MUTED_KEY, hotkeysMuted, nullptr);
     tree.setProperty(HOTKEYS_NUMERIC_KEY, numericHotkeyAllowed, nullptr);
+    tree.setProperty(SAMPLE_CACHE_BUDGET_KEY, sampleCacheBudgetMB, nullptr);
 
     int i = 0;
     for (auto& soundboard: soundboards) {
@@ -324,6 +332,7 @@ void SoundboardProcessor::readSoundboardsFromFile(const File& file)
     selectedSoundboardIndex = selected >= 0 ? std::optional<size_t>(selected) : std::nullopt;
     hotkeysMuted = tree.getProperty(HOTKEYS_MUTED_KEY, hotkeysMuted);
     numericHotkeyAllowed = tree.getProperty(HOTKEYS_NUMERIC_KEY, numericHotkeyAllowed);
+    sampleCacheBudgetMB = tree.getProperty(SAMPLE_CACHE_BUDGET_KEY, sampleCacheBudgetMB);
 
     soundboards.clear();
 
@@ -332,6 +341,39 @@ void SoundboardProcessor::readSoundboardsFromFile(const File& file)
     }
 }
 
+void SoundboardProcessor::setSampleCacheBudgetMB(int megabytes)
+{
+    sampleCacheBudgetMB = jmax(0, megabytes);
+    channelProcessor->getSampleCache().setMemoryBudget((int64) sampleCacheBudgetMB * 1024 * 1024);
+    saveToDisk();
+    preloadSamples();
+}
+
+void SoundboardProcessor::preloadSamples()
+{
+    auto& cache = channelProcessor->getSampleCache();
+    Array<URL> urls;
+
+    auto addSoundboard = [&](Soundboard& soundboard) {
+        for (auto& sample : soundboard.getSamples()) {
+            urls.addIfNotAlreadyThere(sample.getFileURL());
+        }
+    };
+
+    if (selectedSoundboardIndex.has_value() && *selectedSoundboardIndex >= 0 && *selectedSoundboardIndex < soundboards.size()) {
+        addSoundboard(soundboards[*selectedSoundboardIndex]);
+    }
+    for (auto& soundboard : soundboards) {
+        addSoundboard(soundboard);
+    }
+
+    // files removed from every soundboard are dropped, the rest queued in order
+    cache.retainOnly(urls);
+    for (auto& url : urls) {
+        cache.preload(url);
+    }
+}
+
 void SoundboardProcessor::saveToDisk()
 {
     writeSoundboardsToFile(soundboardsFile);
@@ -169,7 +169,21 @@ public:
         saveToDisk();
     }
 
-    
+    /**
+     * @return The maximum amount of RAM in megabytes used for decoded sound samples.
+     */
+    [[nodiscard]] int getSampleCacheBudgetMB() const { return sampleCacheBudgetMB; }
+
+    /**
+     * Set the maximum amount of RAM in megabytes used for decoded sound samples.
+     */
+    void setSampleCacheBudgetMB(int megabytes);
+
+    /**
+     * Makes sure the sample cache holds the sound files of all soundboards, starting with the selected one.
+     */
+    void preloadSamples();
+
     /**
      * Saves the current soundboard data to disk.
      */
@@ -201,6 +215,11 @@ protected:
     constexpr static const char HOTKEYS_MUTED_KEY[] = "hotkeysMuted";
     constexpr static const char HOTKEYS_NUMERIC_KEY[] = "hotkeysAllowNumeric";
 
+    /*
+     * Key of the root node property in the serialized tree data structure that stores the sample cache memory budget.
+     */
+    constexpr static const char SAMPLE_CACHE_BUDGET_KEY[] = "sampleCacheBudgetMB";
+
     File soundboardsFile;
 
     /**
@@ -228,6 +247,8 @@ protected:
 
     bool numericHotkeyAllowed = true;
 
+    int sampleCacheBudgetMB = (int) (SoundboardSampleCache::DEFAULT_MEMORY_BUDGET / (1024 * 1024));
+
     /**
      * Writes the soundboard data to the given file.
      *
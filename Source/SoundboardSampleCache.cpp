@@ -0,0 +1,368 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+#include "SoundboardSampleCache.h"
+
+CachedSampleData::~CachedSampleData()
+{
+    mappedReader.reset();
+
+    if (tempFile != File()) {
+        tempFile.deleteFile();
+    }
+}
+
+int64 CachedSampleData::getMemoryUsage() const
+{
+    return (int64) buffer.getNumChannels() * buffer.getNumSamples() * (int64) sizeof(float);
+}
+
+void CachedSampleData::read(AudioBuffer<float>& dest, int destStartSample, int64 startSample, int numSamples)
+{
+    if (mappedReader) {
+        mappedReader->read(&dest, destStartSample, numSamples, startSample, true, true);
+        return;
+    }
+
+    for (int ch = 0; ch < dest.getNumChannels(); ++ch) {
+        if (numChannels > 0) {
+            dest.copyFrom(ch, destStartSample, buffer, jmin(ch, numChannels - 1), (int) startSample, numSamples);
+        } else {
+            dest.clear(ch, destStartSample, numSamples);
+        }
+    }
+}
+
+
+CachedSampleSource::CachedSampleSource(std::shared_ptr<CachedSampleData> data_)
+    : data(std::move(data_))
+{
+}
+
+int64 CachedSampleSource::getNextReadPosition() const
+{
+    auto length = data->getLengthInSamples();
+    return looping && length > 0 ? nextPlayPos.load() % length : nextPlayPos.load();
+}
+
+void CachedSampleSource::getNextAudioBlock(const AudioSourceChannelInfo& info)
+{
+    auto length = data->getLengthInSamples();
+    auto pos = nextPlayPos.load();
+    int destStart = info.startSample;
+    int remaining = info.numSamples;
+
+    while (remaining > 0) {
+        auto readPos = looping && length > 0 ? pos % length : pos;
+        auto numToRead = (int) jmin((int64) remaining, jmax((int64) 0, length - readPos));
+
+        if (numToRead <= 0) {
+            // past the end
+            info.buffer->clear(destStart, remaining);
+            pos += remaining;
+            break;
+        }
+
+        data->read(*info.buffer, destStart, readPos, numToRead);
+
+        destStart += numToRead;
+        remaining -= numToRead;
+        pos += numToRead;
+    }
+
+    nextPlayPos = pos;
+}
+
+
+SoundboardSampleCache::SoundboardSampleCache() : Thread("soundboard sample cache")
+{
+    formatManager.registerBasicFormats();
+
+    tempDirectory = File::getSpecialLocation(File::tempDirectory).getNonexistentChildFile("SonobusSampleCache", "", false);
+
+    startThread(Thread::Priority::low);
+}
+
+SoundboardSampleCache::~SoundboardSampleCache()
+{
+    stopThread(5000);
+
+    {
+        const ScopedLock sl(entriesLock);
+        entries.clear();
+    }
+
+    tempDirectory.deleteRecursively();
+}
+
+void SoundboardSampleCache::preload(const URL& url)
+{
+    if (url.isEmpty()) return;
+
+    const ScopedLock sl(entriesLock);
+
+    auto key = getKey(url);
+    if (entries.find(key) != entries.end()) {
+        return;
+    }
+
+    Entry entry;
+    entry.url = url;
+    entry.lastUsed = ++useCounter;
+    entries[key] = std::move(entry);
+    pending.add(key);
+
+    notify();
+}
+
+std::shared_ptr<CachedSampleData> SoundboardSampleCache::get(const URL& url)
+{
+    const ScopedLock sl(entriesLock);
+
+    auto found = entries.find(getKey(url));
+    if (found == entries.end()) {
+        preload(url);
+        return nullptr;
+    }
+
+    found->second.lastUsed = ++useCounter;
+    return found->second.data;
+}
+
+void SoundboardSampleCache::retainOnly(const Array<URL>& urls)
+{
+    StringArray keys;
+    for (auto& url : urls) {
+        keys.add(getKey(url));
+    }
+
+    const ScopedLock sl(entriesLock);
+
+    for (auto iter = entries.begin(); iter != entries.end();) {
+        if (!keys.contains(iter->first)) {
+            if (iter->second.data) {
+                memoryUsage -= iter->second.data->getMemoryUsage();
+            }
+            pending.removeString(iter->first);
+            iter = entries.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+}
+
+void SoundboardSampleCache::setMemoryBudget(int64 numBytes)
+{
+    memoryBudget = jmax((int64) 0, numBytes);
+
+    const ScopedLock sl(entriesLock);
+    evictToBudget();
+}
+
+void SoundboardSampleCache::evictToBudget()
+{
+    while (memoryUsage.load() > memoryBudget.load()) {
+        auto oldest = entries.end();
+
+        for (auto iter = entries.begin(); iter != entries.end(); ++iter) {
+            if (iter->second.data && iter->second.data->getMemoryUsage() > 0
+                && (oldest == entries.end() || iter->second.lastUsed < oldest->second.lastUsed)) {
+                oldest = iter;
+            }
+        }
+
+        if (oldest == entries.end()) {
+            break;
+        }
+
+        // next use of it loads it again, memory-mapped if it still doesn't fit
+        DBG("Evicting cached sample: " << oldest->first);
+        memoryUsage -= oldest->second.data->getMemoryUsage();
+        entries.erase(oldest);
+    }
+}
+
+void SoundboardSampleCache::run()
+{
+    while (!threadShouldExit()) {
+        String key;
+        URL url;
+
+        {
+            const ScopedLock sl(entriesLock);
+            if (pending.size() > 0) {
+                key = pending[0];
+                pending.remove(0);
+
+                auto found = entries.find(key);
+                if (found != entries.end()) {
+                    url = found->second.url;
+                }
+            }
+        }
+
+        if (key.isEmpty()) {
+            wait(-1);
+            continue;
+        }
+
+        if (url.isEmpty()) {
+            continue;
+        }
+
+        auto data = loadSample(url);
+
+        const ScopedLock sl(entriesLock);
+
+        auto found = entries.find(key);
+        if (found == entries.end()) {
+            // removed while loading
+            continue;
+        }
+
+        // a reload replaces what was there
+        if (found->second.data) {
+            memoryUsage -= found->second.data->getMemoryUsage();
+        }
+
+        found->second.data = data;
+
+        if (data) {
+            memoryUsage += data->getMemoryUsage();
+        } else {
+            DBG("Could not cache sample: " << key);
+        }
+    }
+}
+
+std::shared_ptr<CachedSampleData> SoundboardSampleCache::loadSample(const URL& url)
+{
+    auto reader = createReaderFor(formatManager, url);
+    if (!reader || reader->sampleRate <= 0.0 || reader->lengthInSamples <= 0) {
+        return nullptr;
+    }
+
+    auto data = std::make_shared<CachedSampleData>();
+    data->sampleRate = reader->sampleRate;
+    data->lengthInSamples = reader->lengthInSamples;
+    data->numChannels = (int) reader->numChannels;
+
+    const auto numBytes = reader->lengthInSamples * (int64) reader->numChannels * (int64) sizeof(float);
+    const bool isShort = reader->lengthInSamples <= (int64) (MAX_IN_MEMORY_SECONDS * reader->sampleRate);
+
+    if (isShort && memoryUsage.load() + numBytes <= memoryBudget.load()) {
+        data->buffer.setSize((int) reader->numChannels, (int) reader->lengthInSamples);
+        if (!reader->read(&data->buffer, 0, (int) reader->lengthInSamples, 0, true, true)) {
+            return nullptr;
+        }
+        return data;
+    }
+
+    // map uncompressed local files directly, decode anything else to a float WAV file first
+    if (url.isLocalFile()) {
+        data->mappedReader = mapFile(url.getLocalFile());
+    }
+
+    if (!data->mappedReader) {
+        if (!tempDirectory.createDirectory()) {
+            return nullptr;
+        }
+
+        auto tempFile = tempDirectory.getNonexistentChildFile("sample", ".wav", false);
+        {
+            auto stream = std::make_unique<FileOutputStream>(tempFile);
+            if (stream->failedToOpen()) {
+                return nullptr;
+            }
+
+            std::unique_ptr<AudioFormatWriter> writer (WavAudioFormat().createWriterFor(stream.get(), reader->sampleRate, reader->numChannels, 32, {}, 0));
+            if (!writer) {
+                tempFile.deleteFile();
+                return nullptr;
+            }
+            stream.release(); // owned by the writer now
+
+            if (!writer->writeFromAudioReader(*reader, 0, -1)) {
+                writer.reset();
+                tempFile.deleteFile();
+                return nullptr;
+            }
+        }
+
+        data->tempFile = tempFile;
+        data->mappedReader = mapFile(tempFile);
+        if (!data->mappedReader) {
+            return nullptr;
+        }
+    }
+
+    // fault in the start of the file so the first trigger doesn't wait for the disk
+    auto touchLength = jmin(data->lengthInSamples, (int64) (2.0 * data->sampleRate));
+    for (int64 pos = 0; pos < touchLength; pos += 1024) {
+        data->mappedReader->touchSample(pos);
+    }
+
+    return data;
+}
+
+std::unique_ptr<MemoryMappedAudioFormatReader> SoundboardSampleCache::mapFile(const File& file)
+{
+    std::unique_ptr<MemoryMappedAudioFormatReader> reader;
+
+    if (file.hasFileExtension("wav")) {
+        reader.reset(WavAudioFormat().createMemoryMappedReader(file));
+    }
+    else if (file.hasFileExtension("aif;aiff")) {
+        reader.reset(AiffAudioFormat().createMemoryMappedReader(file));
+    }
+
+    if (reader && reader->mapEntireFile() && !reader->getMappedSection().isEmpty()) {
+        return reader;
+    }
+
+    return nullptr;
+}
+
+std::unique_ptr<AudioFormatReader> SoundboardSampleCache::createReaderFor(AudioFormatManager& formatManager, const URL& audioFileUrl)
+{
+    std::unique_ptr<AudioFormatReader> reader;
+
+#if ! (JUCE_IOS || JUCE_ANDROID)
+    if (audioFileUrl.isLocalFile()) {
+        reader.reset(formatManager.createReaderFor(audioFileUrl.getLocalFile()));
+    }
+    else
+#endif
+    {
+#if JUCE_ANDROID
+        auto doc = AndroidDocument::fromDocument(audioFileUrl);
+        if (!doc.hasValue()) {
+            doc = AndroidDocument::fromFile(audioFileUrl.getLocalFile());
+        }
+
+        if (doc.hasValue()) {
+            DBG("Loading Android doc: " << doc.getInfo().getName());
+            if (doc.getInfo().canRead()) {
+
+                if (auto strm = doc.createInputStream()) {
+                    reader.reset(formatManager.createReaderFor (std::move(strm)));
+                }
+                else {
+                    DBG("Could not load android doc with URL: " << audioFileUrl.toString(false));
+                }
+            } else {
+                DBG("No permission to read android doc with URL: " << audioFileUrl.toString(false));
+            }
+        }
+#else
+        if (auto strm = audioFileUrl.createInputStream(URL::InputStreamOptions(URL::ParameterHandling::inAddress))) {
+            reader.reset(formatManager.createReaderFor(std::move(strm)));
+        }
+        else {
+            DBG("Could not load from URL: " << audioFileUrl.toString(false));
+        }
+#endif
+    }
+
+    return reader;
+}
@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include "JuceHeader.h"
+
+/**
+ * Decoded audio data of a sound file, shared by every soundboard sample referencing that file.
+ *
+ * Short files are fully decoded into memory, longer ones are kept as memory-mapped PCM.
+ * Either way, reading never touches the decoder, so playback can start within the current block.
+ */
+class CachedSampleData
+{
+public:
+    ~CachedSampleData();
+
+    double getSampleRate() const { return sampleRate; }
+    int64 getLengthInSamples() const { return lengthInSamples; }
+    int getNumChannels() const { return numChannels; }
+
+    bool isMemoryMapped() const { return mappedReader != nullptr; }
+
+    /**
+     * @return The number of bytes of RAM held by the decoded buffer, 0 when memory-mapped.
+     */
+    int64 getMemoryUsage() const;
+
+    /**
+     * Copies samples into the destination buffer, mono files are copied into every destination channel.
+     * Safe to call from the audio thread.
+     */
+    void read(AudioBuffer<float>& dest, int destStartSample, int64 startSample, int numSamples);
+
+private:
+    friend class SoundboardSampleCache;
+
+    double sampleRate = 44100.0;
+    int64 lengthInSamples = 0;
+    int numChannels = 0;
+
+    AudioBuffer<float> buffer;
+    std::unique_ptr<MemoryMappedAudioFormatReader> mappedReader;
+
+    /**
+     * Decoded copy of a compressed file that is being memory-mapped, deleted along with this.
+     */
+    File tempFile;
+};
+
+/**
+ * Audio source playing from cached sample data, for use with an AudioTransportSource without read-ahead.
+ */
+class CachedSampleSource : public PositionableAudioSource
+{
+public:
+    explicit CachedSampleSource(std::shared_ptr<CachedSampleData> data);
+
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override {}
+    void releaseResources() override {}
+    void getNextAudioBlock(const AudioSourceChannelInfo& info) override;
+
+    void setNextReadPosition(int64 newPosition) override { nextPlayPos = newPosition; }
+    int64 getNextReadPosition() const override;
+    int64 getTotalLength() const override { return data->getLengthInSamples(); }
+    bool isLooping() const override { return looping; }
+    void setLooping(bool shouldLoop) override { looping = shouldLoop; }
+
+private:
+    std::shared_ptr<CachedSampleData> data;
+    std::atomic<int64> nextPlayPos { 0 };
+    bool looping = false;
+};
+
+/**
+ * Preloads the sound files used by the soundboards in the background.
+ *
+ * The cache is shared by all soundboard channel processors (use it through a SharedResourcePointer),
+ * and entries are keyed by file URL, so soundboards referencing the same file share its decoded data.
+ * Files up to MAX_IN_MEMORY_SECONDS long are decoded into RAM while they fit within the memory budget,
+ * everything else is memory-mapped. When the budget is lowered, the least recently used files are evicted.
+ */
+class SoundboardSampleCache : private Thread
+{
+public:
+    SoundboardSampleCache();
+    ~SoundboardSampleCache() override;
+
+    /**
+     * Queues a file to be loaded into the cache, does nothing when it is already cached or queued.
+     */
+    void preload(const URL& url);
+
+    /**
+     * Returns the cached data for the file, or nullptr when it isn't loaded (yet).
+     * A file that isn't known to the cache yet is queued for preloading.
+     */
+    std::shared_ptr<CachedSampleData> get(const URL& url);
+
+    /**
+     * Drops all cached files except the given ones. Data still in use by a player is released once playback ends.
+     */
+    void retainOnly(const Array<URL>& urls);
+
+    /**
+     * Sets the maximum amount of RAM used by decoded samples, evicting the least recently used ones when needed.
+     */
+    void setMemoryBudget(int64 numBytes);
+    int64 getMemoryBudget() const { return memoryBudget.load(); }
+
+    /**
+     * @return The number of bytes of RAM currently held by decoded samples.
+     */
+    int64 getMemoryUsage() const { return memoryUsage.load(); }
+
+    /**
+     * Creates a reader for a sound file URL, handling Android documents and remote URLs.
+     *
+     * @return The reader, or nullptr when the file could not be opened.
+     */
+    static std::unique_ptr<AudioFormatReader> createReaderFor(AudioFormatManager& formatManager, const URL& url);
+
+    constexpr static const double MAX_IN_MEMORY_SECONDS = 30.0;
+    constexpr static const int64 DEFAULT_MEMORY_BUDGET = 256 * 1024 * 1024;
+
+private:
+    struct Entry
+    {
+        URL url;
+        std::shared_ptr<CachedSampleData> data;
+        uint32 lastUsed = 0;
+    };
+
+    void run() override;
+
+    std::shared_ptr<CachedSampleData> loadSample(const URL& url);
+    std::unique_ptr<MemoryMappedAudioFormatReader> mapFile(const File& file);
+    void evictToBudget();
+
+    static String getKey(const URL& url) { return url.toString(false); }
+
+    AudioFormatManager formatManager;
+    File tempDirectory;
+
+    CriticalSection entriesLock;
+    std::map<String, Entry> entries;
+    StringArray pending;
+    uint32 useCounter = 0;
+
+    std::atomic<int64> memoryBudget { DEFAULT_MEMORY_BUDGET };
+    std::atomic<int64> memoryUsage { 0 };
+};
@@ -0,0 +1,569 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+
+#include "StreamCapture.h"
+
+using namespace SonoAudio;
+
+namespace {
+
+const char fileMagic[8] = { 'S', 'B', 'C', 'A', 'P', 'T', 'U', 'R' };
+const int formatVersion = 1;
+
+// record types, each record is: type (1 byte), body size (int32), body
+const char recordFormat = 'F';
+const char recordBlock = 'B';
+
+const int recordHeaderBytes = 5;
+const int maxFormatBodyBytes = 3 * 4 + 1 + 255 + 4; // without settings
+const int blockBodyBytes = 4 + 8 + 4 + 8 + 4; // without data
+
+// max silence filled by packet loss concealment for missing sequences, beyond that the arrival times are used
+const double maxConcealMillis = 1000.0;
+
+template <typename T>
+char * put (char * dest, T value)
+{
+    memcpy(dest, &value, sizeof(T)); // little-endian platforms only, same as the aoo wire format
+    return dest + sizeof(T);
+}
+
+template <typename T>
+T get (const char *& src)
+{
+    T value;
+    memcpy(&value, src, sizeof(T));
+    src += sizeof(T);
+    return value;
+}
+
+struct CaptureRecord
+{
+    char type = 0;
+    MemoryBlock body;
+};
+
+class CaptureReader
+{
+public:
+    CaptureReader(const File & file) : in(file)
+    {
+        if (in.failedToOpen()) return;
+
+        char magic[sizeof(fileMagic)];
+        if (in.read(magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, fileMagic, sizeof(fileMagic)) != 0) return;
+        if (in.readInt() != formatVersion) return;
+
+        sessionStartMillis = in.readInt64();
+        const int namelen = in.readInt();
+        if (namelen < 0 || namelen > 1024) return;
+        MemoryBlock name;
+        in.readIntoMemoryBlock(name, namelen);
+        peerName = name.toString();
+
+        valid = true;
+    }
+
+    // returns false at the end, or at an incomplete record (cut off capture)
+    bool next(CaptureRecord & record)
+    {
+        if (!valid || in.getNumBytesRemaining() < recordHeaderBytes) return false;
+
+        record.type = in.readByte();
+        const int size = in.readInt();
+        if (size < 0 || in.getNumBytesRemaining() < size) return false;
+
+        record.body.setSize((size_t) size, false);
+        return in.read(record.body.getData(), size) == size;
+    }
+
+    FileInputStream in;
+    bool valid = false;
+    int64 sessionStartMillis = 0;
+    String peerName;
+};
+
+struct FormatRecord
+{
+    int numChannels = 0;
+    int sampleRate = 0;
+    int blockSize = 0;
+    String codec;
+    const char * settings = nullptr;
+    int settingsSize = 0;
+};
+
+bool parseFormat(const CaptureRecord & record, FormatRecord & f)
+{
+    if (record.body.getSize() < 3 * 4 + 1) return false;
+
+    const char * ptr = static_cast<const char*>(record.body.getData());
+    const char * end = ptr + record.body.getSize();
+    f.numChannels = get<int32>(ptr);
+    f.sampleRate = get<int32>(ptr);
+    f.blockSize = get<int32>(ptr);
+    const int namelen = (uint8) get<char>(ptr);
+    if (ptr + namelen + 4 > end) return false;
+    f.codec = String(ptr, (size_t) namelen);
+    ptr += namelen;
+    f.settingsSize = get<int32>(ptr);
+    f.settings = ptr;
+    return f.settingsSize >= 0 && ptr + f.settingsSize <= end && f.numChannels > 0 && f.sampleRate > 0 && f.blockSize > 0;
+}
+
+struct BlockRecord
+{
+    int32 sequence = 0;
+    double sampleRate = 0.0;
+    int32 channel = 0;
+    double arrivalMillis = 0.0;
+    const char * data = nullptr; // null for dropped blocks
+    int size = 0;
+};
+
+bool parseBlock(const CaptureRecord & record, BlockRecord & b)
+{
+    if (record.body.getSize() < (size_t) blockBodyBytes) return false;
+
+    const char * ptr = static_cast<const char*>(record.body.getData());
+    b.sequence = get<int32>(ptr);
+    b.sampleRate = get<double>(ptr);
+    b.channel = get<int32>(ptr);
+    b.arrivalMillis = get<double>(ptr);
+    const int32 size = get<int32>(ptr);
+    b.data = size >= 0 ? ptr : nullptr;
+    b.size = jmax(0, size);
+    return (size_t) (blockBodyBytes + b.size) <= record.body.getSize();
+}
+
+// one instance of a registered aoo codec's decoder
+class CaptureCodec
+{
+public:
+    ~CaptureCodec() { reset(); }
+
+    bool setFormat(const FormatRecord & f)
+    {
+        const aoo_codec * newcodec = aoo_find_codec(f.codec.toRawUTF8());
+        if (!newcodec) return false;
+
+        if (newcodec != codec) {
+            reset();
+            codec = newcodec;
+            obj = codec->decoder_new();
+        }
+        if (!obj) return false;
+
+        aoo_format_storage fs;
+        fs.header.codec = codec->name;
+        fs.header.nchannels = f.numChannels;
+        fs.header.samplerate = f.sampleRate;
+        fs.header.blocksize = f.blockSize;
+        if (codec->decoder_readformat(obj, &fs.header, f.settings, f.settingsSize) < 0) return false;
+
+        numChannels = f.numChannels;
+        blockSize = f.blockSize;
+        interleaved.realloc((size_t) numChannels * blockSize);
+        return true;
+    }
+
+    // data of null does packet loss concealment, an empty block is silent
+    bool decode(const char * data, int size, AudioBuffer<float> & dest)
+    {
+        const int nsamples = numChannels * blockSize;
+        if (data && size == 0) {
+            dest.clear(0, blockSize);
+            return true;
+        }
+        if (!obj || codec->decoder_decode(obj, data, size, interleaved.get(), nsamples) < 0) {
+            dest.clear(0, blockSize);
+            return false;
+        }
+
+        dest.clear(0, blockSize);
+        for (int ch=0; ch < numChannels && ch < dest.getNumChannels(); ++ch) {
+            auto * dst = dest.getWritePointer(ch);
+            for (int i=0; i < blockSize; ++i) {
+                dst[i] = interleaved[i * numChannels + ch];
+            }
+        }
+        return true;
+    }
+
+    bool isReady() const { return obj != nullptr; }
+    int getBlockSize() const { return blockSize; }
+
+private:
+    void reset()
+    {
+        if (obj && codec) {
+            codec->decoder_free(obj);
+        }
+        obj = nullptr;
+        codec = nullptr;
+    }
+
+    const aoo_codec * codec = nullptr;
+    void * obj = nullptr;
+    int numChannels = 0;
+    int blockSize = 0;
+    HeapBlock<aoo_sample> interleaved;
+};
+
+bool writeSilence(AudioFormatWriter & writer, AudioBuffer<float> & work, int64 numSamples)
+{
+    work.clear();
+    while (numSamples > 0) {
+        const int n = (int) jmin((int64) work.getNumSamples(), numSamples);
+        if (!writer.writeFromAudioSampleBuffer(work, 0, n)) return false;
+        numSamples -= n;
+    }
+    return true;
+}
+
+}
+
+const char * StreamCaptureWriter::fileExtension = ".sbcap";
+
+StreamCaptureWriter::StreamCaptureWriter(std::unique_ptr<OutputStream> stream_, const String & peerName, int64 sessionStartMillis,
+                                         double sessionStartHiRes, int fifoBytes)
+: stream(std::move(stream_)), fifo(fifoBytes), startTimeMs(sessionStartHiRes)
+{
+    fifoData.calloc((size_t) fifoBytes);
+
+    if (!stream) {
+        ok = false;
+        return;
+    }
+
+    auto name = peerName.toUTF8();
+    const int namelen = jmin(1024, (int) name.sizeInBytes() - 1);
+
+    stream->write(fileMagic, sizeof(fileMagic));
+    stream->writeInt(formatVersion);
+    stream->writeInt64(sessionStartMillis);
+    stream->writeInt(namelen);
+    ok = stream->write(name.getAddress(), (size_t) namelen);
+}
+
+StreamCaptureWriter::~StreamCaptureWriter()
+{
+}
+
+aoo_capture_handler StreamCaptureWriter::getHandler()
+{
+    aoo_capture_handler handler;
+    handler.format = &StreamCaptureWriter::handleFormat;
+    handler.block = &StreamCaptureWriter::handleBlock;
+    handler.user = this;
+    return handler;
+}
+
+void StreamCaptureWriter::handleFormat(void *user, void *endpoint, int32_t id, const aoo_format *format, const char *settings, int32_t size)
+{
+    auto * self = static_cast<StreamCaptureWriter*>(user);
+    char header[recordHeaderBytes + maxFormatBodyBytes];
+
+    const int namelen = jmin(255, (int) strlen(format->codec));
+    char * ptr = header + recordHeaderBytes;
+    ptr = put<int32>(ptr, format->nchannels);
+    ptr = put<int32>(ptr, format->samplerate);
+    ptr = put<int32>(ptr, format->blocksize);
+    ptr = put<char>(ptr, (char) namelen);
+    memcpy(ptr, format->codec, (size_t) namelen);
+    ptr += namelen;
+    ptr = put<int32>(ptr, size);
+
+    const int headersize = (int) (ptr - header);
+    put<char>(header, recordFormat);
+    put<int32>(header + 1, headersize - recordHeaderBytes + size);
+
+    self->pushRecord(header, headersize, settings, size);
+}
+
+void StreamCaptureWriter::handleBlock(void *user, void *endpoint, int32_t id, int32_t sequence, double samplerate, int32_t channel, const char *data, int32_t size)
+{
+    auto * self = static_cast<StreamCaptureWriter*>(user);
+    char header[recordHeaderBytes + blockBodyBytes];
+
+    char * ptr = header;
+    ptr = put<char>(ptr, recordBlock);
+    ptr = put<int32>(ptr, blockBodyBytes + (data ? size : 0));
+    ptr = put<int32>(ptr, sequence);
+    ptr = put<double>(ptr, samplerate);
+    ptr = put<int32>(ptr, channel);
+    ptr = put<double>(ptr, Time::getMillisecondCounterHiRes() - self->startTimeMs);
+    ptr = put<int32>(ptr, data ? size : -1);
+
+    if (self->pushRecord(header, (int) sizeof(header), data, data ? size : 0)) {
+        self->capturedBlocks.fetch_add(1, std::memory_order_relaxed);
+    }
+    else {
+        self->droppedBlocks.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool StreamCaptureWriter::pushRecord(const void * header, int headerSize, const void * payload, int payloadSize)
+{
+    if (!ok || fifo.getFreeSpace() < headerSize + payloadSize) {
+        return false;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(headerSize + payloadSize, start1, size1, start2, size2);
+
+    // copy header and payload as one contiguous span across the two fifo segments
+    auto copySpan = [&](const char * src, int srcsize, int offset) {
+        while (srcsize > 0) {
+            const bool first = offset < size1;
+            const int segstart = first ? start1 + offset : start2 + (offset - size1);
+            const int segleft = first ? size1 - offset : size2 - (offset - size1);
+            const int n = jmin(srcsize, segleft);
+            memcpy(fifoData.get() + segstart, src, (size_t) n);
+            src += n;
+            srcsize -= n;
+            offset += n;
+        }
+    };
+
+    copySpan(static_cast<const char*>(header), headerSize, 0);
+    if (payloadSize > 0) {
+        copySpan(static_cast<const char*>(payload), payloadSize, headerSize);
+    }
+
+    fifo.finishedWrite(size1 + size2);
+    return true;
+}
+
+bool StreamCaptureWriter::drain()
+{
+    const ScopedLock sl (drainLock);
+
+    const int ready = fifo.getNumReady();
+    if (ready <= 0 || !stream) return false;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(ready, start1, size1, start2, size2);
+
+    if (size1 > 0) ok &= stream->write(fifoData.get() + start1, (size_t) size1);
+    if (size2 > 0) ok &= stream->write(fifoData.get() + start2, (size_t) size2);
+
+    fifo.finishedRead(size1 + size2);
+    return true;
+}
+
+int StreamCaptureWriter::useTimeSlice()
+{
+    return drain() ? 20 : 100;
+}
+
+bool StreamCaptureWriter::finish()
+{
+    drain();
+
+    const ScopedLock sl (drainLock);
+    if (stream) {
+        stream->flush();
+    }
+
+    if (droppedBlocks.load() > 0) {
+        DBG("Stream capture dropped " << droppedBlocks.load() << " blocks");
+    }
+
+    return ok;
+}
+
+
+//////////////////////////
+
+Array<File> StreamCaptureDecoder::findCaptureFiles(const File & directory)
+{
+    return directory.findChildFiles(File::findFiles, false, String("*") + StreamCaptureWriter::fileExtension);
+}
+
+bool StreamCaptureDecoder::scanFile(const File & source, CaptureInfo & info)
+{
+    CaptureReader reader(source);
+    if (!reader.valid) return false;
+
+    info = CaptureInfo();
+    info.peerName = reader.peerName;
+    info.sessionStartMillis = reader.sessionStartMillis;
+
+    CaptureRecord record;
+    while (reader.next(record)) {
+        if (record.type == recordFormat) {
+            FormatRecord f;
+            if (parseFormat(record, f)) {
+                info.numChannels = jmax(info.numChannels, f.numChannels);
+                if (info.sampleRate == 0) {
+                    info.sampleRate = f.sampleRate;
+                }
+            }
+        }
+        else if (record.type == recordBlock) {
+            BlockRecord b;
+            if (parseBlock(record, b) && info.sampleRate > 0) {
+                if (info.firstBlockMillis < 0.0) {
+                    info.firstBlockMillis = b.arrivalMillis;
+                }
+                ++info.numBlocks;
+                if (!b.data) ++info.numDroppedBlocks;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool StreamCaptureDecoder::decodeFile(const File & source, const File & dest, AudioFormat & format, int bitsPerSample,
+                                      double alignStartMillis, String & error)
+{
+    CaptureInfo info;
+    if (!scanFile(source, info)) {
+        error = TRANS("Invalid stream capture file: ") + source.getFullPathName();
+        return false;
+    }
+
+    if (info.numBlocks == 0 || info.numChannels <= 0) {
+        error = TRANS("No audio in stream capture: ") + source.getFullPathName();
+        return false;
+    }
+
+    std::unique_ptr<OutputStream> outstream (dest.createOutputStream(1 << 18));
+    if (!outstream) {
+        error = TRANS("Error creating output file: ") + dest.getFullPathName();
+        return false;
+    }
+
+    const double samplerate = info.sampleRate;
+    std::unique_ptr<AudioFormatWriter> writer (format.createWriterFor(outstream.get(), samplerate, (unsigned int) info.numChannels, bitsPerSample, {}, 0));
+    if (!writer) {
+        error = TRANS("Error creating writer for ") + dest.getFullPathName();
+        return false;
+    }
+    outstream.release(); // owned by writer now
+
+    CaptureReader reader(source);
+    CaptureCodec codec;
+    CaptureRecord record;
+    AudioBuffer<float> work;
+    int64 pos = 0;
+    int32 lastseq = 0;
+    bool haveseq = false;
+
+    auto timeToSamples = [&](double millis) {
+        return (int64) ((millis - alignStartMillis) * 0.001 * samplerate);
+    };
+
+    while (reader.next(record)) {
+        if (record.type == recordFormat) {
+            FormatRecord f;
+            if (!parseFormat(record, f) || !codec.setFormat(f)) {
+                DBG("Stream capture: unsupported format " << f.codec << " in " << source.getFileName());
+                continue;
+            }
+            if (f.sampleRate != info.sampleRate) {
+                DBG("Stream capture: sample rate changed to " << f.sampleRate << " in " << source.getFileName() << ", not resampled");
+            }
+            work.setSize(info.numChannels, jmax(f.blockSize, 4096), false, false, true);
+            // sequence numbers start over with a new format
+            haveseq = false;
+            continue;
+        }
+
+        BlockRecord b;
+        if (record.type != recordBlock || !parseBlock(record, b) || !codec.isReady()) {
+            continue;
+        }
+
+        const int blocksize = codec.getBlockSize();
+
+        if (haveseq && b.sequence > lastseq + 1) {
+            // conceal short gaps the same way the live sink would
+            const int64 missing = b.sequence - lastseq - 1;
+            if (missing * blocksize <= (int64) (maxConcealMillis * 0.001 * samplerate)) {
+                for (int64 i=0; i < missing; ++i) {
+                    codec.decode(nullptr, 0, work);
+                    if (!writer->writeFromAudioSampleBuffer(work, 0, blocksize)) return false;
+                    pos += blocksize;
+                }
+            }
+        }
+
+        // keep aligned with the arrival times if far behind (leading silence, stopped streams)
+        const int64 target = timeToSamples(b.arrivalMillis);
+        if (!haveseq || target - pos > (int64) (maxConcealMillis * 0.001 * samplerate)) {
+            if (target > pos) {
+                if (!writeSilence(*writer, work, target - pos)) return false;
+                pos = target;
+            }
+        }
+
+        codec.decode(b.data, b.size, work);
+        if (!writer->writeFromAudioSampleBuffer(work, 0, blocksize)) return false;
+        pos += blocksize;
+
+        lastseq = b.sequence;
+        haveseq = true;
+    }
+
+    return writer->flush();
+}
+
+bool StreamCaptureDecoder::decodeDirectory(const File & directory, SessionRecordingFinalizer::StemFormat stemFormat, int bitsPerSample,
+                                           Array<File> & results, String & error)
+{
+    auto files = findCaptureFiles(directory);
+    if (files.isEmpty()) {
+        error = TRANS("No stream captures found in ") + directory.getFullPathName();
+        return false;
+    }
+
+    // all stems start at the earliest block of the session, so they line up
+    Array<CaptureInfo> infos;
+    double alignstart = std::numeric_limits<double>::max();
+    for (auto & file : files) {
+        CaptureInfo info;
+        scanFile(file, info);
+        infos.add(info);
+        if (info.firstBlockMillis >= 0.0) {
+            alignstart = jmin(alignstart, info.firstBlockMillis);
+        }
+    }
+    if (alignstart == std::numeric_limits<double>::max()) {
+        alignstart = 0.0;
+    }
+
+    FlacAudioFormat flacFormat;
+    WavAudioFormat wavFormat;
+    bool allok = true;
+
+    for (int i=0; i < files.size(); ++i) {
+        auto & source = files.getReference(i);
+
+        // flac only supports up to 8 channels
+        AudioFormat * format = (stemFormat == SessionRecordingFinalizer::StemFormatFLAC && infos[i].numChannels <= 8) ? (AudioFormat*) &flacFormat : (AudioFormat*) &wavFormat;
+        int bits = format == &flacFormat ? jmin(24, bitsPerSample) : bitsPerSample;
+
+        File dest = source.withFileExtension(format->getFileExtensions()[0]);
+        if (dest.exists()) {
+            dest = dest.getNonexistentSibling();
+        }
+
+        String ferror;
+        if (decodeFile(source, dest, *format, bits, alignstart, ferror)) {
+            results.add(dest);
+            DBG("Decoded stream capture: " << dest.getFullPathName() << " (" << infos[i].numDroppedBlocks << " of " << infos[i].numBlocks << " blocks were lost)");
+        }
+        else {
+            error = ferror;
+            DBG(ferror);
+            dest.deleteFile();
+            allok = false;
+        }
+    }
+
+    return allok;
+}
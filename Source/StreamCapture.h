@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include "aoo/aoo.hpp"
+
+#include "SessionRecording.h"
+
+namespace SonoAudio {
+
+// Raw network stream capture (.sbcap)
+//
+// Stores the encoded aoo blocks of a remote peer exactly as received (in stream order,
+// before decoding), along with the codec format and the arrival time of each block.
+// This costs almost nothing while recording, the capture is decoded into aligned
+// stems later with StreamCaptureDecoder.
+//
+// The aoo sink calls the capture handler from the network thread, which only
+// copies the block into a lock-free FIFO. A TimeSliceThread writes it to disk.
+
+class StreamCaptureWriter : public TimeSliceClient
+{
+public:
+    // block arrival times are stored relative to sessionStartHiRes (Time::getMillisecondCounterHiRes),
+    // which should be shared by all captures of a session so they can be aligned
+    StreamCaptureWriter(std::unique_ptr<OutputStream> stream, const String & peerName, int64 sessionStartMillis,
+                        double sessionStartHiRes, int fifoBytes = 1 << 20);
+    ~StreamCaptureWriter() override;
+
+    bool isOk() const { return stream != nullptr && ok; }
+
+    // handler to set as aoo_opt_capture_handler on the peer's sink
+    aoo_capture_handler getHandler();
+
+    // writes everything still queued and flushes the file, call after removing the handler
+    bool finish();
+
+    // blocks that did not fit into the fifo
+    int64 getDroppedBlocks() const { return droppedBlocks.load(); }
+    int64 getCapturedBlocks() const { return capturedBlocks.load(); }
+
+    int useTimeSlice() override;
+
+    static const char * fileExtension; // ".sbcap"
+
+private:
+    static void handleFormat(void *user, void *endpoint, int32_t id, const aoo_format *format, const char *settings, int32_t size);
+    static void handleBlock(void *user, void *endpoint, int32_t id, int32_t sequence, double samplerate, int32_t channel, const char *data, int32_t size);
+
+    // pushes a record consisting of header and payload, all or nothing
+    bool pushRecord(const void * header, int headerSize, const void * payload, int payloadSize);
+    bool drain();
+
+    std::unique_ptr<OutputStream> stream;
+    AbstractFifo fifo;
+    HeapBlock<char> fifoData;
+    double startTimeMs;
+    bool ok = true;
+
+    std::atomic<int64> droppedBlocks { 0 };
+    std::atomic<int64> capturedBlocks { 0 };
+    CriticalSection drainLock;
+};
+
+
+// decodes captured streams into regular audio files
+class StreamCaptureDecoder
+{
+public:
+    // finds all .sbcap files in a directory
+    static Array<File> findCaptureFiles(const File & directory);
+
+    // decodes all captures in the directory to stems next to them, aligned to each other.
+    // needs the aoo codecs to be registered (aoo_initialize)
+    static bool decodeDirectory(const File & directory, SessionRecordingFinalizer::StemFormat stemFormat, int bitsPerSample,
+                                Array<File> & results, String & error);
+
+    // decodes one capture, alignStartMillis is the session time the stem starts at.
+    // returns false if the file isn't a valid capture
+    static bool decodeFile(const File & source, const File & dest, AudioFormat & format, int bitsPerSample,
+                           double alignStartMillis, String & error);
+
+    struct CaptureInfo
+    {
+        String peerName;
+        int64 sessionStartMillis = 0;
+        int numChannels = 0; // max over all formats
+        int sampleRate = 0;  // of the first format
+        double firstBlockMillis = -1.0; // session time of the first block
+        int64 numBlocks = 0;
+        int64 numDroppedBlocks = 0;
+    };
+
+    // reads through the capture, returns false if it isn't a valid capture file
+    static bool scanFile(const File & source, CaptureInfo & info);
+};
+
+}
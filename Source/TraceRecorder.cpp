@@ -0,0 +1,322 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+
+#include "TraceRecorder.h"
+
+#include "aoo/aoo.h"
+
+using namespace SonoAudio;
+
+namespace {
+
+const int maxThreads = 32;
+const int eventsPerThread = 8192; // power of two
+
+// wait this long after a dump request, and at least this long between automatic dumps
+const double dumpDelayMs = 500.0;
+const double minDumpIntervalMs = 10000.0;
+
+struct TraceEvent
+{
+    int64 ticks;
+    const char * name;
+    int64 arg;
+    int32 id;
+    char phase;
+};
+
+struct ThreadRing
+{
+    // only the owning thread writes, readers throw away what may have been overwritten while copying
+    std::atomic<uint64> writePos { 0 };
+    // where the current owner started, a ring is reused once its thread exits
+    std::atomic<uint64> ownerStartPos { 0 };
+    std::atomic<bool> inUse { false };
+    std::atomic<bool> hasName { false };
+    char name[32] = {};
+    TraceEvent events[eventsPerThread];
+};
+
+struct TraceState
+{
+    // allocated on first enable and never freed, threads may still hold on to their ring
+    std::unique_ptr<ThreadRing[]> rings;
+    // highest ring index ever handed out, plus one
+    std::atomic<int> numRingsUsed { 0 };
+
+    std::atomic<double> dumpRequestedMs { 0.0 };
+    double lastDumpMs = 0.0;
+
+    CriticalSection dirLock;
+    File dumpDirectory;
+};
+
+TraceState & getState()
+{
+    static TraceState state;
+    return state;
+}
+
+// hands the ring back when the thread exits
+struct RingOwner
+{
+    ~RingOwner() {
+        if (ring) {
+            ring->inUse.store(false, std::memory_order_release);
+        }
+    }
+
+    ThreadRing * ring = nullptr;
+};
+
+thread_local RingOwner ringOwner;
+thread_local ThreadRing * currentRing = nullptr;
+thread_local bool noRingLeft = false;
+
+ThreadRing * getCurrentRing()
+{
+    if (currentRing || noRingLeft) {
+        return currentRing;
+    }
+
+    auto & state = getState();
+    int index = 0;
+    for (; index < maxThreads; ++index) {
+        bool expected = false;
+        if (state.rings[index].inUse.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            break;
+        }
+    }
+
+    if (index >= maxThreads) {
+        noRingLeft = true;
+        return nullptr;
+    }
+
+    int used = state.numRingsUsed.load();
+    while (used < index + 1 && !state.numRingsUsed.compare_exchange_weak(used, index + 1)) {}
+
+    currentRing = &state.rings[index];
+    ringOwner.ring = currentRing;
+
+    // the previous owner's events are not ours
+    currentRing->ownerStartPos.store(currentRing->writePos.load(std::memory_order_relaxed), std::memory_order_release);
+    currentRing->hasName.store(false);
+    currentRing->name[0] = 0;
+
+    // juce threads are named already, anything else (like the audio callback) can name itself
+    if (auto * thread = Thread::getCurrentThread()) {
+        thread->getThreadName().copyToUTF8(currentRing->name, sizeof(currentRing->name));
+        currentRing->hasName.store(true);
+    }
+
+    return currentRing;
+}
+
+void appendEscaped(String & out, const char * str)
+{
+    for (auto * c = str; *c != 0; ++c) {
+        if (*c == '"' || *c == '\\') out << '\\';
+        out << *c;
+    }
+}
+
+}
+
+std::atomic<bool> TraceRecorder::enabled { false };
+
+void TraceRecorder::setEnabled(bool flag)
+{
+    auto & state = getState();
+
+    if (flag && !state.rings) {
+        state.rings.reset(new ThreadRing[maxThreads]);
+    }
+
+    enabled.store(flag);
+    aoo_set_tracefn(flag ? &TraceRecorder::aooTraceCallback : nullptr);
+}
+
+void TraceRecorder::record(const char * name, char phase, int32 id, int64 arg)
+{
+    auto * ring = getCurrentRing();
+    if (!ring) return;
+
+    auto pos = ring->writePos.load(std::memory_order_relaxed);
+    auto & ev = ring->events[pos & (eventsPerThread - 1)];
+    ev.ticks = Time::getHighResolutionTicks();
+    ev.name = name;
+    ev.arg = arg;
+    ev.id = id;
+    ev.phase = phase;
+    ring->writePos.store(pos + 1, std::memory_order_release);
+}
+
+void TraceRecorder::aooTraceCallback(const char * name, char phase, int32_t id, int64_t arg)
+{
+    if (isEnabled()) {
+        record(name, phase, id, arg);
+    }
+}
+
+void TraceRecorder::nameCurrentThread(const char * name)
+{
+    if (!isEnabled()) return;
+
+    auto * ring = getCurrentRing();
+    if (!ring || ring->hasName.load(std::memory_order_relaxed)) return;
+
+    strncpy(ring->name, name, sizeof(ring->name) - 1);
+    ring->hasName.store(true, std::memory_order_release);
+}
+
+String TraceRecorder::createChromeTrace()
+{
+    auto & state = getState();
+
+    String out;
+    out.preallocateBytes(1 << 20);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    if (!state.rings) {
+        return out + "]}\n";
+    }
+
+    const int numRings = jmin(maxThreads, state.numRingsUsed.load());
+    const int pid = 1;
+
+    struct RingCopy
+    {
+        HeapBlock<TraceEvent> events { (size_t) eventsPerThread };
+        int first = 0;
+        int count = 0;
+    };
+    OwnedArray<RingCopy> copies;
+
+    int64 firstTicks = std::numeric_limits<int64>::max();
+
+    for (int r = 0; r < numRings; ++r) {
+        auto & ring = state.rings[r];
+        auto * copy = copies.add(new RingCopy());
+
+        auto endpos = ring.writePos.load(std::memory_order_acquire);
+        auto startpos = jmax(ring.ownerStartPos.load(std::memory_order_acquire), endpos > (uint64) eventsPerThread ? endpos - eventsPerThread : 0);
+
+        for (auto pos = startpos; pos < endpos; ++pos) {
+            copy->events[(int) (pos - startpos)] = ring.events[pos & (eventsPerThread - 1)];
+        }
+
+        // anything the writer may have reached in the meantime is garbage
+        auto afterpos = ring.writePos.load(std::memory_order_acquire);
+        auto validpos = jmax(startpos, afterpos >= (uint64) eventsPerThread ? afterpos - eventsPerThread + 1 : 0);
+
+        copy->first = (int) (validpos - startpos);
+        copy->count = endpos > validpos ? (int) (endpos - validpos) : 0;
+
+        if (copy->count > 0) {
+            firstTicks = jmin(firstTicks, copy->events[copy->first].ticks);
+        }
+    }
+
+    bool firstEvent = true;
+    auto separator = [&]() {
+        if (!firstEvent) out << ",\n";
+        firstEvent = false;
+    };
+
+    for (int r = 0; r < numRings; ++r) {
+        auto & ring = state.rings[r];
+        auto * copy = copies.getUnchecked(r);
+        const int tid = r + 1;
+
+        separator();
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << tid << ",\"args\":{\"name\":\"";
+        if (ring.hasName.load(std::memory_order_acquire) && ring.name[0] != 0) {
+            appendEscaped(out, ring.name);
+        } else {
+            out << "Thread " << tid;
+        }
+        out << "\"}}";
+
+        for (int i = copy->first; i < copy->first + copy->count; ++i) {
+            const auto & ev = copy->events[i];
+            if (ev.name == nullptr) continue;
+
+            auto us = Time::highResolutionTicksToSeconds(ev.ticks - firstTicks) * 1e6;
+
+            separator();
+            out << "{\"name\":\"";
+            appendEscaped(out, ev.name);
+            out << "\",\"ph\":\"" << ev.phase << "\",\"ts\":" << String(us, 3)
+                << ",\"pid\":" << pid << ",\"tid\":" << tid;
+            if (ev.phase == 'i') {
+                out << ",\"s\":\"t\"";
+            }
+            out << ",\"args\":{\"id\":" << ev.id;
+            if (ev.arg != 0) {
+                out << ",\"count\":" << ev.arg;
+            }
+            out << "}}";
+        }
+    }
+
+    out << "\n]}\n";
+    return out;
+}
+
+bool TraceRecorder::writeChromeTrace(const File & file)
+{
+    if (!file.replaceWithText(createChromeTrace())) {
+        DBG("Could not write trace to " << file.getFullPathName());
+        return false;
+    }
+
+    DBG("Wrote trace to " << file.getFullPathName());
+    return true;
+}
+
+void TraceRecorder::setDumpDirectory(const File & dir)
+{
+    auto & state = getState();
+    const ScopedLock sl (state.dirLock);
+    state.dumpDirectory = dir;
+}
+
+void TraceRecorder::requestDump()
+{
+    if (!isEnabled()) return;
+
+    // keep the first request time until it's serviced
+    double expected = 0.0;
+    getState().dumpRequestedMs.compare_exchange_strong(expected, Time::getMillisecondCounterHiRes());
+}
+
+void TraceRecorder::serviceDumpRequests()
+{
+    auto & state = getState();
+
+    const double requested = state.dumpRequestedMs.load();
+    if (requested == 0.0) return;
+
+    const double now = Time::getMillisecondCounterHiRes();
+    if (now < requested + dumpDelayMs) return;
+
+    state.dumpRequestedMs.store(0.0);
+
+    if (state.lastDumpMs > 0.0 && now < state.lastDumpMs + minDumpIntervalMs) {
+        return;
+    }
+    state.lastDumpMs = now;
+
+    File dir;
+    {
+        const ScopedLock sl (state.dirLock);
+        dir = state.dumpDirectory;
+    }
+    if (dir == File()) return;
+
+    dir.createDirectory();
+    auto file = dir.getChildFile("sonobus-trace-" + Time::getCurrentTime().formatted("%Y%m%d-%H%M%S") + ".json");
+    writeChromeTrace(file.getNonexistentSibling());
+}
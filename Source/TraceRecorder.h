@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: GPLv3-or-later WITH Appstore-exception
+// Copyright (C) 2021 Jesse Chappell
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include <atomic>
+
+namespace SonoAudio {
+
+// Low overhead event tracing, to tell apart what caused a glitch
+// (audio callback overrun, stalled network thread, jitter buffer underrun...).
+//
+// Every thread writes begin/end/instant events into its own lock-free ring, preallocated
+// when tracing gets enabled, so markers never block or allocate. While disabled a marker
+// costs one atomic load. The rings hold the most recent events of each thread and can be
+// written out at any time as a Chrome trace JSON file (chrome://tracing or ui.perfetto.dev).
+// A ring goes back to the pool when its thread exits, up to 32 threads can trace at a time.
+//
+// Event names must be string literals, only the pointer is kept.
+
+class TraceRecorder
+{
+public:
+    // also installs the aoo tracing hook
+    static void setEnabled(bool flag);
+    static bool isEnabled() { return enabled.load(std::memory_order_acquire); }
+
+    static void begin(const char * name, int32 id = 0) { if (isEnabled()) record(name, 'B', id, 0); }
+    static void end(const char * name, int32 id = 0) { if (isEnabled()) record(name, 'E', id, 0); }
+    static void instant(const char * name, int32 id = 0, int64 arg = 0) { if (isEnabled()) record(name, 'i', id, arg); }
+
+    // names the calling thread in the trace, unless it already has one (realtime safe)
+    static void nameCurrentThread(const char * name);
+
+    // safe to call while tracing goes on
+    static String createChromeTrace();
+    static bool writeChromeTrace(const File & file);
+
+    // where automatic dumps go, nothing is written without one
+    static void setDumpDirectory(const File & dir);
+
+    // asks for a dump soon, realtime and signal safe
+    static void requestDump();
+
+    // call periodically from a thread that may do file io. writes a requested dump
+    // a little while after the request, so what happened after it is in there too
+    static void serviceDumpRequests();
+
+    struct Scope
+    {
+        Scope(const char * name_, int32 id_ = 0) : name(name_), id(id_) { begin(name, id); }
+        ~Scope() { end(name, id); }
+
+        const char * name;
+        int32 id;
+    };
+
+private:
+    static void record(const char * name, char phase, int32 id, int64 arg);
+    static void aooTraceCallback(const char * name, char phase, int32_t id, int64_t arg);
+
+    static std::atomic<bool> enabled;
+};
+
+}
+
+#define SONO_TRACE_SCOPE(name)  SonoAudio::TraceRecorder::Scope JUCE_JOIN_MACRO (sonoTraceScope_, __LINE__) (name)
+#define SONO_TRACE_BEGIN(name)  SonoAudio::TraceRecorder::begin (name)
+#define SONO_TRACE_END(name)    SonoAudio::TraceRecorder::end (name)
@@ -18,6 +18,9 @@ extern "C"
 
 // these are bit masks to go in the least significant byte of the version
 #define AOO_PROTOCOL_FLAG_COMPACT_DATA 0x1 // supports compact data message
+#define AOO_PROTOCOL_FLAG_SILENT_BLOCKS 0x2 // supports silent blocks (data messages without data)
+#define AOO_PROTOCOL_FLAG_RESEND_RANGES 0x4 // understands /resend messages (ranges of blocks or frames)
+#define AOO_PROTOCOL_FLAG_BINARY_DATA 0x8 // supports binary data messages (no OSC parsing)
 
 #ifndef AOO_DEBUG_DLL
  #define AOO_DEBUG_DLL 0
@@ -104,6 +107,15 @@ AOO_API void aoo_initialize(void);
 // terminate AoO library - call only once!
 AOO_API void aoo_terminate(void);
 
+// optional tracing hook, called for timing markers and stream problems.
+// name: static string, phase: 'B' (begin), 'E' (end) or 'i' (instant),
+// id: source ID, arg: count for instant events.
+// Called from the audio and network threads, so it must be realtime safe.
+typedef void (*aoo_tracefn)(const char *name, char phase, int32_t id, int64_t arg);
+
+// set the tracing hook, NULL disables it (default)
+AOO_API void aoo_set_tracefn(aoo_tracefn fn);
+
 /*//////////////////// OSC ////////////////////////////*/
 
 #define AOO_MSG_SOURCE "/src"
@@ -126,6 +138,10 @@ AOO_API void aoo_terminate(void);
 #define AOO_MSG_COMPACT_DATA_LEN 2
 #define AOO_MSG_CODEC_CHANGE "/codecchange"
 #define AOO_MSG_CODEC_CHANGE_LEN 12
+#define AOO_MSG_PROBE "/probe"
+#define AOO_MSG_PROBE_LEN 6
+#define AOO_MSG_RESEND "/resend"
+#define AOO_MSG_RESEND_LEN 7
 
 // id: the source or sink ID
 // returns: the offset to the remaining address pattern
@@ -358,9 +374,49 @@ typedef enum aoo_option
     // For sources, send an optional userformat blob along with the format messages
     // ---
     // Could be used for any purpose (channel layouts, labels, etc)
-    aoo_opt_userformat
+    aoo_opt_userformat,
+    // Stream capture handler (aoo_capture_handler), sink only
+    // ---
+    // If set, the sink passes the format and every encoded block of
+    // its sources to the handler in stream order, before decoding.
+    // Called from the thread that calls sink_handle_message(),
+    // set a handler with NULL functions to stop capturing.
+    aoo_opt_capture_handler,
+    // Adaptive bitrate (int32_t), source only
+    // ---
+    // The lowest bitrate per channel (bits/s) the source may fall back to
+    // when the sinks report packet loss or rising round trip times, 0 disables.
+    // The bitrate of the format is the upper bound. Only has an effect
+    // for codecs which support AOO_CODEC_SET_BITRATE (Opus).
+    aoo_opt_adaptive_bitrate,
+    // Current bitrate (int32_t), source only, read-only
+    // ---
+    // The bitrate the encoder is currently running at, in bits/s for all channels.
+    aoo_opt_current_bitrate,
+    // Silence threshold (float), source only
+    // ---
+    // Blocks whose peak amplitude is at or below the threshold are not encoded,
+    // sinks which support AOO_PROTOCOL_FLAG_SILENT_BLOCKS get an empty data message
+    // instead and output silence. Other sinks still get the encoded block.
+    // Negative values disable silence suppression (default).
+    aoo_opt_silence_threshold,
+    // Path MTU discovery (int32_t) 0 or 1, source only
+    // ---
+    // If > 0 the source periodically sends padded probe messages of
+    // typical path MTU sizes to each sink and sends data with the
+    // largest packet size that the sinks have confirmed, so that
+    // every block goes out in as few frames as possible.
+    // Sinks which don't answer the probes use aoo_opt_packetsize.
+    // The application should set the "don't fragment" flag on its socket,
+    // otherwise fragmented probes get through and the result is too large.
+    aoo_opt_mtu_discovery,
+    // Current packet size (int32_t), source only, read-only
+    // ---
+    // The max. UDP packet size the source is currently sending with.
+    aoo_opt_current_packetsize
 } aoo_option;
 
+
 #define AOO_ARG(x) &x, sizeof(x)
 #define AOO_ARG_NULL 0, 0
 
@@ -389,6 +445,24 @@ typedef struct aoo_format_storage
     char data[256];
 } aoo_format_storage;
 
+// stream capture (see aoo_opt_capture_handler)
+
+// called with the serialized codec settings whenever a source format is set or changes
+typedef void (*aoo_capture_formatfn)(void *user, void *endpoint, int32_t id,
+                                     const aoo_format *format, const char *settings, int32_t size);
+
+// called for each block in stream order, data is NULL (size 0) for dropped blocks
+// and non-NULL with size 0 for silent blocks
+typedef void (*aoo_capture_blockfn)(void *user, void *endpoint, int32_t id, int32_t sequence,
+                                    double samplerate, int32_t channel, const char *data, int32_t size);
+
+typedef struct aoo_capture_handler
+{
+    aoo_capture_formatfn format;
+    aoo_capture_blockfn block;
+    void *user;
+} aoo_capture_handler;
+
 // create a new AoO source instance
 AOO_API aoo_source * aoo_source_new(int32_t id);
 
@@ -698,6 +772,22 @@ typedef int32_t (*aoo_codec_decode)(
 
 typedef int32_t (*aoo_codec_reset)(void *) ;
 
+// codec controls, all take an int32_t argument
+typedef enum aoo_codec_ctl_type
+{
+    // change the bitrate (bits/s) without resetting the stream
+    AOO_CODEC_SET_BITRATE = 0,
+    // get the bitrate of the current format
+    AOO_CODEC_GET_BITRATE
+} aoo_codec_ctl_type;
+
+typedef int32_t (*aoo_codec_ctl)(
+        void *,         // the encoder instance
+        int32_t,        // the control (aoo_codec_ctl_type)
+        void *,         // argument
+        int32_t         // argument size
+);
+
 
 typedef struct aoo_codec
 {
@@ -719,11 +809,16 @@ typedef struct aoo_codec
     aoo_codec_readformat decoder_readformat;
     aoo_codec_decode decoder_decode;
     aoo_codec_reset decoder_reset;
+    // optional encoder controls, may be NULL
+    aoo_codec_ctl encoder_ctl;
 } aoo_codec;
 
 // register an external codec plugin
 AOO_API int32_t aoo_register_codec(const char *name, const aoo_codec *codec);
 
+// look up a registered codec, e.g. to decode captured streams offline. returns NULL if not found
+AOO_API const aoo_codec * aoo_find_codec(const char *name);
+
 // The type of 'aoo_register_codec', which gets passed to codec setup functions.
 // For now, plugins are registered statically - or manually by the user.
 // Later we might want to automatically look for codec plugins.
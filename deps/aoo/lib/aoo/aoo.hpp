@@ -171,6 +171,26 @@ public:
         return set_option(aoo_opt_userformat, ufmt, size);
     }
 
+    int32_t set_adaptive_bitrate(int32_t minbitrate){
+        return set_option(aoo_opt_adaptive_bitrate, AOO_ARG(minbitrate));
+    }
+
+    int32_t get_current_bitrate(int32_t& n){
+        return get_option(aoo_opt_current_bitrate, AOO_ARG(n));
+    }
+
+    int32_t set_silence_threshold(float peak){
+        return set_option(aoo_opt_silence_threshold, AOO_ARG(peak));
+    }
+
+    int32_t set_mtu_discovery(int32_t n){
+        return set_option(aoo_opt_mtu_discovery, AOO_ARG(n));
+    }
+
+    int32_t get_current_packetsize(int32_t& n){
+        return get_option(aoo_opt_current_packetsize, AOO_ARG(n));
+    }
+
 
     virtual int32_t set_option(int32_t opt, void *ptr, int32_t size) = 0;
     virtual int32_t get_option(int32_t opt, void *ptr, int32_t size) = 0;
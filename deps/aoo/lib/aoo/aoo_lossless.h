@@ -0,0 +1,39 @@
+/* Copyright (c) 2010-Now Christof Ressi, Winfried Ritsch and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+#pragma once
+
+#include "aoo.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*/////////////////// lossless codec ////////////////////////*/
+
+// Integer PCM compressed with linear prediction and Rice coding.
+// Every block is coded on its own (no lookahead and no state between
+// blocks), so it adds no latency and is bit-exact at the given bitdepth.
+
+#define AOO_CODEC_LOSSLESS "lossless"
+
+typedef enum
+{
+    AOO_LOSSLESS_INT16,
+    AOO_LOSSLESS_INT24,
+    AOO_LOSSLESS_BITDEPTH_SIZE
+} aoo_lossless_bitdepth;
+
+typedef struct aoo_format_lossless
+{
+    aoo_format header;
+    int32_t bitdepth;
+} aoo_format_lossless;
+
+AOO_API void aoo_codec_lossless_setup(aoo_codec_registerfn fn);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
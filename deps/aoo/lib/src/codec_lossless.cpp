@@ -0,0 +1,660 @@
+/* Copyright (c) 2010-Now Christof Ressi, Winfried Ritsch and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+#include "aoo/aoo_lossless.h"
+#include "aoo/aoo_utils.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <cmath>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AOO_RESTRICT __restrict
+#else
+#define AOO_RESTRICT __restrict__
+#endif
+
+namespace {
+
+// Each channel of a block is quantized to integers and coded with one of:
+// - a fixed polynomial predictor of order 0-4 (warm-up samples + Rice coded residuals)
+// - verbatim samples (if prediction doesn't pay off)
+// - a single constant value (e.g. digital silence)
+// The channel header is 3 bits of mode, plus 5 bits of Rice parameter for predicted channels.
+
+enum channel_mode {
+    mode_max_order = 4,
+    mode_verbatim = 5,
+    mode_constant = 6
+};
+
+const int32_t max_rice_param = 30;
+
+int32_t bits_per_sample(int32_t bd)
+{
+    switch (bd){
+    case AOO_LOSSLESS_INT16:
+        return 16;
+    case AOO_LOSSLESS_INT24:
+        return 24;
+    default:
+        assert(false);
+        return 0;
+    }
+}
+
+inline uint64_t bitmask(int32_t nbits)
+{
+    return nbits >= 64 ? ~(uint64_t)0 : (((uint64_t)1 << nbits) - 1);
+}
+
+inline int32_t count_leading_zeros(uint64_t x)
+{
+    // x must not be 0
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return 63 - (int32_t)index;
+#elif defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(x);
+#else
+    int32_t n = 0;
+    while (!(x & ((uint64_t)1 << 63))){
+        x <<= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+inline uint32_t zigzag(int32_t x)
+{
+    return ((uint32_t)x << 1) ^ (uint32_t)(x >> 31);
+}
+
+inline int32_t unzigzag(uint32_t u)
+{
+    return (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+}
+
+// round to nearest and clip to the integer range of the bitdepth
+inline int32_t sample_to_int(aoo_sample in, int32_t nbits)
+{
+    const double scale = (double)((int64_t)1 << (nbits - 1));
+    double temp = std::floor(in * scale + 0.5);
+    if (temp > scale - 1.0){
+        temp = scale - 1.0;
+    } else if (temp < -scale){
+        temp = -scale;
+    }
+    return (int32_t)temp;
+}
+
+inline aoo_sample int_to_sample(int32_t in, int32_t nbits)
+{
+    return (aoo_sample)in / (aoo_sample)((int64_t)1 << (nbits - 1));
+}
+
+// residuals of the fixed predictors for samples [start, n).
+// plain loops over contiguous arrays, so the compiler can vectorize them.
+// with at most 24 bit input the order 4 residual still fits into 28 bits.
+void compute_residuals(const int32_t * AOO_RESTRICT x, int32_t start, int32_t n,
+                       int32_t order, int32_t * AOO_RESTRICT r)
+{
+    switch (order){
+    case 0:
+        for (int32_t i = start; i < n; ++i){
+            r[i] = x[i];
+        }
+        break;
+    case 1:
+        for (int32_t i = start; i < n; ++i){
+            r[i] = x[i] - x[i-1];
+        }
+        break;
+    case 2:
+        for (int32_t i = start; i < n; ++i){
+            r[i] = x[i] - 2 * x[i-1] + x[i-2];
+        }
+        break;
+    case 3:
+        for (int32_t i = start; i < n; ++i){
+            r[i] = x[i] - 3 * x[i-1] + 3 * x[i-2] - x[i-3];
+        }
+        break;
+    case 4:
+        for (int32_t i = start; i < n; ++i){
+            r[i] = x[i] - 4 * x[i-1] + 6 * x[i-2] - 4 * x[i-3] + x[i-4];
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+uint64_t sum_abs(const int32_t * AOO_RESTRICT r, int32_t start, int32_t n)
+{
+    uint64_t sum = 0;
+    for (int32_t i = start; i < n; ++i){
+        sum += zigzag(r[i]);
+    }
+    return sum;
+}
+
+// exact number of bits for Rice coding the residuals with parameter k
+uint64_t rice_bits(const int32_t * AOO_RESTRICT r, int32_t start, int32_t n, int32_t k)
+{
+    uint64_t bits = (uint64_t)(n - start) * (k + 1);
+    for (int32_t i = start; i < n; ++i){
+        bits += zigzag(r[i]) >> k;
+    }
+    return bits;
+}
+
+class bit_writer {
+public:
+    bit_writer(char *buf, int32_t size)
+        : buf_((uint8_t *)buf), size_(size) {}
+
+    // nbits <= 32
+    void write(uint32_t value, int32_t nbits){
+        acc_ = (acc_ << nbits) | (value & bitmask(nbits));
+        nacc_ += nbits;
+        while (nacc_ >= 8){
+            nacc_ -= 8;
+            put((uint8_t)(acc_ >> nacc_));
+        }
+    }
+
+    void write_rice(uint32_t u, int32_t k){
+        // quotient in unary (zeros terminated by a one), then the k low bits
+        auto q = u >> k;
+        while (q >= 32){
+            write(0, 32);
+            q -= 32;
+        }
+        write(1, q + 1);
+        if (k > 0){
+            write(u, k);
+        }
+    }
+
+    // returns number of bytes written or -1 if the buffer was too small
+    int32_t finish(){
+        if (nacc_ > 0){
+            put((uint8_t)(acc_ << (8 - nacc_)));
+            nacc_ = 0;
+        }
+        return overflow_ ? -1 : pos_;
+    }
+private:
+    void put(uint8_t b){
+        if (pos_ < size_){
+            buf_[pos_++] = b;
+        } else {
+            overflow_ = true;
+        }
+    }
+
+    uint8_t *buf_;
+    int32_t size_;
+    int32_t pos_ = 0;
+    uint64_t acc_ = 0;
+    int32_t nacc_ = 0;
+    bool overflow_ = false;
+};
+
+class bit_reader {
+public:
+    bit_reader(const char *buf, int32_t size)
+        : buf_((const uint8_t *)buf), size_(size) {}
+
+    // nbits <= 32
+    bool read(int32_t nbits, uint32_t& value){
+        while (nacc_ < nbits){
+            if (pos_ >= size_){
+                return false;
+            }
+            acc_ = (acc_ << 8) | buf_[pos_++];
+            nacc_ += 8;
+        }
+        nacc_ -= nbits;
+        value = (uint32_t)((acc_ >> nacc_) & bitmask(nbits));
+        return true;
+    }
+
+    bool read_signed(int32_t nbits, int32_t& value){
+        uint32_t u;
+        if (!read(nbits, u)){
+            return false;
+        }
+        // sign extend
+        value = (int32_t)(u << (32 - nbits)) >> (32 - nbits);
+        return true;
+    }
+
+    bool read_rice(int32_t k, uint32_t& u){
+        // count the zeros of the unary quotient a byte at a time
+        uint32_t q = 0;
+        for (;;){
+            auto bits = acc_ & bitmask(nacc_);
+            if (bits != 0){
+                auto width = 64 - count_leading_zeros(bits);
+                q += nacc_ - width;
+                nacc_ = width - 1; // skip the terminating one
+                break;
+            }
+            q += nacc_;
+            nacc_ = 0;
+            if (pos_ >= size_){
+                return false;
+            }
+            acc_ = buf_[pos_++];
+            nacc_ = 8;
+        }
+        uint32_t low = 0;
+        if (k > 0 && !read(k, low)){
+            return false;
+        }
+        u = (q << k) | low;
+        return true;
+    }
+private:
+    const uint8_t *buf_;
+    int32_t size_;
+    int32_t pos_ = 0;
+    uint64_t acc_ = 0;
+    int32_t nacc_ = 0;
+};
+
+void print_settings(const aoo_format_lossless& f)
+{
+    (void)f; // LOG_VERBOSE may compile to nothing
+    LOG_VERBOSE("lossless settings: "
+                << "nchannels = " << f.header.nchannels
+                << ", blocksize = " << f.header.blocksize
+                << ", samplerate = " << f.header.samplerate
+                << ", bitdepth = " << bits_per_sample(f.bitdepth));
+}
+
+/*//////////////////// codec //////////////////////////*/
+
+struct codec {
+    codec(){
+        memset(&format, 0, sizeof(aoo_format_lossless));
+    }
+    aoo_format_lossless format;
+    // work buffers for one channel, sized in setformat
+    std::vector<int32_t> samples;
+    std::vector<int32_t> residuals[mode_max_order + 1];
+};
+
+int32_t codec_setformat(void *enc, aoo_format *f)
+{
+    if (strcmp(f->codec, AOO_CODEC_LOSSLESS)){
+        return 0;
+    }
+    auto c = static_cast<codec *>(enc);
+    auto fmt = reinterpret_cast<aoo_format_lossless *>(f);
+
+    // validate blocksize
+    if (fmt->header.blocksize <= 0){
+        LOG_WARNING("lossless: bad blocksize " << fmt->header.blocksize
+                    << ", using 64 samples");
+        fmt->header.blocksize = 64;
+    }
+    // validate samplerate
+    if (fmt->header.samplerate <= 0){
+        LOG_WARNING("lossless: bad samplerate " << fmt->header.samplerate
+                    << ", using 44100");
+        fmt->header.samplerate = 44100;
+    }
+    // validate channels
+    if (fmt->header.nchannels <= 0 || fmt->header.nchannels > 255){
+        LOG_WARNING("lossless: bad channel count " << fmt->header.nchannels
+                    << ", using 1 channel");
+        fmt->header.nchannels = 1;
+    }
+    // validate bitdepth
+    if (fmt->bitdepth < 0 || fmt->bitdepth >= AOO_LOSSLESS_BITDEPTH_SIZE){
+        LOG_WARNING("lossless: bad bitdepth, using 24 bit");
+        fmt->bitdepth = AOO_LOSSLESS_INT24;
+    }
+
+    // save and print settings
+    memcpy(&c->format, fmt, sizeof(aoo_format_lossless));
+    c->format.header.codec = AOO_CODEC_LOSSLESS; // !
+    print_settings(c->format);
+
+    c->samples.resize(c->format.header.blocksize);
+    for (auto& r : c->residuals){
+        r.resize(c->format.header.blocksize);
+    }
+
+    return 1;
+}
+
+int32_t codec_readformat(void *x, aoo_format *fmt,
+                         const char *buf, int32_t size)
+{
+    if (size >= 4){
+        auto c = static_cast<codec *>(x);
+        if (!strcmp(fmt->codec, AOO_CODEC_LOSSLESS) && fmt->blocksize > 0
+                && fmt->samplerate > 0 && fmt->nchannels > 0)
+        {
+            memcpy(&c->format.header, fmt, sizeof(aoo_format));
+            c->format.bitdepth = aoo::from_bytes<int32_t>(buf);
+            c->format.header.codec = AOO_CODEC_LOSSLESS; // !
+
+            if (codec_setformat(x, &c->format.header)) {
+                // it could have been modified during validation, need to re-write the base format of
+                // passed in value
+                memcpy(fmt, &c->format.header, sizeof(aoo_format));
+                return 4;
+            }
+            else {
+                return -1;
+            }
+        } else {
+            LOG_ERROR("lossless: bad format!");
+        }
+    } else {
+        LOG_ERROR("lossless: couldn't read format - not enough data!");
+    }
+    return -1;
+}
+
+int32_t codec_reset(void *x) {
+    // no state between blocks
+    return x != nullptr;
+}
+
+int32_t codec_getformat(void *x, aoo_format_storage *f)
+{
+    auto c = static_cast<codec *>(x);
+    if (c->format.header.codec){
+        memcpy(f, &c->format, sizeof(aoo_format_lossless));
+        return sizeof(aoo_format_lossless);
+    } else {
+        return 0;
+    }
+}
+
+void *encoder_new(){
+    return new codec;
+}
+
+void encoder_free(void *enc){
+    delete (codec *)enc;
+}
+
+void encode_channel(codec& c, bit_writer& writer, int32_t nbits, int32_t nframes)
+{
+    const int32_t *x = c.samples.data();
+
+    // constant (e.g. silence)
+    bool constant = true;
+    for (int32_t i = 1; i < nframes; ++i){
+        if (x[i] != x[0]){
+            constant = false;
+            break;
+        }
+    }
+    if (constant){
+        writer.write(mode_constant, 3);
+        writer.write((uint32_t)x[0], nbits);
+        return;
+    }
+
+    // pick the predictor with the smallest residuals (compared over the same range)
+    const int32_t start = std::min<int32_t>(mode_max_order, nframes);
+    int32_t order = 0;
+    uint64_t bestsum = 0;
+    for (int32_t o = 0; o <= mode_max_order && o < nframes; ++o){
+        compute_residuals(x, o, nframes, o, c.residuals[o].data());
+        auto sum = sum_abs(c.residuals[o].data(), start, nframes);
+        if (o == 0 || sum < bestsum){
+            bestsum = sum;
+            order = o;
+        }
+    }
+
+    // estimate the Rice parameter from the mean and check its neighbours
+    const int32_t *r = c.residuals[order].data();
+    auto mean = (order < nframes) ? sum_abs(r, order, nframes) / (nframes - order) : 0;
+    int32_t kest = mean > 0 ? 63 - count_leading_zeros(mean) : 0;
+    int32_t k = 0;
+    uint64_t bestbits = 0;
+    for (int32_t kk = std::max<int32_t>(0, kest - 1); kk <= std::min<int32_t>(max_rice_param, kest + 1); ++kk){
+        auto bits = rice_bits(r, order, nframes, kk);
+        if (kk == std::max<int32_t>(0, kest - 1) || bits < bestbits){
+            bestbits = bits;
+            k = kk;
+        }
+    }
+
+    auto predbits = 5 + (uint64_t)order * nbits + bestbits;
+    auto verbatimbits = (uint64_t)nframes * nbits;
+
+    if (predbits >= verbatimbits){
+        writer.write(mode_verbatim, 3);
+        for (int32_t i = 0; i < nframes; ++i){
+            writer.write((uint32_t)x[i], nbits);
+        }
+        return;
+    }
+
+    writer.write(order, 3);
+    writer.write(k, 5);
+    for (int32_t i = 0; i < order; ++i){
+        writer.write((uint32_t)x[i], nbits);
+    }
+    for (int32_t i = order; i < nframes; ++i){
+        writer.write_rice(zigzag(r[i]), k);
+    }
+}
+
+int32_t encoder_encode(void *enc,
+                       const aoo_sample *s, int32_t n,
+                       char *buf, int32_t size)
+{
+    auto c = static_cast<codec *>(enc);
+    auto nchannels = c->format.header.nchannels;
+    auto nbits = bits_per_sample(c->format.bitdepth);
+    if (nchannels <= 0 || nbits == 0){
+        return 0;
+    }
+    auto nframes = n / nchannels;
+    if (nframes > (int32_t)c->samples.size()){
+        LOG_ERROR("lossless: block too large!");
+        return -1;
+    }
+
+    bit_writer writer(buf, size);
+
+    for (int32_t ch = 0; ch < nchannels; ++ch){
+        // deinterleave and quantize
+        auto x = c->samples.data();
+        for (int32_t i = 0; i < nframes; ++i){
+            x[i] = sample_to_int(s[i * nchannels + ch], nbits);
+        }
+        encode_channel(*c, writer, nbits, nframes);
+    }
+
+    // a block never needs more than verbatim samples, so this means the buffer is too small
+    auto result = writer.finish();
+    if (result < 0){
+        LOG_ERROR("lossless: output buffer too small!");
+        return -1;
+    }
+    return result;
+}
+
+int32_t encoder_writeformat(void *enc, aoo_format *fmt,
+                            char *buf, int32_t size)
+{
+    if (size >= 4){
+        aoo_format_lossless * ofmt;
+        if (enc == nullptr) {
+            ofmt = reinterpret_cast<aoo_format_lossless *>(fmt);
+        }
+        else {
+            auto c = static_cast<codec *>(enc);
+            ofmt = &c->format;
+            memcpy(fmt, &ofmt->header, sizeof(aoo_format));
+        }
+        aoo::to_bytes<int32_t>(ofmt->bitdepth, buf);
+
+        return 4;
+    } else {
+        LOG_ERROR("lossless: couldn't write settings - buffer too small!");
+        return -1;
+    }
+}
+
+void *decoder_new(){
+    return new codec;
+}
+
+void decoder_free(void *dec){
+    delete (codec *)dec;
+}
+
+bool decode_channel(codec& c, bit_reader& reader, int32_t nbits, int32_t nframes)
+{
+    int32_t *x = c.samples.data();
+    uint32_t mode;
+    if (!reader.read(3, mode)){
+        return false;
+    }
+
+    if (mode == mode_constant){
+        int32_t value;
+        if (!reader.read_signed(nbits, value)){
+            return false;
+        }
+        for (int32_t i = 0; i < nframes; ++i){
+            x[i] = value;
+        }
+        return true;
+    }
+
+    if (mode == mode_verbatim){
+        for (int32_t i = 0; i < nframes; ++i){
+            if (!reader.read_signed(nbits, x[i])){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if (mode > mode_max_order || (int32_t)mode > nframes){
+        return false;
+    }
+
+    int32_t order = mode;
+    uint32_t k;
+    if (!reader.read(5, k) || k > max_rice_param){
+        return false;
+    }
+    for (int32_t i = 0; i < order; ++i){
+        if (!reader.read_signed(nbits, x[i])){
+            return false;
+        }
+    }
+    for (int32_t i = order; i < nframes; ++i){
+        uint32_t u;
+        if (!reader.read_rice(k, u)){
+            return false;
+        }
+        auto e = unzigzag(u);
+        switch (order){
+        case 0:
+            x[i] = e;
+            break;
+        case 1:
+            x[i] = e + x[i-1];
+            break;
+        case 2:
+            x[i] = e + 2 * x[i-1] - x[i-2];
+            break;
+        case 3:
+            x[i] = e + 3 * x[i-1] - 3 * x[i-2] + x[i-3];
+            break;
+        case 4:
+            x[i] = e + 4 * x[i-1] - 6 * x[i-2] + 4 * x[i-3] - x[i-4];
+            break;
+        }
+    }
+    return true;
+}
+
+int32_t decoder_decode(void *dec,
+                       const char *buf, int32_t size,
+                       aoo_sample *s, int32_t n)
+{
+    auto c = static_cast<codec *>(dec);
+    assert(c->format.header.blocksize != 0);
+
+    if (!buf){
+        for (int i = 0; i < n; ++i){
+            s[i] = 0;
+        }
+        return n;
+    }
+
+    auto nchannels = c->format.header.nchannels;
+    auto nbits = bits_per_sample(c->format.bitdepth);
+    if (nchannels <= 0 || nbits == 0){
+        return -1;
+    }
+    auto nframes = n / nchannels;
+    if (nframes > (int32_t)c->samples.size()){
+        return -1;
+    }
+
+    bit_reader reader(buf, size);
+
+    for (int32_t ch = 0; ch < nchannels; ++ch){
+        if (!decode_channel(*c, reader, nbits, nframes)){
+            LOG_ERROR("lossless: corrupt block!");
+            return -1;
+        }
+        // convert and interleave
+        auto x = c->samples.data();
+        for (int32_t i = 0; i < nframes; ++i){
+            s[i * nchannels + ch] = int_to_sample(x[i], nbits);
+        }
+    }
+
+    return n;
+}
+
+aoo_codec codec_class = {
+    AOO_CODEC_LOSSLESS,
+    encoder_new,
+    encoder_free,
+    codec_setformat,
+    codec_getformat,
+    codec_readformat,
+    encoder_writeformat,
+    encoder_encode,
+    codec_reset,
+    decoder_new,
+    decoder_free,
+    codec_setformat,
+    codec_getformat,
+    codec_readformat,
+    decoder_decode,
+    codec_reset,
+    nullptr // encoder_ctl, nothing to control
+};
+
+} // namespace
+
+void aoo_codec_lossless_setup(aoo_codec_registerfn fn){
+    fn(AOO_CODEC_LOSSLESS, &codec_class);
+}
@@ -282,6 +282,24 @@ int32_t encoder_reset(void *enc) {
     return 0;
 }
 
+int32_t encoder_ctl(void *enc, int32_t type, void *ptr, int32_t size) {
+    auto c = static_cast<encoder *>(enc);
+    if (!c->state || size != sizeof(int32_t)){
+        return 0;
+    }
+    switch (type){
+    case AOO_CODEC_SET_BITRATE:
+        // the decoder doesn't need to know, Opus packets are self-describing
+        return opus_multistream_encoder_ctl(c->state, OPUS_SET_BITRATE(*(int32_t *)ptr)) == OPUS_OK;
+    case AOO_CODEC_GET_BITRATE:
+        // the format bitrate, see the note in encoder_setformat()
+        *(int32_t *)ptr = c->format.bitrate;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
 
 /*/////////////////////// decoder ///////////////////////////*/
 
@@ -445,7 +463,8 @@ aoo_codec codec_class = {
     decoder_getformat,
     decoder_readformat,
     decoder_decode,
-    decoder_reset
+    decoder_reset,
+    encoder_ctl
 };
 
 } // namespace
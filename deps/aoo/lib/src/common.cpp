@@ -4,6 +4,7 @@
 
 #include "aoo/aoo_utils.hpp"
 #include "aoo/aoo_pcm.h"
+#include "aoo/aoo_lossless.h"
 #if USE_CODEC_OPUS
 #include "aoo/aoo_opus.h"
 #endif
@@ -65,12 +66,29 @@ int32_t aoo_register_codec(const char *name, const aoo_codec *codec){
     return 1;
 }
 
+const aoo_codec * aoo_find_codec(const char *name){
+    auto c = aoo::find_codec(name);
+    return c ? c->get() : nullptr;
+}
+
 /*//////////////////// OSC ////////////////////////////*/
 
 int32_t aoo_parse_pattern(const char *msg, int32_t n,
                          int32_t *type, int32_t *id)
 {
     int32_t offset = 0;
+    // binary data message, see common.hpp
+    if (n >= AOO_BIN_DATA_HEADERSIZE
+        && !memcmp(msg, AOO_BIN_DATA_MAGIC, AOO_BIN_DATA_MAGIC_LEN))
+    {
+        *type = AOO_TYPE_SINK;
+        if ((msg[3] & AOO_BIN_DATA_FULL) && n >= AOO_BIN_DATA_FULL_HEADERSIZE){
+            *id = aoo::from_bytes<int32_t>(msg + 12);
+        } else {
+            *id = AOO_ID_NONE; // will be looked up by salt
+        }
+        return AOO_BIN_DATA_MAGIC_LEN;
+    }
     // special case the compact data message which doesn't use the aoo domain
     if (n >= AOO_MSG_COMPACT_DATA_LEN
         && !memcmp(msg, AOO_MSG_COMPACT_DATA, AOO_MSG_COMPACT_DATA_LEN)) 
@@ -214,14 +232,15 @@ void block::set(int32_t seq, double sr, int32_t chn,
     channel = chn;
     numframes_ = nframes;
     framesize_ = 0;
+    silent_ = false;
     assert(nbytes > 0);
     buffer_.resize(nbytes);
     // set missing frame bits to 1
-    frames_ = 0;
-    for (int i = 0; i < nframes; ++i){
-        frames_ |= ((uint64_t)1 << i);
+    frames_.assign((nframes + 63) / 64, ~(uint64_t)0);
+    if (nframes % 64){
+        frames_.back() = ((uint64_t)1 << (nframes % 64)) - 1;
     }
-    // LOG_DEBUG("initial frames: " << (unsigned)frames);
+    missing_ = nframes;
 }
 
 void block::set(int32_t seq, double sr, int32_t chn,
@@ -233,22 +252,43 @@ void block::set(int32_t seq, double sr, int32_t chn,
     channel = chn;
     numframes_ = nframes;
     framesize_ = framesize;
-    frames_ = 0; // no frames missing
+    frames_.clear(); // no frames missing
+    missing_ = 0;
+    silent_ = false;
     buffer_.assign(data, data + nbytes);
 }
 
+void block::set_silent(int32_t seq, double sr, int32_t chn)
+{
+    sequence = seq;
+    samplerate = sr;
+    channel = chn;
+    numframes_ = 1;
+    framesize_ = 0;
+    frames_.clear(); // complete
+    missing_ = 0;
+    silent_ = true;
+    buffer_.assign(1, 0); // keep a valid buffer, the size is never sent
+}
+
 bool block::complete() const {
     if (buffer_.data() == nullptr){
         LOG_ERROR("buffer is 0!");
     }
     assert(buffer_.data() != nullptr);
     assert(sequence >= 0);
-    return frames_ == 0;
+    return missing_ == 0;
 }
 
 void block::add_frame(int32_t which, const char *data, int32_t n){
     assert(data != nullptr);
     assert(buffer_.data() != nullptr);
+    assert(which >= 0 && which < numframes_);
+    auto onset = (which == numframes_ - 1) ? (int64_t)size() - n : (int64_t)which * n;
+    if (onset < 0 || onset + n > size()){
+        LOG_ERROR("frame " << which << " with " << n << " bytes doesn't fit into block");
+        return;
+    }
     if (which == numframes_ - 1){
         LOG_DEBUG("copy last frame with " << n << " bytes");
         std::copy(data, data + n, buffer_.end() - n);
@@ -257,8 +297,12 @@ void block::add_frame(int32_t which, const char *data, int32_t n){
         std::copy(data, data + n, buffer_.begin() + which * n);
         framesize_ = n; // LATER allow varying framesizes
     }
-    frames_ &= ~((uint64_t)1 << which);
-    // LOG_DEBUG("frames: " << frames_);
+    auto& bits = frames_[which >> 6];
+    auto mask = (uint64_t)1 << (which & 63);
+    if (bits & mask){
+        bits &= ~mask;
+        missing_--;
+    }
 }
 
 int32_t block::get_frame(int32_t which, char *data, int32_t n){
@@ -296,7 +340,7 @@ int32_t block::frame_size(int32_t which) const {
 
 bool block::has_frame(int32_t which) const {
     assert(which < numframes_);
-    return ((frames_ >> which) & 1) == 0;
+    return missing_ == 0 || (frames_[which >> 6] & ((uint64_t)1 << (which & 63))) == 0;
 }
 
 /*////////////////////////// block_ack /////////////////////////////*/
@@ -331,26 +375,32 @@ bool block_ack::update(double time, double interval){
 
 /*////////////////////////// block_ack_list ///////////////////////////*/
 
-#if BLOCK_ACK_LIST_HASHTABLE
-
 block_ack_list::block_ack_list(){
     static_assert(is_pow2(initial_size_), "initial size must be a power of 2!");
     data_.resize(initial_size_);
-    size_ = 0;
-    deleted_ = 0;
-    oldest_ = INT32_MAX;
 }
 
 void block_ack_list::set_limit(int32_t limit){
     limit_ = limit;
 }
 
+void block_ack_list::resize(int32_t window){
+    // leave room for reordered and resent blocks around the window
+    int32_t n = initial_size_;
+    while (n < window * 2){
+        n <<= 1;
+    }
+    if (n != (int32_t)data_.size()){
+        data_.resize(n);
+    }
+    clear();
+}
+
 void block_ack_list::clear(){
     for (auto& b : data_){
         b.sequence = block_ack::EMPTY;
     }
     size_ = 0;
-    deleted_ = 0;
     oldest_ = INT32_MAX;
 }
 
@@ -363,69 +413,30 @@ bool block_ack_list::empty() const {
 }
 
 block_ack * block_ack_list::find(int32_t seq){
-    int32_t mask = data_.size() - 1;
-    auto index = seq & mask;
-    while (data_[index].sequence != seq){
-        // terminate on empty bucket, but skip deleted buckets
-        if (data_[index].sequence == block_ack::EMPTY){
-            return nullptr;
-        }
-        index = (index + 1) & mask;
-    }
-    assert(data_[index].sequence >= 0);
-    assert(seq >= oldest_);
-    return &data_[index];
+    auto& b = data_[seq & (data_.size() - 1)];
+    return b.sequence == seq ? &b : nullptr;
 }
 
 block_ack& block_ack_list::get(int32_t seq){
-    // try to find item
-    block_ack *deleted = nullptr;
-    int32_t mask = data_.size() - 1;
-    auto index = seq & mask;
-    while (data_[index].sequence != seq){
-        if (data_[index].sequence == block_ack::DELETED){
-            // save for reuse
-            deleted = &data_[index];
-        } else if (data_[index].sequence == block_ack::EMPTY){
-            // empty bucket -> not found -> insert item
-            // update oldest
-            if (seq < oldest_){
-                oldest_ = seq;
-            }
-            // try to reclaim deleted bucket
-            if (deleted){
-                *deleted = block_ack { seq, limit_ };
-                deleted_--;
-                size_++;
-                // load factor doesn't change, no need to rehash
-                return *deleted;
-            }
-            // put in empty bucket
-            data_[index] = block_ack { seq, limit_ };
+    auto& b = data_[seq & (data_.size() - 1)];
+    if (b.sequence != seq){
+        if (b.sequence == block_ack::EMPTY){
             size_++;
-            // rehash if the table is more than 50% full
-            if ((size_ + deleted_) > (int32_t)(data_.size() >> 1)){
-                rehash();
-                auto b = find(seq);
-                assert(b != nullptr);
-                return *b;
-            } else {
-                return data_[index];
-            }
+        } else {
+            LOG_DEBUG("block_ack_list: replace outdated item " << b.sequence);
+        }
+        b = block_ack { seq, limit_ };
+        if (seq < oldest_){
+            oldest_ = seq;
         }
-        index = (index + 1) & mask;
     }
-    // return existing item
-    assert(data_[index].sequence >= 0);
-    return data_[index];
+    return b;
 }
 
 bool block_ack_list::remove(int32_t seq){
-    // first find the key
     auto b = find(seq);
     if (b){
-        b->sequence = block_ack::DELETED; // mark as deleted
-        deleted_++;
+        b->sequence = block_ack::EMPTY;
         size_--;
         // this won't give the "true" oldest value, but a closer one
         if (seq == oldest_){
@@ -443,12 +454,20 @@ int32_t block_ack_list::remove_before(int32_t seq){
     }
     LOG_DEBUG("block_ack_list: oldest before = " << oldest_);
     int count = 0;
-    for (auto& d : data_){
-        if (d.sequence >= 0 && d.sequence < seq){
-            d.sequence = block_ack::DELETED; // mark as deleted
-            count++;
-            size_--;
-            deleted_++;
+    if ((int64_t)seq - oldest_ < (int64_t)data_.size()){
+        // only visit the slots in between
+        for (auto i = oldest_; i < seq; ++i){
+            if (remove(i)){
+                count++;
+            }
+        }
+    } else {
+        for (auto& b : data_){
+            if (b.sequence >= 0 && b.sequence < seq){
+                b.sequence = block_ack::EMPTY;
+                size_--;
+                count++;
+            }
         }
     }
     oldest_ = seq;
@@ -457,33 +476,6 @@ int32_t block_ack_list::remove_before(int32_t seq){
     return count;
 }
 
-void block_ack_list::rehash(){
-    auto newsize = data_.size() << 1; // double the size
-    auto mask = newsize - 1;
-    std::vector<block_ack> temp(newsize);
-    // use this chance to find oldest item
-    oldest_ = INT32_MAX;
-    // we skip all deleted items; 'size_' stays the same
-    deleted_ = 0;
-    // reinsert items
-    for (auto& b : data_){
-        if (b.sequence >= 0){
-            auto index = b.sequence & mask;
-            // find free slot
-            while (temp[index].sequence >= 0){
-                index = (index + 1) & mask;
-            }
-            // insert item
-            temp[index] = block_ack { b.sequence, limit_ };
-            // update oldest
-            if (b.sequence < oldest_){
-                oldest_ = b.sequence;
-            }
-        }
-    }
-    data_ = std::move(temp);
-}
-
 std::ostream& operator<<(std::ostream& os, const block_ack_list& b){
     os << "acklist (" << b.size() << " / " << b.data_.size() << "): ";
     for (auto& d : b.data_){
@@ -494,127 +486,9 @@ std::ostream& operator<<(std::ostream& os, const block_ack_list& b){
     return os;
 }
 
-#else
-
-block_ack_list::block_ack_list(){}
-
-void block_ack_list::setup(int32_t limit){
-    limit_ = limit;
-}
-
-void block_ack_list::clear(){
-    data_.clear();
-}
-
-int32_t block_ack_list::size() const {
-    return data_.size();
-}
-
-bool block_ack_list::empty() const {
-    return data_.empty();
-}
-
-block_ack * block_ack_list::find(int32_t seq){
-#if BLOCK_ACK_LIST_SORTED
-    // binary search
-    auto it = lower_bound(seq);
-    if (it != data_.end() && it->sequence == seq){
-        return &*it;
-    }
-#else
-    // linear search
-    for (auto& b : data_){
-        if (b.sequence == seq){
-            return &b;
-        }
-    }
-#endif
-    return nullptr;
-}
-
-block_ack& block_ack_list::get(int32_t seq){
-#if BLOCK_ACK_LIST_SORTED
-    auto it = lower_bound(seq);
-    // insert if needed
-    if (it == data_.end() || it->sequence != seq){
-        it = data_.emplace(it, seq, limit_);
-    }
-    return *it;
-#else
-    auto b = find(seq);
-    if (b){
-        return *b;
-    } else {
-        data_.emplace_back(seq, limit_);
-        return data_.back();
-    }
-#endif
-}
-
-bool block_ack_list::remove(int32_t seq){
-#if BLOCK_ACK_LIST_SORTED
-    auto it = lower_bound(seq);
-    if (it != data_.end() && it->sequence == seq){
-        data_.erase(it);
-        return true;
-    }
-#else
-    for (auto it = data_.begin(); it != data_.end(); ++it){
-        if (it->sequence == seq){
-            data_.erase(it);
-            return true;
-        }
-    }
-#endif
-    return false;
-}
-
-int32_t block_ack_list::remove_before(int32_t seq){
-    if (empty()){
-        return 0;
-    }
-    int count = 0;
-#if BLOCK_ACK_LIST_SORTED
-    auto begin = data_.begin();
-    auto end = lower_bound(seq);
-    count = end - begin;
-    data_.erase(begin, end);
-#else
-    for (auto it = data_.begin(); it != data_.end(); ){
-        if (it->sequence < seq){
-            it = data_.erase(it);
-            count++;
-        } else {
-            ++it;
-        }
-    }
-#endif
-    return count;
-}
-
-#if BLOCK_ACK_LIST_SORTED
-std::vector<block_ack>::iterator block_ack_list::lower_bound(int32_t seq){
-    return std::lower_bound(data_.begin(), data_.end(), seq, [](auto& a, auto& b){
-        return a.sequence < b;
-    });
-}
-#endif
-
-std::ostream& operator<<(std::ostream& os, const block_ack_list& b){
-    os << "acklist (" << b.size() << "): ";
-    for (auto& d : b.data_){
-        os << d.sequence << " ";
-    }
-    return os;
-}
-
-#endif
-
 /*////////////////////////// history_buffer ///////////////////////////*/
 
 void history_buffer::clear(){
-    head_ = 0;
-    oldest_ = -1;
     for (auto& block : buffer_){
         block.sequence = -1;
     }
@@ -630,37 +504,13 @@ void history_buffer::resize(int32_t n){
 }
 
 block * history_buffer::find(int32_t seq){
-    if (seq >= oldest_){
-    #if 0
-        // linear search
-        for (auto& block : buffer_){
-            if (block.sequence == seq){
-                return &block;
-            }
+    if (seq >= 0 && !buffer_.empty()){
+        auto& block = buffer_[seq % buffer_.size()];
+        if (block.sequence == seq){
+            return &block;
         }
-    #else
-        // binary search
-        // blocks are always pushed in chronological order,
-        // so the ranges [begin, head] and [head, end] will always be sorted.
-        auto dofind = [&](auto begin, auto end) -> block * {
-            auto result = std::lower_bound(begin, end, seq, [](auto& a, auto& b){
-                return a.sequence < b;
-            });
-            if (result != end && result->sequence == seq){
-                return &*result;
-            } else {
-                return nullptr;
-            }
-        };
-        auto result = dofind(buffer_.begin() + head_, buffer_.end());
-        if (!result){
-            result = dofind(buffer_.begin(), buffer_.begin() + head_);
-        }
-        return result;
-    #endif
-    } else {
-        LOG_VERBOSE("couldn't find block " << seq << " - too old");
     }
+    LOG_VERBOSE("couldn't find block " << seq << " - too old");
     return nullptr;
 }
 
@@ -672,14 +522,15 @@ void history_buffer::push(int32_t seq, double sr,
         return;
     }
     assert(data != nullptr && nbytes > 0);
-    // check if we're going to overwrite an existing block
-    if (buffer_[head_].sequence >= 0){
-        oldest_ = buffer_[head_].sequence;
-    }
-    buffer_[head_].set(seq, sr, 0, data, nbytes, nframes, framesize);
-    if (++head_ >= (int32_t)buffer_.size()){
-        head_ = 0;
+    buffer_[seq % buffer_.size()].set(seq, sr, 0, data, nbytes, nframes, framesize);
+}
+
+void history_buffer::push_silent(int32_t seq, double sr)
+{
+    if (buffer_.empty()){
+        return;
     }
+    buffer_[seq % buffer_.size()].set_silent(seq, sr, 0);
 }
 
 /*////////////////////////// block_queue /////////////////////////////*/
@@ -1089,6 +940,7 @@ void aoo_initialize(){
     if (!initialized){
         // register codecs
         aoo_codec_pcm_setup(aoo_register_codec);
+        aoo_codec_lossless_setup(aoo_register_codec);
 
     #if USE_CODEC_OPUS
         aoo_codec_opus_setup(aoo_register_codec);
@@ -1099,3 +951,9 @@ void aoo_initialize(){
 }
 
 void aoo_terminate() {}
+
+std::atomic<aoo_tracefn> aoo::g_tracefn { nullptr };
+
+void aoo_set_tracefn(aoo_tracefn fn){
+    aoo::g_tracefn.store(fn);
+}
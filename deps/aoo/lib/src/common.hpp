@@ -14,11 +14,44 @@
 #include <memory>
 #include <atomic>
 
+// Binary data message (see AOO_PROTOCOL_FLAG_BINARY_DATA), not OSC.
+// All fields are in network byte order:
+// [0] magic "\0ad" [3] flags [4] salt [8] sequence
+// short form, like the compact data message (one frame, channel onset 0):
+//     [12] samplerate (float64, only with AOO_BIN_DATA_SAMPLERATE) [12 or 20] data
+// full form (AOO_BIN_DATA_FULL):
+//     [12] sink ID [16] source ID [20] channel onset [24] total size
+//     [28] number of frames [32] frame index [36] samplerate (float64) [44] data
+#define AOO_BIN_DATA_MAGIC "\0ad"
+#define AOO_BIN_DATA_MAGIC_LEN 3
+#define AOO_BIN_DATA_FULL 0x1
+#define AOO_BIN_DATA_SAMPLERATE 0x2
+#define AOO_BIN_DATA_HEADERSIZE 12
+#define AOO_BIN_DATA_FULL_HEADERSIZE 44
 
 namespace aoo {
 
 bool check_version(uint32_t version);
 
+extern std::atomic<aoo_tracefn> g_tracefn;
+
+inline void trace_event(const char *name, char phase, int32_t id = 0, int64_t arg = 0){
+    auto fn = g_tracefn.load(std::memory_order_relaxed);
+    if (fn){
+        fn(name, phase, id, arg);
+    }
+}
+
+class scoped_trace {
+public:
+    scoped_trace(const char *name, int32_t id = 0)
+        : name_(name), id_(id) { trace_event(name_, 'B', id_); }
+    ~scoped_trace(){ trace_event(name_, 'E', id_); }
+private:
+    const char *name_;
+    int32_t id_;
+};
+
 uint32_t make_version(uint8_t protocolflags = 0);
 
 class dynamic_resampler {
@@ -82,6 +115,13 @@ public:
         return codec_->encoder_reset(obj_);
     }
 
+    int32_t ctl(int32_t type, int32_t value){
+        return codec_->encoder_ctl ? codec_->encoder_ctl(obj_, type, &value, sizeof(value)) : 0;
+    }
+
+    int32_t get_ctl(int32_t type, int32_t& value) const {
+        return codec_->encoder_ctl ? codec_->encoder_ctl(obj_, type, &value, sizeof(value)) : 0;
+    }
 };
 
 class decoder : public base_codec {
@@ -111,6 +151,7 @@ public:
     const char *name() const {
         return codec_->name;
     }
+    const aoo_codec * get() const { return codec_; }
     std::unique_ptr<encoder> create_encoder() const;
     std::unique_ptr<decoder> create_decoder() const;
     
@@ -136,6 +177,8 @@ struct data_packet {
     int32_t framenum;
     const char *data;
     int32_t size;
+    // a silent block has no data, but unlike a dropped block (nframes = 0) it isn't lost
+    bool silent() const { return totalsize == 0 && nframes > 0; }
 };
 
 class block {
@@ -146,6 +189,8 @@ public:
     void set(int32_t seq, double sr, int32_t chn,
              const char *data, int32_t nbytes,
              int32_t nframes, int32_t framesize);
+    void set_silent(int32_t seq, double sr, int32_t chn);
+    bool silent() const { return silent_; }
     const char* data() const { return buffer_.data(); }
     int32_t size() const { return buffer_.size(); }
     bool complete() const;
@@ -154,15 +199,20 @@ public:
     bool has_frame(int32_t which) const;
     int32_t frame_size(int32_t which) const;
     int32_t num_frames() const { return numframes_; }
+    int32_t num_missing() const { return missing_; }
     // data
     int32_t sequence = -1;
     double samplerate = 0;
     int32_t channel = 0;
 protected:
     std::vector<char> buffer_;
-    uint64_t frames_ = 0; // bitfield (later expand)
+    // bitset of missing frames, any number of frames per block.
+    // Blocks are recycled, so this only allocates for unusually large blocks.
+    std::vector<uint64_t> frames_;
+    int32_t missing_ = 0;
     int32_t numframes_ = 0;
     int32_t framesize_ = 0;
+    bool silent_ = false;
 };
 
 class block_queue {
@@ -194,7 +244,6 @@ private:
 class block_ack {
 public:
     static const int32_t EMPTY = -1;
-    static const int32_t DELETED = -2;
 
     block_ack();
     block_ack(int32_t seq, int32_t limit);
@@ -207,14 +256,16 @@ private:
     double timestamp_;
 };
 
-#define BLOCK_ACK_LIST_HASHTABLE 1
-#define BLOCK_ACK_LIST_SORTED 1
-
+// Ring buffer indexed by sequence number, so every operation is O(1).
+// Only blocks within the block queue window need an entry; if a slot is
+// still taken by a block from an older window, it is outdated anyway
+// and just gets replaced.
 class block_ack_list {
 public:
     block_ack_list();
 
     void set_limit(int32_t limit);
+    void resize(int32_t window);
     block_ack* find(int32_t seq);
     block_ack& get(int32_t seq);
     bool remove(int32_t seq);
@@ -225,23 +276,16 @@ public:
 
     friend std::ostream& operator<<(std::ostream& os, const block_ack_list& b);
 private:
-#if !BLOCK_ACK_LIST_HASHTABLE
-#if BLOCK_ACK_LIST_SORTED
-    std::vector<block_ack>::iterator lower_bound(int32_t seq);
-#endif
-#else
-    void rehash();
+    static const int32_t initial_size_ = 64;
 
-    static const int32_t initial_size_ = 16;
-
-    int32_t size_;
-    int32_t deleted_;
-    int32_t oldest_;
-#endif
+    int32_t size_ = 0;
+    int32_t oldest_ = INT32_MAX;
     int32_t limit_ = 0;
     std::vector<block_ack> data_;
 };
 
+// Ring buffer indexed by sequence number (seq % capacity),
+// blocks are pushed in order, so lookups are O(1).
 class history_buffer {
 public:
     void clear();
@@ -251,10 +295,9 @@ public:
     void push(int32_t seq, double sr,
              const char *data, int32_t nbytes,
              int32_t nframes, int32_t framesize);
+    void push_silent(int32_t seq, double sr);
 private:
     std::vector<block> buffer_;
-    int32_t oldest_ = 0;
-    int32_t head_ = 0;
 };
 
 /*//////////////////////// timer //////////////////////*/
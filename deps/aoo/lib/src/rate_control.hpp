@@ -0,0 +1,80 @@
+/* Copyright (c) 2010-Now Christof Ressi, Winfried Ritsch and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+#pragma once
+
+#include <algorithm>
+#include <inttypes.h>
+
+namespace aoo {
+
+// Loss and delay based bitrate controller (AIMD).
+// Every ping reply of a sink is one feedback interval: the lost blocks it
+// reports plus the resend requests we got in the meantime give the loss
+// ratio, and a round trip time well above the lowest one seen means that
+// queues are building up before packets actually get dropped.
+class rate_controller {
+public:
+    // the current bitrate is kept, but clamped to the new bounds
+    void set_bounds(int32_t minrate, int32_t maxrate){
+        maxrate_ = std::max<int32_t>(maxrate, 0);
+        minrate_ = std::min<int32_t>(std::max<int32_t>(minrate, 0), maxrate_);
+        if (rate_ <= 0){
+            rate_ = maxrate_;
+        }
+        rate_ = std::max<double>(minrate_, std::min<double>(rate_, maxrate_));
+    }
+
+    int32_t bitrate() const { return (int32_t)rate_; }
+
+    // rtt in seconds (<= 0: unknown), returns true if the bitrate has changed
+    bool update(double rtt, int32_t lost, int32_t resent, int32_t expected){
+        auto oldrate = bitrate();
+
+        double loss = 0;
+        if (expected > 0){
+            // resent blocks made it in the end, but still show congestion
+            loss = std::min<double>(1.0, (lost + 0.5 * resent) / expected);
+        }
+
+        bool queueing = false;
+        if (rtt > 0){
+            if (minrtt_ <= 0 || rtt < minrtt_){
+                minrtt_ = rtt;
+            } else {
+                // slowly follow a route change to a longer path
+                minrtt_ += (rtt - minrtt_) * 0.01;
+            }
+            srtt_ = srtt_ > 0 ? srtt_ * 0.7 + rtt * 0.3 : rtt;
+            queueing = (srtt_ - minrtt_) > std::max<double>(0.025, minrtt_ * 0.5);
+        }
+
+        if (loss > 0.1){
+            // heavy loss: back off hard
+            rate_ *= std::max<double>(0.5, 1.0 - 0.5 * loss);
+            holdoff_ = 3;
+        } else if (loss > 0.02 || queueing){
+            rate_ *= 0.85;
+            holdoff_ = 2;
+        } else if (holdoff_ > 0){
+            // let the link drain before probing again
+            --holdoff_;
+        } else {
+            rate_ += std::max<double>(rate_ * 0.08, 2000);
+        }
+
+        rate_ = std::max<double>(minrate_, std::min<double>(rate_, maxrate_));
+
+        return bitrate() != oldrate;
+    }
+private:
+    double rate_ = 0;
+    int32_t minrate_ = 0;
+    int32_t maxrate_ = 0;
+    double minrtt_ = 0;
+    double srtt_ = 0;
+    int32_t holdoff_ = 0;
+};
+
+} // aoo
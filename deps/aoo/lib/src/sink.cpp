@@ -202,6 +202,28 @@ int32_t aoo::sink::set_option(int32_t opt, void *ptr, int32_t size)
         CHECKARG(int32_t);
         protocol_flags_ = as<int32_t>(ptr) & 0xff;
         break;
+    // stream capture
+    case aoo_opt_capture_handler:
+    {
+        CHECKARG(aoo_capture_handler);
+        {
+            scoped_lock<spinlock> l(capture_lock_);
+            capture_ = as<aoo_capture_handler>(ptr);
+            capturing_ = capture_.format != nullptr || capture_.block != nullptr;
+        }
+        // once this returns, no more calls to a previous handler are in progress
+        while (capture_users_.load(std::memory_order_acquire) > 0){
+            pause_cpu();
+        }
+        if (capturing_){
+            // the capture needs to know the current formats. written from the network
+            // thread with the next block, the capture only takes records from one thread
+            for (auto& src : sources_){
+                src.request_capture_format();
+            }
+        }
+        break;
+    }
     // unknown
     default:
         LOG_WARNING("aoo_sink: unsupported option " << opt);
@@ -210,6 +232,35 @@ int32_t aoo::sink::set_option(int32_t opt, void *ptr, int32_t size)
     return 1;
 }
 
+aoo_capture_handler aoo::sink::acquire_capture_handler() const {
+    scoped_lock<spinlock> l(capture_lock_);
+    // counted while still locked, so set_option() can't miss us
+    capture_users_.fetch_add(1, std::memory_order_acq_rel);
+    return capture_;
+}
+
+void aoo::sink::release_capture_handler() const {
+    capture_users_.fetch_sub(1, std::memory_order_release);
+}
+
+void aoo::sink::capture_format(void *endpoint, int32_t id, const aoo_format& f,
+                               const char *settings, int32_t size) const {
+    auto handler = acquire_capture_handler();
+    if (handler.format){
+        handler.format(handler.user, endpoint, id, &f, settings, size);
+    }
+    release_capture_handler();
+}
+
+void aoo::sink::capture_block(void *endpoint, int32_t id, int32_t sequence, double sr,
+                              int32_t channel, const char *data, int32_t size) const {
+    auto handler = acquire_capture_handler();
+    if (handler.block){
+        handler.block(handler.user, endpoint, id, sequence, sr, channel, data, size);
+    }
+    release_capture_handler();
+}
+
 int32_t aoo_sink_get_option(aoo_sink *sink, int32_t opt, void *p, int32_t size)
 {
     return sink->get_option(opt, p, size);
@@ -330,6 +381,14 @@ int32_t aoo_sink_handle_message(aoo_sink *sink, const char *data, int32_t n,
 
 int32_t aoo::sink::handle_message(const char *data, int32_t n,
                                   void *endpoint, aoo_replyfn fn) {
+    // binary data messages are not OSC, so check them first
+    if (n >= AOO_BIN_DATA_MAGIC_LEN && !memcmp(data, AOO_BIN_DATA_MAGIC, AOO_BIN_DATA_MAGIC_LEN)){
+        if (samplerate_ == 0){
+            return 0; // not setup yet
+        }
+        return handle_binary_data_message(endpoint, fn, data, n);
+    }
+
     try {
         osc::ReceivedPacket packet(data, n);
         osc::ReceivedMessage msg(packet);
@@ -377,6 +436,8 @@ int32_t aoo::sink::handle_message(const char *data, int32_t n,
             return handle_data_message(endpoint, fn, msg);
         } else if (!strcmp(pattern, AOO_MSG_PING)){
             return handle_ping_message(endpoint, fn, msg);
+        } else if (!strcmp(pattern, AOO_MSG_PROBE)){
+            return handle_probe_message(endpoint, fn, msg, n);
         } else {
             LOG_WARNING("unknown message " << pattern);
         }
@@ -661,6 +722,86 @@ int32_t sink::handle_compact_data_message(void *endpoint, aoo_replyfn fn,
     }
 }
 
+int32_t sink::handle_binary_data_message(void *endpoint, aoo_replyfn fn,
+                                         const char *data, int32_t n)
+{
+    // see common.hpp for the layout
+    if (n < AOO_BIN_DATA_HEADERSIZE){
+        LOG_WARNING("binary data message too short");
+        return 0;
+    }
+    auto flags = data[3];
+    auto salt = aoo::from_bytes<int32_t>(data + 4);
+
+    aoo::data_packet d;
+    d.sequence = aoo::from_bytes<int32_t>(data + 8);
+
+    if (flags & AOO_BIN_DATA_FULL){
+        if (n < AOO_BIN_DATA_FULL_HEADERSIZE){
+            LOG_WARNING("binary data message too short");
+            return 0;
+        }
+        auto sinkid = aoo::from_bytes<int32_t>(data + 12);
+        if (sinkid != id() && sinkid != AOO_ID_WILDCARD){
+            LOG_WARNING("wrong sink ID!");
+            return 0;
+        }
+        auto id = aoo::from_bytes<int32_t>(data + 16);
+        d.channel = aoo::from_bytes<int32_t>(data + 20);
+        d.totalsize = aoo::from_bytes<int32_t>(data + 24);
+        d.nframes = aoo::from_bytes<int32_t>(data + 28);
+        d.framenum = aoo::from_bytes<int32_t>(data + 32);
+        d.samplerate = aoo::from_bytes<double>(data + 36);
+        d.data = data + AOO_BIN_DATA_FULL_HEADERSIZE;
+        d.size = n - AOO_BIN_DATA_FULL_HEADERSIZE;
+
+        if (id < 0){
+            LOG_WARNING("bad ID for binary data message");
+            return 0;
+        }
+        // try to find existing source
+        auto src = find_source(endpoint, id);
+        if (src){
+            return src->handle_data(*this, salt, d);
+        } else {
+            // discard data message, add source and request format!
+            sources_.emplace_front(endpoint, fn, id, salt);
+            src = &sources_.front();
+            src->set_protocol_flags(protocol_flags_);
+            src->request_format();
+            return 0;
+        }
+    } else {
+        int32_t onset = AOO_BIN_DATA_HEADERSIZE;
+        if (flags & AOO_BIN_DATA_SAMPLERATE){
+            if (n < onset + 8){
+                LOG_WARNING("binary data message too short");
+                return 0;
+            }
+            d.samplerate = aoo::from_bytes<double>(data + onset);
+            onset += 8;
+        } else {
+            d.samplerate = 0; // marker to use last
+        }
+        // reconstruct the rest from prior format
+        d.channel = 0;
+        d.nframes = 1;
+        d.framenum = 0;
+        d.data = data + onset;
+        d.size = n - onset;
+        d.totalsize = d.size;
+
+        // try to find existing source by salt
+        auto src = find_source_by_salt(endpoint, salt);
+        if (src){
+            return src->handle_data(*this, salt, d);
+        } else {
+            // discard data message
+            return 0;
+        }
+    }
+}
+
 int32_t sink::handle_ping_message(void *endpoint, aoo_replyfn fn,
                                   const osc::ReceivedMessage& msg)
 {
@@ -683,6 +824,30 @@ int32_t sink::handle_ping_message(void *endpoint, aoo_replyfn fn,
     }
 }
 
+// /aoo/sink/<id>/probe <src> <padding>
+
+int32_t sink::handle_probe_message(void *endpoint, aoo_replyfn fn,
+                                   const osc::ReceivedMessage& msg, int32_t n)
+{
+    auto it = msg.ArgumentsBegin();
+
+    auto id = (it++)->AsInt32();
+
+    if (id < 0){
+        LOG_WARNING("bad ID for " << AOO_MSG_PROBE << " message");
+        return 0;
+    }
+    // try to find existing source
+    auto src = find_source(endpoint, id);
+    if (src){
+        // the size of the probe is the size of the whole packet
+        return src->handle_probe(*this, n);
+    } else {
+        LOG_VERBOSE("couldn't find source " << id << " for " << AOO_MSG_PROBE << " message");
+        return 0;
+    }
+}
+
 /*////////////////////////// source_desc /////////////////////////////*/
 
 source_desc::source_desc(void *endpoint, aoo_replyfn fn, int32_t id, int32_t salt)
@@ -722,6 +887,23 @@ void source_desc::request_codec_change(aoo_format & f)
     }
 }
 
+// called with mutex_ locked
+void source_desc::capture_format(const sink& s){
+    if (decoder_){
+        aoo_format_storage f;
+        if (decoder_->get_format(f)){
+            auto c = aoo::find_codec(decoder_->name());
+            if (c){
+                char buf[AOO_CODEC_MAXSETTINGSIZE];
+                auto size = c->serialize_format(f.header, buf, sizeof(buf));
+                if (size >= 0){
+                    s.capture_format(endpoint_, id_, f.header, buf, size);
+                }
+            }
+        }
+    }
+}
+
 int32_t source_desc::get_buffer_fill_ratio(float &ratio){
     if (audioqueue_.capacity() > 0) {
         ratio = (audioqueue_.read_available() * audioqueue_.blocksize()) / (float)audioqueue_.capacity();
@@ -790,7 +972,7 @@ void source_desc::do_update(const sink &s){
         samplerate_ = decoder_->samplerate();
         streamstate_.reset();
         ack_list_.set_limit(s.resend_limit());
-        ack_list_.clear();
+        ack_list_.resize(blockqueue_.capacity());
 
         // start in a need recovery state so the buffer is re-filled when we get the first data
         streamstate_.request_recover();
@@ -832,6 +1014,11 @@ int32_t source_desc::handle_format(const sink& s, int32_t salt, const aoo_format
     // read format
     decoder_->read_format(f, settings, size);
 
+    if (s.capturing()){
+        s.capture_format(endpoint_, id_, f, settings, size);
+        capture_format_requested_.store(false);
+    }
+
     // user format
     if (userformat) {
         userformat_.assign(userformat, userformat+ufsize);
@@ -870,6 +1057,10 @@ int32_t source_desc::handle_data(const sink& s, int32_t salt, const aoo::data_pa
 #else
     assert(decoder_ != nullptr);
 #endif
+    if (capture_format_requested_.exchange(false) && s.capturing()){
+        capture_format(s);
+    }
+
     LOG_DEBUG("got block: seq = " << d.sequence << ", sr = " << d.samplerate
               << ", chn = " << d.channel << ", totalsize = " << d.totalsize
               << ", nframes = " << d.nframes << ", frame = " << d.framenum << ", size " << d.size);
@@ -880,20 +1071,36 @@ int32_t source_desc::handle_data(const sink& s, int32_t salt, const aoo::data_pa
     }
 
     // check data packet
-    if (!check_packet(d)){
+    if (!check_packet(s, d)){
         return 0;
     }
 
+    // Fast path: the next block in a single frame with nothing queued before it.
+    // Decode it straight from the packet instead of copying it into the block queue.
+    if (d.nframes == 1 && d.sequence == next_ && blockqueue_.empty()
+            && audioqueue_.write_available() && (d.totalsize == d.size)){
+        block_info i;
+        i.sr = d.samplerate > 0 ? d.samplerate : samplerate_;
+        i.channel = d.channel >= 0 ? d.channel : channel_;
+        write_block(s, d.sequence, d.data, d.size, i);
+        next_++;
+        ack_list_.remove(d.sequence);
+
+        check_missing_blocks(s);
+
+        return 1;
+    }
+
     // add data packet
-    if (!add_packet(d)){
+    if (!add_packet(s, d)){
         return 0;
     }
 
     // process blocks and send audio
-    process_blocks();
+    process_blocks(s);
 
 #if 1
-    check_outdated_blocks();
+    check_outdated_blocks(s);
 #endif
 
     // check and resend missing blocks
@@ -936,6 +1143,14 @@ int32_t source_desc::handle_ping(const sink &s, time_tag tt){
     return 1;
 }
 
+int32_t source_desc::handle_probe(const sink &s, int32_t size){
+    // only called from the network thread
+    if (size > probe_size_.load()){
+        probe_size_ = size;
+    }
+    return 1;
+}
+
 bool source_desc::send(const sink& s){
     bool didsomething = false;
 
@@ -955,6 +1170,8 @@ bool source_desc::send(const sink& s){
 }
 
 bool source_desc::process(const sink& s, aoo_sample *buffer, int32_t stride, int32_t numsampleframes){
+    scoped_trace trace("aoo::source_desc::process", id_);
+
     // synchronize with handle_format() and update()!
     // the mutex should be uncontended most of the time.
     // NOTE: We could use try_lock() and skip the block if we couldn't aquire the lock.
@@ -978,6 +1195,7 @@ bool source_desc::process(const sink& s, aoo_sample *buffer, int32_t stride, int
         e.type = AOO_BLOCK_LOST_EVENT;
         e.block_loss.count = lost;
         push_event(e);
+        trace_event("aoo block lost", 'i', id_, lost);
     }
     if (reordered > 0){
         // push packet reorder event
@@ -1086,6 +1304,7 @@ bool source_desc::process(const sink& s, aoo_sample *buffer, int32_t stride, int
 
             // this doesn't do anything if the stream simply stopped
             streamstate_.set_underrun();
+            trace_event("aoo buffer underrun", 'i', id_);
         }
 
         return false;
@@ -1109,7 +1328,7 @@ int32_t source_desc::handle_events(aoo_eventhandler fn, void *user){
     return n;
 }
 
-bool source_desc::check_packet(const data_packet &d){
+bool source_desc::check_packet(const sink& s, const data_packet &d){
     if (d.sequence < next_){
         // block too old, discard!
         LOG_VERBOSE("discarded old block " << d.sequence);
@@ -1124,8 +1343,8 @@ bool source_desc::check_packet(const data_packet &d){
     // check if we need to recover
     bool recover = streamstate_.need_recover();
 
-    // check for empty block (= skipped)
-    bool dropped = d.totalsize == 0;
+    // check for empty block (= skipped), silent blocks are empty as well
+    bool dropped = d.totalsize == 0 && !d.silent();
 
     // check for buffer underrun
     bool underrun = streamstate_.have_underrun();
@@ -1151,6 +1370,7 @@ bool source_desc::check_packet(const data_packet &d){
     if (large_gap || recover || dropped || underrun){
         // record dropped blocks
         streamstate_.add_lost(blockqueue_.size());
+        capture_dropped_queue(s);
         if (diff > 1){
             // record gap (measured in blocks)
             streamstate_.add_gap(diff - 1);
@@ -1184,6 +1404,7 @@ bool source_desc::check_packet(const data_packet &d){
                           : underrun ? "buffer underrun"
                           : "?";
             LOG_VERBOSE("wrote " << count << " empty blocks for " << reason);
+            trace_event(reason, 'i', id_, count);
             //if (large_gap > 0) {
             nextneedsfadein_ = next_;
             //}
@@ -1198,7 +1419,13 @@ bool source_desc::check_packet(const data_packet &d){
     return true;
 }
 
-bool source_desc::add_packet(const data_packet& d){
+bool source_desc::add_packet(const sink& s, const data_packet& d){
+    // there is no limit on the number of frames, but every frame has at least one byte
+    if (!d.silent() && (d.nframes > d.totalsize || d.framenum < 0 || d.framenum >= d.nframes)){
+        LOG_WARNING("bad frame " << d.framenum << " (" << d.nframes << " frames, "
+                    << d.totalsize << " bytes) for block " << d.sequence);
+        return false;
+    }
     auto block = blockqueue_.find(d.sequence);
     if (!block){
         if (blockqueue_.full()){
@@ -1208,6 +1435,7 @@ bool source_desc::add_packet(const data_packet& d){
             // first we check if the first (complete) block is about to be read next,
             // which means that we have a buffer overflow (the source is too fast)
             if (old == next_ && blockqueue_.front().complete()){
+                capture_dropped_queue(s);
                 // clear the block queue and fill audio buffer with zeros.
                 blockqueue_.clear();
                 ack_list_.clear();
@@ -1245,6 +1473,7 @@ bool source_desc::add_packet(const data_packet& d){
                 }
                 // record dropped block
                 streamstate_.add_lost(1);
+                capture_dropped(s, old);
                 // remove block from acklist
                 ack_list_.remove(old);
                 // update 'next'!
@@ -1257,8 +1486,20 @@ bool source_desc::add_packet(const data_packet& d){
         // add new block
         double srate = d.samplerate > 0 ? d.samplerate : samplerate_;
         int chan = d.channel >= 0 ? d.channel : channel_;
+        if (d.silent()){
+            // complete without any frames
+            block = blockqueue_.insert(d.sequence, srate, chan, 1, 1);
+            block->set_silent(d.sequence, srate, chan);
+            return true;
+        }
         block = blockqueue_.insert(d.sequence, srate,
                                    chan, d.totalsize, d.nframes);
+    } else if (block->silent() || d.silent()){
+        LOG_VERBOSE("block " << d.sequence << " already received!");
+        return false;
+    } else if (d.framenum >= block->num_frames()){
+        LOG_WARNING("frame " << d.framenum << " out of range for block " << d.sequence);
+        return false;
     } else if (block->has_frame(d.framenum)){
         LOG_VERBOSE("frame " << d.framenum << " of block " << d.sequence << " already received!");
         return false;
@@ -1276,7 +1517,7 @@ bool source_desc::add_packet(const data_packet& d){
     return true;
 }
 
-void source_desc::process_blocks(){
+void source_desc::process_blocks(const sink& s){
     // Transfer all consecutive complete blocks as long as
     // no previous (expected) blocks are missing.
     if (blockqueue_.empty()){
@@ -1290,13 +1531,11 @@ void source_desc::process_blocks(){
         const char *data;
         int32_t size;
         block_info i;
-        const bool dofadein = b->sequence == nextneedsfadein_;
-        
         if (b->sequence == next && b->complete()){
             // block is ready
             LOG_DEBUG("write samples (" << b->sequence << ")");
             data = b->data();
-            size = b->size();
+            size = b->silent() ? 0 : b->size();
             i.sr = b->samplerate;
             i.channel = b->channel;
 
@@ -1319,37 +1558,9 @@ void source_desc::process_blocks(){
             break;
         }
 
-        next++;
-
-        // decode data and push samples
-        auto ptr = audioqueue_.write_data();
-        auto nsamples = audioqueue_.blocksize();
-        // decode audio data
-        if (decoder_->decode(data, size, ptr, nsamples) < 0){
-            LOG_WARNING("aoo_sink: couldn't decode block!");
-            // decoder failed - fill with zeros
-            std::fill(ptr, ptr + nsamples, 0);
-        }
-        else if (dofadein) {
-            // fade the samples in
-            LOG_VERBOSE("fading in block");
-            auto nchannels = decoder_->nchannels();
-            const int sframes = nsamples/nchannels;
-            for (int i = 0; i < nchannels; ++i){
-                float gain = 0.0f;
-                const float gaindelta = 1.0f / sframes;
-                for (int j = 0; j < sframes; ++j){
-                    ptr[j*nchannels+i] *= gain;
-                    gain += gaindelta;
-                }
-            }                   
-            
-            nextneedsfadein_ = -1;
-        }
-        audioqueue_.write_commit();
+        write_block(s, next, data, size, i);
 
-        // push info
-        infoqueue_.write(i);
+        next++;
     }
     next_ = next;
     // pop blocks
@@ -1366,7 +1577,53 @@ void source_desc::process_blocks(){
     LOG_DEBUG("next: " << next_);
 }
 
-void source_desc::check_outdated_blocks(){
+void source_desc::write_block(const sink& s, int32_t sequence, const char *data,
+                              int32_t size, const block_info& info){
+    const bool dofadein = sequence == nextneedsfadein_;
+
+    if (s.capturing()){
+        s.capture_block(endpoint_, id_, sequence, info.sr, info.channel, data, size);
+    }
+
+    // decode data and push samples
+    auto ptr = audioqueue_.write_data();
+    auto nsamples = audioqueue_.blocksize();
+    // decode audio data
+    if (data && size == 0){
+        // silent block, no need to run the decoder
+        std::fill(ptr, ptr + nsamples, 0);
+        if (dofadein){
+            // nothing to fade, the decoder skipped it though, so fade in the next block instead
+            nextneedsfadein_ = sequence + 1;
+        }
+    } else if (decoder_->decode(data, size, ptr, nsamples) < 0){
+        LOG_WARNING("aoo_sink: couldn't decode block!");
+        // decoder failed - fill with zeros
+        std::fill(ptr, ptr + nsamples, 0);
+    }
+    else if (dofadein) {
+        // fade the samples in
+        LOG_VERBOSE("fading in block");
+        auto nchannels = decoder_->nchannels();
+        const int sframes = nsamples/nchannels;
+        for (int i = 0; i < nchannels; ++i){
+            float gain = 0.0f;
+            const float gaindelta = 1.0f / sframes;
+            for (int j = 0; j < sframes; ++j){
+                ptr[j*nchannels+i] *= gain;
+                gain += gaindelta;
+            }
+        }                   
+        
+        nextneedsfadein_ = -1;
+    }
+    audioqueue_.write_commit();
+
+    // push info
+    infoqueue_.write(info);
+}
+
+void source_desc::check_outdated_blocks(const sink& s){
     // pop outdated blocks (shouldn't really happen...)
     while (!blockqueue_.empty() &&
            (newest_ - blockqueue_.front().sequence) >= blockqueue_.capacity())
@@ -1383,6 +1640,21 @@ void source_desc::check_outdated_blocks(){
         }
         // record dropped block
         streamstate_.add_lost(1);
+        capture_dropped(s, old);
+    }
+}
+
+void source_desc::capture_dropped(const sink& s, int32_t sequence){
+    if (s.capturing()){
+        s.capture_block(endpoint_, id_, sequence, decoder_->samplerate(), channel_, nullptr, 0);
+    }
+}
+
+void source_desc::capture_dropped_queue(const sink& s){
+    if (s.capturing()){
+        for (auto& b : blockqueue_){
+            capture_dropped(s, b.sequence);
+        }
     }
 }
 
@@ -1415,8 +1687,10 @@ void source_desc::check_missing_blocks(const sink& s){
             // insert ack (if needed)
             auto& ack = ack_list_.get(it->sequence);
             if (ack.update(s.elapsed_time(), s.resend_interval())){
-                for (int i = 0; i < it->num_frames(); ++i){
+                // only request the frames we don't have yet
+                for (int i = 0, n = it->num_missing(); n > 0 && i < it->num_frames(); ++i){
                     if (!it->has_frame(i)){
+                        n--;
                         if (numframes < s.resend_maxnumframes()){
                             resendqueue_.write(data_request { it->sequence, i });
                             numframes++;
@@ -1440,7 +1714,9 @@ resend_incomplete_done:
                 // insert ack (if necessary)
                 auto& ack = ack_list_.get(next + i);
                 if (ack.update(s.elapsed_time(), s.resend_interval())){
-                    if (numframes + it->num_frames() <= s.resend_maxnumframes()){
+                    // a block can have more frames than we may request at once,
+                    // so always allow the first one
+                    if (numframes == 0 || numframes + it->num_frames() <= s.resend_maxnumframes()){
                         resendqueue_.write(data_request { next + i, -1 }); // whole block
                         numframes += it->num_frames();
                     } else {
@@ -1456,7 +1732,6 @@ resend_incomplete_done:
     }
 resend_missing_done:
 
-    assert(numframes <= s.resend_maxnumframes());
     if (numframes > 0){
         LOG_DEBUG("requested " << numframes << " frames");
     }
@@ -1536,8 +1811,13 @@ int32_t source_desc::send_data_request(const sink &s){
     // called without lock!
     shared_lock lock(mutex_);
     int32_t salt = salt_;
+    bool ranges = protocol_flags_ & AOO_PROTOCOL_FLAG_RESEND_RANGES;
     lock.unlock();
 
+    if (ranges){
+        return send_resend_request(s, salt);
+    }
+
     int32_t numrequests = 0;
     while ((numrequests = resendqueue_.read_available()) > 0){
         // send request messages
@@ -1577,6 +1857,86 @@ int32_t source_desc::send_data_request(const sink &s){
     return numrequests;
 }
 
+// /aoo/src/<id>/resend <sink> <salt> <seq0> <frame0> <mask0> <seq1> <frame1> <mask1> ...
+// frame < 0: bit i of the mask requests the whole block seq + i,
+// otherwise bit i requests frame + i of block seq.
+
+int32_t source_desc::send_resend_request(const sink &s, int32_t salt){
+    // called without lock!
+    int32_t numrequests = resendqueue_.read_available();
+    if (numrequests <= 0){
+        return 0;
+    }
+
+    char buf[AOO_MAXPACKETSIZE];
+    osc::OutboundPacketStream msg(buf, sizeof(buf));
+
+    // make OSC address pattern
+    const int32_t maxaddrsize = AOO_MSG_DOMAIN_LEN +
+            AOO_MSG_SOURCE_LEN + 16 + AOO_MSG_RESEND_LEN;
+    char address[maxaddrsize];
+    snprintf(address, sizeof(address), "%s%s/%d%s",
+             AOO_MSG_DOMAIN, AOO_MSG_SOURCE, id_, AOO_MSG_RESEND);
+
+    const int32_t maxdatasize = s.packetsize() - maxaddrsize - 16; // id + salt + padding
+    const int32_t maxranges = maxdatasize / 15; // 3 * (int32_t + typetag)
+
+    int32_t numranges = 0;
+
+    auto flush = [&](){
+        if (numranges > 0){
+            msg << osc::EndMessage;
+
+            dosend(msg.Data(), (int32_t)msg.Size());
+
+            msg.Clear();
+            numranges = 0;
+        }
+    };
+
+    auto addrange = [&](const data_request& r, uint32_t mask){
+        if (numranges == 0){
+            msg << osc::BeginMessage(address) << s.id() << salt;
+        }
+        msg << r.sequence << r.frame << (int32_t)mask;
+        if (++numranges == maxranges){
+            flush();
+        }
+    };
+
+    // requests come in ascending order, so we can merge them on the fly
+    data_request range { 0, 0 };
+    uint32_t mask = 0;
+    for (int i = 0; i < numrequests; ++i){
+        data_request r;
+        resendqueue_.read(r);
+        if (mask){
+            if (r.frame < 0 && range.frame < 0){
+                auto offset = r.sequence - range.sequence;
+                if (offset >= 0 && offset < 32){
+                    mask |= (uint32_t)1 << offset;
+                    continue;
+                }
+            } else if (r.frame >= 0 && range.frame >= 0 && r.sequence == range.sequence){
+                auto offset = r.frame - range.frame;
+                if (offset >= 0 && offset < 32){
+                    mask |= (uint32_t)1 << offset;
+                    continue;
+                }
+            }
+            addrange(range, mask);
+        }
+        range = r;
+        mask = 1;
+    }
+    if (mask){
+        addrange(range, mask);
+    }
+    flush();
+
+    return numrequests;
+}
+
 // AoO/<id>/ping <sink>
 
 bool source_desc::send_notifications(const sink& s){
@@ -1617,6 +1977,28 @@ bool source_desc::send_notifications(const sink& s){
         }
     }
 
+    // answer path MTU probes with the largest one we got
+    auto probesize = probe_size_.exchange(0);
+    if (probesize > 0){
+        char buffer[AOO_MAXPACKETSIZE];
+        osc::OutboundPacketStream msg(buffer, sizeof(buffer));
+
+        // make OSC address pattern
+        const int32_t max_addr_size = AOO_MSG_DOMAIN_LEN
+                + AOO_MSG_SOURCE_LEN + 16 + AOO_MSG_PROBE_LEN;
+        char address[max_addr_size];
+        snprintf(address, sizeof(address), "%s%s/%d%s",
+                 AOO_MSG_DOMAIN, AOO_MSG_SOURCE, id_, AOO_MSG_PROBE);
+
+        msg << osc::BeginMessage(address) << s.id() << probesize
+            << osc::EndMessage;
+
+        dosend(msg.Data(), (int32_t)msg.Size());
+
+        LOG_DEBUG("send /probe to source " << id_ << " size: " << probesize);
+        didsomething = true;
+    }
+
     auto invitation = streamstate_.get_invitation_state();
     if (invitation == stream_state::INVITE){
         char buffer[AOO_MAXPACKETSIZE];
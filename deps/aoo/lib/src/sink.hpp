@@ -175,6 +175,8 @@ public:
 
     int32_t handle_ping(const sink& s, time_tag tt);
 
+    int32_t handle_probe(const sink& s, int32_t size);
+
     int32_t handle_events(aoo_eventhandler fn, void *user);
 
     bool send(const sink& s);
@@ -190,6 +192,9 @@ public:
     void request_invite(){ streamstate_.request_invitation(stream_state::INVITE); }
 
     void request_uninvite(){ streamstate_.request_invitation(stream_state::UNINVITE); }
+
+    // the next data message writes the current format to the capture
+    void request_capture_format(){ capture_format_requested_.store(true); }
 private:
     struct data_request {
         int32_t sequence;
@@ -197,13 +202,22 @@ private:
     };
     void do_update(const sink& s);
     // handle messages
-    bool check_packet(const data_packet& d);
+    bool check_packet(const sink& s, const data_packet& d);
+
+    bool add_packet(const sink& s, const data_packet& d);
+
+    void process_blocks(const sink& s);
 
-    bool add_packet(const data_packet& d);
+    void write_block(const sink& s, int32_t sequence, const char *data,
+                     int32_t size, const block_info& info);
 
-    void process_blocks();
+    void check_outdated_blocks(const sink& s);
 
-    void check_outdated_blocks();
+    void capture_format(const sink& s);
+
+    // tell the capture about blocks dropped before they were written
+    void capture_dropped(const sink& s, int32_t sequence);
+    void capture_dropped_queue(const sink& s);
 
     void check_missing_blocks(const sink& s);
     // send messages
@@ -211,6 +225,7 @@ private:
     bool send_codec_change_request(const sink& s);
 
     int32_t send_data_request(const sink& s);
+    int32_t send_resend_request(const sink& s, int32_t salt);
 
     bool send_notifications(const sink& s);
 
@@ -224,6 +239,7 @@ private:
     int32_t salt_;
     // audio decoder
     std::unique_ptr<aoo::decoder> decoder_;
+    std::atomic<bool> capture_format_requested_{false};
     // state
     int32_t newest_ = 0; // sequence number of most recent incoming block
     int32_t next_ = 0; // next outgoing block
@@ -232,6 +248,7 @@ private:
     double samplerate_ = 0; // recent samplerate
     int32_t protocol_flags_ = 0; // protocol flags sent from the remote source
     stream_state streamstate_;
+    std::atomic<int32_t> probe_size_{0}; // largest probe since the last reply
     std::vector<char> userformat_;
     // queues and buffers
     block_queue blockqueue_;
@@ -318,6 +335,13 @@ public:
 
     int32_t protocol_flags() const { return protocol_flags_; }
 
+    // stream capture, only does something if a capture handler is set
+    bool capturing() const { return capturing_.load(std::memory_order_relaxed); }
+    void capture_format(void *endpoint, int32_t id, const aoo_format& f,
+                        const char *settings, int32_t size) const;
+    void capture_block(void *endpoint, int32_t id, int32_t sequence, double sr,
+                       int32_t channel, const char *data, int32_t size) const;
+
 private:
     // settings
     std::atomic<int32_t> id_;
@@ -333,6 +357,15 @@ private:
     std::atomic<float> resend_interval_{ AOO_RESEND_INTERVAL * 0.001 };
     std::atomic<int32_t> resend_maxnumframes_{ AOO_RESEND_MAXNUMFRAMES };
     std::atomic<int32_t> protocol_flags_{ 0 };
+    // stream capture
+    // the handler is copied under the lock and called outside of it,
+    // capture_users_ counts the calls in progress
+    aoo_capture_handler capture_{ nullptr, nullptr, nullptr };
+    std::atomic<bool> capturing_{ false };
+    mutable spinlock capture_lock_;
+    mutable std::atomic<int32_t> capture_users_{ 0 };
+    aoo_capture_handler acquire_capture_handler() const;
+    void release_capture_handler() const;
     // the sources
     lockfree::list<source_desc> sources_;
     // timing
@@ -356,8 +389,14 @@ private:
     int32_t handle_compact_data_message(void *endpoint, aoo_replyfn fn,
                                         const osc::ReceivedMessage& msg);
 
+    int32_t handle_binary_data_message(void *endpoint, aoo_replyfn fn,
+                                       const char *data, int32_t n);
+
     int32_t handle_ping_message(void *endpoint, aoo_replyfn fn,
                                 const osc::ReceivedMessage& msg);
+
+    int32_t handle_probe_message(void *endpoint, aoo_replyfn fn,
+                                 const osc::ReceivedMessage& msg, int32_t n);
 };
 
 } // aoo
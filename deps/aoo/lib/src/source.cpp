@@ -7,6 +7,7 @@
 
 #include <cstring>
 #include <algorithm>
+#include <tuple>
 #include <random>
 #include <cmath>
 
@@ -17,6 +18,18 @@
 // typetag string: max. 12 bytes
 // args (without blob data): 36 bytes
 
+// path MTU discovery: a few quick probe rounds after a reset,
+// then the path is only checked for changes every now and then.
+#define AOO_PROBE_FASTROUNDS 3
+#define AOO_PROBE_FASTINTERVAL 1.0
+#define AOO_PROBE_INTERVAL 30.0
+// give up on a sink's MTU after this many unanswered rounds
+#define AOO_PROBE_MAXMISSES 3
+
+// typical path MTUs minus the IP and UDP headers:
+// Ethernet, PPPoE, Ethernet (IPv6), VPN tunnels, IPv6 minimum, IPv4 minimum
+static const int32_t probe_sizes[] = { 1472, 1464, 1452, 1392, 1232, 548 };
+
 aoo_source * aoo_source_new(int32_t id) {
     return new aoo::source(id);
 }
@@ -29,6 +42,7 @@ aoo::source::source(int32_t id)
     // request queues
     formatrequestqueue_.resize(64, 1);
     datarequestqueue_.resize(1024, 1);
+    resendrequests_.reserve(1024);
 }
 
 void aoo_source_free(aoo_source *src){
@@ -149,6 +163,27 @@ int32_t aoo::source::set_option(int32_t opt, void *ptr, int32_t size)
         CHECKARG(int32_t);
         respect_codec_change_req_ = as<int32_t>(ptr);
         break;
+    // adaptive bitrate
+    case aoo_opt_adaptive_bitrate:
+        CHECKARG(int32_t);
+        adaptive_minbitrate_ = std::max<int32_t>(0, as<int32_t>(ptr));
+        update_bitrate();
+        break;
+    // silence threshold
+    case aoo_opt_silence_threshold:
+        CHECKARG(float);
+        silence_threshold_ = as<float>(ptr);
+        break;
+    // path MTU discovery
+    case aoo_opt_mtu_discovery:
+        CHECKARG(int32_t);
+        mtu_discovery_ = as<int32_t>(ptr) > 0;
+        if (!mtu_discovery_){
+            probed_packetsize_ = 0;
+        }
+        proberounds_ = 0;
+        lastprobetime_ = -1000; // force first probe
+        break;
     // format
     case aoo_opt_userformat:
         return set_userformat(ptr, size);
@@ -213,6 +248,31 @@ int32_t aoo::source::get_option(int32_t opt, void *ptr, int32_t size)
         CHECKARG(int32_t);
         as<int32_t>(ptr) = redundancy_;
         break;
+    // adaptive bitrate
+    case aoo_opt_adaptive_bitrate:
+        CHECKARG(int32_t);
+        as<int32_t>(ptr) = adaptive_minbitrate_;
+        break;
+    // current bitrate
+    case aoo_opt_current_bitrate:
+        CHECKARG(int32_t);
+        as<int32_t>(ptr) = current_bitrate_;
+        break;
+    // path MTU discovery
+    case aoo_opt_mtu_discovery:
+        CHECKARG(int32_t);
+        as<int32_t>(ptr) = mtu_discovery_;
+        break;
+    // current packet size
+    case aoo_opt_current_packetsize:
+        CHECKARG(int32_t);
+        as<int32_t>(ptr) = current_packetsize();
+        break;
+    // silence threshold
+    case aoo_opt_silence_threshold:
+        CHECKARG(float);
+        as<float>(ptr) = silence_threshold_;
+        break;
     // unknown
     default:
         LOG_WARNING("aoo_source: unsupported option " << opt);
@@ -468,6 +528,9 @@ int32_t aoo::source::handle_message(const char *data, int32_t n, void *endpoint,
         } else if (!strcmp(pattern, AOO_MSG_DATA)){
             handle_data_request(endpoint, fn, msg);
             return 1;
+        } else if (!strcmp(pattern, AOO_MSG_RESEND)){
+            handle_resend_request(endpoint, fn, msg);
+            return 1;
         } else if (!strcmp(pattern, AOO_MSG_INVITE)){
             handle_invite(endpoint, fn, msg);
             return 1;
@@ -480,6 +543,9 @@ int32_t aoo::source::handle_message(const char *data, int32_t n, void *endpoint,
         } else if (!strcmp(pattern, AOO_MSG_CODEC_CHANGE)){
             handle_codec_change(endpoint, fn, msg);
             return 1;
+        } else if (!strcmp(pattern, AOO_MSG_PROBE)){
+            handle_probe(endpoint, fn, msg);
+            return 1;
         } else {
             LOG_WARNING("unknown message " << pattern);
         }
@@ -523,6 +589,10 @@ int32_t aoo::source::send(){
         didsomething = true;
     }
 
+    if (send_probes()){
+        didsomething = true;
+    }
+
     return didsomething;
 }
 
@@ -825,7 +895,8 @@ void endpoint::send_format(int32_t src, int32_t salt, const aoo_format& f,
         msg << osc::BeginMessage(AOO_MSG_DOMAIN AOO_MSG_SINK AOO_MSG_WILDCARD AOO_MSG_FORMAT);
     }
 
-    msg << src << (int32_t)make_version(AOO_PROTOCOL_FLAG_COMPACT_DATA) << salt << f.nchannels << f.samplerate << f.blocksize
+    msg << src << (int32_t)make_version(AOO_PROTOCOL_FLAG_COMPACT_DATA | AOO_PROTOCOL_FLAG_SILENT_BLOCKS
+                                           | AOO_PROTOCOL_FLAG_RESEND_RANGES | AOO_PROTOCOL_FLAG_BINARY_DATA) << salt << f.nchannels << f.samplerate << f.blocksize
     << f.codec << osc::Blob(options, size);
 
     if (userformat && ufsize > 0) {
@@ -837,6 +908,85 @@ void endpoint::send_format(int32_t src, int32_t salt, const aoo_format& f,
     send(msg.Data(), (int32_t)msg.Size());
 }
 
+// binary data message, see common.hpp
+
+void endpoint::send_data_binary(int32_t src, int32_t salt, const aoo::data_packet& d, bool sendrate) const {
+    // call without lock!
+
+    char buf[AOO_MAXPACKETSIZE];
+
+    // the short form is enough for the common case, just like the compact data message
+    bool full = d.nframes != 1 || d.channel != 0;
+    int32_t headersize = full ? AOO_BIN_DATA_FULL_HEADERSIZE
+                              : AOO_BIN_DATA_HEADERSIZE + (sendrate ? 8 : 0);
+    if (headersize + d.size > (int32_t)sizeof(buf)){
+        LOG_ERROR("aoo_source: binary data message too large!");
+        return;
+    }
+
+    memcpy(buf, AOO_BIN_DATA_MAGIC, AOO_BIN_DATA_MAGIC_LEN);
+    buf[3] = full ? AOO_BIN_DATA_FULL : (sendrate ? AOO_BIN_DATA_SAMPLERATE : 0);
+    aoo::to_bytes<int32_t>(salt, buf + 4);
+    aoo::to_bytes<int32_t>(d.sequence, buf + 8);
+    if (full){
+        aoo::to_bytes<int32_t>(id, buf + 12);
+        aoo::to_bytes<int32_t>(src, buf + 16);
+        aoo::to_bytes<int32_t>(d.channel, buf + 20);
+        aoo::to_bytes<int32_t>(d.totalsize, buf + 24);
+        aoo::to_bytes<int32_t>(d.nframes, buf + 28);
+        aoo::to_bytes<int32_t>(d.framenum, buf + 32);
+        aoo::to_bytes<double>(d.samplerate, buf + 36);
+    } else if (sendrate){
+        aoo::to_bytes<double>(d.samplerate, buf + 12);
+    }
+    if (d.size > 0){
+        memcpy(buf + headersize, d.data, d.size);
+    }
+
+    LOG_DEBUG("send binary block: seq = " << d.sequence << ", sr = " << d.samplerate
+              << ", chn = " << d.channel << ", totalsize = " << d.totalsize
+              << ", nframes = " << d.nframes << ", frame = " << d.framenum << ", size " << d.size);
+
+    send(buf, headersize + d.size);
+}
+
+// /aoo/sink/<id>/probe <src> <padding>
+
+void endpoint::send_probe(int32_t src, int32_t size) const {
+    // call without lock!
+    static const char padding[AOO_MAXPACKETSIZE] = { 0 };
+
+    char buf[AOO_MAXPACKETSIZE];
+    osc::OutboundPacketStream msg(buf, sizeof(buf));
+
+    const int32_t max_addr_size = AOO_MSG_DOMAIN_LEN
+            + AOO_MSG_SINK_LEN + 16 + AOO_MSG_PROBE_LEN;
+    char address[max_addr_size];
+    if (id != AOO_ID_WILDCARD){
+        snprintf(address, sizeof(address), "%s%s/%d%s",
+                 AOO_MSG_DOMAIN, AOO_MSG_SINK, id, AOO_MSG_PROBE);
+    } else {
+        snprintf(address, sizeof(address), "%s",
+                 AOO_MSG_DOMAIN AOO_MSG_SINK AOO_MSG_WILDCARD AOO_MSG_PROBE);
+    }
+
+    // first get the size of the message without padding
+    msg << osc::BeginMessage(address) << src
+        << osc::Blob(padding, 0) << osc::EndMessage;
+
+    // OSC messages are always a multiple of 4 bytes
+    auto npad = (size - (int32_t)msg.Size()) & ~3;
+    if (npad < 0 || npad > (int32_t)sizeof(padding)){
+        return;
+    }
+
+    msg.Clear();
+    msg << osc::BeginMessage(address) << src
+        << osc::Blob(padding, npad) << osc::EndMessage;
+
+    send(msg.Data(), (int32_t)msg.Size());
+}
+
 // /aoo/sink/<id>/ping <src> <time>
 
 void endpoint::send_ping(int32_t src, time_tag t) const {
@@ -956,10 +1106,22 @@ void source::update(){
         
         // reset encoder state to avoid old garbage
         encoder_->reset();
+
+        // the format sets the upper bound for the adaptive bitrate
+        int32_t bitrate = 0;
+        format_bitrate_ = encoder_->get_ctl(AOO_CODEC_GET_BITRATE, bitrate) && bitrate > 0 ? bitrate : 0;
+        if (format_bitrate_ > 0){
+            // a reset keeps the bitrate, start over from the format
+            encoder_->ctl(AOO_CODEC_SET_BITRATE, format_bitrate_);
+        }
+        current_bitrate_ = format_bitrate_.load();
+        update_bitrate();
         
         // reset time DLL to be on the safe side
         timer_.reset();
         lastpingtime_ = -1000; // force first ping
+        lastprobetime_ = -1000;
+        proberounds_ = 0;
         lastplay_ = false;
         
         // Start new sequence and resend format.
@@ -989,6 +1151,19 @@ void source::update_historybuffer(){
     }
 }
 
+void source::update_bitrate(){
+    auto maxrate = format_bitrate_.load();
+    auto minrate = adaptive_minbitrate_.load() * nchannels_;
+
+    scoped_lock<spinlock> lock(ratecontrol_lock_);
+    if (maxrate > 0 && minrate > 0){
+        ratecontrol_.set_bounds(minrate, maxrate);
+        target_bitrate_ = ratecontrol_.bitrate();
+    } else {
+        target_bitrate_ = maxrate;
+    }
+}
+
 bool source::send_format(){
     bool format_changed = format_changed_.exchange(false);
     bool format_requested = formatrequestqueue_.read_available();
@@ -1054,16 +1229,42 @@ bool source::resend_data(){
         return false;
     }
 
-    bool didsomething = false;
+    auto salt = salt_;
 
+    // Collect all pending requests, so that every frame is sent only once
+    // per pass, no matter how often it has been requested.
+    resendrequests_.clear();
     while (datarequestqueue_.read_available()){
         data_request request;
         datarequestqueue_.read(request);
+        if (request.salt == salt){ // otherwise outdated
+            resendrequests_.push_back(request);
+        }
+    }
+    if (resendrequests_.empty()){
+        return false;
+    }
+
+    // group by sink and block, a whole block request (frame = -1)
+    // comes first and covers all frames of that block.
+    std::sort(resendrequests_.begin(), resendrequests_.end(), [](auto& a, auto& b){
+        return std::make_tuple((uintptr_t)a.user, a.id, a.sequence, a.frame)
+                < std::make_tuple((uintptr_t)b.user, b.id, b.sequence, b.frame);
+    });
+
+    bool didsomething = false;
+    const data_request *prev = nullptr;
 
-        auto salt = salt_;
-        if (salt != request.salt){
-            // outdated request
-            continue;
+    for (auto& request : resendrequests_){
+        if (prev && prev->user == request.user && prev->id == request.id
+                && prev->sequence == request.sequence
+                && (prev->frame < 0 || prev->frame == request.frame)){
+            continue; // already sent
+        }
+        prev = &request;
+
+        if (salt_ != salt){
+            break; // the stream has been reset while we were sending
         }
 
         auto block = history_.find(request.sequence);
@@ -1076,32 +1277,28 @@ bool source::resend_data(){
             d.nframes = block->num_frames();
             // We use a buffer on the heap because blocks and even frames
             // can be quite large and we don't want them to sit on the stack.
-            if (request.frame < 0){
-                // Copy whole block and save frame pointers.
-                sendbuffer_.resize(d.totalsize);
-                char *buf = sendbuffer_.data();
-                char *frameptr[256];
-                int32_t framesize[256];
-                int32_t onset = 0;
-
-                for (int i = 0; i < d.nframes; ++i){
-                    auto nbytes = block->get_frame(i, buf + onset, d.totalsize - onset);
-                    if (nbytes > 0){
-                        frameptr[i] = buf + onset;
-                        framesize[i] = nbytes;
-                        onset += nbytes;
-                    } else {
-                        LOG_ERROR("empty frame!");
-                    }
-                }
+            if (block->silent()){
+                // unlock before sending
+                updatelock.unlock();
+
+                d.totalsize = 0;
+                d.framenum = 0;
+                d.data = sendbuffer_.data(); // not read
+                d.size = 0;
+                request.send_data(id(), salt, d);
+            } else if (request.frame < 0){
+                // Copy whole block, the frames are stored back to back.
+                sendbuffer_.assign(block->data(), block->data() + d.totalsize);
+                auto framesize = block->frame_size(0);
                 // unlock before sending
                 updatelock.unlock();
 
                 // send frames to sink
-                for (int i = 0; i < d.nframes; ++i){
+                auto ptr = sendbuffer_.data();
+                for (int i = 0; i < d.nframes; ++i, ptr += framesize){
                     d.framenum = i;
-                    d.data = frameptr[i];
-                    d.size = framesize[i];
+                    d.data = ptr;
+                    d.size = (i == d.nframes - 1) ? d.totalsize - i * framesize : framesize;
                     request.send_data(id(), salt, d);
                 }
             } else {
@@ -1123,7 +1320,9 @@ bool source::resend_data(){
                 }
             }
             // lock again
-            updatelock.lock();
+            if (!updatelock.owns_lock()){
+                updatelock.lock();
+            }
 
             didsomething = true;
         } else {
@@ -1134,7 +1333,20 @@ bool source::resend_data(){
     return didsomething;
 }
 
+// peak detection for silence suppression, a negative threshold disables it
+static bool is_silent(const aoo_sample *data, int32_t n, float threshold){
+    if (threshold < 0){
+        return false;
+    }
+    aoo_sample peak = 0;
+    for (int32_t i = 0; i < n; ++i){
+        peak = std::max<aoo_sample>(peak, std::abs(data[i]));
+    }
+    return peak <= threshold;
+}
+
 bool source::send_data(){
+    scoped_trace trace("aoo::source::send_data", id_);
     shared_lock updatelock(update_mutex_); // reader lock!
     if (!encoder_){
         return 0;
@@ -1146,6 +1358,7 @@ bool source::send_data(){
     // *first* check for dropped blocks
     // NOTE: there's no ABA problem because the variable will only be decremented in this method.
     if (dropped_ > 0){
+        trace_event("aoo source xrun", 'i', id_);
         // send empty block
         d.sequence = sequence_++;
         d.samplerate = encoder_->samplerate(); // use nominal samplerate
@@ -1197,13 +1410,70 @@ bool source::send_data(){
             auto blocksize = encoder_->blocksize();
             sendbuffer_.resize(sizeof(double) * nchannels * blocksize); // overallocate
 
+            // only this thread encodes, so we can change the bitrate between blocks
+            auto bitrate = target_bitrate_.load();
+            if (bitrate > 0 && bitrate != current_bitrate_.load()){
+                if (encoder_->ctl(AOO_CODEC_SET_BITRATE, bitrate)){
+                    LOG_VERBOSE("aoo_source: bitrate " << current_bitrate_.load() << " -> " << bitrate);
+                    current_bitrate_ = bitrate;
+                } else {
+                    target_bitrate_ = 0;
+                }
+            }
+
+            // sinks which support silent blocks don't need the encoded block
+            bool silent = is_silent(audioqueue_.read_data(), audioqueue_.blocksize(), silence_threshold_.load());
+            int32_t numencoded = numsinks;
+            if (silent){
+                numencoded = (int32_t) std::count_if(sinks, sinks + numsinks, [](auto& sink){
+                    return !(sink.protocol_flags & AOO_PROTOCOL_FLAG_SILENT_BLOCKS);
+                });
+            }
+
+            auto send_silent = [&](sink_desc& sink){
+                data_packet s = d;
+                s.channel = sink.channel;
+                s.totalsize = 0;
+                s.nframes = 1;
+                s.framenum = 0;
+                s.data = sendbuffer_.data(); // not read
+                s.size = 0;
+                if (sink.protocol_flags & AOO_PROTOCOL_FLAG_BINARY_DATA) {
+                    sink.send_data_binary(id(), salt, s, sendrate);
+                } else if (s.channel == 0 && sink.protocol_flags & AOO_PROTOCOL_FLAG_COMPACT_DATA) {
+                    sink.send_data_compact(id(), salt, s, sendrate);
+                } else {
+                    sink.send_data(id(), salt, s);
+                }
+            };
+
+            if (silent && numencoded == 0){
+                // skip the encoder altogether
+                audioqueue_.read_commit();
+
+                history_.push_silent(d.sequence, d.samplerate);
+
+                // unlock before sending!
+                updatelock.unlock();
+
+                auto ntimes = redundancy_.load();
+                for (auto i = 0; i < ntimes; ++i){
+                    for (int j = 0; j < numsinks; ++j){
+                        send_silent(sinks[j]);
+                    }
+                }
+
+                check_sequence_overflow(d.sequence);
+                return 1;
+            }
+
             d.totalsize = encoder_->encode(audioqueue_.read_data(), audioqueue_.blocksize(),
                                            sendbuffer_.data(), (int32_t) sendbuffer_.size());
             audioqueue_.read_commit();
 
             if (d.totalsize > 0){
                 // calculate number of frames
-                auto maxpacketsize = packetsize_ - AOO_DATA_HEADERSIZE;
+                auto maxpacketsize = current_packetsize() - AOO_DATA_HEADERSIZE;
                 auto dv = div(d.totalsize, maxpacketsize);
                 d.nframes = dv.quot + (dv.rem != 0);
 
@@ -1223,9 +1493,17 @@ bool source::send_data(){
                     d.data = data;
                     d.size = n;
                     for (int i = 0; i < numsinks; ++i){
+                        if (silent && sinks[i].protocol_flags & AOO_PROTOCOL_FLAG_SILENT_BLOCKS){
+                            if (frame == 0){
+                                send_silent(sinks[i]);
+                            }
+                            continue;
+                        }
                         d.channel = sinks[i].channel;
-                        // if the protocol_flags allow using the compact data message, use it if appropriate
-                        if (d.nframes == 1 && d.channel == 0 && sinks[i].protocol_flags & AOO_PROTOCOL_FLAG_COMPACT_DATA) {
+                        // if the protocol_flags allow using the binary or compact data message, use it if appropriate
+                        if (sinks[i].protocol_flags & AOO_PROTOCOL_FLAG_BINARY_DATA) {
+                            sinks[i].send_data_binary(id(), salt, d, sendrate);
+                        } else if (d.nframes == 1 && d.channel == 0 && sinks[i].protocol_flags & AOO_PROTOCOL_FLAG_COMPACT_DATA) {
                             sinks[i].send_data_compact(id(), salt, d, sendrate);                
                         } else {
                             sinks[i].send_data(id(), salt, d);
@@ -1262,14 +1540,18 @@ bool source::send_data(){
         return 0;
     }
 
+    check_sequence_overflow(d.sequence);
+
+    return 1;
+}
+
+void source::check_sequence_overflow(int32_t sequence){
     // handle overflow (with 64 samples @ 44.1 kHz this happens every 36 days)
     // for now just force a reset by changing the salt, LATER think how to handle this better
-    if (d.sequence == INT32_MAX){
+    if (sequence == INT32_MAX){
         unique_lock lock2(update_mutex_); // take writer lock
         salt_ = make_salt();
     }
-
-    return 1;
 }
 
 bool source::send_ping(){
@@ -1298,6 +1580,64 @@ bool source::send_ping(){
     }
 }
 
+int32_t source::current_packetsize() const {
+    auto probed = probed_packetsize_.load();
+    return (mtu_discovery_.load() && probed > 0) ? probed : packetsize_.load();
+}
+
+bool source::send_probes(){
+    if (!mtu_discovery_.load()){
+        return false;
+    }
+    // if stream is stopped, the timer won't increment anyway
+    auto elapsed = timer_.get_elapsed();
+    auto interval = proberounds_.load() < AOO_PROBE_FASTROUNDS ?
+                AOO_PROBE_FASTINTERVAL : AOO_PROBE_INTERVAL;
+    if ((elapsed - lastprobetime_.load()) < interval){
+        return false;
+    }
+
+    shared_lock sinklock(sink_mutex_);
+    // first evaluate the previous round. We send with the smallest
+    // MTU of all sinks, sinks which don't answer get the packet size option.
+    int32_t packetsize = AOO_MAXPACKETSIZE;
+    for (auto& sink : sinks_){
+        auto acked = std::min<int32_t>(sink.probe_acked.exchange(0), AOO_MAXPACKETSIZE);
+        if (acked > 0){
+            // also follows a path change to a smaller MTU
+            sink.mtu = acked;
+            sink.probe_misses = 0;
+        } else if (sink.mtu.load() > 0 && ++sink.probe_misses >= AOO_PROBE_MAXMISSES){
+            LOG_VERBOSE("aoo_source: no probe replies from sink " << sink.id);
+            sink.mtu = 0;
+        }
+        packetsize = std::min<int32_t>(packetsize,
+                                       sink.mtu.load() > 0 ? sink.mtu.load() : packetsize_.load());
+    }
+    if (sinks_.empty()){
+        packetsize = 0;
+    }
+    if (probed_packetsize_.exchange(packetsize) != packetsize){
+        LOG_VERBOSE("aoo_source: packet size " << current_packetsize());
+    }
+
+    // then send the next round
+    int32_t numsinks = (int32_t) sinks_.size();
+    auto sinks = (aoo::sink_desc *)alloca((numsinks + 1) * sizeof(aoo::sink_desc)); // avoid alloca(0)
+    std::copy(sinks_.begin(), sinks_.end(), sinks);
+    sinklock.unlock();
+
+    for (int i = 0; i < numsinks; ++i){
+        for (auto size : probe_sizes){
+            sinks[i].send_probe(id(), size);
+        }
+    }
+
+    lastprobetime_ = elapsed;
+    proberounds_++;
+    return true;
+}
+
 void source::handle_format_request(void *endpoint, aoo_replyfn fn,
                                    const osc::ReceivedMessage& msg)
 {
@@ -1346,6 +1686,7 @@ void source::handle_data_request(void *endpoint, aoo_replyfn fn,
     if (sink){
         // get pairs of [seq, frame]
         int npairs = (msg.ArgumentCount() - 2) / 2;
+        resend_requests_ += npairs;
         while (npairs--){
             auto seq = (it++)->AsInt32();
             auto frame = (it++)->AsInt32();
@@ -1358,6 +1699,69 @@ void source::handle_data_request(void *endpoint, aoo_replyfn fn,
     }
 }
 
+// /aoo/src/<id>/resend <sink> <salt> <seq0> <frame0> <mask0> <seq1> <frame1> <mask1> ...
+
+void source::handle_resend_request(void *endpoint, aoo_replyfn fn,
+                                   const osc::ReceivedMessage& msg)
+{
+    auto it = msg.ArgumentsBegin();
+    auto id = (it++)->AsInt32();
+    auto salt = (it++)->AsInt32();
+
+    LOG_DEBUG("handle resend request");
+
+    // check if sink exists (not strictly necessary, but might help catch errors)
+    shared_lock lock(sink_mutex_); // reader lock!
+    auto sink = find_sink(endpoint, id);
+    lock.unlock();
+
+    if (sink){
+        // get triples of [seq, frame, mask]
+        int nranges = (msg.ArgumentCount() - 2) / 3;
+        int32_t count = 0;
+        while (nranges--){
+            auto seq = (it++)->AsInt32();
+            auto frame = (it++)->AsInt32();
+            auto mask = (uint32_t)(it++)->AsInt32();
+            // frame < 0: a range of whole blocks, otherwise a range of frames
+            for (int32_t i = 0; mask != 0; ++i, mask >>= 1){
+                if (mask & 1){
+                    if (datarequestqueue_.write_available()){
+                        datarequestqueue_.write(frame < 0 ?
+                            data_request{ endpoint, fn, id, salt, seq + i, -1 } :
+                            data_request{ endpoint, fn, id, salt, seq, frame + i });
+                    }
+                    count++;
+                }
+            }
+        }
+        resend_requests_ += count;
+    } else {
+        LOG_WARNING("ignoring '" << AOO_MSG_RESEND << "' message: sink not found");
+    }
+}
+
+void source::handle_probe(void *endpoint, aoo_replyfn fn,
+                          const osc::ReceivedMessage& msg)
+{
+    auto it = msg.ArgumentsBegin();
+    auto id = (it++)->AsInt32();
+    auto size = (it++)->AsInt32();
+
+    LOG_DEBUG("handle probe reply " << size);
+
+    shared_lock lock(sink_mutex_); // reader lock!
+    auto sink = find_sink(endpoint, id);
+    if (sink){
+        // the largest probe which made it through in this round
+        if (size > sink->probe_acked.load()){
+            sink->probe_acked = size;
+        }
+    } else {
+        LOG_VERBOSE("ignoring '" << AOO_MSG_PROBE << "' message: sink not found");
+    }
+}
+
 void source::handle_invite(void *endpoint, aoo_replyfn fn,
                            const osc::ReceivedMessage& msg)
 {
@@ -1449,6 +1853,22 @@ void source::handle_ping(void *endpoint, aoo_replyfn fn,
         #endif
             eventqueue_.write(e);
         }
+
+        // each ping reply covers one ping interval of blocks
+        auto interval = ping_interval_.load();
+        auto maxrate = format_bitrate_.load();
+        if (adaptive_minbitrate_.load() > 0 && maxrate > 0 && interval > 0){
+            shared_lock updatelock(update_mutex_); // reader lock!
+            int32_t expected = encoder_ ? interval * encoder_->samplerate() / encoder_->blocksize() : 0;
+            updatelock.unlock();
+
+            double rtt = time_tag::duration(tt1, time_tag(aoo_osctime_get()));
+
+            scoped_lock<spinlock> lock(ratecontrol_lock_);
+            if (ratecontrol_.update(rtt, lost_blocks, resend_requests_.exchange(0), expected)){
+                target_bitrate_ = ratecontrol_.bitrate();
+            }
+        }
     } else {
         LOG_VERBOSE("ignoring '" << AOO_MSG_PING << "' message: sink not found");
     }
@@ -11,6 +11,7 @@
 #include "common.hpp"
 #include "lockfree.hpp"
 #include "time_dll.hpp"
+#include "rate_control.hpp"
 
 #include "oscpack/osc/OscOutboundPacketStream.h"
 #include "oscpack/osc/OscReceivedElements.h"
@@ -30,12 +31,15 @@ struct endpoint {
     // methods
     void send_data(int32_t src, int32_t salt, const data_packet& data) const;
     void send_data_compact(int32_t src, int32_t salt, const data_packet& data, bool sendrate=false);
+    void send_data_binary(int32_t src, int32_t salt, const data_packet& data, bool sendrate=false) const;
 
     void send_format(int32_t src, int32_t salt, const aoo_format& f,
                      const char *options, int32_t size, const char * userformat = nullptr, int32_t ufsize=0) const;
 
     void send_ping(int32_t src, time_tag t) const;
 
+    void send_probe(int32_t src, int32_t size) const;
+
     void send(const char *data, int32_t n) const {
         fn(user, data, n);
     }
@@ -73,7 +77,10 @@ struct sink_desc : endpoint {
         : endpoint(other.user, other.fn, other.id),
           channel(other.channel.load()),
           format_changed(other.format_changed.load()),
-          protocol_flags(other.protocol_flags.load()){}
+          protocol_flags(other.protocol_flags.load()),
+          mtu(other.mtu.load()),
+          probe_acked(other.probe_acked.load()),
+          probe_misses(other.probe_misses.load()){}
     sink_desc& operator=(const sink_desc& other){
         user = other.user;
         fn = other.fn;
@@ -81,6 +88,9 @@ struct sink_desc : endpoint {
         channel = other.channel.load();
         format_changed = other.format_changed.load();
         protocol_flags = other.protocol_flags.load();
+        mtu = other.mtu.load();
+        probe_acked = other.probe_acked.load();
+        probe_misses = other.probe_misses.load();
         return *this;
     }
 
@@ -88,6 +98,10 @@ struct sink_desc : endpoint {
     std::atomic<int16_t> channel;
     std::atomic<bool> format_changed;
     std::atomic<int8_t> protocol_flags;
+    // path MTU discovery
+    std::atomic<int32_t> mtu{0}; // 0: unknown
+    std::atomic<int32_t> probe_acked{0}; // largest probe of the current round
+    std::atomic<int32_t> probe_misses{0};
 
 };
 
@@ -162,6 +176,7 @@ class source final : public isource {
     lockfree::queue<event> eventqueue_;
     lockfree::queue<endpoint> formatrequestqueue_;
     lockfree::queue<data_request> datarequestqueue_;
+    std::vector<data_request> resendrequests_; // send thread only
     history_buffer history_;
     // sinks
     std::vector<sink_desc> sinks_;
@@ -178,6 +193,9 @@ class source final : public isource {
     std::atomic<float> ping_interval_{ AOO_PING_INTERVAL * 0.001 };
     std::atomic<int32_t> protocol_flags_{ 0 };
     std::atomic<int32_t> respect_codec_change_req_{ 0 };
+    std::atomic<int32_t> adaptive_minbitrate_{ 0 };
+    std::atomic<float> silence_threshold_{ -1.f };
+    std::atomic<int32_t> mtu_discovery_{ 0 };
     std::vector<char> userformat_;
     // runtime
     double prev_sent_samplerate_ = 0.0;
@@ -185,6 +203,17 @@ class source final : public isource {
     std::atomic<int32_t> flushingout_ { 0 };
     bool lastplay_ = false;
     int32_t pushing_silent_frames_ = 0;
+    // adaptive bitrate
+    rate_controller ratecontrol_;
+    aoo::spinlock ratecontrol_lock_;
+    std::atomic<int32_t> format_bitrate_{0}; // 0: codec can't change bitrate
+    std::atomic<int32_t> target_bitrate_{0};
+    std::atomic<int32_t> current_bitrate_{0};
+    std::atomic<int32_t> resend_requests_{0};
+    // path MTU discovery
+    std::atomic<int32_t> probed_packetsize_{0}; // 0: use packetsize_
+    std::atomic<float> lastprobetime_{0};
+    std::atomic<int32_t> proberounds_{0};
     
     // helper methods
     sink_desc * find_sink(void *endpoint, int32_t id);
@@ -198,23 +227,37 @@ class source final : public isource {
 
     void update_historybuffer();
 
+    void update_bitrate();
+
+    int32_t current_packetsize() const;
+
     bool send_format();
 
     bool send_data();
 
+    void check_sequence_overflow(int32_t sequence);
+
     bool resend_data();
 
     bool send_ping();
 
+    bool send_probes();
+
     void handle_format_request(void *endpoint, aoo_replyfn fn,
                                const osc::ReceivedMessage& msg);
 
     void handle_data_request(void *endpoint, aoo_replyfn fn,
                              const osc::ReceivedMessage& msg);
 
+    void handle_resend_request(void *endpoint, aoo_replyfn fn,
+                               const osc::ReceivedMessage& msg);
+
     void handle_ping(void *endpoint, aoo_replyfn fn,
                      const osc::ReceivedMessage& msg);
 
+    void handle_probe(void *endpoint, aoo_replyfn fn,
+                      const osc::ReceivedMessage& msg);
+
     void handle_invite(void *endpoint, aoo_replyfn fn,
                        const osc::ReceivedMessage& msg);
 
@@ -13,6 +13,9 @@
 
 namespace aoo {
 
+// hint for busy wait loops
+void pause_cpu();
+
 /*////////////////// simple spin lock ////////////////////*/
 
 class spinlock {
@@ -49,6 +49,11 @@ namespace foleys
  or whatever instance processes an AudioBuffer.
  Then call LevelMeterSource::measureBlock (AudioBuffer<float>& buf) to
  create the readings.
+
+ The audio thread measures peak and RMS of each channel in a single pass and
+ publishes the readings through a triple buffer, so the GUI always reads a
+ consistent snapshot without locking. With a decimation > 1 the blocks are
+ accumulated and only every n-th call updates the readings.
  */
 class LevelMeterSource
 {
@@ -96,10 +101,16 @@ private:
         std::atomic<bool>        clip;
         std::atomic<float>       reduction;
 
+        // blocks gathered for the next update when decimating, audio thread only
+        float  accumMax     = 0.0f;
+        double accumSquares = 0.0;
+        int    accumSamples = 0;
+
         float getAvgRMS () const
         {
             if (rmsHistory.size() > 0) {
-                return std::sqrt(std::accumulate (rmsHistory.begin(), rmsHistory.end(), 0.0f) / static_cast<float>(rmsHistory.size()));
+                // running sum of the history, can drift slightly below zero
+                return float (std::sqrt (std::max (0.0, rmsSum.load()) / static_cast<double>(rmsHistory.size())));
             }
                 
             return float (std::sqrt (rmsSum));
@@ -139,6 +150,7 @@ private:
 
             if (rmsHistory.size() > 0)
             {
+                rmsSum = rmsSum + squaredRMS - rmsHistory [(size_t) rmsPtr];
                 rmsHistory [(size_t) rmsPtr] = squaredRMS;
                 rmsPtr = (rmsPtr + 1) % rmsHistory.size();
             }
@@ -154,6 +166,15 @@ private:
         size_t                   rmsPtr;
     };
 
+    // what the GUI gets to see of a channel
+    struct Snapshot
+    {
+        float max        = 0.0f;
+        float maxOverall = 0.0f;
+        float rms        = 0.0f;
+        bool  clip       = false;
+    };
+
 public:
     LevelMeterSource () :
     holdMSecs       (500),
@@ -174,13 +195,28 @@ public:
      \param rmsWindow is the number of rms values to gather. Keep that aligned with
             the sampleRate and the blocksize to get reproducable results.
             e.g. `rmsWindow = msecs * 0.001f * sampleRate / blockSize;`
+     \param decimation is the number of measureBlock calls gathered into one reading,
+            the rms window is counted in calls, so it covers the same time either way.
      \FIXME: don't call this when measureBlock is processing
      */
-    void resize (const int channels, const int rmsWindow)
+    void resize (const int channels, const int rmsWindow, const int decimation = 1)
     {
-        levels.resize (size_t (channels), ChannelData (size_t (rmsWindow)));
+        blocksPerUpdate = std::max (1, decimation);
+        pendingBlocks = 0;
+
+        const auto numBlocks = size_t (std::max (1, (rmsWindow + blocksPerUpdate - 1) / blocksPerUpdate));
+
+        levels.resize (size_t (channels), ChannelData (numBlocks));
         for (ChannelData& l : levels)
-            l.setRMSsize (size_t (rmsWindow));
+        {
+            l.setRMSsize (numBlocks);
+            l.accumMax = 0.0f;
+            l.accumSquares = 0.0;
+            l.accumSamples = 0;
+        }
+
+        for (auto& snapshot : snapshots)
+            snapshot.resize (size_t (channels));
 
         newDataFlag = true;
     }
@@ -191,26 +227,123 @@ public:
     template<typename FloatType>
     void measureBlock (const juce::AudioBuffer<FloatType>& buffer, int startSample=0, int numSamples=0)
     {
-        lastMeasurement = juce::Time::currentTimeMillis();
-        if (! suspended)
+        if (suspended)
         {
-            const int         numChannels = buffer.getNumChannels ();
-            numSamples  = numSamples <= 0 ? buffer.getNumSamples () : numSamples;
+            lastMeasurement = juce::Time::currentTimeMillis();
+            newDataFlag = true;
+            return;
+        }
+
+        const int         numChannels = buffer.getNumChannels ();
+        numSamples  = numSamples <= 0 ? buffer.getNumSamples () : numSamples;
 
 #if FF_AUDIO_ALLOW_ALLOCATIONS_IN_MEASURE_BLOCK
 JUCE_COMPILER_WARNING("The use of levels.resize() is not realtime safe. Please call resize from the message thread and set this config setting to 0 via Projucer.")
-            levels.resize (size_t (numChannels));
+        if (levels.size() != size_t (numChannels))
+            resize (numChannels, 8, blocksPerUpdate);
 #endif
 
-            for (int channel=0; channel < std::min (numChannels, int (levels.size())); ++channel) {
-                levels [size_t (channel)].setLevels (lastMeasurement,
-                                                     buffer.getMagnitude (channel, startSample, numSamples),
-                                                     buffer.getRMSLevel  (channel, startSample, numSamples),
-                                                     holdMSecs);
-            }
+        const int measuredChannels = std::min (numChannels, int (levels.size()));
+
+        for (int channel=0; channel < measuredChannels; ++channel)
+        {
+            float peak = 0.0f;
+            double squares = 0.0;
+            measurePeakAndSquares (buffer.getReadPointer (channel, startSample), numSamples, peak, squares);
+
+            auto& l = levels [size_t (channel)];
+            l.accumMax = std::max (l.accumMax, peak);
+            l.accumSquares += squares;
+            l.accumSamples += numSamples;
         }
 
-        newDataFlag = true;
+        if (++pendingBlocks < blocksPerUpdate)
+            return;
+
+        pendingBlocks = 0;
+        lastMeasurement = juce::Time::currentTimeMillis();
+
+        for (int channel=0; channel < measuredChannels; ++channel)
+        {
+            auto& l = levels [size_t (channel)];
+            const float rms = l.accumSamples > 0 ? float (std::sqrt (l.accumSquares / l.accumSamples)) : 0.0f;
+            l.setLevels (lastMeasurement, l.accumMax, rms, holdMSecs);
+
+            l.accumMax = 0.0f;
+            l.accumSquares = 0.0;
+            l.accumSamples = 0;
+        }
+
+        publish();
+    }
+
+    /**
+     Peak magnitude and sum of squares of the samples, in one pass
+     */
+    static void measurePeakAndSquares (const float* data, const int numSamples, float& peak, double& squares)
+    {
+        int i = 0;
+        float maxValue = 0.0f;
+        float sum = 0.0f;
+
+#if JUCE_USE_SSE_INTRINSICS
+        const __m128 absMask = _mm_castsi128_ps (_mm_set1_epi32 (0x7fffffff));
+        __m128 vmax = _mm_setzero_ps();
+        __m128 vsum = _mm_setzero_ps();
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const __m128 v = _mm_loadu_ps (data + i);
+            vmax = _mm_max_ps (vmax, _mm_and_ps (v, absMask));
+            vsum = _mm_add_ps (vsum, _mm_mul_ps (v, v));
+        }
+
+        alignas (16) float lanes[4];
+        _mm_store_ps (lanes, vmax);
+        maxValue = std::max (std::max (lanes[0], lanes[1]), std::max (lanes[2], lanes[3]));
+        _mm_store_ps (lanes, vsum);
+        sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif JUCE_USE_ARM_NEON
+        float32x4_t vmax = vdupq_n_f32 (0.0f);
+        float32x4_t vsum = vdupq_n_f32 (0.0f);
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const float32x4_t v = vld1q_f32 (data + i);
+            vmax = vmaxq_f32 (vmax, vabsq_f32 (v));
+            vsum = vmlaq_f32 (vsum, v, v);
+        }
+
+        float lanes[4];
+        vst1q_f32 (lanes, vmax);
+        maxValue = std::max (std::max (lanes[0], lanes[1]), std::max (lanes[2], lanes[3]));
+        vst1q_f32 (lanes, vsum);
+        sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+
+        for (; i < numSamples; ++i)
+        {
+            maxValue = std::max (maxValue, std::abs (data[i]));
+            sum += data[i] * data[i];
+        }
+
+        peak = maxValue;
+        squares = double (sum);
+    }
+
+    static void measurePeakAndSquares (const double* data, const int numSamples, float& peak, double& squares)
+    {
+        double maxValue = 0.0;
+        double sum = 0.0;
+
+        for (int i=0; i < numSamples; ++i)
+        {
+            maxValue = std::max (maxValue, std::abs (data[i]));
+            sum += data[i] * data[i];
+        }
+
+        peak = float (maxValue);
+        squares = sum;
     }
 
     /**
@@ -230,7 +363,7 @@ JUCE_COMPILER_WARNING("The use of levels.resize() is not realtime safe. Please c
             levels [channel].reduction = 1.0f;
         }
 
-        newDataFlag = true;
+        publish();
     }
 
     /**
@@ -283,7 +416,7 @@ JUCE_COMPILER_WARNING("The use of levels.resize() is not realtime safe. Please c
      */
     float getMaxLevel (const int channel) const
     {
-        return levels.at (size_t (channel)).max;
+        return getSnapshot (channel).max;
     }
 
     /**
@@ -292,7 +425,7 @@ JUCE_COMPILER_WARNING("The use of levels.resize() is not realtime safe. Please c
      */
     float getMaxOverallLevel (const int channel) const
     {
-        return levels.at (size_t (channel)).maxOverall;
+        return getSnapshot (channel).maxOverall;
     }
 
     /**
@@ -301,7 +434,7 @@ JUCE_COMPILER_WARNING("The use of levels.resize() is not realtime safe. Please c
      */
     float getRMSLevel (const int channel) const
     {
-        return levels.at (size_t (channel)).getAvgRMS();
+        return getSnapshot (channel).rms;
     }
 
     /**
@@ -309,7 +442,7 @@ JUCE_COMPILER_WARNING("The use of levels.resize() is not realtime safe. Please c
      */
     bool getClipFlag (const int channel) const
     {
-        return levels.at (size_t (channel)).clip;
+        return getSnapshot (channel).clip;
     }
 
     /**
@@ -318,12 +451,14 @@ JUCE_COMPILER_WARNING("The use of levels.resize() is not realtime safe. Please c
     void clearClipFlag (const int channel)
     {
         levels.at (size_t (channel)).clip = false;
+        getSnapshot (channel).clip = false;
     }
 
     void clearAllClipFlags ()
     {
-        for (ChannelData& l : levels) {
-            l.clip = false;
+        for (size_t channel=0; channel < levels.size(); ++channel) {
+            levels [channel].clip = false;
+            getSnapshot (int (channel)).clip = false;
         }
     }
 
@@ -333,6 +468,7 @@ JUCE_COMPILER_WARNING("The use of levels.resize() is not realtime safe. Please c
     void clearMaxNum (const int channel)
     {
         levels.at (size_t (channel)).maxOverall = infinity;
+        getSnapshot (channel).maxOverall = infinity;
     }
 
     /**
@@ -340,8 +476,9 @@ JUCE_COMPILER_WARNING("The use of levels.resize() is not realtime safe. Please c
      */
     void clearAllMaxNums ()
     {
-        for (ChannelData& l : levels) {
-            l.maxOverall = infinity;
+        for (size_t channel=0; channel < levels.size(); ++channel) {
+            levels [channel].maxOverall = infinity;
+            getSnapshot (int (channel)).maxOverall = infinity;
         }
     }
 
@@ -378,9 +515,46 @@ private:
     friend class juce::WeakReference<LevelMeterSource>;
 
     constexpr static float infinity = -100.0f;
+    constexpr static int freshFlag = 4;
+
+    // fills the back buffer and swaps it with the middle one, audio thread only
+    void publish()
+    {
+        auto& back = snapshots [size_t (backIndex)];
+        const auto numChannels = std::min (back.size(), levels.size());
+
+        for (size_t channel=0; channel < numChannels; ++channel)
+        {
+            const auto& l = levels [channel];
+            back [channel].max        = l.max;
+            back [channel].maxOverall = l.maxOverall;
+            back [channel].rms        = l.getAvgRMS();
+            back [channel].clip       = l.clip;
+        }
+
+        backIndex = middleIndex.exchange (backIndex | freshFlag) & 3;
+        newDataFlag = true;
+    }
+
+    // takes the latest published buffer if there is one, GUI thread only
+    Snapshot& getSnapshot (const int channel) const
+    {
+        if (middleIndex.load() & freshFlag)
+            frontIndex = middleIndex.exchange (frontIndex) & 3;
+
+        return snapshots [size_t (frontIndex)].at (size_t (channel));
+    }
 
     std::vector<ChannelData> levels;
 
+    mutable std::vector<Snapshot> snapshots[3];
+    int backIndex = 0;
+    mutable std::atomic<int> middleIndex { 1 };
+    mutable int frontIndex = 2;
+
+    int blocksPerUpdate = 1;
+    int pendingBlocks = 0;
+
     juce::int64 holdMSecs;
 
     std::atomic<juce::int64> lastMeasurement;